@@ -55,3 +55,11 @@ Node* ASTAddNode::copyTree() {
 	}
 	return node;	
 }
+
+string ASTAddNode::differentiate(string variable) {
+	string derivative = "0.0";
+	for (int i = 0; i < jjtGetNumChildren(); i ++) {
+		derivative = addInfix(derivative, jjtGetChild(i)->differentiate(variable));
+	}
+	return derivative;
+}
@@ -38,3 +38,7 @@ Node* ASTExpression::copyTree() {
 	}
 	return node;	
 }
+
+string ASTExpression::differentiate(string variable) {
+	return jjtGetChild(0)->differentiate(variable);
+}
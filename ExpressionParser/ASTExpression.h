@@ -13,6 +13,7 @@ public:
 	double evaluate(int evalType, double* values=0); 
 
 	Node* copyTree();
+	string differentiate(string variable);
 
 private:
 	ASTExpression();
@@ -6,6 +6,7 @@ using std::min;
 using std::max;
 
 #include "ASTFuncNode.h"
+#include "ASTPowerNode.h"
 #include "RuntimeException.h"
 #include "ExpressionException.h"
 #include "MathUtil.h"
@@ -675,3 +676,130 @@ bool ASTFuncNode::equals(Node* node) {
 
 	return true;
 }
+
+/*
+ * chain rule: f'(u) * du for the functions of one argument;
+ * ceil and floor are piecewise constant, factorial and j1 have no derivative here
+ */
+string ASTFuncNode::differentiate(string variable) {
+	if (!dependsOn(variable)) {
+		return "0.0";
+	}
+	switch (funcType) {
+		case POW:
+			return ASTPowerNode::powerDerivative(jjtGetChild(0), jjtGetChild(1), variable);
+		case ATAN2: {
+			// d atan2(a, b) = (b * da - a * db) / (a * a + b * b)
+			string a = "(" + jjtGetChild(0)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+			string b = "(" + jjtGetChild(1)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+			string numerator = addInfix(multiplyInfix(b, jjtGetChild(0)->differentiate(variable)),
+				negateInfix(multiplyInfix(a, jjtGetChild(1)->differentiate(variable))));
+			return "(" + numerator + " / ((" + a + " * " + a + ") + (" + b + " * " + b + ")))";
+		}
+		case MAX:
+		case MIN: {
+			string a = "(" + jjtGetChild(0)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+			string b = "(" + jjtGetChild(1)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+			string op = funcType == MAX ? " >= " : " <= ";
+			string otherOp = funcType == MAX ? " < " : " > ";
+			return addInfix(multiplyInfix("(" + a + op + b + ")", jjtGetChild(0)->differentiate(variable)),
+				multiplyInfix("(" + a + otherOp + b + ")", jjtGetChild(1)->differentiate(variable)));
+		}
+		case CEIL:
+		case FLOOR:
+			return "0.0";
+		default:
+			break;
+	}
+
+	string u = "(" + jjtGetChild(0)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+	string uu = "(" + u + " * " + u + ")";
+	string outer;
+	switch (funcType) {
+		case EXP:
+			outer = "exp(" + u + ")";
+			break;
+		case SQRT:
+			outer = "(0.5 / sqrt(" + u + "))";
+			break;
+		case ABS:
+			outer = "((" + u + " > 0.0) - (" + u + " < 0.0))";
+			break;
+		case LOG:
+			outer = "(1.0 / " + u + ")";
+			break;
+		case SIN:
+			outer = "cos(" + u + ")";
+			break;
+		case COS:
+			outer = "( - sin(" + u + "))";
+			break;
+		case TAN:
+			outer = "(sec(" + u + ") ^ 2.0)";
+			break;
+		case ASIN:
+			outer = "(1.0 / sqrt(1.0 - " + uu + "))";
+			break;
+		case ACOS:
+			outer = "( - 1.0 / sqrt(1.0 - " + uu + "))";
+			break;
+		case ATAN:
+			outer = "(1.0 / (1.0 + " + uu + "))";
+			break;
+		case CSC:
+			outer = "( - csc(" + u + ") * cot(" + u + "))";
+			break;
+		case COT:
+			outer = "( - (csc(" + u + ") ^ 2.0))";
+			break;
+		case SEC:
+			outer = "(sec(" + u + ") * tan(" + u + "))";
+			break;
+		case ACSC:
+			outer = "( - 1.0 / (abs(" + u + ") * sqrt(" + uu + " - 1.0)))";
+			break;
+		case ACOT:
+			outer = "( - 1.0 / (1.0 + " + uu + "))";
+			break;
+		case ASEC:
+			outer = "(1.0 / (abs(" + u + ") * sqrt(" + uu + " - 1.0)))";
+			break;
+		case SINH:
+			outer = "cosh(" + u + ")";
+			break;
+		case COSH:
+			outer = "sinh(" + u + ")";
+			break;
+		case TANH:
+			outer = "(sech(" + u + ") ^ 2.0)";
+			break;
+		case CSCH:
+			outer = "( - csch(" + u + ") * coth(" + u + "))";
+			break;
+		case COTH:
+			outer = "( - (csch(" + u + ") ^ 2.0))";
+			break;
+		case SECH:
+			outer = "( - sech(" + u + ") * tanh(" + u + "))";
+			break;
+		case ASINH:
+			outer = "(1.0 / sqrt(" + uu + " + 1.0))";
+			break;
+		case ACOSH:
+			outer = "(1.0 / sqrt(" + uu + " - 1.0))";
+			break;
+		case ATANH:
+		case ACOTH:
+			outer = "(1.0 / (1.0 - " + uu + "))";
+			break;
+		case ACSCH:
+			outer = "( - 1.0 / (abs(" + u + ") * sqrt(1.0 + " + uu + ")))";
+			break;
+		case ASECH:
+			outer = "( - 1.0 / (" + u + " * sqrt(1.0 - " + uu + ")))";
+			break;
+		default:
+			throw ExpressionException("cannot differentiate function " + funcName + "()");
+	}
+	return multiplyInfix(outer, jjtGetChild(0)->differentiate(variable));
+}
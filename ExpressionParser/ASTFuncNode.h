@@ -14,6 +14,7 @@ public:
 	double evaluate(int evalType, double* values=0); 
 
 	Node* copyTree();
+	string differentiate(string variable);
 	bool equals(Node* node);
 
 private:
@@ -152,3 +152,7 @@ bool ASTIdNode::equals(Node* node) {
 bool ASTIdNode::isConstant( ) const {
 	return false;
 }
+
+string ASTIdNode::differentiate(string variable) {
+	return name == variable ? "1.0" : "0.0";
+}
@@ -20,6 +20,7 @@ public:
 	void getSymbols(vector<string>& symbols, int language, NameScope* nameScope);
 
 	Node* copyTree();
+	string differentiate(string variable);
 	bool equals(Node* node);
 	/**
 	* @return false
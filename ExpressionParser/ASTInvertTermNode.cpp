@@ -49,3 +49,13 @@ Node* ASTInvertTermNode::copyTree() {
 	}
 	return node;	
 }
+
+// d(1/u) = - du / (u * u)
+string ASTInvertTermNode::differentiate(string variable) {
+	string du = jjtGetChild(0)->differentiate(variable);
+	if (du == "0.0") {
+		return du;
+	}
+	string u = "(" + jjtGetChild(0)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+	return "( - " + du + " / (" + u + " * " + u + "))";
+}
@@ -36,3 +36,7 @@ Node* ASTMinusTermNode::copyTree() {
 	}
 	return node;	
 }
+
+string ASTMinusTermNode::differentiate(string variable) {
+	return negateInfix(jjtGetChild(0)->differentiate(variable));
+}
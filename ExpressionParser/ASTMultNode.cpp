@@ -211,3 +211,27 @@ Node* ASTMultNode::copyTree() {
 	}
 	return node;	
 }
+
+// product rule, a divisor is a factor 1/u whose derivative comes from ASTInvertTermNode
+string ASTMultNode::differentiate(string variable) {
+	if (isBoolean()) {
+		return "0.0";
+	}
+	int numChildren = jjtGetNumChildren();
+	vector<string> factors(numChildren);
+	for (int i = 0; i < numChildren; i ++) {
+		string child = "(" + jjtGetChild(i)->infixString(LANGUAGE_DEFAULT, 0) + ")";
+		factors[i] = dynamic_cast<ASTInvertTermNode*>(jjtGetChild(i)) ? "(1.0 / " + child + ")" : child;
+	}
+	string derivative = "0.0";
+	for (int i = 0; i < numChildren; i ++) {
+		string term = jjtGetChild(i)->differentiate(variable);
+		for (int j = 0; j < numChildren && term != "0.0"; j ++) {
+			if (j != i) {
+				term = multiplyInfix(term, factors[j]);
+			}
+		}
+		derivative = addInfix(derivative, term);
+	}
+	return derivative;
+}
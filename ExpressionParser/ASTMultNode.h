@@ -14,6 +14,7 @@ public:
 	bool isBoolean();
 
 	Node* copyTree();
+	string differentiate(string variable);
 
 private:
 	ASTMultNode();
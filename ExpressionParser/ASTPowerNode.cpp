@@ -123,3 +123,27 @@ Node* ASTPowerNode::copyTree() {
 	}
 	return node;	
 }
+
+string ASTPowerNode::differentiate(string variable) {
+	return powerDerivative(jjtGetChild(0), jjtGetChild(1), variable);
+}
+
+/*
+ * d(u ^ v) = v * u ^ (v - 1) * du if v is constant,
+ *            u ^ v * (dv * log(u) + v * du / u) otherwise
+ */
+string ASTPowerNode::powerDerivative(Node* base, Node* exponent, string variable) {
+	string du = base->differentiate(variable);
+	string dv = exponent->differentiate(variable);
+	if (du == "0.0" && dv == "0.0") {
+		return "0.0";
+	}
+	string u = "(" + base->infixString(LANGUAGE_DEFAULT, 0) + ")";
+	string v = "(" + exponent->infixString(LANGUAGE_DEFAULT, 0) + ")";
+	if (dv == "0.0") {
+		return multiplyInfix("(" + v + " * (" + u + " ^ (" + v + " - 1.0)))", du);
+	}
+	string logTerm = multiplyInfix(dv, "log(" + u + ")");
+	string baseTerm = du == "0.0" ? du : "(" + v + " * " + du + " / " + u + ")";
+	return multiplyInfix("(" + u + " ^ " + v + ")", addInfix(logTerm, baseTerm));
+}
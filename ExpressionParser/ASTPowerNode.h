@@ -13,6 +13,9 @@ public:
 	double evaluate(int evalType, double* values=0); 
 
 	Node* copyTree();
+	string differentiate(string variable);
+	// derivative of u ^ v, also used by pow(u, v)
+	static string powerDerivative(Node* base, Node* exponent, string variable);
 
 private:
 	ASTPowerNode();
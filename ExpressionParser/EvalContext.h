@@ -0,0 +1,42 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef EVALCONTEXT_H
+#define EVALCONTEXT_H
+
+#include <vector>
+using std::vector;
+
+// number of element indices a context carries, at least the VAR_INDEX of the simulation
+#define EVAL_CONTEXT_NUM_INDICES 8
+
+/*-----------------------------------------------------------
+	state of one evaluation through value proxies: the element
+	indices the proxies read their arrays at, time and coordinates,
+	and the working stack of the stack machine. Expressions
+	evaluated with different contexts share nothing that changes,
+	so each thread can use its own.
+ ------------------------------------------------------------*/
+class EvalContext
+{
+public:
+	EvalContext() {
+		for (int i = 0; i < EVAL_CONTEXT_NUM_INDICES; i ++) {
+			indices[i] = -1;
+		}
+		time = 0;
+		x = 0;
+		y = 0;
+		z = 0;
+	}
+
+	int indices[EVAL_CONTEXT_NUM_INDICES];
+	double time;
+	double x;
+	double y;
+	double z;
+	vector<double> stack;
+};
+
+#endif
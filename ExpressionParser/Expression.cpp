@@ -13,6 +13,7 @@ using std::istringstream;
 #include "ParseException.h"
 #include "ParserException.h"
 #include "StackMachine.h"
+#include "EvalContext.h"
 
 //long Expression::flattenCount = 0;
 //long Expression::diffCount = 0;
@@ -136,6 +137,17 @@ double Expression::evaluateVector(double* values)
 	}
 }
 
+void Expression::evaluateBatch(int numPoints, double** columns, double* result)
+{
+	// filled with the values of a point only if the point has to be evaluated on its own
+	vector<double> values;
+	try {
+		getStackMachine()->evaluateBatch(numPoints, columns, result, values);
+	} catch (Exception& ex) {
+		Exception::rethrowException(ex, ex.getMessage()+ " in " + getEvaluationSummary(&values[0]));
+	}
+}
+
 void Expression::parseExpression(string exp)
 {
 	//parseCount++;
@@ -189,7 +201,11 @@ string Expression::trim(string str)
 	return ((st > 0) || (len < (int)str.length())) ?  str.substr(st, len-st) : str;
 }
 
-inline StackMachine* Expression::getStackMachine() {
+void Expression::createStackMachine() {
+	getStackMachine();
+}
+
+StackMachine* Expression::getStackMachine() {
 	if (stackMachine == NULL) {
 		vector<StackElement> elements_vector;
 		rootNode->getStackElements(elements_vector);
@@ -216,6 +232,18 @@ double Expression::evaluateProxy() {
 	return evaluateVector(0);
 }
 
+double Expression::evaluate(EvalContext& context) {
+	StackMachine* machine = getStackMachine();
+	try {
+		return machine->evaluate(context);
+	} catch (Exception& ex) {
+		vector<double> values;
+		machine->getProxyValues(context, values);
+		Exception::rethrowException(ex, ex.getMessage()+ " in " + getEvaluationSummary(values.empty() ? 0 : &values[0]));
+		throw; // not reached, rethrowException always throws
+	}
+}
+
 void Expression::substituteInPlace(Expression* origExp, Expression* newExp) {
 	Node* origNode = origExp->rootNode;
 	Node* newNode = newExp->rootNode->copyTree();
@@ -235,3 +263,113 @@ bool Expression::isConstant( ) const {
 	}
 	return false;
 }
+
+Expression* Expression::differentiate(string variable) {
+	return new Expression(rootNode->differentiate(variable));
+}
+
+// a constant (no factors) or coefficient * (x1 - n1) * (x2 - n2) * ..., on the stack of getProductForm
+struct ProductTerm {
+	double coefficient;
+	vector<int> symbolIndexes;
+	vector<double> offsets;
+};
+
+bool Expression::getProductForm(double& coefficient, vector<int>& symbolIndexes, vector<double>& offsets) {
+	StackMachine* machine = getStackMachine();
+	StackElement* elements = machine->getElements();
+	int size = machine->getNumElements();
+	vector<ProductTerm> stack;
+	for (int i = 0; i < size; i ++) {
+		StackElement& element = elements[i];
+		switch (element.type) {
+		case TYPE_FLOAT: {
+			ProductTerm term;
+			term.coefficient = element.value;
+			stack.push_back(term);
+			break;
+		}
+		case TYPE_IDENTIFIER: {
+			ProductTerm term;
+			term.coefficient = 1.0;
+			term.symbolIndexes.push_back(element.vectorIndex);
+			term.offsets.push_back(0.0);
+			stack.push_back(term);
+			break;
+		}
+		case TYPE_SUB: // negation
+			if (stack.empty()) {
+				return false;
+			}
+			stack.back().coefficient = -stack.back().coefficient;
+			break;
+		case TYPE_DIV: // reciprocal, of constants only
+			if (stack.empty() || !stack.back().symbolIndexes.empty() || stack.back().coefficient == 0.0) {
+				return false;
+			}
+			stack.back().coefficient = 1 / stack.back().coefficient;
+			break;
+		case TYPE_MULT: {
+			if (stack.size() < 2) {
+				return false;
+			}
+			ProductTerm arg2 = stack.back();
+			stack.pop_back();
+			ProductTerm& arg1 = stack.back();
+			arg1.coefficient *= arg2.coefficient;
+			arg1.symbolIndexes.insert(arg1.symbolIndexes.end(), arg2.symbolIndexes.begin(), arg2.symbolIndexes.end());
+			arg1.offsets.insert(arg1.offsets.end(), arg2.offsets.begin(), arg2.offsets.end());
+			break;
+		}
+		case TYPE_ADD: {
+			// constants, or a symbol shifted by a constant
+			if (stack.size() < 2) {
+				return false;
+			}
+			ProductTerm arg2 = stack.back();
+			stack.pop_back();
+			ProductTerm& arg1 = stack.back();
+			if (arg1.symbolIndexes.empty() && arg2.symbolIndexes.empty()) {
+				arg1.coefficient += arg2.coefficient;
+			} else if (arg2.symbolIndexes.empty() && arg1.symbolIndexes.size() == 1 && arg1.coefficient == 1.0) {
+				arg1.offsets[0] -= arg2.coefficient;
+			} else if (arg1.symbolIndexes.empty() && arg2.symbolIndexes.size() == 1 && arg2.coefficient == 1.0) {
+				arg2.offsets[0] -= arg1.coefficient;
+				arg1 = arg2;
+			} else {
+				return false;
+			}
+			break;
+		}
+		case TYPE_POW: {
+			// to a small whole constant power
+			if (stack.size() < 2 || !stack.back().symbolIndexes.empty()) {
+				return false;
+			}
+			double exponent = stack.back().coefficient;
+			stack.pop_back();
+			ProductTerm& base = stack.back();
+			if (exponent != (int)exponent || exponent < 1 || exponent > 10) {
+				return false;
+			}
+			ProductTerm power = base;
+			for (int k = 1; k < (int)exponent; k ++) {
+				power.coefficient *= base.coefficient;
+				power.symbolIndexes.insert(power.symbolIndexes.end(), base.symbolIndexes.begin(), base.symbolIndexes.end());
+				power.offsets.insert(power.offsets.end(), base.offsets.begin(), base.offsets.end());
+			}
+			base = power;
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+	if (stack.size() != 1) {
+		return false;
+	}
+	coefficient = stack[0].coefficient;
+	symbolIndexes = stack[0].symbolIndexes;
+	offsets = stack[0].offsets;
+	return true;
+}
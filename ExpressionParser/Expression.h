@@ -7,9 +7,13 @@ class SymbolTable;
 class SymbolTableEntry;
 class Node;
 class StackMachine;
+class EvalContext;
 
 namespace VCell {
 
+class ExpressionCompiler;
+class FusedExpressionProgram;
+
 class Expression
 {
 public:
@@ -29,6 +33,11 @@ public:
 	double evaluateVectorTree(double* values);
 	// exercise the new way of evaluating vector by using stack machine
 	double evaluateVector(double* values);
+	// evaluateVector at numPoints points at once, columns[i] holds the values of symbol i at every point
+	void evaluateBatch(int numPoints, double** columns, double* result);
+	// creates the stack machine of evaluateVector and evaluateBatch, otherwise created by the first
+	// of them; the bound expression can then be evaluated by threads at the same time
+	void createStackMachine();
 
 	string infix(void);
 	/**
@@ -42,11 +51,25 @@ public:
 
 	SymbolTableEntry* getSymbolBinding(string symbol);
 	double evaluateProxy();
+	// evaluateProxy() with the indices, coordinates and time of context, may run concurrently
+	// with other contexts once the expression has been evaluated
+	double evaluate(EvalContext& context);
 	
 	void showStackInstructions();
 	void substituteInPlace(Expression* origExp, Expression* newExp);
 	string infix_Visit(void);
 	bool isConstant( ) const;
+	/**
+	* new unbound expression for the derivative with respect to symbol variable, caller deletes it;
+	* throws ExpressionException if a function has no derivative
+	*/
+	Expression* differentiate(string variable);
+	/**
+	* true if the bound expression is coefficient * (x1 - n1) * (x2 - n2) * ... with x1, x2, ... symbols
+	* (vector indexes in symbolIndexes) and n1, n2, ... constants (in offsets), e.g. mass action kinetics;
+	* a constant expression is the product of no symbols
+	*/
+	bool getProductForm(double& coefficient, vector<int>& symbolIndexes, vector<double>& offsets);
 
 private:
 	Node  *rootNode;
@@ -59,11 +82,14 @@ private:
 	//static long bindCount;
 	void parseExpression(string exp);
 	StackMachine* stackMachine;
-	inline StackMachine* getStackMachine();
+	StackMachine* getStackMachine();
 	/**
 	* common ctor code
 	*/ 
 	void init(const string & expString);
+
+	friend class ExpressionCompiler;
+	friend class FusedExpressionProgram;
 };
 }
 #endif
@@ -0,0 +1,295 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+
+#include "ExpressionCompiler.h"
+#include "Expression.h"
+#include "StackMachine.h"
+#include "MathUtil.h"
+#include "Exception.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::stringstream;
+
+#if (!defined(WIN32) && !defined(WIN64))
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+#ifndef VCELL_EXPRESSION_CC
+#define VCELL_EXPRESSION_CC "cc"
+#endif
+
+using VCell::Expression;
+using VCell::ExpressionCompiler;
+
+//
+// functions the generated code does not get from libm, called through a table
+// so that native and interpreted evaluation share the same implementation
+//
+enum RUNTIME_FUNCTION {RT_ROUND = 0, RT_ACSC, RT_ACOT, RT_ASEC, RT_CSCH, RT_COTH, RT_SECH,
+	RT_ASINH, RT_ACOSH, RT_ATANH, RT_ACSCH, RT_ACOTH, RT_ASECH, RT_FACTORIAL, RT_J1,
+	NUM_RUNTIME_FUNCTIONS};
+
+typedef double (*RuntimeFunction)(double);
+
+static double runtime_j1(double x) {
+	return j1(x);
+}
+
+static RuntimeFunction runtimeFunctions[NUM_RUNTIME_FUNCTIONS] = {
+	MathUtil::round, MathUtil::acsc, MathUtil::acot, MathUtil::asec, MathUtil::csch, MathUtil::coth, MathUtil::sech,
+	MathUtil::asinh, MathUtil::acosh, MathUtil::atanh, MathUtil::acsch, MathUtil::acoth, MathUtil::asech, MathUtil::factorial, runtime_j1
+};
+
+static const char* RUNTIME_INIT_FUNCTION = "vcell_expression_init";
+static const char* FUNCTION_PREFIX = "vcell_expression_";
+
+void ExpressionCompiler::add(Expression* expression) {
+	expressionList.push_back(expression);
+}
+
+string ExpressionCompiler::getCompilerCommand() {
+	const char* cc = getenv("VCELL_EXPRESSION_CC");
+	if (cc != 0 && cc[0] != '\0') {
+		return cc;
+	}
+	return VCELL_EXPRESSION_CC;
+}
+
+//
+// every stack slot becomes a local variable s<depth>; a program is only translated if
+// each instruction sees the same stack depth on every path reaching it (see StackMachine::computeStackDepths)
+//
+string ExpressionCompiler::translate(StackElement* elements, int size, const string& functionName) {
+	vector<int> depth;
+	int maxDepth = StackMachine::computeStackDepths(elements, size, depth);
+	if (maxDepth < 0) {
+		return "";
+	}
+	vector<bool> isTarget(size + 1, false);
+	for (int i = 0; i < size; i ++) {
+		if (elements[i].type == TYPE_BZ) {
+			isTarget[i + elements[i].branchOffset] = true;
+		}
+	}
+
+	stringstream ss;
+	ss.precision(17);
+	ss << "int " << functionName << "(const double* v, double* r)\n{\n\tdouble s0";
+	for (int k = 1; k < maxDepth; k ++) {
+		ss << ", s" << k;
+	}
+	ss << ";\n";
+	for (int i = 0; i < size; i ++) {
+		if (isTarget[i]) {
+			ss << "L" << i << ": ;\n";
+		}
+		StackElement& token = elements[i];
+		int top = depth[i] - 1;
+		string u = "s" + std::to_string(top);
+		string a = "s" + std::to_string(top - 1);
+		bool bCheck = true;
+		ss << "\t";
+		switch (token.type) {
+			case TYPE_BZ:
+				ss << "if (" << u << " == 0.0) goto L" << (i + token.branchOffset) << ";";
+				bCheck = false;
+				break;
+			case TYPE_LT: ss << a << " = " << a << " < " << u << ";"; bCheck = false; break;
+			case TYPE_GT: ss << a << " = " << a << " > " << u << ";"; bCheck = false; break;
+			case TYPE_LE: ss << a << " = " << a << " <= " << u << ";"; bCheck = false; break;
+			case TYPE_GE: ss << a << " = " << a << " >= " << u << ";"; bCheck = false; break;
+			case TYPE_EQ: ss << a << " = " << a << " == " << u << ";"; bCheck = false; break;
+			case TYPE_NE: ss << a << " = " << a << " != " << u << ";"; bCheck = false; break;
+			case TYPE_AND: ss << a << " = " << a << " && " << u << ";"; bCheck = false; break;
+			case TYPE_OR: ss << a << " = " << a << " || " << u << ";"; bCheck = false; break;
+			case TYPE_NOT: ss << u << " = !" << u << ";"; bCheck = false; break;
+			case TYPE_ADD: ss << a << " += " << u << ";"; break;
+			case TYPE_SUB: ss << u << " = -" << u << ";"; break;
+			case TYPE_MULT: ss << a << " *= " << u << ";"; break;
+			case TYPE_DIV: ss << "if (" << u << " == 0.0) return 1; " << u << " = 1/" << u << ";"; break;
+			case TYPE_FLOAT:
+				u = "s" + std::to_string(top + 1);
+				if (token.value != token.value || fabs(token.value) == MathUtil::double_infinity) {
+					ss << "return 1;";
+				} else {
+					ss << u << " = " << token.value << ";";
+				}
+				bCheck = false;
+				break;
+			case TYPE_IDENTIFIER:
+				u = "s" + std::to_string(top + 1);
+				ss << u << " = v[" << token.vectorIndex << "];";
+				break;
+			case TYPE_EXP: ss << u << " = exp(" << u << ");"; break;
+			case TYPE_SQRT: ss << "if (" << u << " < 0) return 1; " << u << " = sqrt(" << u << ");"; break;
+			case TYPE_ABS: ss << u << " = fabs(" << u << ");"; break;
+			case TYPE_POW:
+				ss << "if (" << a << " < 0.0 && rt[" << RT_ROUND << "](" << u << ") != " << u << ") return 1; "
+					<< "if (" << a << " == 0.0 && " << u << " < 0) return 1; "
+					<< "if (" << u << " == 0.0 || " << a << " == 1.0) " << a << " = 1.0; "
+					<< "else { " << a << " = pow(" << a << ", " << u << "); if (!isfinite(" << a << ")) return 1; }";
+				break;
+			case TYPE_LOG: ss << "if (" << u << " <= 0.0) return 1; " << u << " = log(" << u << ");"; break;
+			case TYPE_SIN: ss << u << " = sin(" << u << ");"; break;
+			case TYPE_COS: ss << u << " = cos(" << u << ");"; break;
+			case TYPE_TAN: ss << u << " = tan(" << u << ");"; break;
+			case TYPE_ASIN: ss << "if (fabs(" << u << ") > 1.0) return 1; " << u << " = asin(" << u << ");"; break;
+			case TYPE_ACOS: ss << "if (fabs(" << u << ") > 1.0) return 1; " << u << " = acos(" << u << ");"; break;
+			case TYPE_ATAN: ss << u << " = atan(" << u << ");"; break;
+			case TYPE_ATAN2: ss << a << " = atan2(" << a << ", " << u << ");"; break;
+			// same operand order as std::max/std::min
+			case TYPE_MAX: ss << a << " = (" << a << " < " << u << ") ? " << u << " : " << a << ";"; break;
+			case TYPE_MIN: ss << a << " = (" << u << " < " << a << ") ? " << u << " : " << a << ";"; break;
+			case TYPE_CEIL: ss << u << " = ceil(" << u << ");"; break;
+			case TYPE_FLOOR: ss << u << " = floor(" << u << ");"; break;
+			case TYPE_CSC: ss << u << " = sin(" << u << "); if (" << u << " == 0) return 1; " << u << " = 1/" << u << ";"; break;
+			case TYPE_COT: ss << u << " = tan(" << u << "); if (" << u << " == 0) return 1; " << u << " = 1/" << u << ";"; break;
+			case TYPE_SEC: ss << u << " = cos(" << u << "); if (" << u << " == 0) return 1; " << u << " = 1/" << u << ";"; break;
+			case TYPE_ACSC: ss << "if (fabs(" << u << ") < 1.0) return 1; " << u << " = rt[" << RT_ACSC << "](" << u << ");"; break;
+			case TYPE_ACOT: ss << u << " = rt[" << RT_ACOT << "](" << u << ");"; break;
+			case TYPE_ASEC: ss << "if (fabs(" << u << ") < 1.0) return 1; " << u << " = rt[" << RT_ASEC << "](" << u << ");"; break;
+			case TYPE_SINH: ss << u << " = sinh(" << u << ");"; break;
+			case TYPE_COSH: ss << u << " = cosh(" << u << ");"; break;
+			case TYPE_TANH: ss << u << " = tanh(" << u << ");"; break;
+			case TYPE_CSCH: ss << "if (" << u << " == 0.0) return 1; " << u << " = rt[" << RT_CSCH << "](" << u << ");"; break;
+			case TYPE_COTH: ss << "if (" << u << " == 0.0) return 1; " << u << " = rt[" << RT_COTH << "](" << u << ");"; break;
+			case TYPE_SECH: ss << u << " = rt[" << RT_SECH << "](" << u << ");"; break;
+			case TYPE_ASINH: ss << u << " = rt[" << RT_ASINH << "](" << u << ");"; break;
+			case TYPE_ACOSH: ss << "if (" << u << " < 1.0) return 1; " << u << " = rt[" << RT_ACOSH << "](" << u << ");"; break;
+			case TYPE_ATANH: ss << "if (fabs(" << u << ") >= 1.0) return 1; " << u << " = rt[" << RT_ATANH << "](" << u << ");"; break;
+			case TYPE_ACSCH: ss << "if (" << u << " == 0.0) return 1; " << u << " = rt[" << RT_ACSCH << "](" << u << ");"; break;
+			case TYPE_ACOTH: ss << "if (fabs(" << u << ") <= 1.0) return 1; " << u << " = rt[" << RT_ACOTH << "](" << u << ");"; break;
+			case TYPE_ASECH: ss << "if (" << u << " <= 0.0 || " << u << " > 1.0) return 1; " << u << " = rt[" << RT_ASECH << "](" << u << ");"; break;
+			case TYPE_FACTORIAL: ss << "if (" << u << " < 0.0 || (" << u << "-(int)" << u << ") != 0) return 1; " << u << " = rt[" << RT_FACTORIAL << "](" << u << ");"; break;
+			case TYPE_J1: ss << u << " = rt[" << RT_J1 << "](" << u << ");"; break;
+		}
+		if (bCheck) {
+			// binary operators leave their result one slot down
+			string result = u;
+			switch (token.type) {
+				case TYPE_ADD: case TYPE_MULT: case TYPE_POW: case TYPE_ATAN2: case TYPE_MAX: case TYPE_MIN:
+					result = a;
+					break;
+			}
+			ss << " if (!isfinite(" << result << ")) return 1;";
+		}
+		ss << "\n";
+	}
+	if (isTarget[size]) {
+		ss << "L" << size << ": ;\n";
+	}
+	ss << "\t*r = s0;\n\treturn 0;\n}\n\n";
+	return ss.str();
+}
+
+#if (defined(WIN32) || defined(WIN64))
+
+int ExpressionCompiler::compile() {
+	cout << "ExpressionCompiler: native expressions are not supported on Windows, using interpreter" << endl;
+	expressionList.clear();
+	return 0;
+}
+
+#else
+
+int ExpressionCompiler::compile() {
+	vector<StackMachine*> machines;
+	stringstream source;
+	source << "#include <math.h>\n\n"
+		<< "typedef double (*rt_function)(double);\n"
+		<< "static rt_function rt[" << NUM_RUNTIME_FUNCTIONS << "];\n\n"
+		<< "void " << RUNTIME_INIT_FUNCTION << "(const rt_function* table)\n{\n"
+		<< "\tint i;\n\tfor (i = 0; i < " << NUM_RUNTIME_FUNCTIONS << "; i ++) {\n\t\trt[i] = table[i];\n\t}\n}\n\n";
+	for (int i = 0; i < (int)expressionList.size(); i ++) {
+		StackMachine* stackMachine = 0;
+		try {
+			stackMachine = expressionList[i]->getStackMachine();
+		} catch (...) {
+			continue;
+		}
+		if (stackMachine->isCompiled()) {
+			continue;
+		}
+		stringstream name;
+		name << FUNCTION_PREFIX << machines.size();
+		string function = translate(stackMachine->getElements(), stackMachine->getNumElements(), name.str());
+		if (function.empty()) {
+			continue;
+		}
+		source << function;
+		machines.push_back(stackMachine);
+	}
+	expressionList.clear();
+	if (machines.size() == 0) {
+		return 0;
+	}
+
+	const char* tmpdir = getenv("TMPDIR");
+	string dirTemplate = string(tmpdir == 0 || tmpdir[0] == '\0' ? "/tmp" : tmpdir) + "/vcellexpXXXXXX";
+	vector<char> dirBuffer(dirTemplate.begin(), dirTemplate.end());
+	dirBuffer.push_back('\0');
+	if (mkdtemp(&dirBuffer[0]) == 0) {
+		cout << "ExpressionCompiler: failed to create temporary directory, using interpreter" << endl;
+		return 0;
+	}
+	string dir = &dirBuffer[0];
+	string sourceFile = dir + "/expressions.c";
+	string libraryFile = dir + "/expressions.so";
+	string logFile = dir + "/compile.log";
+	{
+		ofstream ofs(sourceFile.c_str());
+		ofs << source.str();
+	}
+
+	// no fused multiply-add, results must match the interpreter bit for bit
+	string command = getCompilerCommand() + " -O2 -fPIC -shared -ffp-contract=off -w -o \"" + libraryFile
+		+ "\" \"" + sourceFile + "\" -lm > \"" + logFile + "\" 2>&1";
+	int returnCode = system(command.c_str());
+
+	void* handle = 0;
+	if (returnCode == 0) {
+		handle = dlopen(libraryFile.c_str(), RTLD_NOW | RTLD_LOCAL);
+	}
+	if (handle == 0) {
+		cout << "ExpressionCompiler: failed to build native expressions (" << command << "), using interpreter" << endl;
+	}
+	remove(sourceFile.c_str());
+	remove(libraryFile.c_str());
+	remove(logFile.c_str());
+	rmdir(dir.c_str());
+	if (handle == 0) {
+		return 0;
+	}
+
+	typedef void (*InitFunction)(const RuntimeFunction*);
+	InitFunction init = (InitFunction)dlsym(handle, RUNTIME_INIT_FUNCTION);
+	if (init == 0) {
+		return 0;
+	}
+	init(runtimeFunctions);
+
+	int numCompiled = 0;
+	for (int i = 0; i < (int)machines.size(); i ++) {
+		stringstream name;
+		name << FUNCTION_PREFIX << i;
+		NativeStackFunction function = (NativeStackFunction)dlsym(handle, name.str().c_str());
+		if (function != 0) {
+			machines[i]->setNativeFunction(function);
+			numCompiled ++;
+		}
+	}
+	return numCompiled;
+}
+
+#endif
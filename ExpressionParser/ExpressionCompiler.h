@@ -0,0 +1,60 @@
+#ifndef VCELL_EXPRESSIONCOMPILER_H
+#define VCELL_EXPRESSIONCOMPILER_H
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+struct StackElement;
+
+namespace VCell {
+
+class Expression;
+
+/**
+ * Translates the stack machine programs of bound expressions into C, builds them
+ * into one shared library with the system C compiler and attaches the resulting
+ * native functions to the expressions' stack machines.
+ *
+ * Only vector evaluation (Expression::evaluateVector(values)) uses native code;
+ * proxy evaluation stays in the interpreter. When native code detects a domain or
+ * range error it reports failure and the interpreter re-evaluates the point, so the
+ * exception type and message are exactly those of the interpreter.
+ *
+ * If no compiler is available (or on Windows) compile() returns 0 and every
+ * expression keeps using the interpreter. The library stays loaded until the
+ * process exits.
+ *
+ * The compiler command defaults to the C compiler VCell was built with and can be
+ * overridden with the VCELL_EXPRESSION_CC environment variable.
+ */
+class ExpressionCompiler
+{
+public:
+	/**
+	* expression must be bound and remain valid memory until compile() returns;
+	* expressions that cannot be lowered to a stack program (e.g. unbound) are skipped
+	*/
+	void add(Expression* expression);
+	int getNumExpressions() { return (int)expressionList.size(); }
+
+	/**
+	* returns the number of expressions that now evaluate natively
+	*/
+	int compile();
+
+	/**
+	* C source of one function evaluating the stack program, empty if the program
+	* cannot be translated (e.g. inconsistent stack depth)
+	*/
+	static string translate(StackElement* elements, int size, const string& functionName);
+
+private:
+	vector<Expression*> expressionList;
+
+	static string getCompilerCommand();
+};
+
+}
+#endif
@@ -0,0 +1,384 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+
+#include "FusedExpressionProgram.h"
+#include "Expression.h"
+#include "StackMachine.h"
+#include "MathUtil.h"
+#include <math.h>
+#include <string.h>
+#include <limits>
+#include <algorithm>
+using std::max;
+using std::min;
+
+using VCell::Expression;
+using VCell::FusedExpressionProgram;
+
+// the value of anything the interpreter would throw on
+static const double POISON = std::numeric_limits<double>::quiet_NaN();
+
+FusedExpressionProgram::FusedExpressionProgram() {
+	numSourceOperations = 0;
+	bBuilt = false;
+	numRegisters = 0;
+}
+
+void FusedExpressionProgram::setConstantSymbol(int symbolIndex, double value) {
+	constantSymbols[symbolIndex] = value;
+}
+
+bool FusedExpressionProgram::add(Expression* expression) {
+	StackMachine* stackMachine = expression->getStackMachine();
+	StackElement* elements = stackMachine->getElements();
+	int size = stackMachine->getNumElements();
+	vector<int> depths;
+	if (StackMachine::computeStackDepths(elements, size, depths) < 1) {
+		return false;
+	}
+
+	// run the program on nodes instead of values. A branch taken leaves the tested
+	// (zero) value where the fall through path leaves its result, so at the target
+	// the top of the stack becomes a select on each condition branching there
+	vector<int> stack;
+	vector<vector<int> > branchConditions(size + 1);
+	for (int i = 0; i <= size; i ++) {
+		vector<int>& conditions = branchConditions[i];
+		for (int b = (int)conditions.size() - 1; b >= 0; b --) {
+			stack.back() = addNode(TYPE_BZ, conditions[b], stack.back());
+		}
+		if (i == size) {
+			break;
+		}
+		StackElement& token = elements[i];
+		switch (token.type) {
+			case TYPE_FLOAT:
+				stack.push_back(addConstantNode(token.value));
+				break;
+			case TYPE_IDENTIFIER: {
+				map<int, double>::iterator iter = constantSymbols.find(token.vectorIndex);
+				if (iter != constantSymbols.end()) {
+					stack.push_back(addConstantNode(iter->second));
+				} else {
+					Node node = {TYPE_IDENTIFIER, -1, -1, token.vectorIndex, 0};
+					stack.push_back(findOrAddNode(node));
+				}
+				break;
+			}
+			case TYPE_BZ:
+				numSourceOperations ++;
+				branchConditions[i + token.branchOffset].push_back(stack.back());
+				stack.pop_back();
+				break;
+			case TYPE_LT: case TYPE_GT: case TYPE_LE: case TYPE_GE: case TYPE_EQ: case TYPE_NE:
+			case TYPE_AND: case TYPE_OR: case TYPE_ADD: case TYPE_MULT: case TYPE_POW:
+			case TYPE_ATAN2: case TYPE_MAX: case TYPE_MIN: {
+				numSourceOperations ++;
+				int right = stack.back();
+				stack.pop_back();
+				stack.back() = addNode(token.type, stack.back(), right);
+				break;
+			}
+			default:
+				numSourceOperations ++;
+				stack.back() = addNode(token.type, stack.back(), -1);
+				break;
+		}
+	}
+	outputNodes.push_back(stack.back());
+	bBuilt = false;
+	return true;
+}
+
+void FusedExpressionProgram::addConstant(double value) {
+	outputNodes.push_back(addConstantNode(value));
+	bBuilt = false;
+}
+
+int FusedExpressionProgram::addConstantNode(double value) {
+	Node node = {TYPE_FLOAT, -1, -1, -1, value};
+	return findOrAddNode(node);
+}
+
+int FusedExpressionProgram::addNode(int type, int arg0, int arg1) {
+	switch (type) {
+		case TYPE_ADD: case TYPE_MULT: case TYPE_AND: case TYPE_OR: case TYPE_EQ: case TYPE_NE:
+			if (arg0 > arg1) {
+				std::swap(arg0, arg1);
+			}
+			break;
+	}
+	bool bConstant0 = nodes[arg0].type == TYPE_FLOAT;
+	bool bConstant1 = arg1 < 0 || nodes[arg1].type == TYPE_FLOAT;
+	if (type == TYPE_BZ && bConstant0) {
+		double condition = nodes[arg0].value;
+		if (condition - condition != 0) {
+			return addConstantNode(POISON);
+		}
+		return condition != 0 ? arg1 : arg0;
+	}
+	// x * 1 is x, also when x is not finite
+	if (type == TYPE_MULT) {
+		if (bConstant0 && nodes[arg0].value == 1.0) {
+			return arg1;
+		}
+		if (bConstant1 && nodes[arg1].value == 1.0) {
+			return arg0;
+		}
+	}
+	if (bConstant0 && bConstant1) {
+		double result;
+		apply(type, 1, &nodes[arg0].value, arg1 < 0 ? 0 : &nodes[arg1].value, &result);
+		return addConstantNode(result);
+	}
+	Node node = {type, arg0, arg1, -1, 0};
+	return findOrAddNode(node);
+}
+
+int FusedExpressionProgram::findOrAddNode(const Node& node) {
+	long long valueBits;
+	memcpy(&valueBits, &node.value, sizeof(valueBits));
+	vector<long long> key(5);
+	key[0] = node.type;
+	key[1] = node.arg0;
+	key[2] = node.arg1;
+	key[3] = node.symbolIndex;
+	key[4] = valueBits;
+	map<vector<long long>, int>::iterator iter = nodeIndexes.find(key);
+	if (iter != nodeIndexes.end()) {
+		return iter->second;
+	}
+	int index = (int)nodes.size();
+	nodes.push_back(node);
+	nodeIndexes[key] = index;
+	return index;
+}
+
+int FusedExpressionProgram::getNumOperations() {
+	if (!bBuilt) {
+		build();
+	}
+	return (int)instructions.size();
+}
+
+void FusedExpressionProgram::build() {
+	int numNodes = (int)nodes.size();
+
+	// nodes only use earlier nodes, find the last use of every node needed by an output
+	vector<int> lastUse(numNodes, -1);
+	for (int k = 0; k < (int)outputNodes.size(); k ++) {
+		lastUse[outputNodes[k]] = numNodes;
+	}
+	for (int n = numNodes - 1; n >= 0; n --) {
+		if (lastUse[n] < 0) {
+			continue;
+		}
+		if (nodes[n].arg0 >= 0) {
+			lastUse[nodes[n].arg0] = max<int>(lastUse[nodes[n].arg0], n);
+		}
+		if (nodes[n].arg1 >= 0) {
+			lastUse[nodes[n].arg1] = max<int>(lastUse[nodes[n].arg1], n);
+		}
+	}
+
+	// one block of BATCH_BLOCK_SIZE values per register, reused once a value is no longer needed
+	instructions.clear();
+	nodeSlots.assign(numNodes, -1);
+	vector<int> freeRegisters;
+	numRegisters = 0;
+	int numConstants = 0;
+	for (int n = 0; n < numNodes; n ++) {
+		Node& node = nodes[n];
+		if (lastUse[n] < 0 || node.type == TYPE_IDENTIFIER) {
+			continue;
+		}
+		if (node.type == TYPE_FLOAT) {
+			nodeSlots[n] = numConstants ++;
+			continue;
+		}
+		int args[2] = {node.arg0, node.arg1};
+		for (int a = 0; a < 2; a ++) {
+			if (args[a] >= 0 && lastUse[args[a]] == n && nodes[args[a]].type != TYPE_FLOAT
+					&& nodes[args[a]].type != TYPE_IDENTIFIER && (a == 0 || args[1] != args[0])) {
+				freeRegisters.push_back(nodeSlots[args[a]]);
+			}
+		}
+		if (freeRegisters.size() > 0) {
+			nodeSlots[n] = freeRegisters.back();
+			freeRegisters.pop_back();
+		} else {
+			nodeSlots[n] = numRegisters ++;
+		}
+		Instruction instruction = {node.type, n, node.arg0, node.arg1};
+		instructions.push_back(instruction);
+	}
+
+	constants.assign(numConstants * BATCH_BLOCK_SIZE, 0);
+	for (int n = 0; n < numNodes; n ++) {
+		if (nodes[n].type == TYPE_FLOAT && nodeSlots[n] >= 0) {
+			std::fill_n(constants.begin() + nodeSlots[n] * BATCH_BLOCK_SIZE, BATCH_BLOCK_SIZE, nodes[n].value);
+		}
+	}
+	bBuilt = true;
+}
+
+const double* FusedExpressionProgram::locate(int node, double** columns, double* values, int offset, double* workspace) {
+	switch (nodes[node].type) {
+		case TYPE_FLOAT:
+			return &constants[nodeSlots[node] * BATCH_BLOCK_SIZE];
+		case TYPE_IDENTIFIER:
+			return columns == 0 ? values + nodes[node].symbolIndex : columns[nodes[node].symbolIndex] + offset;
+		default:
+			return workspace + nodeSlots[node] * BATCH_BLOCK_SIZE;
+	}
+}
+
+void FusedExpressionProgram::execute(int numPoints, double** columns, double* values, int offset, double* workspace) {
+	for (int i = 0; i < (int)instructions.size(); i ++) {
+		Instruction& instruction = instructions[i];
+		apply(instruction.type, numPoints, locate(instruction.arg0, columns, values, offset, workspace),
+			instruction.arg1 < 0 ? 0 : locate(instruction.arg1, columns, values, offset, workspace),
+			workspace + nodeSlots[instruction.result] * BATCH_BLOCK_SIZE);
+	}
+}
+
+bool FusedExpressionProgram::evaluate(double* values, double* outputs) {
+	if (!bBuilt) {
+		build();
+	}
+	registers.resize(max<int>(numRegisters * BATCH_BLOCK_SIZE, 1));
+	execute(1, 0, values, 0, &registers[0]);
+	int bError = 0;
+	for (int k = 0; k < (int)outputNodes.size(); k ++) {
+		outputs[k] = *locate(outputNodes[k], 0, values, 0, &registers[0]);
+		bError |= (outputs[k] - outputs[k] != 0);
+	}
+	return bError == 0;
+}
+
+bool FusedExpressionProgram::evaluateBatch(int numPoints, double** columns, double** outputs) {
+	return evaluateBatch(numPoints, columns, outputs, registers);
+}
+
+int FusedExpressionProgram::getWorkspaceSize() {
+	if (!bBuilt) {
+		build();
+	}
+	return max<int>(numRegisters * BATCH_BLOCK_SIZE, 1);
+}
+
+bool FusedExpressionProgram::evaluateBatch(int numPoints, double** columns, double** outputs, vector<double>& workspace) {
+	if ((int)workspace.size() < getWorkspaceSize()) {
+		workspace.resize(getWorkspaceSize());
+	}
+	return evaluateBatch(numPoints, columns, outputs, &workspace[0]);
+}
+
+bool FusedExpressionProgram::evaluateBatch(int numPoints, double** columns, double** outputs, double* workspace) {
+	if (!bBuilt) {
+		build();
+	}
+	for (int offset = 0; offset < numPoints; offset += BATCH_BLOCK_SIZE) {
+		int blockSize = min<int>(BATCH_BLOCK_SIZE, numPoints - offset);
+		execute(blockSize, columns, 0, offset, workspace);
+		int bError = 0;
+		for (int k = 0; k < (int)outputNodes.size(); k ++) {
+			const double* value = locate(outputNodes[k], columns, 0, offset, workspace);
+			double* output = outputs[k] + offset;
+			for (int p = 0; p < blockSize; p ++) {
+				output[p] = value[p];
+				bError |= (value[p] - value[p] != 0);
+			}
+		}
+		if (bError) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//
+// every operation gives POISON when an operand is not finite or when the interpreter
+// reports a domain error or a result that is not finite (x - x is 0 only for finite x)
+//
+#define FUSED_UNARY(domainError, expr) \
+	for (int p = 0; p < numPoints; p ++) { \
+		double u = left[p]; \
+		double r = (expr); \
+		result[p] = ((domainError) | (u - u != 0) | (r - r != 0)) ? POISON : r; \
+	} \
+	break;
+
+#define FUSED_BINARY(domainError, expr) \
+	for (int p = 0; p < numPoints; p ++) { \
+		double a = left[p]; \
+		double u = right[p]; \
+		double r = (expr); \
+		result[p] = ((domainError) | (a - a != 0) | (u - u != 0) | (r - r != 0)) ? POISON : r; \
+	} \
+	break;
+
+void FusedExpressionProgram::apply(int type, int numPoints, const double* left, const double* right, double* result) {
+	switch (type) {
+		case TYPE_BZ:
+			for (int p = 0; p < numPoints; p ++) {
+				double c = left[p];
+				result[p] = (c - c != 0) ? POISON : (c != 0 ? right[p] : c);
+			}
+			break;
+		case TYPE_LT: FUSED_BINARY(0, a < u)
+		case TYPE_GT: FUSED_BINARY(0, a > u)
+		case TYPE_LE: FUSED_BINARY(0, a <= u)
+		case TYPE_GE: FUSED_BINARY(0, a >= u)
+		case TYPE_EQ: FUSED_BINARY(0, a == u)
+		case TYPE_NE: FUSED_BINARY(0, a != u)
+		case TYPE_AND: FUSED_BINARY(0, a && u)
+		case TYPE_OR: FUSED_BINARY(0, a || u)
+		case TYPE_NOT: FUSED_UNARY(0, !u)
+		case TYPE_ADD: FUSED_BINARY(0, a + u)
+		case TYPE_SUB: FUSED_UNARY(0, -u)
+		case TYPE_MULT: FUSED_BINARY(0, a * u)
+		case TYPE_DIV: FUSED_UNARY(u == 0.0, 1/u)
+		case TYPE_EXP: FUSED_UNARY(0, exp(u))
+		case TYPE_SQRT: FUSED_UNARY(u < 0, sqrt(u))
+		case TYPE_ABS: FUSED_UNARY(0, fabs(u))
+		case TYPE_POW: FUSED_BINARY((a < 0.0 && MathUtil::round(u) != u) || (a == 0.0 && u < 0), (u == 0.0 || a == 1.0) ? 1.0 : pow(a, u))
+		case TYPE_LOG: FUSED_UNARY(u <= 0.0, log(u))
+		case TYPE_SIN: FUSED_UNARY(0, sin(u))
+		case TYPE_COS: FUSED_UNARY(0, cos(u))
+		case TYPE_TAN: FUSED_UNARY(0, tan(u))
+		case TYPE_ASIN: FUSED_UNARY(fabs(u) > 1.0, asin(u))
+		case TYPE_ACOS: FUSED_UNARY(fabs(u) > 1.0, acos(u))
+		case TYPE_ATAN: FUSED_UNARY(0, atan(u))
+		case TYPE_ATAN2: FUSED_BINARY(0, atan2(a, u))
+		case TYPE_MAX: FUSED_BINARY(0, max<double>(a, u))
+		case TYPE_MIN: FUSED_BINARY(0, min<double>(a, u))
+		case TYPE_CEIL: FUSED_UNARY(0, ceil(u))
+		case TYPE_FLOOR: FUSED_UNARY(0, floor(u))
+		case TYPE_CSC: FUSED_UNARY(sin(u) == 0, 1/sin(u))
+		case TYPE_COT: FUSED_UNARY(tan(u) == 0, 1/tan(u))
+		case TYPE_SEC: FUSED_UNARY(cos(u) == 0, 1/cos(u))
+		case TYPE_ACSC: FUSED_UNARY(fabs(u) < 1.0, MathUtil::acsc(u))
+		case TYPE_ACOT: FUSED_UNARY(0, MathUtil::acot(u))
+		case TYPE_ASEC: FUSED_UNARY(fabs(u) < 1.0, MathUtil::asec(u))
+		case TYPE_SINH: FUSED_UNARY(0, sinh(u))
+		case TYPE_COSH: FUSED_UNARY(0, cosh(u))
+		case TYPE_TANH: FUSED_UNARY(0, tanh(u))
+		case TYPE_CSCH: FUSED_UNARY(u == 0.0, MathUtil::csch(u))
+		case TYPE_COTH: FUSED_UNARY(u == 0.0, MathUtil::coth(u))
+		case TYPE_SECH: FUSED_UNARY(0, MathUtil::sech(u))
+		case TYPE_ASINH: FUSED_UNARY(0, MathUtil::asinh(u))
+		case TYPE_ACOSH: FUSED_UNARY(u < 1.0, MathUtil::acosh(u))
+		case TYPE_ATANH: FUSED_UNARY(fabs(u) >= 1.0, MathUtil::atanh(u))
+		case TYPE_ACSCH: FUSED_UNARY(u == 0.0, MathUtil::acsch(u))
+		case TYPE_ACOTH: FUSED_UNARY(fabs(u) <= 1.0, MathUtil::acoth(u))
+		case TYPE_ASECH: FUSED_UNARY(u <= 0.0 || u > 1.0, MathUtil::asech(u))
+		// don't count up to a value that is rejected
+		case TYPE_FACTORIAL: FUSED_UNARY(u < 0.0 || u != floor(u), (u < 0.0 || u != floor(u)) ? 0.0 : MathUtil::factorial(u))
+		case TYPE_J1: FUSED_UNARY(0, j1(u))
+		default:
+			throw "FusedExpressionProgram::apply(), unknown operation";
+	}
+}
@@ -0,0 +1,122 @@
+#ifndef VCELL_FUSEDEXPRESSIONPROGRAM_H
+#define VCELL_FUSEDEXPRESSIONPROGRAM_H
+
+#include <vector>
+#include <map>
+using std::vector;
+using std::map;
+
+namespace VCell {
+
+class Expression;
+
+/**
+ * One program computing several bound expressions at once (e.g. the reaction
+ * rates of all the variables of a region), evaluated in vector mode like
+ * Expression::evaluateVector(values).
+ *
+ * The stack programs of the expressions are merged into one graph where
+ * - symbols declared constant (parameters) become constants,
+ * - operations on constants are folded,
+ * - identical subexpressions, within and across expressions, are computed once
+ *   (operands of commutative operations are put in a canonical order).
+ * Nothing is reassociated or otherwise rewritten, so each output is bit for bit
+ * the value the expression's own stack machine computes.
+ *
+ * A branch of the stack machine (boolean factors of a product) becomes a select,
+ * and a value the interpreter would reject (domain error, division by zero,
+ * infinity or NaN) is carried as NaN through every operation that uses it.
+ * An output is therefore not finite exactly when evaluating its expression
+ * throws; evaluate() and evaluateBatch() then return false and the caller is
+ * expected to evaluate the expressions one by one to get the exception.
+ *
+ * The program is finished by the first evaluation or getNumOperations(). After
+ * that, evaluateBatch() with a workspace per thread may run concurrently.
+ */
+class FusedExpressionProgram
+{
+public:
+	FusedExpressionProgram();
+
+	/**
+	* symbolIndex always has value, must be called before adding expressions
+	*/
+	void setConstantSymbol(int symbolIndex, double value);
+
+	/**
+	* adds expression as the next output. expression must be bound; returns false
+	* (and adds nothing) if its stack program cannot be merged
+	*/
+	bool add(Expression* expression);
+	void addConstant(double value);
+
+	int getNumOutputs() { return (int)outputNodes.size(); }
+	/**
+	* number of operations the expressions' stack machines execute, and the number
+	* left in the merged program
+	*/
+	int getNumSourceOperations() { return numSourceOperations; }
+	int getNumOperations();
+
+	/**
+	* outputs[k] = value of the k-th expression; returns false if any of them throws
+	*/
+	bool evaluate(double* values, double* outputs);
+	/**
+	* same at numPoints points, columns[i] holds the values of symbol i at every point
+	* (as for Expression::evaluateBatch) and outputs[k][p] receives output k at point p
+	*/
+	bool evaluateBatch(int numPoints, double** columns, double** outputs);
+	/**
+	* same with the intermediate values in workspace (resized as needed) instead of the program
+	*/
+	bool evaluateBatch(int numPoints, double** columns, double** outputs, vector<double>& workspace);
+	/**
+	* same with a workspace of getWorkspaceSize() values the caller allocated
+	*/
+	bool evaluateBatch(int numPoints, double** columns, double** outputs, double* workspace);
+	int getWorkspaceSize();
+
+private:
+	struct Node {
+		int type;		// STACK_ELEMENT_TYPE, TYPE_BZ is a select: arg1 if arg0 != 0, arg0 otherwise
+		int arg0;
+		int arg1;
+		int symbolIndex;
+		double value;
+	};
+	struct Instruction {
+		int type;
+		int result;
+		int arg0;
+		int arg1;
+	};
+
+	map<int, double> constantSymbols;
+	vector<Node> nodes;
+	map<vector<long long>, int> nodeIndexes;
+	vector<int> outputNodes;
+	int numSourceOperations;
+
+	// executable form, built on first evaluation: the values of node n are the block
+	// nodeSlots[n] of constants (for a constant) or of the workspace (for an operation)
+	bool bBuilt;
+	vector<Instruction> instructions;
+	vector<int> nodeSlots;
+	int numRegisters;
+	vector<double> constants;
+	vector<double> registers;
+
+	int addConstantNode(double value);
+	int addNode(int type, int arg0, int arg1);
+	int findOrAddNode(const Node& node);
+	void build();
+	// symbols are read from columns[symbol] + offset, or from values if columns is null
+	const double* locate(int node, double** columns, double* values, int offset, double* workspace);
+	void execute(int numPoints, double** columns, double* values, int offset, double* workspace);
+
+	static void apply(int type, int numPoints, const double* left, const double* right, double* result);
+};
+
+}
+#endif
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <typeinfo>
 #include <iostream>
+#include <algorithm>
 using std::cout;
 using std::endl;
 
@@ -238,3 +239,47 @@ bool Node::isConstant( ) const {
 	}
 	return true;
 }
+
+bool Node::dependsOn(string variable) {
+	vector<string> symbols;
+	getSymbols(symbols, LANGUAGE_DEFAULT, 0);
+	return std::find(symbols.begin(), symbols.end(), variable) != symbols.end();
+}
+
+string Node::differentiate(string variable) {
+	// logical values are piecewise constant
+	if (!dependsOn(variable) || isBoolean()) {
+		return "0.0";
+	}
+	throw ExpressionException("cannot differentiate '" + infixString(LANGUAGE_DEFAULT, 0) + "'");
+}
+
+string Node::addInfix(const string& a, const string& b) {
+	if (a == "0.0") {
+		return b;
+	}
+	if (b == "0.0") {
+		return a;
+	}
+	return "(" + a + " + " + b + ")";
+}
+
+string Node::multiplyInfix(const string& a, const string& b) {
+	if (a == "0.0" || b == "0.0") {
+		return "0.0";
+	}
+	if (a == "1.0") {
+		return b;
+	}
+	if (b == "1.0") {
+		return a;
+	}
+	return "(" + a + " * " + b + ")";
+}
+
+string Node::negateInfix(const string& a) {
+	if (a == "0.0") {
+		return a;
+	}
+	return "( - " + a + ")";
+}
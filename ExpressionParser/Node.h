@@ -60,10 +60,21 @@ public:
 	void substitute(Node* origNode, Node* newNode);
 	virtual bool equals(Node* node);
 	virtual bool isConstant( ) const;
+	/**
+	* infix of the derivative with respect to symbol variable, "0.0" if the node doesn't depend on it;
+	* throws ExpressionException for what has no derivative
+	*/
+	virtual string differentiate(string variable);
+	bool dependsOn(string variable);
 
 protected:
 	Node* parent;
 	Node** children;
 	int numChildren;
+
+	// infix of a + b, a * b and -a that drop the zeros and ones of derivatives
+	static string addInfix(const string& a, const string& b);
+	static string multiplyInfix(const string& a, const string& b);
+	static string negateInfix(const string& a);
 };
 #endif
@@ -18,6 +18,10 @@ public:
 		return value;
 	};
 
+	double evaluate(EvalContext& context) {
+		return value;
+	};
+
 	void setValue(double d) {
 		value = d;
 	}
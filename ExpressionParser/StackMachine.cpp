@@ -7,12 +7,14 @@
 #include "StackMachine.h"
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include "MathUtil.h"
 #include "DivideByZeroException.h"
 #include "FunctionDomainException.h"
 #include "FunctionRangeException.h"
 #include "Exception.h"
 #include "ValueProxy.h"
+#include "EvalContext.h"
 #include <iostream>
 #include <algorithm>
 using std::cout;
@@ -23,6 +25,11 @@ using std::min;
 StackMachine::StackMachine(StackElement* arg_elements, int size) {
 	elements = arg_elements;
 	elementSize = size;
+	nativeFunction = 0;
+	maxStackDepth = 0;
+	numSymbols = 0;
+	bHasBranch = false;
+	analyzeForBatch();
 }
 
 StackMachine::~StackMachine() {
@@ -58,7 +65,37 @@ void StackMachine::showInstructions(){
 }
 
 double StackMachine::evaluate(double* values){	
+	if (values != 0 && nativeFunction != 0) {
+		double result;
+		if (nativeFunction(values, &result) == 0) {
+			return result;
+		}
+		// native code hit a domain or range error, interpret to throw the same exception
+	}
 	double workingStack[20];
+	return interpret(values, 0, workingStack);
+}
+
+double StackMachine::evaluate(EvalContext& context) {
+	// no more values than instructions are ever on the stack
+	if ((int)context.stack.size() < elementSize) {
+		context.stack.resize(elementSize);
+	}
+	return interpret(0, &context, &context.stack[0]);
+}
+
+void StackMachine::getProxyValues(EvalContext& context, vector<double>& values) {
+	for (int i = 0; i < elementSize; i ++) {
+		if (elements[i].type == TYPE_IDENTIFIER && elements[i].valueProxy != 0) {
+			if ((int)values.size() <= elements[i].vectorIndex) {
+				values.resize(elements[i].vectorIndex + 1);
+			}
+			values[elements[i].vectorIndex] = elements[i].valueProxy->evaluate(context);
+		}
+	}
+}
+
+double StackMachine::interpret(double* values, EvalContext* context, double* workingStack) {
 	StackElement *token = elements;
 	double *tos = workingStack-1;
 	//
@@ -142,7 +179,9 @@ double StackMachine::evaluate(double* values){
 				*(++tos) = token->value; // push 1 float onto the stack.
 				break; 
 			case TYPE_IDENTIFIER: // 16, push 1
-				if (values == 0){
+				if (values == 0 && context != 0){
+					*(++tos) = token->valueProxy->evaluate(*context); // push identifier's value onto stack
+				} else if (values == 0){
 					*(++tos) = token->valueProxy->evaluate(); // push identifier's value onto stack
 				} else {
 					*(++tos) = values[token->vectorIndex]; // push identifier's value onto stack
@@ -393,3 +432,261 @@ double StackMachine::evaluate(double* values){
 	}		
 	return *tos;
 }
+
+int StackMachine::computeStackDepths(StackElement* elements, int size, vector<int>& depths) {
+	depths.assign(size + 1, -1);
+	if (size <= 0) {
+		return -1;
+	}
+	depths[0] = 0;
+	int maxDepth = 0;
+	for (int i = 0; i < size; i ++) {
+		int d = depths[i];
+		int next;
+		StackElement& token = elements[i];
+		switch (token.type) {
+			case TYPE_FLOAT:
+			case TYPE_IDENTIFIER:
+				next = d + 1;
+				break;
+			case TYPE_BZ: {
+				if (d < 1) {
+					return -1;
+				}
+				// the branch leaves the tested value on the stack
+				int target = i + token.branchOffset;
+				if (token.branchOffset <= 0 || target > size || (depths[target] >= 0 && depths[target] != d)) {
+					return -1;
+				}
+				depths[target] = d;
+				next = d - 1;
+				break;
+			}
+			case TYPE_LT: case TYPE_GT: case TYPE_LE: case TYPE_GE: case TYPE_EQ: case TYPE_NE:
+			case TYPE_AND: case TYPE_OR: case TYPE_ADD: case TYPE_MULT: case TYPE_POW:
+			case TYPE_ATAN2: case TYPE_MAX: case TYPE_MIN:
+				if (d < 2) {
+					return -1;
+				}
+				next = d - 1;
+				break;
+			default:
+				if (token.type < TYPE_NOT || token.type > TYPE_J1 || d < 1) {
+					return -1;
+				}
+				next = d;
+				break;
+		}
+		if (depths[i + 1] >= 0 && depths[i + 1] != next) {
+			return -1;
+		}
+		depths[i + 1] = next;
+		maxDepth = max<int>(maxDepth, next);
+	}
+	if (depths[size] != 1) {
+		return -1;
+	}
+	return maxDepth;
+}
+
+void StackMachine::analyzeForBatch() {
+	int depth = computeStackDepths(elements, elementSize, stackDepths);
+	maxStackDepth = (depth < 1 || depth > BATCH_MAX_STACK_DEPTH) ? -1 : depth;
+
+	symbolIndexes.clear();
+	numSymbols = 0;
+	bHasBranch = false;
+	branchTargets.assign(elementSize + 1, false);
+	for (int i = 0; i < elementSize; i ++) {
+		if (elements[i].type == TYPE_IDENTIFIER) {
+			int index = elements[i].vectorIndex;
+			if (std::find(symbolIndexes.begin(), symbolIndexes.end(), index) == symbolIndexes.end()) {
+				symbolIndexes.push_back(index);
+				numSymbols = max<int>(numSymbols, index + 1);
+			}
+		} else if (elements[i].type == TYPE_BZ && maxStackDepth > 0) {
+			bHasBranch = true;
+			branchTargets[i + elements[i].branchOffset] = true;
+		}
+	}
+}
+
+//
+// unary operators replace tos, binary operators pop tos and replace nos (next on stack).
+// domainError is the same test the interpreter throws on; the value computed for a bad point
+// is discarded because the block is evaluated again by the interpreter. With branches, every
+// point is computed and the result is only kept for active points, which keeps the loops
+// free of branches.
+//
+#define BATCH_UNARY(domainError, expr) \
+	for (int p = 0; p < numPoints; p ++) { \
+		double u = tos[p]; \
+		double r = (expr); \
+		if (bMasked) { \
+			bError |= active[p] & (domainError); \
+			tos[p] = active[p] ? r : u; \
+		} else { \
+			bError |= (domainError); \
+			tos[p] = r; \
+		} \
+	} \
+	break;
+
+#define BATCH_BINARY(domainError, expr) \
+	for (int p = 0; p < numPoints; p ++) { \
+		double a = nos[p]; \
+		double u = tos[p]; \
+		double r = (expr); \
+		if (bMasked) { \
+			bError |= active[p] & (domainError); \
+			nos[p] = active[p] ? r : a; \
+		} else { \
+			bError |= (domainError); \
+			nos[p] = r; \
+		} \
+	} \
+	break;
+
+#define BATCH_PUSH(expr) \
+	for (int p = 0; p < numPoints; p ++) { \
+		push[p] = (!bMasked || active[p]) ? (expr) : push[p]; \
+	} \
+	break;
+
+template <bool bMasked>
+bool StackMachine::evaluateBlock(int numPoints, double** columns, int offset, double* result) {
+	double workingStack[BATCH_MAX_STACK_DEPTH][BATCH_BLOCK_SIZE];
+	int active[BATCH_BLOCK_SIZE];
+	int resume[BATCH_BLOCK_SIZE];
+	if (bMasked) {
+		// inactive points compute on whatever is in their slots, make sure it is initialized
+		memset(workingStack, 0, sizeof(workingStack[0]) * maxStackDepth);
+		for (int p = 0; p < numPoints; p ++) {
+			active[p] = 1;
+			resume[p] = -1;
+		}
+	}
+	int bError = 0;
+	StackElement *token = elements;
+	for (int i = 0; i < elementSize; i ++, token ++) {
+		if (bMasked && branchTargets[i]) {
+			for (int p = 0; p < numPoints; p ++) {
+				active[p] |= (resume[p] == i);
+			}
+		}
+		int depth = stackDepths[i];
+		double* push = workingStack[depth];
+		double* tos = depth > 0 ? workingStack[depth - 1] : 0;
+		double* nos = depth > 1 ? workingStack[depth - 2] : 0;
+		switch (token->type) {
+			case TYPE_BZ:
+				if (bMasked) {
+					int target = i + token->branchOffset;
+					for (int p = 0; p < numPoints; p ++) {
+						if (active[p] && tos[p] == 0.0) {
+							active[p] = 0;
+							resume[p] = target;
+						}
+					}
+				}
+				break;
+			case TYPE_LT: BATCH_BINARY(0, a < u)
+			case TYPE_GT: BATCH_BINARY(0, a > u)
+			case TYPE_LE: BATCH_BINARY(0, a <= u)
+			case TYPE_GE: BATCH_BINARY(0, a >= u)
+			case TYPE_EQ: BATCH_BINARY(0, a == u)
+			case TYPE_NE: BATCH_BINARY(0, a != u)
+			case TYPE_AND: BATCH_BINARY(0, a && u)
+			case TYPE_OR: BATCH_BINARY(0, a || u)
+			case TYPE_NOT: BATCH_UNARY(0, !u)
+			case TYPE_ADD: BATCH_BINARY(0, a + u)
+			case TYPE_SUB: BATCH_UNARY(0, -u)
+			case TYPE_MULT: BATCH_BINARY(0, a * u)
+			case TYPE_DIV: BATCH_UNARY(u == 0.0, 1/u)
+			case TYPE_FLOAT: {
+				double value = token->value;
+				BATCH_PUSH(value)
+			}
+			case TYPE_IDENTIFIER: {
+				double* column = columns[token->vectorIndex] + offset;
+				BATCH_PUSH(column[p])
+			}
+			case TYPE_EXP: BATCH_UNARY(0, exp(u))
+			case TYPE_SQRT: BATCH_UNARY(u < 0, sqrt(u))
+			case TYPE_ABS: BATCH_UNARY(0, fabs(u))
+			case TYPE_POW: BATCH_BINARY((a < 0.0 && MathUtil::round(u) != u) || (a == 0.0 && u < 0), (u == 0.0 || a == 1.0) ? 1.0 : pow(a, u))
+			case TYPE_LOG: BATCH_UNARY(u <= 0.0, log(u))
+			case TYPE_SIN: BATCH_UNARY(0, sin(u))
+			case TYPE_COS: BATCH_UNARY(0, cos(u))
+			case TYPE_TAN: BATCH_UNARY(0, tan(u))
+			case TYPE_ASIN: BATCH_UNARY(fabs(u) > 1.0, asin(u))
+			case TYPE_ACOS: BATCH_UNARY(fabs(u) > 1.0, acos(u))
+			case TYPE_ATAN: BATCH_UNARY(0, atan(u))
+			case TYPE_ATAN2: BATCH_BINARY(0, atan2(a, u))
+			case TYPE_MAX: BATCH_BINARY(0, max<double>(a, u))
+			case TYPE_MIN: BATCH_BINARY(0, min<double>(a, u))
+			case TYPE_CEIL: BATCH_UNARY(0, ceil(u))
+			case TYPE_FLOOR: BATCH_UNARY(0, floor(u))
+			case TYPE_CSC: BATCH_UNARY(sin(u) == 0, 1/sin(u))
+			case TYPE_COT: BATCH_UNARY(tan(u) == 0, 1/tan(u))
+			case TYPE_SEC: BATCH_UNARY(cos(u) == 0, 1/cos(u))
+			case TYPE_ACSC: BATCH_UNARY(fabs(u) < 1.0, MathUtil::acsc(u))
+			case TYPE_ACOT: BATCH_UNARY(0, MathUtil::acot(u))
+			case TYPE_ASEC: BATCH_UNARY(fabs(u) < 1.0, MathUtil::asec(u))
+			case TYPE_SINH: BATCH_UNARY(0, sinh(u))
+			case TYPE_COSH: BATCH_UNARY(0, cosh(u))
+			case TYPE_TANH: BATCH_UNARY(0, tanh(u))
+			case TYPE_CSCH: BATCH_UNARY(u == 0.0, MathUtil::csch(u))
+			case TYPE_COTH: BATCH_UNARY(u == 0.0, MathUtil::coth(u))
+			case TYPE_SECH: BATCH_UNARY(0, MathUtil::sech(u))
+			case TYPE_ASINH: BATCH_UNARY(0, MathUtil::asinh(u))
+			case TYPE_ACOSH: BATCH_UNARY(u < 1.0, MathUtil::acosh(u))
+			case TYPE_ATANH: BATCH_UNARY(fabs(u) >= 1.0, MathUtil::atanh(u))
+			case TYPE_ACSCH: BATCH_UNARY(u == 0.0, MathUtil::acsch(u))
+			case TYPE_ACOTH: BATCH_UNARY(fabs(u) <= 1.0, MathUtil::acoth(u))
+			case TYPE_ASECH: BATCH_UNARY(u <= 0.0 || u > 1.0, MathUtil::asech(u))
+			// don't count up to a value that is rejected or not used
+			case TYPE_FACTORIAL: BATCH_UNARY(u < 0.0 || u != floor(u), (u < 0.0 || u != floor(u) || (bMasked && !active[p])) ? 0.0 : MathUtil::factorial(u))
+			case TYPE_J1: BATCH_UNARY(0, j1(u))
+			default:
+				return false;
+		}
+		// the interpreter's infinity and NaN test on the top of the stack, x - x is 0 only for finite x;
+		// a branch pushes nothing and may leave the stack empty, as the interpreter's tos >= workingStack
+		if (token->type != TYPE_BZ && stackDepths[i + 1] > 0) {
+			double* top = workingStack[stackDepths[i + 1] - 1];
+			for (int p = 0; p < numPoints; p ++) {
+				bError |= (!bMasked || active[p]) & (top[p] - top[p] != 0);
+			}
+		}
+		if (bError) {
+			return false;
+		}
+	}
+	for (int p = 0; p < numPoints; p ++) {
+		result[offset + p] = workingStack[0][p];
+	}
+	return true;
+}
+
+void StackMachine::evaluateBatch(int numPoints, double** columns, double* result, vector<double>& values) {
+	for (int offset = 0; offset < numPoints; offset += BATCH_BLOCK_SIZE) {
+		int blockSize = min<int>(BATCH_BLOCK_SIZE, numPoints - offset);
+		if (maxStackDepth > 0) {
+			bool bEvaluated = bHasBranch ? evaluateBlock<true>(blockSize, columns, offset, result)
+				: evaluateBlock<false>(blockSize, columns, offset, result);
+			if (bEvaluated) {
+				continue;
+			}
+		}
+		if ((int)values.size() < max<int>(numSymbols, 1)) {
+			values.resize(max<int>(numSymbols, 1), 0.0);
+		}
+		for (int p = offset; p < offset + blockSize; p ++) {
+			for (int s = 0; s < (int)symbolIndexes.size(); s ++) {
+				values[symbolIndexes[s]] = columns[symbolIndexes[s]][p];
+			}
+			result[p] = evaluate(&values[0]);
+		}
+	}
+}
@@ -1,6 +1,9 @@
 #ifndef STACKMACHINE_H
 #define STACKMACHINE_H
 
+#include <vector>
+using std::vector;
+
 /**
  * for expression: "(((1 < 2) * 3) + (5 * log(0.0) * (0.0 > 0.0)) + 2)"
  * 
@@ -39,6 +42,7 @@ enum STACK_ELEMENT_TYPE {TYPE_BZ = 1, TYPE_LT, TYPE_GT, TYPE_LE, TYPE_GE, TYPE_E
 	TYPE_ACOTH, TYPE_ASECH, TYPE_FACTORIAL,TYPE_J1};	// totally 52
 
 class ValueProxy;
+class EvalContext;
 
 struct StackElement {
     int type;
@@ -79,17 +83,65 @@ struct StackElement {
 	}
 };
 
+/**
+ * native translation of a stack program (see ExpressionCompiler), returns 0 and
+ * stores the value in result, or nonzero if evaluation would throw
+ */
+typedef int (*NativeStackFunction)(const double* values, double* result);
+
+// points interpreted together by evaluateBatch, and the deepest stack it handles
+#define BATCH_BLOCK_SIZE 64
+#define BATCH_MAX_STACK_DEPTH 20
+
 class StackMachine {
 private:
 	//double *workingStack;
 	StackElement* elements;
 	int elementSize;
+	NativeStackFunction nativeFunction;
+
+	// batch evaluation, computed by the constructor so that threads can share the machine
+	vector<int> stackDepths;
+	int maxStackDepth;	// -1 if the program can only be evaluated one point at a time
+	vector<int> symbolIndexes;
+	int numSymbols;
+	bool bHasBranch;
+	vector<bool> branchTargets;
+	void analyzeForBatch();
+	template <bool bMasked> bool evaluateBlock(int numPoints, double** columns, int offset, double* result);
+	// symbols come from values, or from their proxies (evaluated with context if it is not null)
+	double interpret(double* values, EvalContext* context, double* workingStack);
 
 public:
 	StackMachine(StackElement* arg_elements, int size);
 	~StackMachine();
 	double evaluate(double* values=0);	
+	// symbols from their proxies, at the indices of context, with the working stack of context
+	double evaluate(EvalContext& context);
+	// values[vectorIndex] = value of each symbol of the program in context, for error messages
+	void getProxyValues(EvalContext& context, vector<double>& values);
+	/**
+	 * evaluates the program at numPoints points. The input is a structure of arrays:
+	 * columns[vectorIndex][i] is the value of symbol vectorIndex at point i (columns of
+	 * unused symbols may be null). Each block of points runs through the instructions
+	 * together; a block in which some point would throw is evaluated again point by point
+	 * with evaluate(), gathering each point into values, so exceptions are unchanged and
+	 * values holds the offending point.
+	 */
+	void evaluateBatch(int numPoints, double** columns, double* result, vector<double>& values);
 	void showInstructions();
+
+	/**
+	 * fills depths[i] with the stack depth before instruction i (size+1 entries) and returns the
+	 * maximum depth, or -1 if the depth is not the same on every path or the program doesn't leave
+	 * exactly one value
+	 */
+	static int computeStackDepths(StackElement* elements, int size, vector<int>& depths);
+
+	StackElement* getElements() { return elements; }
+	int getNumElements() { return elementSize; }
+	void setNativeFunction(NativeStackFunction f) { nativeFunction = f; }
+	bool isCompiled() { return nativeFunction != 0; }
 };
 	
 #endif
@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "SimpleSymbolTable.h"
+#include "ValueProxy.h"
+#include "ScalarValueProxy.h"
+#include "EvalContext.h"
+#include "DivideByZeroException.h"
+#include <thread>
+
+using VCell::Expression;
+
+static string symbols[] = {"a", "b", "k"};
+static const int NUM_ELEMENTS = 100;
+
+class evalcontext_test : public ::testing::Test {
+protected:
+	double aValues[NUM_ELEMENTS];
+	double bValues[NUM_ELEMENTS];
+	int sharedIndices[EVAL_CONTEXT_NUM_INDICES];
+	ScalarValueProxy k;
+	ValueProxy* proxies[3];
+	SimpleSymbolTable* symbolTable;
+
+	void SetUp() {
+		for (int i = 0; i < NUM_ELEMENTS; i ++) {
+			aValues[i] = 0.5 + i;
+			bValues[i] = 2.0 - 0.03 * i;
+		}
+		for (int i = 0; i < EVAL_CONTEXT_NUM_INDICES; i ++) {
+			sharedIndices[i] = -1;
+		}
+		k.setValue(3);
+		// a is indexed by index 0, b by index 1
+		proxies[0] = new ValueProxy(aValues, 0, sharedIndices);
+		proxies[1] = new ValueProxy(bValues, 1, sharedIndices);
+		proxies[2] = &k;
+		symbolTable = new SimpleSymbolTable(symbols, 3, proxies);
+	}
+
+	void TearDown() {
+		delete symbolTable;
+		delete proxies[0];
+		delete proxies[1];
+	}
+
+	double evaluateShared(Expression& exp, int aIndex, int bIndex) {
+		sharedIndices[0] = aIndex;
+		sharedIndices[1] = bIndex;
+		return exp.evaluateProxy();
+	}
+};
+
+TEST_F(evalcontext_test, matches_shared_indices) {
+	Expression exp("a * b / (k + a) - (b > 1) * log(a);", *symbolTable);
+	EvalContext first;
+	EvalContext second;
+	for (int i = 0; i < NUM_ELEMENTS; i ++) {
+		first.indices[0] = i;
+		first.indices[1] = i;
+		second.indices[0] = NUM_ELEMENTS - 1 - i;
+		second.indices[1] = i / 2;
+		double firstValue = exp.evaluate(first);
+		double secondValue = exp.evaluate(second);
+		ASSERT_EQ(evaluateShared(exp, i, i), firstValue);
+		ASSERT_EQ(evaluateShared(exp, NUM_ELEMENTS - 1 - i, i / 2), secondValue);
+	}
+	// the shared indices are left alone
+	sharedIndices[0] = 7;
+	first.indices[0] = 8;
+	exp.evaluate(first);
+	ASSERT_EQ(7, sharedIndices[0]);
+}
+
+TEST_F(evalcontext_test, concurrent_contexts) {
+	Expression exp("pow(a, 2) + sqrt(abs(b)) * k - max(a, b);", *symbolTable);
+	double expected[NUM_ELEMENTS];
+	for (int i = 0; i < NUM_ELEMENTS; i ++) {
+		expected[i] = evaluateShared(exp, i, i);
+	}
+
+	const int NUM_THREADS = 4;
+	double results[NUM_THREADS][NUM_ELEMENTS];
+	vector<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; t ++) {
+		threads.push_back(std::thread([&exp, &results, t]() {
+			EvalContext context;
+			for (int repeat = 0; repeat < 50; repeat ++) {
+				for (int i = 0; i < NUM_ELEMENTS; i ++) {
+					context.indices[0] = i;
+					context.indices[1] = i;
+					results[t][i] = exp.evaluate(context);
+				}
+			}
+		}));
+	}
+	for (int t = 0; t < NUM_THREADS; t ++) {
+		threads[t].join();
+	}
+	for (int t = 0; t < NUM_THREADS; t ++) {
+		for (int i = 0; i < NUM_ELEMENTS; i ++) {
+			ASSERT_EQ(expected[i], results[t][i]);
+		}
+	}
+}
+
+TEST_F(evalcontext_test, reports_context_values) {
+	Expression exp("k / (a - 10.5);", *symbolTable);
+	EvalContext context;
+	context.indices[0] = 10;
+	try {
+		exp.evaluate(context);
+		FAIL() << "expected DivideByZeroException";
+	} catch (DivideByZeroException& ex) {
+		// the summary shows the value of a in the context
+		ASSERT_NE(string::npos, ex.getMessage().find("a = 10.5"));
+	}
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "SimpleSymbolTable.h"
+#include "StackMachine.h"
+#include "DivideByZeroException.h"
+#include "FunctionDomainException.h"
+#include "FunctionRangeException.h"
+
+using VCell::Expression;
+
+static string symbols[] = {"t", "x", "y"};
+
+static const char* expressionStrings[] = {
+	"x + y * t;",
+	"(x - y) / (t + 2);",
+	"x^2 + pow(y, 3) - sqrt(abs(x));",
+	"exp(-t) * sin(x) + cos(y) * tan(0.3);",
+	"(x > y) * 3 + (x <= y) * log(abs(y) + 1);",
+	"((x < 0.5) && (y > 0.1)) || !(t == 1);",
+	"max(x, y) - min(x, t) + ceil(y) - floor(x);",
+	"atan2(x, y + 3) + atan(x) + asinh(y) + sech(x);",
+	// the branch skips log() where it would throw
+	"(x > 0) * log(x) + (x <= 0) * 2;",
+	"((y > 0.5) * (x / y) + 1) * ((t > 0.5) * 2 + 3);",
+	"factorial(3) + j1(x) + acot(y + 5) + cosh(x) * tanh(y);",
+};
+
+// more points than one block, with a partial last block
+static const int NUM_POINTS = BATCH_BLOCK_SIZE * 2 + 7;
+
+class expressionbatch_test : public ::testing::Test {
+protected:
+	double columnValues[3][NUM_POINTS];
+	double* columns[3];
+
+	void SetUp() {
+		for (int p = 0; p < NUM_POINTS; p ++) {
+			columnValues[0][p] = (p % 3) * 0.5;
+			columnValues[1][p] = -1.0 + 0.013 * p;
+			columnValues[2][p] = 2.0 - 0.007 * p;
+		}
+		for (int i = 0; i < 3; i ++) {
+			columns[i] = columnValues[i];
+		}
+	}
+
+	double pointValue(Expression& exp, int p) {
+		double values[3] = {columnValues[0][p], columnValues[1][p], columnValues[2][p]};
+		return exp.evaluateVector(values);
+	}
+};
+
+TEST_F(expressionbatch_test, matches_interpreter) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	int numExpressions = sizeof(expressionStrings) / sizeof(expressionStrings[0]);
+	for (int i = 0; i < numExpressions; i ++) {
+		Expression exp(expressionStrings[i], symbolTable);
+		double result[NUM_POINTS];
+		exp.evaluateBatch(NUM_POINTS, columns, result);
+		for (int p = 0; p < NUM_POINTS; p ++) {
+			ASSERT_EQ(pointValue(exp, p), result[p]) << expressionStrings[i] << " at point " << p;
+		}
+	}
+}
+
+TEST_F(expressionbatch_test, same_exceptions) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	double result[NUM_POINTS];
+	Expression divide("1/x;", symbolTable);
+	columnValues[1][BATCH_BLOCK_SIZE + 3] = 0;
+	ASSERT_THROW(divide.evaluateBatch(NUM_POINTS, columns, result), DivideByZeroException);
+
+	Expression logarithm("log(y);", symbolTable);
+	columnValues[2][NUM_POINTS - 1] = -1;
+	ASSERT_THROW(logarithm.evaluateBatch(NUM_POINTS, columns, result), FunctionDomainException);
+
+	Expression overflow("exp(1000 * y);", symbolTable);
+	ASSERT_THROW(overflow.evaluateBatch(NUM_POINTS, columns, result), FunctionRangeException);
+}
+
+TEST_F(expressionbatch_test, constant_and_single_point) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	Expression constant("2.5 * 4;", symbolTable);
+	double result[NUM_POINTS];
+	constant.evaluateBatch(NUM_POINTS, columns, result);
+	for (int p = 0; p < NUM_POINTS; p ++) {
+		ASSERT_EQ(10.0, result[p]);
+	}
+
+	Expression exp("x * y + t;", symbolTable);
+	exp.evaluateBatch(1, columns, result);
+	ASSERT_EQ(pointValue(exp, 0), result[0]);
+}
+
+TEST_F(expressionbatch_test, leading_boolean_factor) {
+	// the branch of a leading boolean factor leaves the stack empty
+	SimpleSymbolTable symbolTable(symbols, 3);
+	const char* leadingStrings[] = {"(x > 1) * y;", "(t < 0.7) * (y > 0.5) * log(y);"};
+	for (int i = 0; i < 2; i ++) {
+		Expression exp(leadingStrings[i], symbolTable);
+		double result[NUM_POINTS];
+		exp.evaluateBatch(NUM_POINTS, columns, result);
+		for (int p = 0; p < NUM_POINTS; p ++) {
+			ASSERT_EQ(pointValue(exp, p), result[p]) << leadingStrings[i] << " at point " << p;
+		}
+	}
+}
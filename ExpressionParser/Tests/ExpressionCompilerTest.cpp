@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "ExpressionCompiler.h"
+#include "SimpleSymbolTable.h"
+#include "StackMachine.h"
+#include "DivideByZeroException.h"
+#include "FunctionDomainException.h"
+#include <math.h>
+
+using VCell::Expression;
+using VCell::ExpressionCompiler;
+
+static string symbols[] = {"t", "x", "y"};
+
+static const char* expressionStrings[] = {
+	"x + y * t;",
+	"(x - y) / (t + 2);",
+	"x^2 + pow(y, 3) - sqrt(abs(x));",
+	"exp(-t) * sin(x) + cos(y) * tan(0.3);",
+	"(x > y) * 3 + (x <= y) * log(abs(y) + 1);",
+	"((x < 0.5) && (y > 0.1)) || !(t == 1);",
+	"max(x, y) - min(x, t) + ceil(y) - floor(x);",
+	"atan2(x, y + 3) + atan(x) + asinh(y) + sech(x);",
+	"(t > 0.5) * (x / (y + 10)) + (t <= 0.5) * 1.0e-3;",
+	"factorial(3) + j1(x) + acot(y + 5) + cosh(x) * tanh(y);",
+};
+
+static double pointValues[][3] = {
+	{0.0, 0.25, 0.75},
+	{1.0, -0.5, 0.2},
+	{0.7, 2.0, -1.5},
+	{3.0, 0.0, 0.0},
+};
+
+TEST(expressioncompiler_test, matches_interpreter) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	int numExpressions = sizeof(expressionStrings) / sizeof(expressionStrings[0]);
+	vector<Expression*> compiled, interpreted;
+	ExpressionCompiler compiler;
+	for (int i = 0; i < numExpressions; i ++) {
+		compiled.push_back(new Expression(expressionStrings[i], symbolTable));
+		interpreted.push_back(new Expression(expressionStrings[i], symbolTable));
+		compiler.add(compiled[i]);
+	}
+	if (compiler.compile() != numExpressions) {
+		GTEST_SKIP() << "no C compiler available";
+	}
+	int numPoints = sizeof(pointValues) / sizeof(pointValues[0]);
+	for (int i = 0; i < numExpressions; i ++) {
+		for (int p = 0; p < numPoints; p ++) {
+			double expected = 0, actual = 0;
+			string expectedError, actualError;
+			try {
+				expected = interpreted[i]->evaluateVector(pointValues[p]);
+			} catch (VCell::Exception& ex) {
+				expectedError = ex.getMessage();
+			}
+			try {
+				actual = compiled[i]->evaluateVector(pointValues[p]);
+			} catch (VCell::Exception& ex) {
+				actualError = ex.getMessage();
+			}
+			ASSERT_EQ(expectedError, actualError) << expressionStrings[i];
+			ASSERT_EQ(expected, actual) << expressionStrings[i];
+		}
+		delete compiled[i];
+		delete interpreted[i];
+	}
+}
+
+TEST(expressioncompiler_test, same_exceptions) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	Expression divide("1/x;", symbolTable);
+	Expression logarithm("log(y - 1);", symbolTable);
+	ExpressionCompiler compiler;
+	compiler.add(&divide);
+	compiler.add(&logarithm);
+	if (compiler.compile() != 2) {
+		GTEST_SKIP() << "no C compiler available";
+	}
+	double values[3] = {0, 0, 0};
+	ASSERT_THROW(divide.evaluateVector(values), DivideByZeroException);
+	ASSERT_THROW(logarithm.evaluateVector(values), FunctionDomainException);
+	values[1] = 4;
+	values[2] = 3;
+	ASSERT_EQ(divide.evaluateVector(values), 0.25);
+	ASSERT_EQ(logarithm.evaluateVector(values), log(2.0));
+}
+
+TEST(expressioncompiler_test, rejects_bad_programs) {
+	StackElement zeroOffset[3];
+	zeroOffset[0] = StackElement(1.0);
+	zeroOffset[1] = StackElement(TYPE_BZ);
+	zeroOffset[2] = StackElement(2.0);
+	ASSERT_TRUE(ExpressionCompiler::translate(zeroOffset, 3, "f").empty());
+
+	StackElement underflow[2];
+	underflow[0] = StackElement(1.0);
+	underflow[1] = StackElement(TYPE_ADD);
+	ASSERT_TRUE(ExpressionCompiler::translate(underflow, 2, "f").empty());
+
+	StackElement ok[3];
+	ok[0] = StackElement(1.0);
+	ok[1] = StackElement(2.0);
+	ok[2] = StackElement(TYPE_ADD);
+	ASSERT_FALSE(ExpressionCompiler::translate(ok, 3, "f").empty());
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "SimpleSymbolTable.h"
+#include "ExpressionException.h"
+
+#include <math.h>
+
+using VCell::Expression;
+
+static string symbols[] = {"t", "x", "y"};
+
+// smooth at the test points, so central differences check the derivatives
+static const char* expressionStrings[] = {
+	"x + y * t;",
+	"(x - y) / (t + 2);",
+	"x^2 + pow(y, 3) - sqrt(abs(x)) + x^y;",
+	"exp(-t * x) * sin(x) + cos(y) * tan(x * 0.3);",
+	"(x > y) * 3 * x + (x <= y) * log(abs(y) + x);",
+	"max(x, y) - min(x * x, t) + ceil(y) - floor(x);",
+	"atan2(x, y + 3) + atan(x) + asinh(y) + sech(x) + acos(x / 4) + asin(y / 4);",
+	"- x / (1 + y * y) - 2 * x * y / (x + y + t);",
+	"cosh(x) * tanh(y) + sinh(x * y) + acot(y + 5) + csc(x) + sec(y) + cot(x);",
+	"acosh(x + 2) + atanh(y / 4) + acsch(x) + asech(y / 4) + acsc(x + 2) + asec(y + 2) + csch(y) + coth(x);",
+	"((x < 0.5) && (y > 0.1)) * x;",
+};
+
+static const double points[][3] = {
+	{0.3, 0.7, 1.1},
+	{1.5, 1.2, 0.4},
+	{0.0, 0.9, 2.3},
+};
+
+TEST(expressionderivative_test, matches_central_differences) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	int numExpressions = sizeof(expressionStrings) / sizeof(expressionStrings[0]);
+	int numPoints = sizeof(points) / sizeof(points[0]);
+	for (int i = 0; i < numExpressions; i ++) {
+		Expression exp(expressionStrings[i], symbolTable);
+		for (int v = 0; v < 3; v ++) {
+			Expression* derivative = exp.differentiate(symbols[v]);
+			derivative->bindExpression(&symbolTable);
+			for (int p = 0; p < numPoints; p ++) {
+				double values[3] = {points[p][0], points[p][1], points[p][2]};
+				double h = 1e-6 * (1 + fabs(values[v]));
+				values[v] = points[p][v] + h;
+				double up = exp.evaluateVector(values);
+				values[v] = points[p][v] - h;
+				double down = exp.evaluateVector(values);
+				values[v] = points[p][v];
+				double expected = (up - down) / (2 * h);
+				EXPECT_NEAR(derivative->evaluateVector(values), expected, 1e-5 * (1 + fabs(expected)))
+					<< "d/d" << symbols[v] << " " << expressionStrings[i] << " = " << derivative->infix();
+			}
+			delete derivative;
+		}
+	}
+}
+
+TEST(expressionderivative_test, constant_when_independent) {
+	Expression exp("x * exp(y) + 3;");
+	Expression* derivative = exp.differentiate("t");
+	EXPECT_TRUE(derivative->isConstant());
+	EXPECT_EQ(derivative->evaluateConstant(), 0.0);
+	delete derivative;
+
+	derivative = exp.differentiate("x");
+	EXPECT_EQ(derivative->infix(), Expression("exp(y);").infix());
+	delete derivative;
+}
+
+TEST(expressionderivative_test, throws_without_derivative) {
+	Expression exp("j1(x) + y;");
+	EXPECT_THROW(delete exp.differentiate("x"), ExpressionException);
+	Expression* derivative = exp.differentiate("y");
+	EXPECT_EQ(derivative->evaluateConstant(), 1.0);
+	delete derivative;
+}
@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "SimpleSymbolTable.h"
+
+#include <math.h>
+
+using VCell::Expression;
+
+static string symbols[] = {"t", "A", "B"};
+
+// products of shifted symbols, the product form must evaluate as the expression
+static const char* productStrings[] = {
+	"2.5;",
+	"A;",
+	"0.5 * A;",
+	"0.05 * A * (A - 1) / 2;",
+	"-3 * (A + 2) * B;",
+	"(1 - 0.5) * B * A / 4;",
+	"A^2 * B;",
+	"(2 + A) * (B - 1.5) * t;",
+};
+
+static const char* otherStrings[] = {
+	"A + B;",
+	"A / B;",
+	"2 * A - 1;",
+	"exp(A);",
+	"A^B;",
+	"A^0.5;",
+	"(A > 1) * B;",
+};
+
+static double points[][3] = {
+	{0.3, 7, 11},
+	{1.5, 1, 0},
+	{2.0, 120, 35},
+};
+
+TEST(expressionproductform_test, evaluates_as_expression) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	int numExpressions = sizeof(productStrings) / sizeof(productStrings[0]);
+	int numPoints = sizeof(points) / sizeof(points[0]);
+	for (int i = 0; i < numExpressions; i ++) {
+		Expression exp(productStrings[i], symbolTable);
+		double coefficient;
+		vector<int> symbolIndexes;
+		vector<double> offsets;
+		ASSERT_TRUE(exp.getProductForm(coefficient, symbolIndexes, offsets)) << productStrings[i];
+		ASSERT_EQ(symbolIndexes.size(), offsets.size());
+		for (int p = 0; p < numPoints; p ++) {
+			double product = coefficient;
+			for (int k = 0; k < (int)symbolIndexes.size(); k ++) {
+				product *= points[p][symbolIndexes[k]] - offsets[k];
+			}
+			double expected = exp.evaluateVector(points[p]);
+			ASSERT_NEAR(product, expected, 1e-12 * (1 + fabs(expected))) << productStrings[i];
+		}
+	}
+}
+
+TEST(expressionproductform_test, mass_action_factors) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	Expression exp("0.05 * A * (A - 1) / 2;", symbolTable);
+	double coefficient;
+	vector<int> symbolIndexes;
+	vector<double> offsets;
+	ASSERT_TRUE(exp.getProductForm(coefficient, symbolIndexes, offsets));
+	ASSERT_DOUBLE_EQ(coefficient, 0.025);
+	ASSERT_EQ(symbolIndexes.size(), 2);
+	ASSERT_EQ(symbolIndexes[0], 1);
+	ASSERT_EQ(symbolIndexes[1], 1);
+	ASSERT_EQ(offsets[0], 0);
+	ASSERT_EQ(offsets[1], 1);
+}
+
+TEST(expressionproductform_test, rejects_other_expressions) {
+	SimpleSymbolTable symbolTable(symbols, 3);
+	int numExpressions = sizeof(otherStrings) / sizeof(otherStrings[0]);
+	for (int i = 0; i < numExpressions; i ++) {
+		Expression exp(otherStrings[i], symbolTable);
+		double coefficient;
+		vector<int> symbolIndexes;
+		vector<double> offsets;
+		ASSERT_FALSE(exp.getProductForm(coefficient, symbolIndexes, offsets)) << otherStrings[i];
+	}
+}
@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include "Expression.h"
+#include "SimpleSymbolTable.h"
+#include "FusedExpressionProgram.h"
+
+using VCell::Expression;
+using VCell::FusedExpressionProgram;
+
+static string symbols[] = {"t", "x", "y", "k"};
+
+static const char* rateStrings[] = {
+	"x * y / (k + x) - 0.5 * x;",
+	"-x * y / (k + x) + 0.5 * x;",
+	"2 * k * y / (x + k) * exp(-t);",
+	"(x > 0) * log(x) + (x <= 0) * 2 * k;",
+	"((y > 0.5) * (x / y) + 1) * ((t > 0.5) * 2 + 3);",
+	"pow(x, 2) / (pow(x, 2) + k * k) + max(x, y) - sqrt(abs(y));",
+	"k * 3;",
+};
+
+static const int NUM_RATES = sizeof(rateStrings) / sizeof(rateStrings[0]);
+static const int NUM_POINTS = 150;
+static const double K = 0.75;
+
+class fusedexpressionprogram_test : public ::testing::Test {
+protected:
+	SimpleSymbolTable* symbolTable;
+	Expression* rates[NUM_RATES];
+	double columnValues[4][NUM_POINTS];
+	double* columns[4];
+
+	void SetUp() {
+		symbolTable = new SimpleSymbolTable(symbols, 4);
+		for (int i = 0; i < NUM_RATES; i ++) {
+			rates[i] = new Expression(rateStrings[i], *symbolTable);
+		}
+		for (int p = 0; p < NUM_POINTS; p ++) {
+			columnValues[0][p] = (p % 3) * 0.5;
+			columnValues[1][p] = -1.0 + 0.013 * p;
+			columnValues[2][p] = 2.0 - 0.011 * p;
+			columnValues[3][p] = K;
+		}
+		for (int i = 0; i < 4; i ++) {
+			columns[i] = columnValues[i];
+		}
+	}
+
+	void TearDown() {
+		for (int i = 0; i < NUM_RATES; i ++) {
+			delete rates[i];
+		}
+		delete symbolTable;
+	}
+
+	void pointValues(int p, double* values) {
+		for (int i = 0; i < 4; i ++) {
+			values[i] = columnValues[i][p];
+		}
+	}
+
+	void addAll(FusedExpressionProgram& program) {
+		program.setConstantSymbol(3, K);
+		for (int i = 0; i < NUM_RATES; i ++) {
+			ASSERT_TRUE(program.add(rates[i]));
+		}
+	}
+};
+
+TEST_F(fusedexpressionprogram_test, matches_interpreter) {
+	FusedExpressionProgram program;
+	addAll(program);
+	ASSERT_EQ(NUM_RATES, program.getNumOutputs());
+
+	double outputValues[NUM_RATES][NUM_POINTS];
+	double* outputs[NUM_RATES];
+	for (int i = 0; i < NUM_RATES; i ++) {
+		outputs[i] = outputValues[i];
+	}
+	ASSERT_TRUE(program.evaluateBatch(NUM_POINTS, columns, outputs));
+
+	// same with the intermediate values outside the program, as each thread does
+	double workspaceOutputValues[NUM_RATES][NUM_POINTS];
+	double* workspaceOutputs[NUM_RATES];
+	for (int i = 0; i < NUM_RATES; i ++) {
+		workspaceOutputs[i] = workspaceOutputValues[i];
+	}
+	vector<double> workspace;
+	ASSERT_TRUE(program.evaluateBatch(NUM_POINTS, columns, workspaceOutputs, workspace));
+	ASSERT_EQ(program.getWorkspaceSize(), (int)workspace.size());
+
+	for (int p = 0; p < NUM_POINTS; p ++) {
+		double values[4];
+		pointValues(p, values);
+		double pointOutputs[NUM_RATES];
+		ASSERT_TRUE(program.evaluate(values, pointOutputs));
+		for (int i = 0; i < NUM_RATES; i ++) {
+			double expected = rates[i]->evaluateVector(values);
+			ASSERT_EQ(expected, outputValues[i][p]) << rateStrings[i] << " at point " << p;
+			ASSERT_EQ(expected, pointOutputs[i]) << rateStrings[i] << " at point " << p;
+			ASSERT_EQ(expected, workspaceOutputValues[i][p]) << rateStrings[i] << " at point " << p;
+		}
+	}
+}
+
+TEST_F(fusedexpressionprogram_test, shares_and_folds) {
+	FusedExpressionProgram program;
+	addAll(program);
+	int numSeparate = 0;
+	for (int i = 0; i < NUM_RATES; i ++) {
+		FusedExpressionProgram single;
+		single.setConstantSymbol(3, K);
+		single.add(rates[i]);
+		numSeparate += single.getNumOperations();
+		if (i == NUM_RATES - 1) {
+			// k * 3 is a constant
+			ASSERT_EQ(0, single.getNumOperations());
+		}
+	}
+	// k + x, 1 / (k + x), 0.5 * x are shared by the first three rates
+	ASSERT_LE(program.getNumOperations(), numSeparate - 4);
+	ASSERT_LT(numSeparate, program.getNumSourceOperations());
+
+	FusedExpressionProgram twice;
+	twice.add(rates[0]);
+	twice.add(rates[0]);
+	FusedExpressionProgram once;
+	once.add(rates[0]);
+	ASSERT_EQ(once.getNumOperations(), twice.getNumOperations());
+}
+
+TEST_F(fusedexpressionprogram_test, reports_errors) {
+	FusedExpressionProgram program;
+	program.add(rates[3]);
+	double values[4] = {0, -1, 1, K};
+	double output;
+	// log(x) is skipped for x <= 0
+	ASSERT_TRUE(program.evaluate(values, &output));
+	ASSERT_EQ(2 * K, output);
+
+	Expression divide("y / (x - 1);", *symbolTable);
+	program.add(&divide);
+	double outputs[2];
+	ASSERT_TRUE(program.evaluate(values, outputs));
+	values[1] = 1;
+	ASSERT_FALSE(program.evaluate(values, outputs));
+
+	// an error that is compared away still fails, as it throws in the interpreter
+	Expression compared("(log(y) > 0) + 1;", *symbolTable);
+	FusedExpressionProgram comparison;
+	comparison.add(&compared);
+	ASSERT_TRUE(comparison.evaluate(values, &output));
+	values[2] = -1;
+	ASSERT_FALSE(comparison.evaluate(values, &output));
+
+	double* outputColumns[1] = {&output};
+	double* valueColumns[4] = {&values[0], &values[1], &values[2], &values[3]};
+	ASSERT_FALSE(comparison.evaluateBatch(1, valueColumns, outputColumns));
+}
@@ -4,6 +4,7 @@
  */
 
 #include "ValueProxy.h"
+#include "EvalContext.h"
 
 //-----------------------------------------------------------------
 //
@@ -20,3 +21,7 @@ ValueProxy::ValueProxy(double* arg_values, int arg_indexindex, int* arg_indices)
 double ValueProxy::evaluate(){
 	return values[indices[indexindex]];
 }
+
+double ValueProxy::evaluate(EvalContext& context){
+	return values[context.indices[indexindex]];
+}
@@ -5,6 +5,8 @@
 #ifndef VALUEPROXY_H
 #define VALUEPROXY_H
 
+class EvalContext;
+
 /*-----------------------------------------------------------
 	vartype is the index to the indices of array
  ------------------------------------------------------------*/
@@ -12,7 +14,10 @@ class ValueProxy
 {
 public:
 	ValueProxy(double* arg_values, int arg_vartype, int* arg_indices);  
+	virtual ~ValueProxy() {}
 	virtual double evaluate();
+	// same at the indices of context instead of the shared ones
+	virtual double evaluate(EvalContext& context);
 
 protected:
 	double* values;
@@ -0,0 +1,216 @@
+#include "SparseNewtonMatrix.h"
+
+#include <math.h>
+#include <algorithm>
+#include <set>
+using std::set;
+
+SparseNewtonMatrix::SparseNewtonMatrix(int n, const vector<vector<int> >& rowColumns) {
+	N = n;
+	numColors = 0;
+	numFactorizations = 0;
+
+	jacobianRowStarts.push_back(0);
+	for (int i = 0; i < N; i ++) {
+		set<int> row(rowColumns[i].begin(), rowColumns[i].end());
+		for (set<int>::iterator it = row.begin(); it != row.end(); ++ it) {
+			if (*it < 0 || *it >= N) {
+				throw "SparseNewtonMatrix : column out of range";
+			}
+			jacobianColumns.push_back(*it);
+		}
+		jacobianRowStarts.push_back((long)jacobianColumns.size());
+	}
+	jacobianValues.assign(jacobianColumns.size(), 0);
+
+	// transpose
+	columnStarts.assign(N + 1, 0);
+	for (long e = 0; e < (long)jacobianColumns.size(); e ++) {
+		columnStarts[jacobianColumns[e] + 1] ++;
+	}
+	for (int j = 0; j < N; j ++) {
+		columnStarts[j + 1] += columnStarts[j];
+	}
+	columnEntries.resize(jacobianColumns.size());
+	columnRows.resize(jacobianColumns.size());
+	vector<long> next(columnStarts.begin(), columnStarts.end() - 1);
+	for (int i = 0; i < N; i ++) {
+		for (long e = jacobianRowStarts[i]; e < jacobianRowStarts[i + 1]; e ++) {
+			long k = next[jacobianColumns[e]] ++;
+			columnEntries[k] = e;
+			columnRows[k] = i;
+		}
+	}
+
+	computeColors();
+	computeFill();
+}
+
+/*
+ * greedy coloring: each column takes the smallest color not taken
+ * by an earlier column with an entry in one of its rows
+ */
+void SparseNewtonMatrix::computeColors() {
+	vector<int> colors(N, -1);
+	// the last column that forbade each color
+	vector<int> forbidden(N, -1);
+	for (int j = 0; j < N; j ++) {
+		for (long k = columnStarts[j]; k < columnStarts[j + 1]; k ++) {
+			int i = columnRows[k];
+			for (long e = jacobianRowStarts[i]; e < jacobianRowStarts[i + 1]; e ++) {
+				int other = colors[jacobianColumns[e]];
+				if (other >= 0) {
+					forbidden[other] = j;
+				}
+			}
+		}
+		int color = 0;
+		while (forbidden[color] == j) {
+			color ++;
+		}
+		colors[j] = color;
+		numColors = std::max(numColors, color + 1);
+	}
+
+	colorStarts.assign(numColors + 1, 0);
+	for (int j = 0; j < N; j ++) {
+		colorStarts[colors[j] + 1] ++;
+	}
+	for (int c = 0; c < numColors; c ++) {
+		colorStarts[c + 1] += colorStarts[c];
+	}
+	colorColumns.resize(N);
+	vector<long> next(colorStarts.begin(), colorStarts.end() - 1);
+	for (int j = 0; j < N; j ++) {
+		colorColumns[next[colors[j]] ++] = j;
+	}
+}
+
+/*
+ * symbolic LU of the pattern of J plus the diagonal: eliminating column j < i
+ * from row i fills row i with the pattern of row j of U
+ */
+void SparseNewtonMatrix::computeFill() {
+	rowStarts.push_back(0);
+	diagPositions.resize(N);
+	jacobianPositions.resize(jacobianColumns.size());
+	for (int i = 0; i < N; i ++) {
+		set<int> row(jacobianColumns.begin() + jacobianRowStarts[i], jacobianColumns.begin() + jacobianRowStarts[i + 1]);
+		row.insert(i);
+		// fill goes right of the pivot column, so it is visited later
+		for (set<int>::iterator it = row.begin(); *it < i; ++ it) {
+			int j = *it;
+			for (long m = diagPositions[j] + 1; m < rowStarts[j + 1]; m ++) {
+				row.insert(cols[m]);
+			}
+		}
+
+		long rowStart = (long)cols.size();
+		for (set<int>::iterator it = row.begin(); it != row.end(); ++ it) {
+			if (*it == i) {
+				diagPositions[i] = (long)cols.size();
+			}
+			cols.push_back(*it);
+		}
+		rowStarts.push_back((long)cols.size());
+
+		for (long e = jacobianRowStarts[i]; e < jacobianRowStarts[i + 1]; e ++) {
+			jacobianPositions[e] = std::lower_bound(cols.begin() + rowStart, cols.end(), jacobianColumns[e]) - cols.begin();
+		}
+	}
+	values.resize(cols.size());
+	rowMarkers.assign(N, -1);
+}
+
+long SparseNewtonMatrix::getJacobianPosition(int i, int j) {
+	vector<int>::iterator rowEnd = jacobianColumns.begin() + jacobianRowStarts[i + 1];
+	vector<int>::iterator it = std::lower_bound(jacobianColumns.begin() + jacobianRowStarts[i], rowEnd, j);
+	return it == rowEnd || *it != j ? -1 : (long)(it - jacobianColumns.begin());
+}
+
+int SparseNewtonMatrix::computeJacobian(Function function, void* data, realtype t, N_Vector y, N_Vector f0,
+		N_Vector errorWeights, N_Vector work1, N_Vector work2) {
+	realtype* yData = NV_DATA_S(y);
+	realtype* f0Data = NV_DATA_S(f0);
+	realtype* weights = NV_DATA_S(errorWeights);
+	realtype* savedY = NV_DATA_S(work1);
+	realtype* fData = NV_DATA_S(work2);
+	realtype srur = sqrt(UNIT_ROUNDOFF);
+
+	for (int c = 0; c < numColors; c ++) {
+		for (long k = colorStarts[c]; k < colorStarts[c + 1]; k ++) {
+			int j = colorColumns[k];
+			savedY[j] = yData[j];
+			yData[j] += srur * std::max(fabs(yData[j]), RCONST(1.0) / weights[j]);
+		}
+		int flag = function(t, y, work2, data);
+		for (long k = colorStarts[c]; k < colorStarts[c + 1]; k ++) {
+			int j = colorColumns[k];
+			// the increment actually taken
+			realtype increment = yData[j] - savedY[j];
+			yData[j] = savedY[j];
+			if (flag != 0) {
+				continue;
+			}
+			for (long m = columnStarts[j]; m < columnStarts[j + 1]; m ++) {
+				int i = columnRows[m];
+				jacobianValues[columnEntries[m]] = (fData[i] - f0Data[i]) / increment;
+			}
+		}
+		if (flag != 0) {
+			return flag;
+		}
+	}
+	return 0;
+}
+
+bool SparseNewtonMatrix::factor(N_Vector diagonal, realtype c) {
+	for (int i = 0; i < N; i ++) {
+		long rowStart = rowStarts[i];
+		long rowEnd = rowStarts[i + 1];
+		long diagPosition = diagPositions[i];
+		for (long k = rowStart; k < rowEnd; k ++) {
+			values[k] = 0;
+			rowMarkers[cols[k]] = k;
+		}
+		values[diagPosition] = diagonal == 0 ? RCONST(1.0) : NV_Ith_S(diagonal, i);
+		for (long e = jacobianRowStarts[i]; e < jacobianRowStarts[i + 1]; e ++) {
+			values[jacobianPositions[e]] += c * jacobianValues[e];
+		}
+
+		for (long k = rowStart; k < diagPosition; k ++) {
+			int j = cols[k];
+			realtype lij = values[k] *= values[diagPositions[j]];
+			for (long m = diagPositions[j] + 1; m < rowStarts[j + 1]; m ++) {
+				values[rowMarkers[cols[m]]] -= lij * values[m];
+			}
+		}
+
+		for (long k = rowStart; k < rowEnd; k ++) {
+			rowMarkers[cols[k]] = -1;
+		}
+		if (values[diagPosition] == 0) {
+			return false;
+		}
+		values[diagPosition] = RCONST(1.0) / values[diagPosition];
+	}
+	numFactorizations ++;
+	return true;
+}
+
+void SparseNewtonMatrix::solve(realtype* x) {
+	for (int i = 0; i < N; i ++) {
+		realtype sum = x[i];
+		for (long k = rowStarts[i]; k < diagPositions[i]; k ++) {
+			sum -= values[k] * x[cols[k]];
+		}
+		x[i] = sum;
+	}
+	for (int i = N - 1; i >= 0; i --) {
+		realtype sum = x[i];
+		for (long k = diagPositions[i] + 1; k < rowStarts[i + 1]; k ++) {
+			sum -= values[k] * x[cols[k]];
+		}
+		x[i] = sum * values[diagPositions[i]];
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef SPARSENEWTONMATRIX_H
+#define SPARSENEWTONMATRIX_H
+
+#include <vector>
+using std::vector;
+
+#include <nvector/nvector_serial.h>
+#include <sundials/sundials_types.h>
+
+/*
+ * Newton matrix M = diag(d) + c J of a sparse system, used to precondition SPGMR:
+ * CVODE has M = I - gamma df/dy, IDA has M = dF/dy + c_j dF/dy'.
+ *
+ * J is computed by finite differences. Columns that share no row get the same
+ * color and are perturbed together, so J costs one function evaluation per color
+ * rather than one per column. M is factored by sparse LU without pivoting in the
+ * given order; its fill is computed once from the pattern of J plus the diagonal.
+ */
+class SparseNewtonMatrix {
+public:
+	// same arguments as a CVRhsFn
+	typedef int (*Function)(realtype t, N_Vector y, N_Vector f, void* data);
+
+	// rowColumns[i] : the components of y that f_i depends on
+	SparseNewtonMatrix(int n, const vector<vector<int> >& rowColumns);
+
+	int getNumColors() { return numColors; }
+	long getNumJacobianNonZeros() { return (long)jacobianColumns.size(); }
+	long getNumFactorNonZeros() { return (long)cols.size(); }
+	long getNumFactorizations() { return numFactorizations; }
+
+	/*
+	 * J by forward differences of f around (t, y), f0 = f(t, y); y is perturbed and restored,
+	 * work1 and work2 are overwritten. Returns the nonzero return value of f if it fails.
+	 */
+	int computeJacobian(Function function, void* data, realtype t, N_Vector y, N_Vector f0,
+		N_Vector errorWeights, N_Vector work1, N_Vector work2);
+	/*
+	 * entries of J row by row in increasing column order, the order of the sorted rowColumns;
+	 * an analytic J is stored here instead of calling computeJacobian()
+	 */
+	realtype* getJacobianValues() { return jacobianValues.empty() ? 0 : &jacobianValues[0]; }
+	// index in getJacobianValues() of entry (i, j), -1 if it is not in the pattern
+	long getJacobianPosition(int i, int j);
+	// M = diag(diagonal) + c J, diagonal 0 is the identity; returns false on a zero pivot
+	bool factor(N_Vector diagonal, realtype c);
+	// x = M^-1 x
+	void solve(realtype* x);
+
+private:
+	int N;
+
+	// J in compressed rows
+	vector<long> jacobianRowStarts;
+	vector<int> jacobianColumns;
+	vector<realtype> jacobianValues;
+	// position in cols of each entry of J
+	vector<long> jacobianPositions;
+
+	// entries of J by column, as indexes into jacobianColumns, and their rows
+	vector<long> columnStarts;
+	vector<long> columnEntries;
+	vector<int> columnRows;
+	// columns of color k are colorColumns[colorStarts[k]] to colorColumns[colorStarts[k + 1] - 1]
+	int numColors;
+	vector<long> colorStarts;
+	vector<int> colorColumns;
+
+	// L and U in compressed rows, the diagonal holds 1/u_ii
+	vector<long> rowStarts;
+	vector<int> cols;
+	vector<long> diagPositions;
+	vector<realtype> values;
+	vector<long> rowMarkers;
+	long numFactorizations;
+
+	void computeFill();
+	void computeColors();
+};
+
+#endif
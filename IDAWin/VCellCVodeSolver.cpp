@@ -8,6 +8,7 @@
 #include <FunctionDomainException.h>
 #include <FunctionRangeException.h>
 #include "StoppedByUserException.h"
+#include "SparseNewtonMatrix.h"
 #include <time.h>
 #include <sys/timeb.h>
 #include <sstream>
@@ -18,11 +19,12 @@ using std::stringstream;
 #endif
 
 #include <memory.h>
+#include <algorithm>
 
 #include <cvode/cvode.h>             /* prototypes for CVODE fcts. and consts. */
 #include <nvector/nvector_serial.h>  /* serial N_Vector types, fcts., and macros */
 #include <cvode/cvode_dense.h>       /* prototype for CVDense */
-//#include <cvode/cvode_spgmr.h>       /* prototype for CVSPGMR */
+#include <cvode/cvode_spgmr.h>       /* prototype for CVSPGMR */
 #include <sundials/sundials_dense.h> /* definitions DenseMat DENSE_ELEM */
 #include <sundials/sundials_types.h> /* definition of type realtype */
 
@@ -36,7 +38,7 @@ initCVode
 		CVodeCreate
 		CVodeMalloc
 		CVodeSetFdata
-		CVDense
+		CVDense or CVSpgmr with CVSpilsSetPreconditioner
 		CVodeSetMaxNumSteps
 	solveInitialDiscontinuities(start_time)
 		updateTandVariableValues
@@ -219,6 +221,19 @@ void VCellCVodeSolver::initialize() {
 	for (int i = 0; i < NEQ; i ++) {
 		rateExpressions[i]->bindExpression(defaultSymbolTable);
 	}
+	if (bCompileExpressions) {
+		compileExpressions(rateExpressions, NEQ);
+	}
+	if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR || bAnalyticJacobian) {
+		vector<vector<int> > dependencies;
+		getVariableDependencies(rateExpressions, NEQ, dependencies);
+		if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR) {
+			createNewtonMatrix(dependencies);
+		}
+		if (bAnalyticJacobian) {
+			createJacobianExpressions(rateExpressions, dependencies);
+		}
+	}
 }
 
 int VCellCVodeSolver::RHS (realtype t, N_Vector y, N_Vector r) {	
@@ -254,6 +269,53 @@ int VCellCVodeSolver::RHS_callback(realtype t, N_Vector y, N_Vector r, void *fda
 	return solver->RHS(t, y, r);
 }
 
+int VCellCVodeSolver::PrecSetup(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype *jcurPtr, realtype gamma, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	if (jok) {
+		*jcurPtr = FALSE;
+	} else {
+		int flag = 0;
+		if (bAnalyticJacobian) {
+			// the entries are in the order of the pattern
+			flag = evaluateJacobianExpressions(t, y);
+			std::copy(jacobianValues.begin(), jacobianValues.end(), newtonMatrix->getJacobianValues());
+		} else {
+			CVodeGetErrWeights(solver, tmp1);
+			flag = newtonMatrix->computeJacobian(RHS_callback, this, t, y, fy, tmp1, tmp2, tmp3);
+		}
+		if (flag != 0) {
+			return flag;
+		}
+		*jcurPtr = TRUE;
+	}
+	// a zero pivot is recoverable, CVODE retries with a fresh J or a smaller step
+	return newtonMatrix->factor(0, -gamma) ? 0 : 1;
+}
+
+int VCellCVodeSolver::PrecSetup_callback(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype *jcurPtr, realtype gamma, void *P_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	VCellCVodeSolver* solver = (VCellCVodeSolver*)P_data;
+	return solver->PrecSetup(t, y, fy, jok, jcurPtr, gamma, tmp1, tmp2, tmp3);
+}
+
+int VCellCVodeSolver::DenseJacobian_callback(long int N, DenseMat J, realtype t, N_Vector y, N_Vector fy, void *jac_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	VCellCVodeSolver* solver = (VCellCVodeSolver*)jac_data;
+	int flag = solver->evaluateJacobianExpressions(t, y);
+	if (flag != 0) {
+		return flag;
+	}
+	// J is zeroed by CVDense
+	for (int e = 0; e < (int)solver->jacobianValues.size(); e ++) {
+		DENSE_ELEM(J, solver->jacobianRows[e], solver->jacobianVariables[e]) = solver->jacobianValues[e];
+	}
+	return 0;
+}
+
+int VCellCVodeSolver::PrecSolve_callback(realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *P_data, N_Vector tmp) {
+	VCellCVodeSolver* solver = (VCellCVodeSolver*)P_data;
+	N_VScale(RCONST(1.0), r, z);
+	solver->newtonMatrix->solve(NV_DATA_S(z));
+	return 0;
+}
+
 int VCellCVodeSolver::RootFn_callback(realtype t, N_Vector y, realtype *gout, void *g_data) {
 	VCellCVodeSolver* solver = (VCellCVodeSolver*)g_data;
 	return solver->RootFn(t, y, gout);
@@ -311,8 +373,16 @@ void VCellCVodeSolver::reInit(double t) {
 
 		flag = CVodeSetFdata(solver, this);
 		checkCVodeFlag(flag);
-		flag = CVDense(solver, NEQ);
-		//flag = CVSpgmr(solver, PREC_NONE, 0);
+		if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR) {
+			flag = CVSpgmr(solver, PREC_LEFT, 0);
+			checkCVodeFlag(flag);
+			flag = CVSpilsSetPreconditioner(solver, PrecSetup_callback, PrecSolve_callback, this);
+		} else {
+			flag = CVDense(solver, NEQ);
+			if (flag == CV_SUCCESS && bAnalyticJacobian) {
+				flag = CVDenseSetJacFn(solver, DenseJacobian_callback, this);
+			}
+		}
 		checkCVodeFlag(flag);
 
 		flag = CVodeSetMaxNumSteps(solver, 5000);
@@ -22,6 +22,15 @@ private:
 	int RHS(realtype t, N_Vector y, N_Vector yp);
 	static int RHS_callback(realtype t, N_Vector y, N_Vector r, void *fdata);
 	/*
+	SPGMR preconditioner P = I - gamma J with the sparse finite difference J of RHS,
+	J is recomputed when CVODE has jok false and reused otherwise
+	*/
+	int PrecSetup(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype *jcurPtr, realtype gamma, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int PrecSetup_callback(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype *jcurPtr, realtype gamma, void *P_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	// analytic Jacobian for CVDense
+	static int DenseJacobian_callback(long int N, DenseMat J, realtype t, N_Vector y, N_Vector fy, void *jac_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int PrecSolve_callback(realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr, void *P_data, N_Vector tmp);
+	/*
 	Arguments 
 		t		is the current value of the independent variable.
 		y		is the current value of the dependent variable vector, y(t).
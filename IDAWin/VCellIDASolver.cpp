@@ -4,6 +4,7 @@
 #include <SimpleSymbolTable.h>
 #include <Exception.h>
 #include "StoppedByUserException.h"
+#include "SparseNewtonMatrix.h"
 #include <DivideByZeroException.h>
 #include <FunctionDomainException.h>
 #include <FunctionRangeException.h>
@@ -19,10 +20,11 @@ using std::stringstream;
 #include <assert.h>
 #include <ida/ida.h>
 #include <ida/ida_dense.h>
-//#include <ida/ida_spgmr.h>
+#include <ida/ida_spgmr.h>
 #include <nvector/nvector_serial.h>
 
 #include <memory.h>
+#include <algorithm>
 
 /**
   * calling sequence
@@ -33,7 +35,7 @@ initIDA
 		IDAMalloc
 		IDASetRdata
 		IDASetMaxStep
-		IDADense
+		IDADense or IDASpgmr with IDASpilsSetPreconditioner
 		IDASetMaxNumSteps
 		IDASetId
 		IDACalcIC
@@ -206,6 +208,7 @@ VCellIDASolver::VCellIDASolver() : VCellSundialsSolver() {
 	inverseTransformMatrix = 0;
 	yp = 0;
 	id = 0;
+	jacobianYp = 0;
 }
 
 VCellIDASolver::~VCellIDASolver() {
@@ -264,6 +267,62 @@ int VCellIDASolver::Residual(realtype t, N_Vector y, N_Vector yp, N_Vector resid
 	}
 }
 
+int VCellIDASolver::PrecSetup(realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	int flag = 0;
+	if (bAnalyticJacobian) {
+		flag = evaluateJacobianExpressions(t, y);
+		realtype* matrixValues = newtonMatrix->getJacobianValues();
+		std::fill(matrixValues, matrixValues + newtonMatrix->getNumJacobianNonZeros(), RCONST(0.0));
+		for (int m = 0; m < (int)jacobianTermEntries.size(); m ++) {
+			matrixValues[jacobianTermPositions[m]] += jacobianValues[jacobianTermEntries[m]] * jacobianTermCoefficients[m];
+		}
+	} else {
+		IDAGetErrWeights(solver, tmp1);
+		jacobianYp = yp;
+		flag = newtonMatrix->computeJacobian(JacobianResidual_callback, this, t, y, r, tmp1, tmp2, tmp3);
+		jacobianYp = 0;
+	}
+	if (flag != 0) {
+		return flag;
+	}
+	N_VScale(-c_j, id, tmp1);
+	return newtonMatrix->factor(tmp1, RCONST(1.0)) ? 0 : 1;
+}
+
+int VCellIDASolver::PrecSetup_callback(realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, void *prec_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	VCellIDASolver* solver = (VCellIDASolver*)prec_data;
+	return solver->PrecSetup(t, y, yp, r, c_j, tmp1, tmp2, tmp3);
+}
+
+int VCellIDASolver::PrecSolve_callback(realtype t, N_Vector y, N_Vector yp, N_Vector r, N_Vector rvec, N_Vector zvec, realtype c_j, realtype delta, void *prec_data, N_Vector tmp) {
+	VCellIDASolver* solver = (VCellIDASolver*)prec_data;
+	N_VScale(RCONST(1.0), rvec, zvec);
+	solver->newtonMatrix->solve(NV_DATA_S(zvec));
+	return 0;
+}
+
+int VCellIDASolver::DenseJacobian_callback(long int Neq, realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, void *jac_data, DenseMat J, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3) {
+	VCellIDASolver* solver = (VCellIDASolver*)jac_data;
+	int flag = solver->evaluateJacobianExpressions(t, y);
+	if (flag != 0) {
+		return flag;
+	}
+	// J is zeroed by IDADense
+	for (int m = 0; m < (int)solver->jacobianTermEntries.size(); m ++) {
+		int e = solver->jacobianTermEntries[m];
+		DENSE_ELEM(J, solver->jacobianRows[e], solver->jacobianTermColumns[m]) += solver->jacobianValues[e] * solver->jacobianTermCoefficients[m];
+	}
+	for (int i = 0; i < solver->numDifferential; i ++) {
+		DENSE_ELEM(J, i, i) -= c_j;
+	}
+	return 0;
+}
+
+int VCellIDASolver::JacobianResidual_callback(realtype t, N_Vector y, N_Vector residual, void *data) {
+	VCellIDASolver* solver = (VCellIDASolver*)data;
+	return solver->Residual(t, y, solver->jacobianYp, residual);
+}
+
 int VCellIDASolver::RootFn_callback(realtype t, N_Vector y, N_Vector yp, realtype *gout, void *g_data) {
 	VCellIDASolver* solver = (VCellIDASolver*)g_data;
 	return solver->RootFn(t, y, /*yp, */gout);
@@ -394,6 +453,43 @@ void VCellIDASolver::initialize() {
 	for (int i = 0; i < NEQ; i ++) {
 		rhsExpressions[i]->bindExpression(defaultSymbolTable);
 	}
+	if (bCompileExpressions) {
+		compileExpressions(rhsExpressions, NEQ);
+	}
+	if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR || bAnalyticJacobian) {
+		// the residual sees y through the inverse transform
+		vector<vector<int> > variableDependencies;
+		getVariableDependencies(rhsExpressions, NEQ, variableDependencies);
+		vector<vector<int> > dependencies(NEQ);
+		for (int i = 0; i < NEQ; i ++) {
+			for (int k = 0; k < (int)variableDependencies[i].size(); k ++) {
+				int v = variableDependencies[i][k];
+				for (int j = 0; j < NEQ; j ++) {
+					if (inverseTransformMatrix[v][j] != 0) {
+						dependencies[i].push_back(j);
+					}
+				}
+			}
+		}
+		if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR) {
+			createNewtonMatrix(dependencies);
+		}
+		if (bAnalyticJacobian && createJacobianExpressions(rhsExpressions, variableDependencies)) {
+			for (int e = 0; e < (int)jacobianExpressions.size(); e ++) {
+				int v = jacobianVariables[e];
+				for (int j = 0; j < NEQ; j ++) {
+					if (inverseTransformMatrix[v][j] != 0) {
+						jacobianTermEntries.push_back(e);
+						jacobianTermColumns.push_back(j);
+						jacobianTermCoefficients.push_back(inverseTransformMatrix[v][j]);
+						if (newtonMatrix != 0) {
+							jacobianTermPositions.push_back(newtonMatrix->getJacobianPosition(jacobianRows[e], j));
+						}
+					}
+				}
+			}
+		}
+	}
 
 	yp = N_VNew_Serial(NEQ);
 	id = N_VNew_Serial(NEQ);
@@ -480,9 +576,17 @@ void VCellIDASolver::reInit(double t) {
 		flag = IDASetMaxStep(solver, maxTimeStep);
 		checkIDAFlag(flag);
 
-		// choose the linear solver (Dense "direct" matrix LU decomposition solver).
-		flag = IDADense(solver, NEQ);
-		//flag = IDASpgmr(solver, 0);
+		// choose the linear solver (Dense "direct" matrix LU decomposition solver, or preconditioned SPGMR).
+		if (linearSolver == SUNDIALS_LINEAR_SOLVER_SPGMR) {
+			flag = IDASpgmr(solver, 0);
+			checkIDAFlag(flag);
+			flag = IDASpilsSetPreconditioner(solver, PrecSetup_callback, PrecSolve_callback, this);
+		} else {
+			flag = IDADense(solver, NEQ);
+			if (flag == IDA_SUCCESS && bAnalyticJacobian) {
+				flag = IDADenseSetJacFn(solver, DenseJacobian_callback, this);
+			}
+		}
 		checkIDAFlag(flag);
 
 		IDASetMaxNumSteps(solver, 5000);
@@ -25,6 +25,13 @@ private:
 
 	N_Vector yp;
 	N_Vector id;  // 1 for differential variable, 0 for algebraic variable (used in IDACalcIC()).
+	N_Vector jacobianYp; // yp held fixed while the preconditioner differences the residual
+	// analytic dF_i/dy_j += jacobianValues[jacobianTermEntries[m]] * jacobianTermCoefficients[m] through the inverse transform,
+	// jacobianTermPositions[m] is (i, j) in the SPGMR preconditioner
+	vector<int> jacobianTermEntries;
+	vector<int> jacobianTermColumns;
+	vector<double> jacobianTermCoefficients;
+	vector<long> jacobianTermPositions;
 
 	int Residual(realtype t, N_Vector y, N_Vector yp, N_Vector residual);	
 	static int Residual_callback(realtype t, N_Vector y, N_Vector yp, N_Vector residual, void *rdata);
@@ -41,6 +48,16 @@ private:
 		In the latter case, the integrator halts. If a recoverable error occured, the integrator will attempt to correct and retry.
 	*/
 	//int RootFn(realtype t, N_Vector y, N_Vector yp, realtype *gout);
+	/*
+	SPGMR preconditioner P = dF/dy + c_j dF/dy' = J - c_j diag(id) with the sparse finite
+	difference J of the residual; IDA has no jok, so J is recomputed at every setup
+	*/
+	int PrecSetup(realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int PrecSetup_callback(realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, void *prec_data, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int PrecSolve_callback(realtype t, N_Vector y, N_Vector yp, N_Vector r, N_Vector rvec, N_Vector zvec, realtype c_j, realtype delta, void *prec_data, N_Vector tmp);
+	// analytic Jacobian for IDADense
+	static int DenseJacobian_callback(long int Neq, realtype t, N_Vector y, N_Vector yp, N_Vector r, realtype c_j, void *jac_data, DenseMat J, N_Vector tmp1, N_Vector tmp2, N_Vector tmp3);
+	static int JacobianResidual_callback(realtype t, N_Vector y, N_Vector residual, void *data);
 	static int RootFn_callback(realtype t, N_Vector y, N_Vector yp, realtype *gout, void *g_data);
 	/*
 	Arguments 
@@ -1,11 +1,17 @@
 #include <SimpleSymbolTable.h>
+#include <ExpressionCompiler.h>
 #include "StoppedByUserException.h"
 #include "VCellSundialsSolver.h"
 #include "OdeResultSet.h"
+#include "SparseNewtonMatrix.h"
+#include <SymbolTableEntry.h>
+#include <ExpressionException.h>
+#include <algorithm>
 #include <assert.h>
 #include <math.h>
 #include <sstream>
 using std::stringstream;
+using VCell::ExpressionCompiler;
 
 #include <memory.h>
 
@@ -38,6 +44,97 @@ Expression* VCellSundialsSolver::readExpression(istream& inputstream) {
 	return new Expression(exp);
 }
 
+/*
+ * translates the bound expressions (plus the discontinuity expressions) to native code,
+ * anything that can't be compiled keeps using the stack machine interpreter
+ */
+void VCellSundialsSolver::compileExpressions(Expression** expressions, int numExpressions) {
+	ExpressionCompiler compiler;
+	for (int i = 0; i < numExpressions; i ++) {
+		compiler.add(expressions[i]);
+	}
+	for (int i = 0; i < numDiscontinuities; i ++) {
+		compiler.add(odeDiscontinuities[i]->discontinuityExpression);
+	}
+	int numTotal = compiler.getNumExpressions();
+	int numCompiled = compiler.compile();
+	cout << "compiled " << numCompiled << " of " << numTotal << " expressions to native code" << endl;
+}
+
+void VCellSundialsSolver::getVariableDependencies(Expression** expressions, int numExpressions, vector<vector<int> >& dependencies) {
+	dependencies.assign(numExpressions, vector<int>());
+	for (int i = 0; i < numExpressions; i ++) {
+		vector<string> symbols;
+		expressions[i]->getSymbols(symbols);
+		for (int k = 0; k < (int)symbols.size(); k ++) {
+			SymbolTableEntry* ste = expressions[i]->getSymbolBinding(symbols[k]);
+			// values[0] is t, values[1 ~ N] are the variables
+			if (ste != 0 && ste->getIndex() >= 1 && ste->getIndex() <= NEQ) {
+				dependencies[i].push_back(ste->getIndex() - 1);
+			}
+		}
+		std::sort(dependencies[i].begin(), dependencies[i].end());
+		dependencies[i].erase(std::unique(dependencies[i].begin(), dependencies[i].end()), dependencies[i].end());
+	}
+}
+
+void VCellSundialsSolver::createNewtonMatrix(const vector<vector<int> >& dependencies) {
+	delete newtonMatrix;
+	newtonMatrix = new SparseNewtonMatrix(NEQ, dependencies);
+	cout << "SPGMR preconditioner : " << newtonMatrix->getNumJacobianNonZeros() << " Jacobian nonzeros in "
+		<< newtonMatrix->getNumColors() << " colors, " << newtonMatrix->getNumFactorNonZeros() << " nonzeros in LU" << endl;
+}
+
+bool VCellSundialsSolver::createJacobianExpressions(Expression** expressions, const vector<vector<int> >& dependencies) {
+	try {
+		for (int i = 0; i < (int)dependencies.size(); i ++) {
+			for (int k = 0; k < (int)dependencies[i].size(); k ++) {
+				int v = dependencies[i][k];
+				Expression* derivative = expressions[i]->differentiate(variableNames[v]);
+				jacobianExpressions.push_back(derivative);
+				jacobianRows.push_back(i);
+				jacobianVariables.push_back(v);
+				derivative->bindExpression(defaultSymbolTable);
+			}
+		}
+	} catch (VCell::Exception& ex) {
+		cout << "analytic Jacobian not available, using finite differences : " << ex.getMessage() << endl;
+		for (int e = 0; e < (int)jacobianExpressions.size(); e ++) {
+			delete jacobianExpressions[e];
+		}
+		jacobianExpressions.clear();
+		jacobianRows.clear();
+		jacobianVariables.clear();
+		bAnalyticJacobian = false;
+		return false;
+	}
+	jacobianValues.resize(jacobianExpressions.size());
+	if (bCompileExpressions && jacobianExpressions.size() > 0) {
+		ExpressionCompiler compiler;
+		for (int e = 0; e < (int)jacobianExpressions.size(); e ++) {
+			compiler.add(jacobianExpressions[e]);
+		}
+		int numCompiled = compiler.compile();
+		cout << "compiled " << numCompiled << " of " << jacobianExpressions.size() << " Jacobian expressions to native code" << endl;
+	}
+	cout << "analytic Jacobian : " << jacobianExpressions.size() << " nonzero entries" << endl;
+	return true;
+}
+
+int VCellSundialsSolver::evaluateJacobianExpressions(realtype t, N_Vector y) {
+	try {
+		updateTandVariableValues(t, y);
+		for (int e = 0; e < (int)jacobianExpressions.size(); e ++) {
+			jacobianValues[e] = jacobianExpressions[e]->evaluateVector(values);
+		}
+		return 0;
+	} catch (ExpressionException& ex) {
+		cout << "failed to evaluate Jacobian: " << ex.getMessage() << endl;
+		recoverableErrMsg = ex.getMessage();
+		return 1;
+	}
+}
+
 VCellSundialsSolver::VCellSundialsSolver() {
 	NEQ = 0;
 	NPARAM = 0;
@@ -47,6 +144,10 @@ VCellSundialsSolver::VCellSundialsSolver() {
 	AbsoluteTolerance = 0.0;
 	keepEvery = 0;
 	maxTimeStep = 0.0;		
+	bCompileExpressions = false;
+	linearSolver = SUNDIALS_LINEAR_SOLVER_DENSE;
+	newtonMatrix = 0;
+	bAnalyticJacobian = false;
 
 	solver = 0;
 	initialConditionSymbolTable = 0;
@@ -84,6 +185,10 @@ VCellSundialsSolver::~VCellSundialsSolver() {
 	delete[] paramNames;
 	delete[] allSymbols;
 	delete defaultSymbolTable;
+	delete newtonMatrix;
+	for (int e = 0; e < (int)jacobianExpressions.size(); e ++) {
+		delete jacobianExpressions[e];
+	}
 
 	for (int i = 0; i < numDiscontinuities; i ++) {
 		delete odeDiscontinuities[i];
@@ -207,6 +312,19 @@ void VCellSundialsSolver::readInput(istream& inputstream) {
 				inputstream >> maxTimeStep;
 			} else if (name == "KEEP_EVERY") {
 				inputstream >> keepEvery;
+			} else if (name == "COMPILE_EXPRESSIONS") {
+				bCompileExpressions = true;
+			} else if (name == "ANALYTIC_JACOBIAN") {
+				bAnalyticJacobian = true;
+			} else if (name == "LINEAR_SOLVER") {
+				inputstream >> name;
+				if (name == "DENSE") {
+					linearSolver = SUNDIALS_LINEAR_SOLVER_DENSE;
+				} else if (name == "SPGMR") {
+					linearSolver = SUNDIALS_LINEAR_SOLVER_SPGMR;
+				} else {
+					throw VCell::Exception("Unknown linear solver \"" + name + "\"");
+				}
 			} else if (name == "OUTPUT_TIME_STEP") {
 				double outputTimeStep = 0.0;
 				inputstream >> outputTimeStep;
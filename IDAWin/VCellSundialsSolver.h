@@ -17,17 +17,22 @@ using VCell::Expression;
 
 #include <nvector/nvector_serial.h>
 #include <sundials/sundials_types.h>
+#include <sundials/sundials_dense.h>
 
 #include <stdio.h>
 
 class SymbolTable;
 class OdeResultSet;
+class SparseNewtonMatrix;
 
 #define bytesPerSample 25
 #define MaxFileSizeBytes 1000000000 /* 1 gigabyte */	
 #define BAD_EXPRESSION_MSG " is not terminated by ';'"
 #define MAX_NUM_EVENTS_DISCONTINUITIES_EVAL 50
 
+// LINEAR_SOLVER in the input file; SPGMR is preconditioned with the sparse Newton matrix
+enum SundialsLinearSolver {SUNDIALS_LINEAR_SOLVER_DENSE, SUNDIALS_LINEAR_SOLVER_SPGMR};
+
 struct EventAssignment {
 	int varIndex;
 	Expression* assignmentExpression;
@@ -144,6 +149,15 @@ protected:
 	realtype AbsoluteTolerance;
 	long keepEvery;
 	double maxTimeStep;		
+	bool bCompileExpressions;
+	SundialsLinearSolver linearSolver;
+	SparseNewtonMatrix* newtonMatrix;
+	// ANALYTIC_JACOBIAN : d expression i / d variable for the variables of row i, row by row
+	bool bAnalyticJacobian;
+	vector<Expression*> jacobianExpressions;
+	vector<int> jacobianRows;
+	vector<int> jacobianVariables;
+	vector<realtype> jacobianValues;
 	vector<double> outputTimes;
 	double* tempRowData; // data for current time to be written to output file and to be added to odeResultSet
 
@@ -185,6 +199,14 @@ protected:
 	virtual string getSolverName()=0;
 
 	Expression* readExpression(istream& inputstream);
+	void compileExpressions(Expression** expressions, int numExpressions);
+	// variables (0 ~ N-1) each of the bound expressions depends on, in increasing order
+	void getVariableDependencies(Expression** expressions, int numExpressions, vector<vector<int> >& dependencies);
+	void createNewtonMatrix(const vector<vector<int> >& dependencies);
+	// differentiates, binds and compiles; returns false, and clears bAnalyticJacobian, if an expression has no derivative
+	bool createJacobianExpressions(Expression** expressions, const vector<vector<int> >& dependencies);
+	// jacobianValues at (t, y), returns 1 (recoverable) if an evaluation fails
+	int evaluateJacobianExpressions(realtype t, N_Vector y);
 	bool executeEvents(realtype Time);
 	double getNextEventTime();
 
@@ -71,3 +71,84 @@ TEST(multitrialstats_test, testGaussian) {
     ASSERT_NEAR(stats.getMin(0,0), sample_min, 1e-12);
     ASSERT_NEAR(stats.getMax(0,0), sample_max, 1e-12);
 }
+
+TEST(multitrialstats_test, testPercentiles) {
+    // counts 0..10, one trial each: the percentiles are exact while the bins are one count wide
+    MultiTrialStats stats(1,1);
+    for (int i=0; i<=10; i++) {
+        double varVals_1[1] = {(double)i};
+        stats.startNewTrial();
+        stats.addSample(0, 0.0, varVals_1);
+    }
+    ASSERT_NEAR(stats.getHistogramBinWidth(0,0), 1.0, 1e-12);
+    ASSERT_EQ(stats.getHistogramCount(0,0,3), 1);
+    ASSERT_EQ(stats.getHistogramCount(0,0,11), 0);
+    ASSERT_NEAR(stats.getPercentile(0,0,0), 0.0, 1e-12);
+    ASSERT_NEAR(stats.getPercentile(0,0,25), 2.5, 1e-12);
+    ASSERT_NEAR(stats.getPercentile(0,0,50), 5.0, 1e-12);
+    ASSERT_NEAR(stats.getPercentile(0,0,95), 9.5, 1e-12);
+    ASSERT_NEAR(stats.getPercentile(0,0,100), 10.0, 1e-12);
+}
+
+TEST(multitrialstats_test, testHistogramCoarsening) {
+    // counts up to 1000 do not fit 64 bins of width 1, the width doubles until they fit in 16
+    MultiTrialStats stats(1,1);
+    for (int i=0; i<1000; i++) {
+        double varVals_1[1] = {(double)i};
+        stats.startNewTrial();
+        stats.addSample(0, 0.0, varVals_1);
+    }
+    ASSERT_EQ(stats.getNumHistogramBins(), MultiTrialStats::DEFAULT_HISTOGRAM_BINS);
+    ASSERT_NEAR(stats.getHistogramBinWidth(0,0), 16.0, 1e-12);
+    long total = 0;
+    for (int k=0; k<stats.getNumHistogramBins(); k++) {
+        total += stats.getHistogramCount(0,0,k);
+    }
+    ASSERT_EQ(total, 1000);
+    ASSERT_EQ(stats.getHistogramCount(0,0,0), 16);
+    // within a bin of the exact median
+    ASSERT_NEAR(stats.getPercentile(0,0,50), 499.5, 16.0);
+}
+
+TEST(multitrialstats_test, testMerge) {
+    // two workers' statistics merged are those of all the trials
+    std::default_random_engine generator(566564762);
+    std::poisson_distribution<int> small(5.0);
+    std::poisson_distribution<int> large(300.0);
+    MultiTrialStats all(2,2), first(2,2), second(2,2);
+    for (int i=0; i<2000; i++) {
+        MultiTrialStats& worker = (i < 700) ? first : second;
+        all.startNewTrial();
+        worker.startNewTrial();
+        for (int t=0; t<2; t++) {
+            double varVals[2] = {(double)small(generator), (double)large(generator)};
+            all.addSample(t, t, varVals);
+            worker.addSample(t, t, varVals);
+        }
+    }
+    first.merge(second);
+    for (int t=0; t<2; t++) {
+        for (int i=0; i<2; i++) {
+            ASSERT_NEAR(first.getMean(i,t), all.getMean(i,t), 1e-9);
+            ASSERT_NEAR(first.getVariance(i,t), all.getVariance(i,t), 1e-6);
+            ASSERT_EQ(first.getMin(i,t), all.getMin(i,t));
+            ASSERT_EQ(first.getMax(i,t), all.getMax(i,t));
+            ASSERT_EQ(first.getHistogramBinWidth(i,t), all.getHistogramBinWidth(i,t));
+            for (int k=0; k<all.getNumHistogramBins(); k++) {
+                ASSERT_EQ(first.getHistogramCount(i,t,k), all.getHistogramCount(i,t,k));
+            }
+            ASSERT_EQ(first.getPercentile(i,t,50), all.getPercentile(i,t,50));
+        }
+    }
+    MultiTrialStats other(3,2);
+    ASSERT_THROW(first.merge(other), std::invalid_argument);
+}
+
+TEST(multitrialstats_test, testNoHistogram) {
+    MultiTrialStats stats(1,1,0);
+    double varVals_1[1] = {3};
+    stats.startNewTrial();
+    stats.addSample(0, 0.0, varVals_1);
+    ASSERT_NEAR(stats.getMean(0,0), 3.0, 1e-12);
+    ASSERT_TRUE(std::isnan(stats.getPercentile(0,0,50)));
+}
@@ -0,0 +1,30 @@
+//
+// Trials run in parallel must give the output of the serial run.
+//
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "StochTestUtils.h"
+#include <string>
+
+// runs the model with the given control block and number of threads, returns the output file
+static std::string runGibson(const std::string& control, int numThreads) {
+	return runStoch(false, control + "NUM_THREADS\t" + std::to_string(numThreads) + "\n", bindingModel(20, 0, 15, 0.3, 2.0));
+}
+
+TEST(paralleltrialstest, histogram) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t0.5\nTOLERANCE\t1.0E-9\n"
+		"NUM_TRIAL\t200\nSEED\t1634997497\n";
+	std::string serial = runGibson(control, 1);
+	ASSERT_EQ(serial, runGibson(control, 3));
+	ASSERT_EQ(serial, runGibson(control, 8));
+}
+
+TEST(paralleltrialstest, multiTrialStats) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t2.0\nTOLERANCE\t1.0E-9\nSAVE_PERIOD\t0.05\n"
+		"MAX_SAVE_POINTS\t41.0\nNUM_TRIAL\t150\nSEED\t566564762\nBMULTIBUTNOTHISTO\t1\n";
+	std::string serial = runGibson(control, 1);
+	ASSERT_EQ(serial, runGibson(control, 3));
+	ASSERT_EQ(serial, runGibson(control, 8));
+}
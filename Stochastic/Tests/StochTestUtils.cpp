@@ -0,0 +1,100 @@
+#include "StochTestUtils.h"
+#include "../VCellStoch/include/Gibson.h"
+#include "../VCellStoch/include/TauLeaping.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+std::string bindingModel(int s0Count, int s1Count, int s2Count, double forwardRate, double reverseRate) {
+	std::stringstream model;
+	model << std::setprecision(16);
+	model << "<model>\n"
+		"<discreteVariables>\n"
+		"TotalVars\t3\n"
+		"s0_Count\t" << s0Count << "\n"
+		"s1_Count\t" << s1Count << "\n"
+		"s2_Count\t" << s2Count << "\n"
+		"</discreteVariables>\n"
+		"\n"
+		"<jumpProcesses>\n"
+		"TotalProcesses\t2\n"
+		"r0\n"
+		"r0_reverse\n"
+		"</jumpProcesses>\n"
+		"\n"
+		"<processDesc>\n"
+		"TotalDescriptions\t2\n"
+		"JumpProcess\tr0\n"
+		"\tPropensity\t(" << forwardRate << " * s0_Count * s2_Count)\n"
+		"\tEffect\t3\n"
+		"\t\ts0_Count\tinc\t-1.0\n\n"
+		"\t\ts2_Count\tinc\t-1.0\n\n"
+		"\t\ts1_Count\tinc\t1.0\n\n"
+		"\tDependentProcesses\t2\n"
+		"\t\tr0\n"
+		"\t\tr0_reverse\n"
+		"\n"
+		"JumpProcess\tr0_reverse\n"
+		"\tPropensity\t(" << reverseRate << " * s1_Count)\n"
+		"\tEffect\t3\n"
+		"\t\ts0_Count\tinc\t1.0\n\n"
+		"\t\ts2_Count\tinc\t1.0\n\n"
+		"\t\ts1_Count\tinc\t-1.0\n\n"
+		"\tDependentProcesses\t2\n"
+		"\t\tr0\n"
+		"\t\tr0_reverse\n"
+		"\n"
+		"</processDesc>\n"
+		"</model>\n";
+	return model.str();
+}
+
+std::string runStoch(bool bTauLeaping, const std::string& control, const std::string& model,
+	const std::string& trajectoryFileName) {
+	std::string inputFileName = std::tmpnam(nullptr);
+	std::string outputFileName = std::tmpnam(nullptr);
+	std::ofstream inputFileStream(inputFileName);
+	inputFileStream << "<control>\n" << control << "</control>\n" << model;
+	inputFileStream.close();
+
+	Gibson* gb = bTauLeaping ? new TauLeaping(inputFileName.c_str(), outputFileName.c_str())
+		: new Gibson(inputFileName.c_str(), outputFileName.c_str());
+	gb->march();
+	delete gb;
+
+	std::ifstream outputFileStream(outputFileName);
+	std::stringstream output;
+	output << outputFileStream.rdbuf();
+	outputFileStream.close();
+	std::remove(inputFileName.c_str());
+	std::remove(outputFileName.c_str());
+	if (trajectoryFileName.empty()) {
+		std::remove((outputFileName + "_hdf5").c_str());
+	} else {
+		std::rename((outputFileName + "_hdf5").c_str(), trajectoryFileName.c_str());
+	}
+	return output.str();
+}
+
+std::vector<std::vector<double> > getRows(const std::string& output, bool bFirstColumn) {
+	std::vector<std::vector<double> > rows;
+	std::stringstream ss(output);
+	std::string line;
+	std::getline(ss, line);
+	while (std::getline(ss, line)) {
+		std::stringstream ls(line);
+		std::vector<double> row;
+		double value;
+		if (!bFirstColumn) {
+			ls >> value;
+		}
+		while (ls >> value) {
+			row.push_back(value);
+		}
+		if (!row.empty()) {
+			rows.push_back(row);
+		}
+	}
+	return rows;
+}
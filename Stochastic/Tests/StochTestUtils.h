@@ -0,0 +1,21 @@
+//
+// Runs the models of the VCellStoch tests and parses their output.
+//
+#ifndef STOCHTESTUTILS_H
+#define STOCHTESTUTILS_H
+
+#include <string>
+#include <vector>
+
+// the model of s0 + s2 <-> s1 with the given initial counts, forward and reverse rate constants
+std::string bindingModel(int s0Count, int s1Count, int s2Count, double forwardRate, double reverseRate);
+
+// runs the model with the given control block with Gibson, or TauLeaping, returns the output
+// file; the HDF5 trajectory, if any, is kept as trajectoryFileName when it is given
+std::string runStoch(bool bTauLeaping, const std::string& control, const std::string& model,
+	const std::string& trajectoryFileName = std::string());
+
+// the rows of an output file after its header, with or without the first column (time or trial)
+std::vector<std::vector<double> > getRows(const std::string& output, bool bFirstColumn = false);
+
+#endif
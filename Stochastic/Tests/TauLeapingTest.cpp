@@ -0,0 +1,151 @@
+//
+// Tau-leaping must keep counts non negative and conserved, agree with the exact
+// method on average and give the output of the serial run with trials in parallel.
+//
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "StochTestUtils.h"
+#include <vector>
+
+// A <-> B, many molecules: mostly leaps
+static const char* isomerization_model_contents = R"INPUT_FILE(
+<model>
+<discreteVariables>
+TotalVars	2
+A	10000
+B	0
+</discreteVariables>
+
+<jumpProcesses>
+TotalProcesses	2
+forward
+reverse
+</jumpProcesses>
+
+<processDesc>
+TotalDescriptions	2
+JumpProcess	forward
+	Propensity	(1.0 * A)
+	Effect	2
+		A	inc	-1.0
+
+		B	inc	1.0
+
+	DependentProcesses	2
+		forward
+		reverse
+
+JumpProcess	reverse
+	Propensity	(1.0 * B)
+	Effect	2
+		A	inc	1.0
+
+		B	inc	-1.0
+
+	DependentProcesses	2
+		forward
+		reverse
+
+</processDesc>
+</model>
+)INPUT_FILE";
+
+// A -> C and A + A -> B from 30 molecules: critical processes and exact steps
+static const char* dimerization_model_contents = R"INPUT_FILE(
+<model>
+<discreteVariables>
+TotalVars	3
+A	30
+B	0
+C	0
+</discreteVariables>
+
+<jumpProcesses>
+TotalProcesses	2
+decay
+dimerization
+</jumpProcesses>
+
+<processDesc>
+TotalDescriptions	2
+JumpProcess	decay
+	Propensity	(0.5 * A)
+	Effect	2
+		A	inc	-1.0
+
+		C	inc	1.0
+
+	DependentProcesses	2
+		decay
+		dimerization
+
+JumpProcess	dimerization
+	Propensity	(0.05 * A * (A - 1) / 2)
+	Effect	2
+		A	inc	-2.0
+
+		B	inc	1.0
+
+	DependentProcesses	2
+		decay
+		dimerization
+
+</processDesc>
+</model>
+)INPUT_FILE";
+
+TEST(tauleapingtest, singleTrajectory) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t5.0\nTOLERANCE\t1.0E-9\nSAVE_PERIOD\t0.5\n"
+		"MAX_SAVE_POINTS\t100.0\nNUM_TRIAL\t1\nSEED\t1489333437\n";
+	std::vector<std::vector<double> > rows = getRows(runStoch(true, control, isomerization_model_contents));
+	// the initial values, then every save period to the ending time
+	ASSERT_EQ(rows.size(), 11);
+	for (auto & row : rows) {
+		ASSERT_EQ(row.size(), 2);
+		ASSERT_EQ(row[0] + row[1], 10000);
+	}
+	// 5000 at equilibrium, with a standard deviation of 50
+	ASSERT_NEAR(rows.back()[0], 5000, 250);
+}
+
+TEST(tauleapingtest, histogramMatchesGibson) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t0.3\nTOLERANCE\t1.0E-9\n"
+		"NUM_TRIAL\t100\nSEED\t1634997497\n";
+	std::vector<std::vector<double> > leaped = getRows(runStoch(true, control, isomerization_model_contents));
+	std::vector<std::vector<double> > exact = getRows(runStoch(false, control, isomerization_model_contents));
+	ASSERT_EQ(leaped.size(), 100);
+	ASSERT_EQ(exact.size(), 100);
+	double leapedMean = 0, exactMean = 0;
+	for (int k = 0; k < 100; k++) {
+		leapedMean += leaped[k][0] / 100;
+		exactMean += exact[k][0] / 100;
+	}
+	// 5000 (1 + exp(-0.6)) = 7744, the means of 100 trials are within a few units of it
+	ASSERT_NEAR(leapedMean, 7744, 20);
+	ASSERT_NEAR(exactMean, 7744, 20);
+}
+
+TEST(tauleapingtest, smallCounts) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t20.0\nTOLERANCE\t1.0E-9\n"
+		"NUM_TRIAL\t200\nSEED\t566564762\nTAU_LEAPING_EPSILON\t0.1\n";
+	std::vector<std::vector<double> > rows = getRows(runStoch(true, control, dimerization_model_contents));
+	ASSERT_EQ(rows.size(), 200);
+	for (auto & row : rows) {
+		ASSERT_EQ(row.size(), 3);
+		ASSERT_GE(row[0], 0);
+		ASSERT_GE(row[1], 0);
+		ASSERT_GE(row[2], 0);
+		ASSERT_EQ(row[0] + 2 * row[1] + row[2], 30);
+	}
+}
+
+TEST(tauleapingtest, parallelTrials) {
+	std::string control =
+		"STARTING_TIME\t0.0\nENDING_TIME\t2.0\nTOLERANCE\t1.0E-9\nSAVE_PERIOD\t0.1\n"
+		"MAX_SAVE_POINTS\t21.0\nNUM_TRIAL\t50\nSEED\t566564762\nBMULTIBUTNOTHISTO\t1\n";
+	std::string serial = runStoch(true, control + "NUM_THREADS\t1\n", dimerization_model_contents);
+	ASSERT_EQ(serial, runStoch(true, control + "NUM_THREADS\t3\n", dimerization_model_contents));
+}
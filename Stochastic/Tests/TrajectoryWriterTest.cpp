@@ -0,0 +1,107 @@
+//
+// The HDF5 trajectory must hold the samples of the text output of the same run.
+//
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "../VCellStoch/include/TrajectoryWriter.h"
+#include "StochTestUtils.h"
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+// the times and the values, variable after variable, of an HDF5 trajectory
+static void readTrajectory(const std::string& fileName, std::vector<double>& times, std::vector<double>& values, int& numVars) {
+	hid_t file = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	ASSERT_GE(file, 0);
+	hid_t dataset = H5Dopen1(file, "SimTimes");
+	hid_t space = H5Dget_space(dataset);
+	hsize_t timesDim[1];
+	H5Sget_simple_extent_dims(space, timesDim, NULL);
+	times.resize(timesDim[0]);
+	H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, times.data());
+	H5Sclose(space);
+	H5Dclose(dataset);
+
+	dataset = H5Dopen1(file, "Trajectory");
+	space = H5Dget_space(dataset);
+	hsize_t valuesDim[2];
+	H5Sget_simple_extent_dims(space, valuesDim, NULL);
+	numVars = valuesDim[0];
+	ASSERT_EQ(valuesDim[1], timesDim[0]);
+	values.resize(valuesDim[0] * valuesDim[1]);
+	H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+	H5Sclose(space);
+	H5Dclose(dataset);
+	H5Fclose(file);
+}
+
+// runs the model with the given control block, in text and in HDF5, and compares the samples
+static void compareOutputs(bool bTauLeaping, const std::string& control) {
+	std::string model = bindingModel(200, 0, 150, 0.003, 2.0);
+	// text rows: time, then the values
+	std::vector<std::vector<double> > rows = getRows(runStoch(bTauLeaping, control, model), true);
+	std::string trajectoryFileName = std::tmpnam(nullptr);
+	runStoch(bTauLeaping, control + "OUTPUT_FORMAT\tHDF5\n", model, trajectoryFileName);
+
+	std::vector<double> times;
+	std::vector<double> values;
+	int numVars = 0;
+	readTrajectory(trajectoryFileName, times, values, numVars);
+	std::remove(trajectoryFileName.c_str());
+
+	ASSERT_GT(rows.size(), 1);
+	ASSERT_EQ(numVars, 3);
+	ASSERT_EQ(times.size(), rows.size());
+	for (int t = 0; t < rows.size(); t++) {
+		ASSERT_EQ(rows[t].size(), numVars + 1);
+		// the text has 10 significant digits
+		ASSERT_NEAR(times[t], rows[t][0], 1e-9 * std::max(1.0, std::fabs(rows[t][0])));
+		for (int v = 0; v < numVars; v++) {
+			ASSERT_EQ(values[v * times.size() + t], rows[t][v + 1]);
+		}
+	}
+}
+
+TEST(trajectorywritertest, chunks) {
+	std::string fileName = std::tmpnam(nullptr);
+	std::vector<std::string> varNames = {"a", "b"};
+	int numSamples = 2 * TrajectoryWriter::CHUNK_SIZE + 100;
+	{
+		TrajectoryWriter writer(fileName, varNames);
+		for (int k = 0; k < numSamples; k++) {
+			double vals[2] = {(double)k, (double)-k};
+			writer.addSample(0.5 * k, vals);
+		}
+		ASSERT_EQ(writer.getNumSamples(), numSamples);
+	}
+	std::vector<double> times;
+	std::vector<double> values;
+	int numVars = 0;
+	readTrajectory(fileName, times, values, numVars);
+	std::remove(fileName.c_str());
+	ASSERT_EQ(numVars, 2);
+	ASSERT_EQ(times.size(), numSamples);
+	for (int k = 0; k < numSamples; k++) {
+		ASSERT_EQ(times[k], 0.5 * k);
+		ASSERT_EQ(values[k], k);
+		ASSERT_EQ(values[numSamples + k], -k);
+	}
+}
+
+TEST(trajectorywritertest, savePeriod) {
+	compareOutputs(false,
+		"STARTING_TIME\t0.0\nENDING_TIME\t20.0\nTOLERANCE\t1.0E-9\nSAVE_PERIOD\t0.002\n"
+		"MAX_SAVE_POINTS\t20000.0\nNUM_TRIAL\t1\nSEED\t1489333437\n");
+}
+
+TEST(trajectorywritertest, keepEvery) {
+	compareOutputs(false,
+		"STARTING_TIME\t0.0\nENDING_TIME\t5.0\nTOLERANCE\t1.0E-9\n"
+		"MAX_SAVE_POINTS\t100000.0\nNUM_TRIAL\t1\nSEED\t1489333437\n");
+}
+
+TEST(trajectorywritertest, tauLeaping) {
+	compareOutputs(true,
+		"STARTING_TIME\t0.0\nENDING_TIME\t20.0\nTOLERANCE\t1.0E-9\nSAVE_PERIOD\t0.01\n"
+		"MAX_SAVE_POINTS\t20000.0\nNUM_TRIAL\t1\nSEED\t1489333437\n");
+}
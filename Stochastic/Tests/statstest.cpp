@@ -4,10 +4,11 @@
 #include <stdexcept>
 #include "gtest/gtest.h"
 #include "../VCellStoch/include/Gibson.h"
+#include "StochTestUtils.h"
 #include <iostream>
 #include <cstdio>
 
-const char* input_file_contents = R"INPUT_FILE(
+const char* input_file_control = R"INPUT_FILE(
 <control>
 STARTING_TIME	0.0
 ENDING_TIME 	20.0
@@ -19,47 +20,6 @@ SEED	1634997497
 BMULTIBUTNOTHISTO	1
 </control>
 
-<model>
-<discreteVariables>
-TotalVars	3
-s0_Count	1
-s1_Count	0
-s2_Count	1
-</discreteVariables>
-
-<jumpProcesses>
-TotalProcesses	2
-r0
-r0_reverse
-</jumpProcesses>
-
-<processDesc>
-TotalDescriptions	2
-JumpProcess	r0
-	Propensity	(0.9996443474639611 * s0_Count * s2_Count)
-	Effect	3
-		s0_Count	inc	-1.0
-
-		s2_Count	inc	-1.0
-
-		s1_Count	inc	1.0
-
-	DependentProcesses	0
-
-JumpProcess	r0_reverse
-	Propensity	0.0
-	Effect	3
-		s0_Count	inc	1.0
-
-		s2_Count	inc	1.0
-
-		s1_Count	inc	-1.0
-
-	DependentProcesses	1
-		r0
-
-</processDesc>
-</model>
 )INPUT_FILE";
 
 /**
@@ -115,7 +75,7 @@ TEST(statstest,test1) {
 
 	// Setup the Gibson Solver input file
 	if (outputFileStream.is_open()) outputFileStream.close();
-	inputFileStream << input_file_contents;
+	inputFileStream << input_file_control << bindingModel(1, 0, 1, 0.9996443474639611, 0.0);
 	inputFileStream.close();
 
 	// Create the Gibson Solver
@@ -0,0 +1,53 @@
+#ifndef COMPILEDSTOCHMODEL_H
+#define COMPILEDSTOCHMODEL_H
+
+#include <stdint.h>
+#include <vector>
+#include "StochVar.h"
+#include "Jump.h"
+
+/* This class defines the flat form of a model's processes that the simulation
+ * loop uses instead of walking the Jump and StochVarContext objects:
+ *    the effects of all processes as rows of (variable, value, assignment),
+ *    the dependent processes of all processes as rows of process indexes,
+ *    the propensities, the last evaluated ones are kept for the next reaction method.
+ * A propensity of the form c * (x1 - n1) * (x2 - n2) * ... in the variables, which
+ * mass action kinetics give, is evaluated as this product; any other propensity
+ * is evaluated by its expression.
+ * The processes are indexed as in StochModel.listOfProcesses (Jump::getNameIndex()),
+ * the variables as in StochModel.listOfVars. The values array given to the methods
+ * is the one of the expressions: the variables, then the time.
+ * Reference method descriptions in CompiledStochModel.cpp.
+ */
+class CompiledStochModel {
+public:
+	CompiledStochModel(vector<StochVar*>& vars, vector<Jump*>& processes);
+	~CompiledStochModel();
+	void loadValues(double* values, double time);
+	void fire(int process, double* values);
+	double updatePropensity(int process, double* values);
+	double getPropensity(int process) {return propensities[process];}
+	int getNumDependents(int process) {return dependentStart[process + 1] - dependentStart[process];}
+	const int* getDependents(int process) {return dependents.data() + dependentStart[process];}
+	bool isMassAction(int process) {return factorStart[process] >= 0;}
+private:
+	vector<Jump*> processes;
+	vector<uint64_t*> varValues;//where the variables' values are stored
+	//effects of each process, as rows of (variable, value, assignment or increment)
+	vector<int> effectStart;
+	vector<int> effectVar;
+	vector<int64_t> effectValue;
+	vector<char> bEffectAssign;
+	//dependent processes of each process
+	vector<int> dependentStart;
+	vector<int> dependents;
+	//mass action propensities, coefficient and rows of (variable, offset); factorStart is -1 for other processes
+	vector<double> coefficients;
+	vector<int> factorStart;
+	vector<int> factorEnd;
+	vector<int> factorVar;
+	vector<double> factorOffset;
+	vector<double> propensities;
+};
+
+#endif
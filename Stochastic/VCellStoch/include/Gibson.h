@@ -2,11 +2,14 @@
 #define GIBSON_H
 
 #include <fstream>
+#include <sstream>
 #include <random>
 #include "StochModel.h"
 #include "MultiTrialStats.h"
 
 class IndexedTree;
+class CompiledStochModel;
+class TrajectoryWriter;
 
 /* This class defines Gibson method which is also called Next Reaction Method.
  * The Gibson method uses only a single random number per simulation event and 
@@ -15,7 +18,9 @@ class IndexedTree;
  * indexed priority queue. The latter is implemented as an indexed tree in our
  * package. 
  * The class takes model information from input file and outputs the result as
- * plots(single trial) or histograms(multiple trials).
+ * plots(single trial) or histograms(multiple trials). With OUTPUT_FORMAT HDF5 in
+ * the control block, a single trial is streamed to the HDF5 file <output>_hdf5
+ * (see TrajectoryWriter) and the output file only has the header.
  * Reference method descriptions in Gibson.cpp.
  *
  * @Author: Tracy LI, Boris Slepchenko
@@ -26,7 +31,7 @@ class Gibson : public StochModel{
 public:
 	Gibson();
 	Gibson(const char*, const char*);
-	~Gibson();
+	virtual ~Gibson();
 	int core();
 	void march();
 	double getRandomUniform();
@@ -35,18 +40,29 @@ public:
 	* maximum number of points which can be saved
 	*/
 	const static unsigned int MAX_ALLOWED_POINTS = 5000000;
-private:
+	/**
+	* trials per thread run at once by a parallel ensemble before their results are written
+	*/
+	const static int TRIALS_PER_THREAD = 16;
+protected:
 	IndexedTree *Tree; //the data structure(binary tree) to store all the processes and make each parent smaller than it's children.
 	double* currvals;//array of variable values to be used by expression parser. variables are stored in vector listOfVars.
+	CompiledStochModel* compiledModel;//the flat effects, dependencies and propensities of the processes, used by core()
 	std::ofstream outfile; //the output file stream where the results are saved.
+	std::ostream* trialOutput; //where core() writes: outfile, or the buffer of a trial worker.
+	const char* infilename;//the input file name, read again by each trial worker.
 	const char* outfilename;//the output file name.
 	bool flag_savePeriod;//the flag for using save period.
+	bool bTrajectoryHDF5;//OUTPUT_FORMAT HDF5, a single trajectory is saved to the HDF5 file instead of the output file
+	TrajectoryWriter* trajectoryWriter;//where the samples of a single trajectory go, with OUTPUT_FORMAT HDF5
 	int finalizeSampleRow(int,double);//central location to call to complete 1 output sample to file
+	void reportProgress(int,double);//progress message, no more than every 2 seconds
 	int savedSampleCount; //saved sample counter that survives certain iterations to keep overall count
 	time_t lastTime;
     static const string MY_T_STR;
 
-    MultiTrialStats *multiTrialStats;
+    MultiTrialStats *multiTrialStats;//created by march(), trial workers have none
+    int numHistogramBins;//HISTOGRAM_BINS, bins of the distributions kept by multiTrialStats, 0 for none
     //Var dealing with multitrial-nonhisto (avg,min,max)
     bool bMultiButNotHisto;
     int currMultiNonHistoIter;
@@ -54,6 +70,23 @@ private:
     void accumOrSaveInit(int varLen,double timePoint,bool bAddTab);
     std::mt19937_64 *generator;
     std::uniform_real_distribution<double> *distribution;
+
+    //parallel ensemble: each thread runs whole trials on its own copy of the model (a trial worker),
+    //the results are then written in trial order so that the output is that of the serial run
+    int numThreads;//NUM_THREADS, 0 for all OpenMP threads
+    bool bTrialWorker;
+    std::ostringstream trialBuffer;//a worker's output of its current trial
+    vector<int> trialSampleIndexes;//a worker's multiTrialStats samples of its current trial
+    vector<double> trialSampleTimes;
+    vector<double> trialSampleValues;
+    struct TrialResult;
+    void runTrial(long seed);
+    virtual Gibson* newTrialWorker();//a copy of the model read from the input file, for a trial thread
+    void runWorkerTrial(long trial, TrialResult& result);
+    bool writeTrialResult(long trial, TrialResult& result);
+    void marchParallel(long numTrials, int numTrialThreads);
+    int getNumTrialThreads();
+    void addTrialSample(int timeIndex, double timeValue, double* varVals);
 } ;
 
 #endif
@@ -34,6 +34,7 @@ public:
 private:
 	int size;// the size of the tree
 	vector<Jump*> index; //binary tree which saves jump processes and the root has the smallest value
+	vector<double> times; //the processes' times in the order of index, compared without reading the processes
 };
 
 #endif
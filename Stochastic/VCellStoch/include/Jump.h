@@ -40,6 +40,9 @@ public:
 	StochVarContext(StochVar*, string, int);
 	~StochVarContext();
 	void updateCurr();
+	StochVar *getVar() {return sv;}
+	string getOperation() {return operation;}
+	int getVal() {return val;}
 private:
 	StochVar *sv;
 	string operation;
@@ -83,6 +86,8 @@ class Jump
 	   double getOldProbabilityRate() {return propensity;}
 	   double getProbabilityRate(double*);
 	   string getProbabilityRateEvaluationSummary(double* values);
+	   void getProbabilitySymbols(vector<string>& symbols);
+	   bool getProbabilityProductForm(double& coefficient, vector<int>& symbolIndexes, vector<double>& offsets);
 
 
     private:
@@ -11,26 +11,45 @@
 using std::vector;
 using std::string;
 
+// Besides the mean, variance, min and max of each variable at each time point, the
+// distribution across trials is kept as a histogram of numHistogramBins bins starting
+// at 0: bin k counts the values in [k * width, (k + 1) * width). The width starts at 1,
+// exact for molecule counts, and doubles (pairs of bins merge) whenever a value does not
+// fit, so that memory stays bounded. Histograms of the same number of bins merge exactly,
+// which makes the statistics of trials run apart mergeable.
 class MultiTrialStats {
 public:
-    MultiTrialStats(int numVars, int numTimePoints);
+    MultiTrialStats(int numVars, int numTimePoints, int numHistogramBins = DEFAULT_HISTOGRAM_BINS);
 
     void startNewTrial();
     void addSample(int timeIndex, double timeValue, double* varVals);
+    void merge(const MultiTrialStats& other);
 
     double getMean(int varIndex, int timeIndex);
     double getVariance(int varIndex, int timeIndex);
     double getMin(int varIndex, int timeIndex);
     double getMax(int varIndex, int timeIndex);
+    double getPercentile(int varIndex, int timeIndex, double percent);
+    double getHistogramBinWidth(int varIndex, int timeIndex);
+    unsigned int getHistogramCount(int varIndex, int timeIndex, int bin);
 
     int getNumVars() const { return numVars; }
     int getNumTimePoints() { return timeValues.size(); }
+    int getNumHistogramBins() const { return numHistogramBins; }
     double getTimePoint(int timeIndex) { return timeValues[timeIndex]; }
     void writeHDF5(std::string outfilename, vector<string> listOfVarNames);
+
+    static const int DEFAULT_HISTOGRAM_BINS = 64;
+    // percentiles written to the HDF5 file
+    static const int NUM_PERCENTILES = 5;
+    static const double PERCENTILES[NUM_PERCENTILES];
 private:
     void init();
+    void addToHistogram(int timeIndex, int varIndex, double value);
+    void coarsenHistogram(int timeIndex, int varIndex);
     int numVars;
     int numTimePoints;
+    int numHistogramBins;
     int currentTrial;
 
     vector<vector<double> > mean;
@@ -38,6 +57,8 @@ private:
     vector<vector<double> > variance;
     vector<vector<double> > statMin;
     vector<vector<double> > statMax;
+    vector<vector<unsigned int> > histogramCounts; // numHistogramBins per variable, empty until the time point is sampled
+    vector<vector<double> > histogramBinWidth;
     vector<double> timeValues;
 };
 
@@ -0,0 +1,67 @@
+#ifndef TAULEAPING_H
+#define TAULEAPING_H
+
+#include <stdint.h>
+#include "Gibson.h"
+
+/* This class defines the explicit tau-leaping method with the tau selection of
+ * Cao, Gillespie and Petzold (J. Chem. Phys. 124, 044109, 2006). In a leap of
+ * length tau every reaction fires a Poisson number of times, tau being chosen so
+ * that no propensity changes by much more than a fraction epsilon during the leap.
+ * Critical reactions, those a few firings away from using up one of their
+ * reactants, fire at most once per leap as in the exact method; and when a leap
+ * would be no longer than a few exact steps, the method takes exact steps
+ * (direct method) instead.
+ * The model, the trials and the output are those of Gibson, only core() differs.
+ * Control (optional, in the control block of the input file):
+ *    TAU_LEAPING_EPSILON         the fraction epsilon, 0.03 by default
+ *    TAU_LEAPING_CRITICAL_COUNT  the firings left below which a reaction is critical, 10 by default
+ * Reference method descriptions in TauLeaping.cpp.
+ */
+class TauLeaping : public Gibson {
+public:
+	TauLeaping(const char*, const char*);
+	~TauLeaping();
+	int core();
+	/**
+	* exact steps taken when a leap would be too short
+	*/
+	const static int NUM_EXACT_STEPS = 100;
+protected:
+	Gibson* newTrialWorker();
+private:
+	double epsilon;//relative change of the propensities allowed in a leap
+	int criticalCount;//a reaction with fewer firings left than this is critical
+	//stoichiometry of the increments of each process, as rows of (variable, change)
+	vector<int> stoichStart;
+	vector<int> stoichVar;
+	vector<int64_t> stoichChange;
+	vector<bool> bExactOnly;//processes with effects other than increments, only fired one at a time
+	//for each variable, the highest order of the processes it is a reactant of and how many
+	//of it these processes use, for the tau selection
+	vector<int> highestOrder;
+	vector<int> highestOrderCount;
+	vector<double> propensities;
+	vector<bool> bCritical;
+	vector<int64_t> counts;
+	vector<int64_t> leapCounts;
+	vector<double> mu;//expected change of each variable per unit time by non critical processes
+	vector<double> sigma2;//its variance per unit time
+	vector<double> sampleValues;//the current values, as writeSample() takes them
+	double outputTimer;
+	int saveIntervalCount;
+
+	void readControl(const char* filename);
+	void setupStoichiometry();
+	double updatePropensities(double simtime);
+	double selectTau();
+	double getG(int var, int64_t count);
+	int pickProcess(double target, bool bCriticalOnly);
+	void fireExact(int process);
+	double getPositiveRandomUniform();
+	void saveSamplesBefore(double time, double* values);
+	void saveStep(double simtime);
+	void writeSample(double time, double* values, bool bLast);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TRAJECTORYWRITER_H
+#define TRAJECTORYWRITER_H
+
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+
+#ifdef __APPLE__
+    #if __arm__ || __arm64__
+    #include "/opt/homebrew/opt/hdf5/include/hdf5.h"
+    #else
+    #include "/usr/local/opt/hdf5/include/hdf5.h"
+    #endif
+#else
+#include <hdf5.h>
+#endif
+
+/* This class streams the samples of a single trajectory to an HDF5 file as they
+ * are taken, instead of formatting them as text:
+ *    VarNames     the variable names
+ *    SimTimes     the sample times
+ *    Trajectory   the values, one row of sample values per variable
+ * Samples are buffered and written CHUNK_SIZE at a time, each a chunk of SimTimes
+ * and one chunk of each variable's row of Trajectory, which both grow as needed.
+ * Reference method descriptions in TrajectoryWriter.cpp.
+ */
+class TrajectoryWriter {
+public:
+    TrajectoryWriter(string filename, const vector<string>& varNames);
+    ~TrajectoryWriter();
+    void addSample(double timeValue, double* varVals);
+    void close();
+    long getNumSamples() const { return numSamples; }
+    /**
+    * samples in each chunk, and in the buffer
+    */
+    const static int CHUNK_SIZE = 4096;
+private:
+    void flush();
+    bool closeFile();
+    string filename;
+    int numVars;
+    long numSamples;//samples added, written or buffered
+    int numBuffered;
+    vector<double> timeBuffer;
+    vector<double> valueBuffer;//CHUNK_SIZE samples per variable, variable after variable
+    hid_t file;
+    hid_t timesDataset;
+    hid_t valuesDataset;
+};
+
+#endif
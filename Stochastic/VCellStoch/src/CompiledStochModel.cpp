@@ -0,0 +1,118 @@
+#include "../include/CompiledStochModel.h"
+
+#include <map>
+using namespace std;
+
+/*
+ *This constructor flattens the effects, the dependent processes and the mass action
+ *propensities of the processes.
+ *Input para: vector<StochVar*>&, the variables, whose values the expressions take first
+ *            vector<Jump*>&, the processes, each at its name index
+ */
+CompiledStochModel::CompiledStochModel(vector<StochVar*>& vars, vector<Jump*>& arg_processes)
+{
+	processes = arg_processes;
+	int varLen = vars.size();
+	int numProcesses = processes.size();
+	map<StochVar*, int> varIndexes;
+	for (int i = 0; i < varLen; i++) {
+		varIndexes[vars[i]] = i;
+		varValues.push_back(vars[i]->getCurr());
+	}
+	effectStart.push_back(0);
+	dependentStart.push_back(0);
+	for (int j = 0; j < numProcesses; j++) {
+		Jump* jump = processes[j];
+		//operations other than "inc" and "equ" change nothing, as in StochVarContext::updateCurr()
+		for (int k = 0; k < jump->getNumVars(); k++) {
+			StochVarContext* context = jump->getVar(k);
+			bool bAssign = context->getOperation() == "equ";
+			if (bAssign || context->getOperation() == "inc") {
+				effectVar.push_back(varIndexes[context->getVar()]);
+				effectValue.push_back(context->getVal());
+				bEffectAssign.push_back(bAssign);
+			}
+		}
+		effectStart.push_back(effectVar.size());
+		for (int k = 0; k < jump->getNumDependentJumps(); k++) {
+			dependents.push_back(jump->getDependent(k)->getNameIndex());
+		}
+		dependentStart.push_back(dependents.size());
+
+		//the time, after the variables, is not a count
+		double coefficient;
+		vector<int> symbolIndexes;
+		vector<double> offsets;
+		bool bMassAction = jump->getProbabilityProductForm(coefficient, symbolIndexes, offsets);
+		for (int k = 0; bMassAction && k < symbolIndexes.size(); k++) {
+			bMassAction = symbolIndexes[k] < varLen;
+		}
+		coefficients.push_back(bMassAction ? coefficient : 0.0);
+		factorStart.push_back(bMassAction ? (int)factorVar.size() : -1);
+		if (bMassAction) {
+			factorVar.insert(factorVar.end(), symbolIndexes.begin(), symbolIndexes.end());
+			factorOffset.insert(factorOffset.end(), offsets.begin(), offsets.end());
+		}
+		factorEnd.push_back(factorVar.size());
+	}
+	propensities.assign(numProcesses, 0.0);
+}//end of constructor CompiledStochModel()
+
+CompiledStochModel::~CompiledStochModel()
+{
+}//end of destructor ~CompiledStochModel()
+
+/*
+ *Copy the variables' values and the time to the values of the expressions.
+ *Input para: double*, the values of the expressions
+ *            double, the time
+ */
+void CompiledStochModel::loadValues(double* values, double time)
+{
+	int varLen = varValues.size();
+	for (int i = 0; i < varLen; i++) {
+		values[i] = *varValues[i];
+	}
+	values[varLen] = time;
+}//end of method loadValues()
+
+/*
+ *Apply the effects of a process to the variables and to the values of the expressions.
+ *Input para: int, the process
+ *            double*, the values of the expressions, updated where the variables changed
+ */
+void CompiledStochModel::fire(int process, double* values)
+{
+	for (int k = effectStart[process]; k < effectStart[process + 1]; k++) {
+		int var = effectVar[k];
+		uint64_t* value = varValues[var];
+		if (bEffectAssign[k]) {
+			*value = (uint64_t)effectValue[k];
+		} else {
+			*value += (uint64_t)effectValue[k];
+		}
+		values[var] = *value;
+	}
+}//end of method fire()
+
+/*
+ *Evaluate the propensity of a process and keep it.
+ *Input para: int, the process
+ *            double*, the values of the expressions
+ *Output para: double, the propensity
+ */
+double CompiledStochModel::updatePropensity(int process, double* values)
+{
+	double p;
+	int start = factorStart[process];
+	if (start >= 0) {
+		p = coefficients[process];
+		for (int k = start; k < factorEnd[process]; k++) {
+			p *= values[factorVar[k]] - factorOffset[k];
+		}
+	} else {
+		p = processes[process]->getProbabilityRate(values);
+	}
+	propensities[process] = p;
+	return p;
+}//end of method updatePropensity()
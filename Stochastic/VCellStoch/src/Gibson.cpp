@@ -15,15 +15,23 @@
 #include <cstdlib>
 #include <iostream>
 #include <random>
+#include <algorithm>
+#include <exception>
 using namespace std;
 
 #include <ctime>
 #include "../include/IndexedTree.h"
+#include "../include/CompiledStochModel.h"
+#include "../include/TrajectoryWriter.h"
 
 #ifdef USE_MESSAGING
 #include <VCELL/SimulationMessaging.h>
 #endif
 #include "VCellException.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 const double double_infinity = numeric_limits<double>::infinity();
 const double EPSILON = 1E-12;
 const string Gibson::MY_T_STR = "t";
@@ -35,6 +43,16 @@ Gibson::Gibson()
 	: savedSampleCount(1), lastTime (std::numeric_limits<long>::min()) {
 	Tree = NULL;
 	currvals = NULL;
+	compiledModel = NULL;
+	bTrajectoryHDF5 = false;
+	trajectoryWriter = NULL;
+	trialOutput = &outfile;
+	infilename = NULL;
+	outfilename = NULL;
+	multiTrialStats = NULL;
+	numThreads = 0;
+	numHistogramBins = MultiTrialStats::DEFAULT_HISTOGRAM_BINS;
+	bTrialWorker = false;
     generator = new std::mt19937_64();
     distribution = new std::uniform_real_distribution<double>(0.0,1.0);
 #ifdef USE_MESSAGING
@@ -49,6 +67,7 @@ Gibson::Gibson()
  *            string, the output file(name), where the results are saved.
  */
 Gibson::Gibson(const char* arg_infilename, const char* arg_outfilename) : Gibson(){ // Use delegating constructor
+	this->infilename = arg_infilename;
 	this->outfilename = arg_outfilename;
 
 	ifstream infile;
@@ -83,6 +102,17 @@ Gibson::Gibson(const char* arg_infilename, const char* arg_outfilename) : Gibson
 			infile >> NUM_TRIAL;
 		} else if (instring == "SEED"){
 			infile >> SEED;
+		} else if (instring == "NUM_THREADS"){
+			infile >> numThreads;
+		} else if (instring == "HISTOGRAM_BINS"){
+			infile >> numHistogramBins;
+		} else if (instring == "OUTPUT_FORMAT"){
+			string format;
+			infile >> format;
+			if (format != "TEXT" && format != "HDF5") {
+				VCELL_EXCEPTION(invalid_argument, "Unknown OUTPUT_FORMAT " << format << ", expected TEXT or HDF5");
+			}
+			bTrajectoryHDF5 = format == "HDF5";
 		} else if (instring == "TotalVars"){ //load listofvars
 			int varCount;
 			infile >> varCount;
@@ -185,9 +215,7 @@ Gibson::Gibson(const char* arg_infilename, const char* arg_outfilename) : Gibson
 
 	//initialization of the double array currvals
 	currvals=new double[listOfIniValues.size()+1];
-    if (bMultiButNotHisto){
-        this->multiTrialStats = new MultiTrialStats(listOfVars.size(), MAX_SAVE_POINTS);
-    }
+	compiledModel = new CompiledStochModel(listOfVars, listOfProcesses);
 #ifdef DEBUG
 	cout << "-------------------control information----------------"<<endl;
 	cout << "starting time:"<<STARTING_TIME <<endl;
@@ -244,6 +272,9 @@ Gibson::~Gibson()
 	listOfProcessNames.clear();
 	//delete currvals
 	delete[] currvals;
+	delete compiledModel;
+	delete trajectoryWriter;
+	delete multiTrialStats;
     delete distribution;
     delete generator;
 }//end of destructor ~Gibson()
@@ -264,20 +295,19 @@ int Gibson::core()
 	int iterationCounter=0;//counter used for termination of the loop when max_iteration is reached
 	int i; //loop variable
 	int varLen = listOfIniValues.size(); //variables' length
+	bool bSaveLastStep = (NUM_TRIAL ==1) && (flag_savePeriod);//lastStepVals are only output by a single trajectory with save period
+	//get current values for evaluating the probability expressions, kept up to date by compiledModel->fire()
+	compiledModel->loadValues(currvals, simtime);
+	for(int k=0;k<varLen;k++)
+	{
+		lastStepVals[k]=currvals[k];
+	}
 	//reset the indexed tree
 	for(i=0;i<Tree->getSize();i++)
 	{
 		Jump *jump = Tree->getProcess(i);
 		jump->setNode(i);
-
-		//get current values for evaluating the probability expression & also reset last setp values
-		for(int k=0;k<varLen;k++)
-		{
-			currvals[k]=listOfIniValues[k];
-			lastStepVals[k]=*listOfVars.at(k)->getCurr();
-		}
-		currvals[varLen] = simtime;
-		p = jump->getProbabilityRate(currvals);
+		p = compiledModel->updatePropensity(jump->getNameIndex(), currvals);
 		//amended Oct 11th, 2007. Stop the simulation and send error message back if
 		//anyone of the propensity functions is negative.
 		if(p < 0){
@@ -303,11 +333,13 @@ int Gibson::core()
 	}
 	Tree->build();
     if (bMultiButNotHisto) {
-        multiTrialStats->startNewTrial();
+        if (!bTrialWorker) {
+            multiTrialStats->startNewTrial();
+        }
         double initialValues[listOfIniValues.size()];
         for (int k=0;k<listOfIniValues.size();k++)
             initialValues[k]=listOfIniValues[k];
-        multiTrialStats->addSample(0, 0.0, initialValues);
+        addTrialSample(0, 0.0, initialValues);
     }
 	//the while loop does one trial for simulation and ends by ending_time.
 	while(simtime < ENDING_TIME)
@@ -317,14 +349,17 @@ int Gibson::core()
 			break;
 		}
 #endif
-		//save last step variables' values
-		for(i = 0;i<varLen;i++){
-			lastStepVals[i]=*listOfVars.at(i)->getCurr();
-		}
 	    //get next reaction with shortest absolute time
 		Jump* event = Tree->getProcess(0);
 		//update time
 		simtime = event->getTime();
+		//save last step variables' values, when they are output before this reaction
+		if(bSaveLastStep && ((outputTimer+SAVE_PERIOD) < simtime || simtime > ENDING_TIME))
+		{
+			for(i = 0;i<varLen;i++){
+				lastStepVals[i]=currvals[i];
+			}
+		}
 		if(simtime > ENDING_TIME)
 		{
 			//simulation time exceed ending time. Before we quit the simulation
@@ -334,11 +369,13 @@ int Gibson::core()
 				while((outputTimer+SAVE_PERIOD+EPSILON) < ENDING_TIME)
 				{
                     if(bMultiButNotHisto) {//Accumulate data mode
-                        multiTrialStats->addSample(savedSampleCount, outputTimer + SAVE_PERIOD, lastStepVals);
+                        addTrialSample(savedSampleCount, outputTimer + SAVE_PERIOD, lastStepVals);
+                    }else if(trajectoryWriter != NULL) {
+                        trajectoryWriter->addSample(outputTimer + SAVE_PERIOD, lastStepVals);
                     }else {
                         accumOrSaveInit(varLen, outputTimer + SAVE_PERIOD, true);
                         for (i = 0; i < varLen; i++) {
-                            outfile << lastStepVals[i] << "\t";
+                            *trialOutput << lastStepVals[i] << "\t";
                         }
                     }
 //                    outfile << outputTimer+SAVE_PERIOD << "\t";
@@ -351,24 +388,17 @@ int Gibson::core()
 			}
 			break;
 		}
-		//update affected variables
-		int numVars = event->getNumVars();
-		for(i = 0;i<numVars;i++){
-			event->getVar(i)->updateCurr();
-		}
-		//get current values for evaluate the probability expression
-		for(int k=0;k<varLen;k++)
-		{
-			currvals[k]=*listOfVars.at(k)->getCurr();
-		}
+		//update affected variables and their values for evaluating the probability expressions
+		int eventIndex = event->getNameIndex();
+		compiledModel->fire(eventIndex, currvals);
 		currvals[varLen] = simtime;
 		//update the jump that occured
 		double r = getRandomUniform();
-		p = event->getProbabilityRate(currvals);
+		p = compiledModel->updatePropensity(eventIndex, currvals);
 		//amended Oct 11th, 2007. Stop the simulation and send error message back if
 		//anyone of the propensity functions is negative.
 		if(p < 0){
-			VCELL_EXCEPTION(runtime_error,"at time point " << simtime << ", propensity of jump process "<< listOfProcessNames.at(event->getNameIndex()) <<" evaluated to a negative value (" << p << "). Simulation abort!" << endl << event->getProbabilityRateEvaluationSummary(currvals) );
+			VCELL_EXCEPTION(runtime_error,"at time point " << simtime << ", propensity of jump process "<< listOfProcessNames.at(eventIndex) <<" evaluated to a negative value (" << p << "). Simulation abort!" << endl << event->getProbabilityRateEvaluationSummary(currvals) );
 		}
 		//amended May 17th. The previous sentence will cause the time of a process stuck in double_infinity when r<=0
 		if(r>0)
@@ -384,16 +414,18 @@ int Gibson::core()
 			Tree->updateTree(event, double_infinity);
 		}
 		//update dependent jumps
-		int numDependentJumps = event->getNumDependentJumps();
+		int numDependentJumps = compiledModel->getNumDependents(eventIndex);
+		const int* dependents = compiledModel->getDependents(eventIndex);
 		for(i=0;i<numDependentJumps;i++)
 		{
-			Jump *dJump = event->getDependent(i);
-			double p_old = dJump->getOldProbabilityRate();
-			double p_new = dJump->getProbabilityRate(currvals);
+			int dIndex = dependents[i];
+			Jump *dJump = listOfProcesses[dIndex];
+			double p_old = compiledModel->getPropensity(dIndex);
+			double p_new = compiledModel->updatePropensity(dIndex, currvals);
 			//amended Oct 11th, 2007. Stop the simulation and send error message back if
 			//anyone of the propensity functions is negative.
 			if(p_new < 0){
-				VCELL_EXCEPTION(runtime_error, "at time point " << simtime << ", propensity of jump process "<< listOfProcessNames.at(dJump->getNameIndex()) <<" evaluated to a negative value (" << p << "). Simulation abort!" << endl << dJump->getProbabilityRateEvaluationSummary(currvals) );
+				VCELL_EXCEPTION(runtime_error, "at time point " << simtime << ", propensity of jump process "<< listOfProcessNames.at(dIndex) <<" evaluated to a negative value (" << p_new << "). Simulation abort!" << endl << dJump->getProbabilityRateEvaluationSummary(currvals) );
 			}
 			double tau = dJump->getTime();
 			//amended May 17th. to make sure that tau is a finite double
@@ -428,11 +460,13 @@ int Gibson::core()
 					while((outputTimer+SAVE_PERIOD) < simtime)
 					{
                         if(bMultiButNotHisto) {//Accumulate data mode
-                            multiTrialStats->addSample(savedSampleCount, outputTimer + SAVE_PERIOD, lastStepVals);
+                            addTrialSample(savedSampleCount, outputTimer + SAVE_PERIOD, lastStepVals);
+                        }else if(trajectoryWriter != NULL) {
+                            trajectoryWriter->addSample(outputTimer + SAVE_PERIOD, lastStepVals);
                         }else {
                             accumOrSaveInit(varLen, outputTimer + SAVE_PERIOD, true);
                             for (i = 0; i < varLen; i++) {
-                                outfile << lastStepVals[i] << "\t";
+                                *trialOutput << lastStepVals[i] << "\t";
                             }
                         }
 						savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
@@ -440,19 +474,34 @@ int Gibson::core()
 					}
 					if(outputTimer+SAVE_PERIOD <= simtime + EPSILON)
 					{
-						outfile << outputTimer+SAVE_PERIOD << "\t";
-						for(i=0;i<varLen;i++){
-							outfile<< *listOfVars.at(i)->getCurr() << "\t";
-							savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
+						if(trajectoryWriter != NULL)
+						{
+							trajectoryWriter->addSample(outputTimer+SAVE_PERIOD, currvals);
+							savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);
+						}
+						else
+						{
+							*trialOutput << outputTimer+SAVE_PERIOD << "\t";
+							for(i=0;i<varLen;i++){
+								*trialOutput << *listOfVars.at(i)->getCurr() << "\t";
+								savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
+							}
 						}
 						outputTimer = outputTimer + SAVE_PERIOD;
 					}
 				}
 				else //KeepEvery
 				{
-					outfile << simtime << "\t";
-					for(i=0;i<varLen;i++){
-						outfile<< *listOfVars.at(i)->getCurr()<< "\t";
+					if(trajectoryWriter != NULL)
+					{
+						trajectoryWriter->addSample(simtime, currvals);
+					}
+					else
+					{
+						*trialOutput << simtime << "\t";
+						for(i=0;i<varLen;i++){
+							*trialOutput << *listOfVars.at(i)->getCurr()<< "\t";
+						}
 					}
 					savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
 				}
@@ -471,11 +520,13 @@ int Gibson::core()
 	if((simtime > ENDING_TIME) && (NUM_TRIAL == 1) && (flag_savePeriod))//SingleTrajectory_OutputInterval
 	{
         if(bMultiButNotHisto) {//Accumulate data mode
-            multiTrialStats->addSample(savedSampleCount, ENDING_TIME, lastStepVals);
+            addTrialSample(savedSampleCount, ENDING_TIME, lastStepVals);
+        }else if(trajectoryWriter != NULL) {
+            trajectoryWriter->addSample(ENDING_TIME, currvals);
         }else {
             accumOrSaveInit(listOfVars.size(), ENDING_TIME, false);
             for (i = 0; i < listOfVars.size(); i++) {
-                outfile << "\t" << *listOfVars.at(i)->getCurr();
+                *trialOutput << "\t" << *listOfVars.at(i)->getCurr();
             }
         }
 		savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
@@ -485,7 +536,7 @@ int Gibson::core()
 	{
 		for(i=0;i<listOfVars.size();i++)
 		{
-			outfile<< "\t" << *listOfVars.at(i)->getCurr();
+			*trialOutput << "\t" << *listOfVars.at(i)->getCurr();
 		}
 		savedSampleCount = finalizeSampleRow(savedSampleCount,simtime);//outfile << endl;
 	}
@@ -499,9 +550,9 @@ int Gibson::core()
 
 void Gibson::accumOrSaveInit(int varLen,double timePoint,bool bAddTab) {
     if(bAddTab) {
-        outfile << timePoint << "\t";
+        *trialOutput << timePoint << "\t";
     }else{
-        outfile << timePoint;
+        *trialOutput << timePoint;
     }
 }
 //end of method core()
@@ -520,8 +571,8 @@ void Gibson::accumOrSaveInit(int varLen,double timePoint,bool bAddTab) {
 
 
 int Gibson::finalizeSampleRow(int savedSampleCount,double simtime){
-    if(!bMultiButNotHisto) {
-        outfile << endl;
+    if(!bMultiButNotHisto && trajectoryWriter == NULL) {
+        *trialOutput << endl;
     }
 //	cout << "savedSampleCount=" << savedSampleCount << endl;
 	if(savedSampleCount > MAX_SAVE_POINTS) {
@@ -529,6 +580,15 @@ int Gibson::finalizeSampleRow(int savedSampleCount,double simtime){
 			"Simulation exceeded maximum saved time points " << MAX_SAVE_POINTS 
 			<< ". Partial results may be available. \nYou can increase the save interval (\"keep every\") or increase the maximum number of saved time points (\"keep at most\").");
 	}
+	//a trial worker's progress is reported as its trials are written
+	if (!bTrialWorker) {
+		reportProgress(savedSampleCount, simtime);
+	}
+
+	return savedSampleCount+1;
+}
+
+void Gibson::reportProgress(int savedSampleCount,double simtime){
 	//progress no more than every 2 seconds
 	if (difftime(time(NULL),lastTime) > 2.0){
 		lastTime = time(NULL);
@@ -560,8 +620,6 @@ int Gibson::finalizeSampleRow(int savedSampleCount,double simtime){
 #endif
 		}
 	}
-
-	return savedSampleCount+1;
 }
 
 
@@ -591,6 +649,9 @@ void Gibson::march(){
 
         this->numMultiNonHisto = this->NUM_TRIAL;
         this->NUM_TRIAL = 1;//set to 1 to use single trajectory logic in 'core'
+        //only here, the trial workers of marchParallel() pass their samples on instead
+        delete this->multiTrialStats;
+        this->multiTrialStats = new MultiTrialStats(this->listOfVars.size(), this->MAX_SAVE_POINTS, this->numHistogramBins);
 
         //output file header description for time and variable names
         this->outfile << "t:";
@@ -600,20 +661,17 @@ void Gibson::march(){
         this->outfile << endl;
 
         //Execute NUM_TRIALS of core and accumulate the results
-        for (this->currMultiNonHistoIter = 0; this->currMultiNonHistoIter < this->numMultiNonHisto; this->currMultiNonHistoIter++){
-            this->generator->seed(this->currMultiNonHistoIter+SEED);
-            //run the simulation
-            this->core();
-            //reset to initial values before next simulation
-            this->savedSampleCount = 1;
-            for(int i = 0; i < this->listOfIniValues.size(); i++){
-                this->listOfVars[i]->setCurr(this->listOfIniValues.at(i));
+        int numTrialThreads = getNumTrialThreads();
+        if (numTrialThreads > 1 && this->numMultiNonHisto > 1) {
+            marchParallel(this->numMultiNonHisto, numTrialThreads);
+        } else {
+            for (this->currMultiNonHistoIter = 0; this->currMultiNonHistoIter < this->numMultiNonHisto; this->currMultiNonHistoIter++){
+                //run the simulation and reset to initial values before next simulation
+                this->runTrial(this->currMultiNonHistoIter+SEED);
+                this->savedSampleCount = 1;
+//                outfileProg.write((char *)&thebyte,1);
+//                outfileProg.flush();
             }
-            for(int i = 0; i < this->listOfProcesses.size(); i++){
-                this->Tree->setProcess(i, this->listOfProcesses.at(i));
-            }
-//            outfileProg.write((char *)&thebyte,1);
-//            outfileProg.flush();
         }
 //        outfileProg.close();
 
@@ -638,13 +696,32 @@ void Gibson::march(){
         }
         this->outfile << endl;
         //output initial condition at STARTING_TIME
-        this->outfile << this->STARTING_TIME << "\t";
-        for(const unsigned long long listOfIniValue : this->listOfIniValues){
-            this->outfile << listOfIniValue << "\t";
+        if(this->bTrajectoryHDF5){
+            //the samples go to the HDF5 file, the output file only has the header
+            this->trajectoryWriter = new TrajectoryWriter(string(this->outfilename) + "_hdf5", this->listOfVarNames);
+            vector<double> initialValues(this->listOfIniValues.begin(), this->listOfIniValues.end());
+            this->trajectoryWriter->addSample(this->STARTING_TIME, initialValues.data());
+        }else{
+            this->outfile << this->STARTING_TIME << "\t";
+            for(const unsigned long long listOfIniValue : this->listOfIniValues){
+                this->outfile << listOfIniValue << "\t";
+            }
+            outfile << endl;
         }
-        outfile << endl;
-        //run the simulation
-        core();
+        //run the simulation, the samples taken are written if it stops early,
+        //a failure to write them is only reported when it does not
+        try {
+            core();
+            if(this->trajectoryWriter != NULL){
+                this->trajectoryWriter->close();
+            }
+        } catch (...) {
+            delete this->trajectoryWriter;
+            this->trajectoryWriter = NULL;
+            throw;
+        }
+        delete this->trajectoryWriter;
+        this->trajectoryWriter = NULL;
 
     } else if (this->NUM_TRIAL > 1){
 		//output file header
@@ -653,27 +730,24 @@ void Gibson::march(){
 			this->outfile<< listOfVarName << ":";
 		}
 		this->outfile << endl;
-		for (long j = this->SEED; j < this->NUM_TRIAL + this->SEED; j++)
-		{
+		int numTrialThreads = getNumTrialThreads();
+		if (numTrialThreads > 1) {
+			marchParallel(this->NUM_TRIAL, numTrialThreads);
+		} else {
+			for (long j = this->SEED; j < this->NUM_TRIAL + this->SEED; j++)
+			{
 #ifdef USE_MESSAGING
-		if (SimulationMessaging::getInstVar()->isStopRequested()) {
-			break;
-		}
+			if (SimulationMessaging::getInstVar()->isStopRequested()) {
+				break;
+			}
 #endif
 
 #ifdef DEBUG
-			cout << "Trial No. " << j <<endl;
+				cout << "Trial No. " << j <<endl;
 #endif
-			this->generator->seed(j);
-			//output trial number.  PS:results after each trial are printed in core() function.
-			this->outfile << j - this->SEED + 1;//this expression should evaluate equal to 'savedSampleCount'
-			this->core();//this will save 1 row of data (
-			//reset to initial values before next simulation
-			for(int i=0; i < this->listOfIniValues.size();i++){
-				this->listOfVars[i]->setCurr(this->listOfIniValues.at(i));
-			}
-			for(int i=0;i < this->listOfProcesses.size();i++){
-				this->Tree->setProcess(i, this->listOfProcesses.at(i));
+				//output trial number.  PS:results after each trial are printed in core() function.
+				this->outfile << j - this->SEED + 1;//this expression should evaluate equal to 'savedSampleCount'
+				this->runTrial(j);//this will save 1 row of data (
 			}
 		}
 	} else {
@@ -696,6 +770,176 @@ void Gibson::march(){
 #endif
 }//end of method march()
 
+/*
+ * This method runs one trial with the random numbers seeded by seed, then resets
+ * the variables and the indexed tree to their initial state for the next trial.
+ */
+void Gibson::runTrial(long seed){
+	this->generator->seed(seed);
+	this->core();
+	for(int i = 0; i < this->listOfIniValues.size(); i++){
+		this->listOfVars[i]->setCurr(this->listOfIniValues.at(i));
+	}
+	for(int i = 0; i < this->listOfProcesses.size(); i++){
+		this->Tree->setProcess(i, this->listOfProcesses.at(i));
+	}
+}//end of method runTrial()
+
+/*
+ * The results of one trial run by a trial worker, kept until the trials before it are written.
+ */
+struct Gibson::TrialResult {
+	bool bRun;
+	string output;
+	vector<int> sampleIndexes;
+	vector<double> sampleTimes;
+	vector<double> sampleValues;
+	exception_ptr error;
+};
+
+/*
+ * This method runs trial number 'trial' (from 0) in a trial worker, with the same seed
+ * as in the serial run, and moves its output, samples and error into result.
+ */
+void Gibson::runWorkerTrial(long trial, TrialResult& result){
+	result.bRun = false;
+	result.error = nullptr;
+#ifdef USE_MESSAGING
+	if (!bMultiButNotHisto && SimulationMessaging::getInstVar()->isStopRequested()) {
+		return;
+	}
+#endif
+	trialBuffer.str("");
+	trialSampleIndexes.clear();
+	trialSampleTimes.clear();
+	trialSampleValues.clear();
+	try {
+		if (bMultiButNotHisto) {
+			runTrial(trial + SEED);
+			savedSampleCount = 1;
+		} else {
+			trialBuffer << trial + 1;
+			runTrial(trial + SEED);
+		}
+	} catch (...) {
+		result.error = current_exception();
+	}
+	result.bRun = true;
+	result.output = trialBuffer.str();
+	result.sampleIndexes.swap(trialSampleIndexes);
+	result.sampleTimes.swap(trialSampleTimes);
+	result.sampleValues.swap(trialSampleValues);
+}//end of method runWorkerTrial()
+
+/*
+ * This method writes the results of a trial run by a trial worker as the serial run would have:
+ * its output to the output file and its samples to multiTrialStats. The error of the trial, if any,
+ * is thrown once its partial results are written. Returns false if the trial was not run.
+ */
+bool Gibson::writeTrialResult(long trial, TrialResult& result){
+	if (!result.bRun) {
+		return false;
+	}
+	this->outfile << result.output;
+	if (bMultiButNotHisto) {
+		this->currMultiNonHistoIter = trial;
+		this->multiTrialStats->startNewTrial();
+		int numVars = this->listOfVars.size();
+		for (int k = 0; k < result.sampleIndexes.size(); k++) {
+			this->multiTrialStats->addSample(result.sampleIndexes[k], result.sampleTimes[k], &result.sampleValues[k * numVars]);
+		}
+	}
+	if (result.error) {
+		rethrow_exception(result.error);
+	}
+	reportProgress(this->savedSampleCount, ENDING_TIME);
+	if (!bMultiButNotHisto) {
+		this->savedSampleCount++;
+	}
+	return true;
+}//end of method writeTrialResult()
+
+/*
+ * This method runs numTrials trials of a histogram or of the multiple trial statistics on
+ * numTrialThreads threads. Each thread has a trial worker, a Gibson with its own copy of the model
+ * read from the same input file, and the threads take TRIALS_PER_THREAD trials each at a time.
+ * Trials keep the seeds of the serial run and are written in trial order, so the results do not
+ * depend on the number of threads.
+ */
+void Gibson::marchParallel(long numTrials, int numTrialThreads){
+	vector<Gibson*> workers;
+	try {
+		for (int k = 0; k < numTrialThreads; k++) {
+			Gibson* worker = newTrialWorker();
+			workers.push_back(worker);
+			worker->bTrialWorker = true;
+			worker->NUM_TRIAL = this->NUM_TRIAL;//1 for the multiple trial statistics
+			worker->trialOutput = &worker->trialBuffer;
+			worker->trialBuffer << setprecision(10);
+		}
+
+		long batchSize = min((long)numTrialThreads * TRIALS_PER_THREAD, numTrials);
+		vector<TrialResult> results(batchSize);
+		bool bStopped = false;
+		for (long first = 0; first < numTrials && !bStopped; first += batchSize) {
+			long count = min(batchSize, numTrials - first);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(numTrialThreads)
+#endif
+			for (long k = 0; k < count; k++) {
+				int thread = 0;
+#ifdef _OPENMP
+				thread = omp_get_thread_num();
+#endif
+				workers[thread]->runWorkerTrial(first + k, results[k]);
+			}
+			for (long k = 0; k < count && !bStopped; k++) {
+				bStopped = !writeTrialResult(first + k, results[k]);
+			}
+		}
+	} catch (...) {
+		for (auto & worker : workers)
+			delete worker;
+		throw;
+	}
+	for (auto & worker : workers)
+		delete worker;
+}//end of method marchParallel()
+
+/*
+ * This method creates a trial worker, a Gibson with its own copy of the model read from the input file.
+ * Methods derived from Gibson create a worker of their own kind.
+ */
+Gibson* Gibson::newTrialWorker(){
+	return new Gibson(this->infilename, this->outfilename);
+}//end of method newTrialWorker()
+
+/*
+ * This method returns the number of threads running trials in parallel, NUM_THREADS
+ * or else all OpenMP threads.
+ */
+int Gibson::getNumTrialThreads(){
+#ifdef _OPENMP
+	return numThreads > 0 ? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}//end of method getNumTrialThreads()
+
+/*
+ * This method adds a sample of the current trial to multiTrialStats, or to the samples of
+ * the trial in a trial worker.
+ */
+void Gibson::addTrialSample(int timeIndex, double timeValue, double* varVals){
+	if (!bTrialWorker) {
+		multiTrialStats->addSample(timeIndex, timeValue, varVals);
+		return;
+	}
+	trialSampleIndexes.push_back(timeIndex);
+	trialSampleTimes.push_back(timeValue);
+	trialSampleValues.insert(trialSampleValues.end(), varVals, varVals + listOfVars.size());
+}//end of method addTrialSample()
+
 /*
  * This method generates a random number from uniform distribution.
  * Output: double, the random number generated.
@@ -26,6 +26,7 @@ IndexedTree::~IndexedTree()
 void IndexedTree::addProcess(Jump *jmp)
 {
 	index.push_back(jmp);
+	times.push_back(jmp->getTime());
 	size = index.size();
 	return;
 }//end of method addProcess()
@@ -47,6 +48,7 @@ Jump* IndexedTree::getProcess(int i)
 void IndexedTree::setProcess(int i, Jump *jump)
 {
 	index[i] = jump;
+	times[i] = jump->getTime();
 	return;
 }//end of method setProcess()
 
@@ -64,6 +66,9 @@ void IndexedTree::swap(int i, int j)
 	index[i]->setNode(i);
 	index[j] = pTemp;
 	index[j]->setNode(j);
+	double tTemp = times[i];
+	times[i] = times[j];
+	times[j] = tTemp;
 	return;
 }//end of method swap()
 
@@ -79,12 +84,12 @@ void IndexedTree::heapify(int i)
 	l = leftChild(i);
 	r = rightChild(i);
 	if(l<size){
-		if(*index[l]<*index[i]){
+		if(times[l]<times[i]){
 			smallest = l;
 		}
 	}
 	if(r<size){
-		if(*index[r]<*index[smallest]){
+		if(times[r]<times[smallest]){
 			smallest = r;
 		}
 	}
@@ -102,6 +107,9 @@ void IndexedTree::heapify(int i)
  */
 void IndexedTree::build()
 {
+	for(int i=0; i<size; i++){
+		times[i] = index[i]->getTime();
+	}
 	for(int i=int(size/2)-1; i>=0; i--){
 		heapify(i);
 	}
@@ -117,11 +125,17 @@ void IndexedTree::update(int i)
 {
 	int p = parent(i);
 
-	if((p>=0)&&(*index[i]<*index[p])){
+	if((p>=0)&&(times[i]<times[p])){
+		//up to the root while smaller than the parent
+		do{
 			swap(i, p);
-			update(p);
-			return;
-	}else{
+			i = p;
+			p = parent(i);
+		}while((p>=0)&&(times[i]<times[p]));
+		return;
+	}
+	//down to the leaves while larger than a child
+	while(true){
 		int smallest = i;
 		int l = leftChild(i);
 		int r = rightChild(i);
@@ -130,17 +144,15 @@ void IndexedTree::update(int i)
 			smallest = l;
 		}
 		if(r<size){
-			if(*index[r]<*index[smallest]){
+			if(times[r]<times[smallest]){
 				smallest = r;
 			}
 		}
-		if(smallest!=i){
-			if(*index[smallest]<*index[i]){
-				swap(i, smallest);
-				update(smallest);
-			}
+		if(smallest==i || !(times[smallest]<times[i])){
+			return;
 		}
-		return;
+		swap(i, smallest);
+		i = smallest;
 	}
 }//end of method update()
 
@@ -153,6 +165,7 @@ void IndexedTree::updateTree(Jump *jump, double newTime)
 {
 	int nd = jump->getNode();
 	index[nd]->setTime(newTime);
+	times[nd] = newTime;
 	update(nd);
 	return;
 }//end of method updateTree()
@@ -184,6 +184,34 @@ double Jump::getProbabilityRate(double* expVal)
 	return 0;
 }//end of method getProbabilityRate()
 
+/*
+ *Get the symbols the probability expression depends on.
+ *Output para: vector<string>&, the symbols
+ */
+void Jump::getProbabilitySymbols(vector<string>& symbols)
+{
+	if(probExpression!=NULL)
+	{
+		probExpression->getSymbols(symbols);
+	}
+}//end of method getProbabilitySymbols()
+
+/*
+ *Get the probability expression as coefficient * (x1 - n1) * (x2 - n2) * ..., e.g. mass action.
+ *Output para: double&, the coefficient
+ *             vector<int>&, the indexes of x1, x2, ... in the symbols of the expression
+ *             vector<double>&, n1, n2, ...
+ *Return: bool, false if the expression is not of this form
+ */
+bool Jump::getProbabilityProductForm(double& coefficient, vector<int>& symbolIndexes, vector<double>& offsets)
+{
+	if(probExpression!=NULL)
+	{
+		return probExpression->getProductForm(coefficient, symbolIndexes, offsets);
+	}
+	return false;
+}//end of method getProbabilityProductForm()
+
 string Jump::getProbabilityRateEvaluationSummary(double* values)
 {
 	if (probExpression!=NULL)
@@ -6,6 +6,7 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <stdexcept>
 #include <math.h>
 
 #ifdef __APPLE__
@@ -21,10 +22,44 @@
 using std::vector;
 using std::string;
 
+const int MultiTrialStats::DEFAULT_HISTOGRAM_BINS;
+const int MultiTrialStats::NUM_PERCENTILES;
+const double MultiTrialStats::PERCENTILES[MultiTrialStats::NUM_PERCENTILES] = {5, 25, 50, 75, 95};
 
-MultiTrialStats::MultiTrialStats(int numVars, int numTimePoints) {
+// merges the bins of a histogram pairwise, for twice the bin width
+static void coarsen(unsigned int* counts, int numBins) {
+    for (int k = 0; k < numBins; ++k) {
+        unsigned int count = 0;
+        if (2 * k < numBins) {
+            count += counts[2 * k];
+        }
+        if (2 * k + 1 < numBins) {
+            count += counts[2 * k + 1];
+        }
+        counts[k] = count;
+    }
+}
+
+// the value of the given rank (from 0) in a histogram, the values of a bin being spread evenly
+// across it; with a bin width of 1 the bins hold the counts themselves
+static double getValueAtRank(const unsigned int* counts, int numBins, double width, long rank) {
+    long cumulative = 0;
+    for (int k = 0; k < numBins; ++k) {
+        if (rank < cumulative + counts[k]) {
+            if (width == 1) {
+                return k;
+            }
+            return (k + (rank - cumulative + 0.5) / counts[k]) * width;
+        }
+        cumulative += counts[k];
+    }
+    return numBins * width;
+}
+
+MultiTrialStats::MultiTrialStats(int numVars, int numTimePoints, int numHistogramBins) {
     this->numVars = numVars;
     this->numTimePoints = numTimePoints;
+    this->numHistogramBins = std::max(numHistogramBins, 0);
     currentTrial = 0;
     init();
 }
@@ -35,12 +70,15 @@ void MultiTrialStats::init() {
     variance.resize(numTimePoints);
     statMin.resize(numTimePoints);
     statMax.resize(numTimePoints);
+    histogramCounts.resize(numTimePoints);
+    histogramBinWidth.resize(numTimePoints);
     for (int i = 0; i < numTimePoints; ++i) {
         mean[i].resize(numVars,0);
         M2[i].resize(numVars,0);
         variance[i].resize(numVars,0);
         statMin[i].resize(numVars,std::numeric_limits<double>::max());
         statMax[i].resize(numVars,std::numeric_limits<double>::min());
+        histogramBinWidth[i].resize(numVars,1.0);
     }
 }
 
@@ -54,6 +92,9 @@ void MultiTrialStats::addSample(int timeIndex, double timeValue, double *varVals
     if (timeValues.size() <= timeIndex){
         timeValues.push_back(timeValue);
     }
+    if (histogramCounts[timeIndex].empty()) {
+        histogramCounts[timeIndex].resize(numVars * numHistogramBins, 0);
+    }
     for (int i = 0; i < numVars; ++i) {
         double currValue = varVals[i];
         double delta = currValue - mean[timeIndex][i];
@@ -62,7 +103,74 @@ void MultiTrialStats::addSample(int timeIndex, double timeValue, double *varVals
         variance[timeIndex][i] = M2[timeIndex][i] / (currentTrial-1);
         statMin[timeIndex][i] = std::min(currValue, statMin[timeIndex][i]) ;
         statMax[timeIndex][i] = std::max(currValue, statMax[timeIndex][i]) ;
+        addToHistogram(timeIndex, i, currValue);
+    }
+}
+
+void MultiTrialStats::addToHistogram(int timeIndex, int varIndex, double value) {
+    if (numHistogramBins == 0 || !std::isfinite(value)) {
+        return;
+    }
+    // values below 0, which counts never are, go to the first bin
+    double bin = value < 0 ? 0 : floor(value / histogramBinWidth[timeIndex][varIndex]);
+    while (bin >= numHistogramBins) {
+        coarsenHistogram(timeIndex, varIndex);
+        bin = floor(value / histogramBinWidth[timeIndex][varIndex]);
     }
+    histogramCounts[timeIndex][varIndex * numHistogramBins + (int)bin] += 1;
+}
+
+void MultiTrialStats::coarsenHistogram(int timeIndex, int varIndex) {
+    coarsen(&histogramCounts[timeIndex][varIndex * numHistogramBins], numHistogramBins);
+    histogramBinWidth[timeIndex][varIndex] *= 2;
+}
+
+// adds the trials of other, accumulated apart with the same time points, as if their samples had been added here
+void MultiTrialStats::merge(const MultiTrialStats& other) {
+    if (other.numVars != numVars || other.numHistogramBins != numHistogramBins || other.timeValues.size() > numTimePoints) {
+        throw std::invalid_argument("MultiTrialStats::merge(): the statistics do not have the same variables, histogram bins or time points");
+    }
+    double nA = currentTrial;
+    double nB = other.currentTrial;
+    double n = nA + nB;
+    for (int timeIndex = 0; timeIndex < other.timeValues.size(); ++timeIndex) {
+        if (timeValues.size() <= timeIndex) {
+            timeValues.push_back(other.timeValues[timeIndex]);
+        }
+        for (int i = 0; i < numVars; ++i) {
+            // parallel variance (Chan et al.)
+            double delta = other.mean[timeIndex][i] - mean[timeIndex][i];
+            if (n > 0) {
+                mean[timeIndex][i] += delta * nB / n;
+                M2[timeIndex][i] += other.M2[timeIndex][i] + delta * delta * nA * nB / n;
+            }
+            variance[timeIndex][i] = M2[timeIndex][i] / (n - 1);
+            statMin[timeIndex][i] = std::min(other.statMin[timeIndex][i], statMin[timeIndex][i]);
+            statMax[timeIndex][i] = std::max(other.statMax[timeIndex][i], statMax[timeIndex][i]);
+        }
+        if (other.histogramCounts[timeIndex].empty()) {
+            continue;
+        }
+        if (histogramCounts[timeIndex].empty()) {
+            histogramCounts[timeIndex].resize(numVars * numHistogramBins, 0);
+        }
+        for (int i = 0; i < numVars; ++i) {
+            vector<unsigned int> otherCounts(other.histogramCounts[timeIndex].begin() + i * numHistogramBins,
+                                             other.histogramCounts[timeIndex].begin() + (i + 1) * numHistogramBins);
+            double otherWidth = other.histogramBinWidth[timeIndex][i];
+            while (histogramBinWidth[timeIndex][i] < otherWidth) {
+                coarsenHistogram(timeIndex, i);
+            }
+            while (otherWidth < histogramBinWidth[timeIndex][i]) {
+                coarsen(otherCounts.data(), numHistogramBins);
+                otherWidth *= 2;
+            }
+            for (int k = 0; k < numHistogramBins; ++k) {
+                histogramCounts[timeIndex][i * numHistogramBins + k] += otherCounts[k];
+            }
+        }
+    }
+    currentTrial += other.currentTrial;
 }
 
 double MultiTrialStats::getMean(int varIndex, int timeIndex) {
@@ -81,6 +189,42 @@ double MultiTrialStats::getMax(int varIndex, int timeIndex) {
     return statMax[timeIndex][varIndex];
 }
 
+// percentile (0 to 100) of the values, interpolated between the ranks around it as
+// numpy.percentile does; exact for counts while the bin width is 1, NaN if there is no histogram
+double MultiTrialStats::getPercentile(int varIndex, int timeIndex, double percent) {
+    if (histogramCounts[timeIndex].empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    const unsigned int* counts = &histogramCounts[timeIndex][varIndex * numHistogramBins];
+    long total = 0;
+    for (int k = 0; k < numHistogramBins; ++k) {
+        total += counts[k];
+    }
+    if (total == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    double width = histogramBinWidth[timeIndex][varIndex];
+    double rank = std::min(std::max(percent, 0.0), 100.0) / 100 * (total - 1);
+    long lowerRank = (long)floor(rank);
+    double value = getValueAtRank(counts, numHistogramBins, width, lowerRank);
+    if (rank > lowerRank) {
+        double upperValue = getValueAtRank(counts, numHistogramBins, width, lowerRank + 1);
+        value += (rank - lowerRank) * (upperValue - value);
+    }
+    return std::min(std::max(value, statMin[timeIndex][varIndex]), statMax[timeIndex][varIndex]);
+}
+
+double MultiTrialStats::getHistogramBinWidth(int varIndex, int timeIndex) {
+    return histogramBinWidth[timeIndex][varIndex];
+}
+
+unsigned int MultiTrialStats::getHistogramCount(int varIndex, int timeIndex, int bin) {
+    if (histogramCounts[timeIndex].empty()) {
+        return 0;
+    }
+    return histogramCounts[timeIndex][varIndex * numHistogramBins + bin];
+}
+
 void MultiTrialStats::startNewTrial() {
     currentTrial += 1;
 //    std::cout << std::endl << "startNewTrial(currentTrial: " << currentTrial << ")" << std::endl;
@@ -177,8 +321,66 @@ void MultiTrialStats::writeHDF5(string outfilename, vector<string> listOfVarName
             status = H5Dwrite(dataset, doubleDataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, allData);
             H5Dclose(dataset);
         }
+
+        //
+        //Save distributions: histogram bin widths for all times and variables
+        //
+        if (numHistogramBins > 0) {
+            dataset = H5Dcreate1(file, "StatHistogramBinWidth", doubleDataType, dataspace, H5P_DEFAULT);
+            vector<double> binWidths(meanDim[0] * meanDim[1]);
+            for (int timeIndex = 0; timeIndex < meanDim[0]; ++timeIndex) {
+                for (int varIndex = 0; varIndex < meanDim[1]; ++varIndex) {
+                    binWidths[timeIndex * meanDim[1] + varIndex] = histogramBinWidth[timeIndex][varIndex];
+                }
+            }
+            status = H5Dwrite(dataset, doubleDataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, binWidths.data());
+            H5Dclose(dataset);
+        }
         H5Sclose(dataspace);
 
+        if (numHistogramBins > 0) {
+            //
+            //Save percentile levels, then percentiles and histograms for all times and variables
+            //
+            rank = 1;
+            hsize_t levelsDim[1] = {NUM_PERCENTILES};
+            dataspace = H5Screate_simple(rank, levelsDim, NULL);
+            dataset = H5Dcreate1(file, "StatPercentileLevels", doubleDataType, dataspace, H5P_DEFAULT);
+            status = H5Dwrite(dataset, doubleDataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, PERCENTILES);
+            H5Dclose(dataset);
+            H5Sclose(dataspace);
+
+            rank = 3;
+            hsize_t percentilesDim[3] = {meanDim[0], meanDim[1], NUM_PERCENTILES};
+            dataspace = H5Screate_simple(rank, percentilesDim, NULL);
+            dataset = H5Dcreate1(file, "StatPercentiles", doubleDataType, dataspace, H5P_DEFAULT);
+            vector<double> percentiles(meanDim[0] * meanDim[1] * NUM_PERCENTILES);
+            for (int timeIndex = 0; timeIndex < meanDim[0]; ++timeIndex) {
+                for (int varIndex = 0; varIndex < meanDim[1]; ++varIndex) {
+                    for (int p = 0; p < NUM_PERCENTILES; ++p) {
+                        percentiles[(timeIndex * meanDim[1] + varIndex) * NUM_PERCENTILES + p] = getPercentile(varIndex, timeIndex, PERCENTILES[p]);
+                    }
+                }
+            }
+            status = H5Dwrite(dataset, doubleDataType, H5S_ALL, H5S_ALL, H5P_DEFAULT, percentiles.data());
+            H5Dclose(dataset);
+            H5Sclose(dataspace);
+
+            hsize_t histogramDim[3] = {meanDim[0], meanDim[1], (hsize_t)numHistogramBins};
+            dataspace = H5Screate_simple(rank, histogramDim, NULL);
+            dataset = H5Dcreate1(file, "StatHistogram", H5T_NATIVE_UINT, dataspace, H5P_DEFAULT);
+            vector<unsigned int> histograms(meanDim[0] * meanDim[1] * numHistogramBins, 0);
+            for (int timeIndex = 0; timeIndex < meanDim[0]; ++timeIndex) {
+                if (!histogramCounts[timeIndex].empty()) {
+                    std::copy(histogramCounts[timeIndex].begin(), histogramCounts[timeIndex].end(),
+                              histograms.begin() + timeIndex * meanDim[1] * numHistogramBins);
+                }
+            }
+            status = H5Dwrite(dataset, H5T_NATIVE_UINT, H5S_ALL, H5S_ALL, H5P_DEFAULT, histograms.data());
+            H5Dclose(dataset);
+            H5Sclose(dataspace);
+        }
+
         H5Fclose(file);
     } catch (const std::exception& ex) {
         std::cout << " Error writing HDF5 file " << ofhdf5 << " " << ex.what() << "'\n";
@@ -0,0 +1,510 @@
+#include "../include/TauLeaping.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+using namespace std;
+
+#ifdef USE_MESSAGING
+#include <VCELL/SimulationMessaging.h>
+#endif
+#include "VCellException.h"
+#include "../include/CompiledStochModel.h"
+#include "../include/TrajectoryWriter.h"
+
+static const double double_infinity = numeric_limits<double>::infinity();
+static const double EPSILON = 1E-12;
+static const double DEFAULT_EPSILON = 0.03;
+static const int DEFAULT_CRITICAL_COUNT = 10;
+//exact steps are taken when the leap is shorter than this many mean exact steps
+static const double EXACT_STEPS_THRESHOLD = 10.0;
+
+/*
+ *This constructor reads the model as Gibson does, then the tau-leaping control and
+ *the stoichiometry of the processes.
+ *Input para: srting, the input file(name), where the model info. is read.
+ *            string, the output file(name), where the results are saved.
+ */
+TauLeaping::TauLeaping(const char* arg_infilename, const char* arg_outfilename)
+	: Gibson(arg_infilename, arg_outfilename) {
+	epsilon = DEFAULT_EPSILON;
+	criticalCount = DEFAULT_CRITICAL_COUNT;
+	outputTimer = STARTING_TIME;
+	saveIntervalCount = SAMPLE_INTERVAL;
+	readControl(arg_infilename);
+	setupStoichiometry();
+}//end of constructor TauLeaping(infilename,outfilename)
+
+TauLeaping::~TauLeaping()
+{
+}//end of destructor ~TauLeaping()
+
+/*
+ *This method reads TAU_LEAPING_EPSILON and TAU_LEAPING_CRITICAL_COUNT, which Gibson skips.
+ */
+void TauLeaping::readControl(const char* filename)
+{
+	ifstream infile(filename);
+	string instring;
+	while (infile >> instring) {
+		if (instring == "TAU_LEAPING_EPSILON") {
+			infile >> epsilon;
+		} else if (instring == "TAU_LEAPING_CRITICAL_COUNT") {
+			infile >> criticalCount;
+		} else if (instring == "</control>") {
+			break;
+		}
+	}
+	if (!(epsilon > 0 && epsilon < 1)) {
+		VCELL_EXCEPTION(invalid_argument, "TAU_LEAPING_EPSILON " << epsilon << " should be between 0 and 1");
+	}
+}//end of method readControl()
+
+/*
+ *This method collects the increments of each process and, from the symbols of the
+ *propensities, the reactants of each process. The order of a process is the number of
+ *molecules it uses: a reactant it consumes n of counts n, any other reactant counts 1.
+ */
+void TauLeaping::setupStoichiometry()
+{
+	int varLen = listOfVars.size();
+	int numProcesses = listOfProcesses.size();
+	map<StochVar*, int> varIndexes;
+	for (int i = 0; i < varLen; i++) {
+		varIndexes[listOfVars[i]] = i;
+	}
+	highestOrder.assign(varLen, 0);
+	highestOrderCount.assign(varLen, 0);
+	bExactOnly.assign(numProcesses, false);
+	stoichStart.push_back(0);
+	for (int j = 0; j < numProcesses; j++) {
+		Jump* jump = listOfProcesses[j];
+		map<int, int64_t> changes;
+		for (int k = 0; k < jump->getNumVars(); k++) {
+			StochVarContext* context = jump->getVar(k);
+			if (context->getOperation() == "inc") {
+				changes[varIndexes[context->getVar()]] += context->getVal();
+			} else {
+				bExactOnly[j] = true;
+			}
+		}
+		for (auto & change : changes) {
+			if (change.second != 0) {
+				stoichVar.push_back(change.first);
+				stoichChange.push_back(change.second);
+			}
+		}
+		stoichStart.push_back(stoichVar.size());
+
+		vector<string> symbols;
+		jump->getProbabilitySymbols(symbols);
+		vector<int> reactants;
+		vector<int> reactantCounts;
+		int order = 0;
+		for (auto & symbol : symbols) {
+			vector<string>::iterator iter = find(listOfVarNames.begin(), listOfVarNames.end(), symbol);
+			if (iter == listOfVarNames.end()) {
+				continue;
+			}
+			int var = iter - listOfVarNames.begin();
+			if (find(reactants.begin(), reactants.end(), var) != reactants.end()) {
+				continue;
+			}
+			int count = 1;
+			map<int, int64_t>::iterator changeIter = changes.find(var);
+			if (changeIter != changes.end() && changeIter->second < -1) {
+				count = (int)-changeIter->second;
+			}
+			reactants.push_back(var);
+			reactantCounts.push_back(count);
+			order += count;
+		}
+		for (int k = 0; k < reactants.size(); k++) {
+			int var = reactants[k];
+			if (order > highestOrder[var] || (order == highestOrder[var] && reactantCounts[k] > highestOrderCount[var])) {
+				highestOrder[var] = order;
+				highestOrderCount[var] = reactantCounts[k];
+			}
+		}
+	}
+	propensities.resize(numProcesses);
+	bCritical.resize(numProcesses);
+	counts.resize(varLen);
+	leapCounts.resize(varLen);
+	mu.resize(varLen);
+	sigma2.resize(varLen);
+	sampleValues.resize(varLen);
+}//end of method setupStoichiometry()
+
+/*
+ *This method does one run as Gibson::core() does, with the same output, by leaps and
+ *exact steps.
+ */
+int TauLeaping::core()
+{
+	int varLen = listOfVars.size();
+	int numProcesses = listOfProcesses.size();
+	double simtime = STARTING_TIME;
+	vector<double> lastStepVals(varLen);//values before the last leap or step, saved for the save periods it spans
+	bool bStopped = false;
+	outputTimer = STARTING_TIME;
+	saveIntervalCount = SAMPLE_INTERVAL;
+	if (bMultiButNotHisto) {
+		if (!bTrialWorker) {
+			multiTrialStats->startNewTrial();
+		}
+		for (int k = 0; k < varLen; k++) {
+			lastStepVals[k] = listOfIniValues[k];
+		}
+		addTrialSample(0, 0.0, &lastStepVals[0]);
+	}
+	while (simtime < ENDING_TIME)
+	{
+#ifdef USE_MESSAGING
+		if (SimulationMessaging::getInstVar()->isStopRequested()) {
+			bStopped = true;
+			break;
+		}
+#endif
+		double a0 = updatePropensities(simtime);
+		if (!(a0 > 0)) {
+			//nothing happens anymore, the values are kept to the ending time
+			break;
+		}
+		double tau1 = selectTau();
+		if (tau1 < EXACT_STEPS_THRESHOLD / a0) {
+			//a leap would be too short, exact steps instead
+			for (int step = 0; step < NUM_EXACT_STEPS; step++) {
+				if (step > 0) {
+					a0 = updatePropensities(simtime);
+					if (!(a0 > 0)) {
+						break;
+					}
+				}
+				double tau = -log(getPositiveRandomUniform()) / a0;
+				if (simtime + tau >= ENDING_TIME) {
+					simtime = ENDING_TIME;
+					break;
+				}
+				int process = pickProcess(getRandomUniform() * a0, false);
+				for (int k = 0; k < varLen; k++) {
+					lastStepVals[k] = counts[k];
+				}
+				saveSamplesBefore(simtime + tau, &lastStepVals[0]);
+				fireExact(process);
+				simtime += tau;
+				saveStep(simtime);
+			}
+			continue;
+		}
+
+		//the critical processes fire once at the time of the exact method, unless the leap ends before
+		double a0c = 0;
+		for (int j = 0; j < numProcesses; j++) {
+			if (bCritical[j]) {
+				a0c += propensities[j];
+			}
+		}
+		double tau2 = a0c > 0 ? -log(getPositiveRandomUniform()) / a0c : double_infinity;
+		//leaps end at the save periods, so that samples are not those of the time a leap started
+		bool bSavePeriodEnd = (NUM_TRIAL == 1) && flag_savePeriod && (outputTimer + SAVE_PERIOD + EPSILON) < ENDING_TIME;
+		double leapEnd = bSavePeriodEnd ? outputTimer + SAVE_PERIOD : ENDING_TIME;
+		int criticalProcess = -1;
+		double tau;
+		bool bLeapEnd;
+		while (true) {
+			bool bFireCritical = tau2 <= tau1;
+			tau = bFireCritical ? tau2 : tau1;
+			bLeapEnd = simtime + tau >= leapEnd;
+			if (bLeapEnd) {
+				tau = leapEnd - simtime;
+				bFireCritical = false;
+			}
+			leapCounts = counts;
+			for (int j = 0; j < numProcesses; j++) {
+				if (bCritical[j] || !(propensities[j] > 0)) {
+					continue;
+				}
+				poisson_distribution<long long> poisson(propensities[j] * tau);
+				long long numFirings = poisson(*generator);
+				for (int s = stoichStart[j]; s < stoichStart[j + 1]; s++) {
+					leapCounts[stoichVar[s]] += numFirings * stoichChange[s];
+				}
+			}
+			criticalProcess = -1;
+			if (bFireCritical) {
+				criticalProcess = pickProcess(getRandomUniform() * a0c, true);
+				if (!bExactOnly[criticalProcess]) {
+					for (int s = stoichStart[criticalProcess]; s < stoichStart[criticalProcess + 1]; s++) {
+						leapCounts[stoichVar[s]] += stoichChange[s];
+					}
+				}
+			}
+			bool bNegative = false;
+			for (int k = 0; k < varLen; k++) {
+				if (leapCounts[k] < 0) {
+					bNegative = true;
+					break;
+				}
+			}
+			if (!bNegative) {
+				break;
+			}
+			//too long a leap, half of it
+			tau1 /= 2;
+		}
+		for (int k = 0; k < varLen; k++) {
+			lastStepVals[k] = counts[k];
+		}
+		saveSamplesBefore(simtime + tau, &lastStepVals[0]);
+		for (int k = 0; k < varLen; k++) {
+			listOfVars[k]->setCurr((uint64_t)leapCounts[k]);
+		}
+		if (criticalProcess >= 0 && bExactOnly[criticalProcess]) {
+			fireExact(criticalProcess);
+		}
+		simtime = bLeapEnd ? leapEnd : simtime + tau;
+		if (bLeapEnd && bSavePeriodEnd) {
+			double* values = sampleValues.data();
+			for (int k = 0; k < varLen; k++) {
+				values[k] = *listOfVars[k]->getCurr();
+			}
+			writeSample(leapEnd, values, false);
+			outputTimer = outputTimer + SAVE_PERIOD;
+		}
+		saveStep(simtime);
+	}//end of while loop
+	if (bStopped) {
+		return 0;
+	}
+	//the values at the save periods left and at the ending time
+	double* values = sampleValues.data();
+	for (int k = 0; k < varLen; k++) {
+		values[k] = *listOfVars[k]->getCurr();
+	}
+	if ((NUM_TRIAL == 1) && flag_savePeriod)//SingleTrajectory_OutputInterval
+	{
+		while ((outputTimer + SAVE_PERIOD + EPSILON) < ENDING_TIME) {
+			writeSample(outputTimer + SAVE_PERIOD, values, false);
+			outputTimer = outputTimer + SAVE_PERIOD;
+		}
+		writeSample(ENDING_TIME, values, true);
+	}
+	if (NUM_TRIAL > 1)//Histogram
+	{
+		for (int k = 0; k < varLen; k++) {
+			*trialOutput << "\t" << values[k];
+		}
+		savedSampleCount = finalizeSampleRow(savedSampleCount, ENDING_TIME);
+	}
+	return 0;
+}//end of method core()
+
+/*
+ *This method evaluates the propensities of all processes with the current values.
+ *Output para: double, the sum of the propensities.
+ */
+double TauLeaping::updatePropensities(double simtime)
+{
+	int varLen = listOfVars.size();
+	for (int k = 0; k < varLen; k++) {
+		counts[k] = (int64_t)*listOfVars[k]->getCurr();
+		currvals[k] = counts[k];
+	}
+	currvals[varLen] = simtime;
+	double a0 = 0;
+	for (int j = 0; j < listOfProcesses.size(); j++) {
+		Jump* jump = listOfProcesses[j];
+		double p = compiledModel->updatePropensity(j, currvals);
+		if (p < 0) {
+			VCELL_EXCEPTION(runtime_error,"at time point " << simtime << ", propensity of jump process "<< listOfProcessNames.at(j) <<" evaluated to a negative value (" << p << "). Simulation abort!" << endl << jump->getProbabilityRateEvaluationSummary(currvals) );
+		}
+		propensities[j] = p;
+		a0 += p;
+	}
+	return a0;
+}//end of method updatePropensities()
+
+/*
+ *This method marks the critical processes and returns the leap for the others
+ *(Cao et al. 2006, eq. 33): for every reactant, the expected change and the standard
+ *deviation of its count in the leap are bounded by max(epsilon * count / g, 1).
+ */
+double TauLeaping::selectTau()
+{
+	int varLen = listOfVars.size();
+	int numProcesses = listOfProcesses.size();
+	fill(mu.begin(), mu.end(), 0.0);
+	fill(sigma2.begin(), sigma2.end(), 0.0);
+	for (int j = 0; j < numProcesses; j++) {
+		if (!(propensities[j] > 0)) {
+			bCritical[j] = false;
+			continue;
+		}
+		//firings left before a reactant runs out
+		int64_t firingsLeft = numeric_limits<int64_t>::max();
+		for (int s = stoichStart[j]; s < stoichStart[j + 1]; s++) {
+			if (stoichChange[s] < 0) {
+				firingsLeft = min(firingsLeft, counts[stoichVar[s]] / -stoichChange[s]);
+			}
+		}
+		bCritical[j] = bExactOnly[j] || firingsLeft < criticalCount;
+		if (bCritical[j]) {
+			continue;
+		}
+		for (int s = stoichStart[j]; s < stoichStart[j + 1]; s++) {
+			double change = (double)stoichChange[s];
+			mu[stoichVar[s]] += change * propensities[j];
+			sigma2[stoichVar[s]] += change * change * propensities[j];
+		}
+	}
+	double tau = double_infinity;
+	for (int i = 0; i < varLen; i++) {
+		if (highestOrder[i] == 0 || (mu[i] == 0 && sigma2[i] == 0)) {
+			continue;
+		}
+		double bound = max(epsilon * counts[i] / getG(i, counts[i]), 1.0);
+		if (mu[i] != 0) {
+			tau = min(tau, bound / fabs(mu[i]));
+		}
+		if (sigma2[i] > 0) {
+			tau = min(tau, bound * bound / sigma2[i]);
+		}
+	}
+	return tau;
+}//end of method selectTau()
+
+/*
+ *This method returns g of Cao et al. for a reactant: the relative change of the
+ *propensities of the highest order processes it is a reactant of, over its own.
+ */
+double TauLeaping::getG(int var, int64_t count)
+{
+	int order = highestOrder[var];
+	int n = highestOrderCount[var];
+	if (count < n) {
+		return order;
+	}
+	double x = (double)count;
+	if (order == 2 && n == 2) {
+		return 2 + 1 / (x - 1);
+	}
+	if (order == 3 && n == 2) {
+		return 1.5 * (2 + 1 / (x - 1));
+	}
+	if (order == 3 && n == 3) {
+		return 3 + 1 / (x - 1) + 2 / (x - 2);
+	}
+	return order;
+}//end of method getG()
+
+/*
+ *This method picks the process, among all or the critical ones with a positive propensity,
+ *where the running sum of the propensities goes above target.
+ */
+int TauLeaping::pickProcess(double target, bool bCriticalOnly)
+{
+	int last = -1;
+	double sum = 0;
+	for (int j = 0; j < listOfProcesses.size(); j++) {
+		if ((bCriticalOnly && !bCritical[j]) || !(propensities[j] > 0)) {
+			continue;
+		}
+		sum += propensities[j];
+		last = j;
+		if (sum > target) {
+			break;
+		}
+	}
+	return last;
+}//end of method pickProcess()
+
+/*
+ *This method fires a process once, with its effects as the model states them.
+ */
+void TauLeaping::fireExact(int process)
+{
+	compiledModel->fire(process, currvals);
+}//end of method fireExact()
+
+double TauLeaping::getPositiveRandomUniform()
+{
+	double r;
+	do {
+		r = getRandomUniform();
+	} while (r <= 0);
+	return r;
+}//end of method getPositiveRandomUniform()
+
+/*
+ *This method saves values at the save periods before time, for a single trajectory with a save period.
+ */
+void TauLeaping::saveSamplesBefore(double time, double* values)
+{
+	if ((NUM_TRIAL == 1) && flag_savePeriod) {
+		while ((outputTimer + SAVE_PERIOD) < time) {
+			writeSample(outputTimer + SAVE_PERIOD, values, false);
+			outputTimer = outputTimer + SAVE_PERIOD;
+		}
+	}
+}//end of method saveSamplesBefore()
+
+/*
+ *This method saves the current values after a leap or a step, every SAMPLE_INTERVAL of them,
+ *for a single trajectory without a save period (keep every).
+ */
+void TauLeaping::saveStep(double simtime)
+{
+	if ((NUM_TRIAL != 1) || flag_savePeriod) {
+		return;
+	}
+	if (saveIntervalCount == SAMPLE_INTERVAL) {
+		int varLen = listOfVars.size();
+		double* values = sampleValues.data();
+		for (int k = 0; k < varLen; k++) {
+			values[k] = *listOfVars[k]->getCurr();
+		}
+		writeSample(simtime, values, false);
+	}
+	if (saveIntervalCount == 1)
+		saveIntervalCount = SAMPLE_INTERVAL;
+	else
+		saveIntervalCount--;
+}//end of method saveStep()
+
+/*
+ *This method writes one sample as Gibson::core() does: a row of the output file, the last
+ *one without a trailing tab, a sample of the HDF5 trajectory or of the multiple trial statistics.
+ */
+void TauLeaping::writeSample(double time, double* values, bool bLast)
+{
+	int varLen = listOfVars.size();
+	if (bMultiButNotHisto) {//Accumulate data mode
+		addTrialSample(savedSampleCount, time, values);
+	} else if (trajectoryWriter != NULL) {
+		trajectoryWriter->addSample(time, values);
+	} else {
+		accumOrSaveInit(varLen, time, !bLast);
+		for (int k = 0; k < varLen; k++) {
+			if (bLast) {
+				*trialOutput << "\t" << values[k];
+			} else {
+				*trialOutput << values[k] << "\t";
+			}
+		}
+	}
+	savedSampleCount = finalizeSampleRow(savedSampleCount, time);
+}//end of method writeSample()
+
+/*
+ *This method creates a trial worker running tau-leaping too.
+ */
+Gibson* TauLeaping::newTrialWorker()
+{
+	return new TauLeaping(infilename, outfilename);
+}//end of method newTrialWorker()
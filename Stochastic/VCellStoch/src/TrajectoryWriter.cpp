@@ -0,0 +1,187 @@
+#include "../include/TrajectoryWriter.h"
+
+#include <stdexcept>
+using namespace std;
+
+#include "VCellException.h"
+
+/*
+ *This constructor creates the HDF5 file with the variable names and the empty, chunked
+ *datasets of the sample times and values.
+ *Input para: string, the HDF5 file(name)
+ *            vector<string>&, the variable names
+ */
+TrajectoryWriter::TrajectoryWriter(string filename, const vector<string>& varNames)
+{
+    this->filename = filename;
+    numVars = varNames.size();
+    numSamples = 0;
+    numBuffered = 0;
+    timeBuffer.resize(CHUNK_SIZE);
+    valueBuffer.resize((size_t)numVars * CHUNK_SIZE);
+    timesDataset = -1;
+    valuesDataset = -1;
+    file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file < 0) {
+        VCELL_EXCEPTION(runtime_error, "Unable to create HDF5 file " << filename);
+    }
+
+    //variable names
+    hsize_t varNamesDim[1] = {(hsize_t)numVars};
+    hid_t dataspace = H5Screate_simple(1, varNamesDim, NULL);
+    hid_t varLenStr = H5Tcopy(H5T_C_S1);
+    H5Tset_size(varLenStr, H5T_VARIABLE);
+    hid_t dataset = H5Dcreate1(file, "VarNames", varLenStr, dataspace, H5P_DEFAULT);
+    vector<const char*> chars;
+    for (const auto & varName : varNames) {
+        chars.push_back(varName.c_str());
+    }
+    H5Dwrite(dataset, varLenStr, H5S_ALL, H5S_ALL, H5P_DEFAULT, chars.data());
+    H5Dclose(dataset);
+    H5Tclose(varLenStr);
+    H5Sclose(dataspace);
+
+    //times, growing with the samples
+    hsize_t timesDim[1] = {0};
+    hsize_t timesMaxDim[1] = {H5S_UNLIMITED};
+    hsize_t timesChunk[1] = {CHUNK_SIZE};
+    dataspace = H5Screate_simple(1, timesDim, timesMaxDim);
+    hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, 1, timesChunk);
+    timesDataset = H5Dcreate1(file, "SimTimes", H5T_NATIVE_DOUBLE, dataspace, properties);
+    H5Pclose(properties);
+    H5Sclose(dataspace);
+
+    //values, a row of samples per variable, a chunk holds one variable's samples
+    hsize_t valuesDim[2] = {(hsize_t)numVars, 0};
+    hsize_t valuesMaxDim[2] = {(hsize_t)numVars, H5S_UNLIMITED};
+    hsize_t valuesChunk[2] = {1, CHUNK_SIZE};
+    dataspace = H5Screate_simple(2, valuesDim, valuesMaxDim);
+    properties = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(properties, 2, valuesChunk);
+    valuesDataset = H5Dcreate1(file, "Trajectory", H5T_NATIVE_DOUBLE, dataspace, properties);
+    H5Pclose(properties);
+    H5Sclose(dataspace);
+
+    if (timesDataset < 0 || valuesDataset < 0) {
+        close();
+        VCELL_EXCEPTION(runtime_error, "Unable to create the trajectory datasets of HDF5 file " << filename);
+    }
+}//end of constructor TrajectoryWriter()
+
+/*
+ *The destructor closes the file, when close() has not been called. As it may be called
+ *while an exception is thrown, a failure to write the last samples is not reported here.
+ */
+TrajectoryWriter::~TrajectoryWriter()
+{
+    try {
+        close();
+    } catch (...) {
+    }
+}//end of destructor ~TrajectoryWriter()
+
+/*
+ *Add a sample, written with the samples buffered before it once the buffer is full.
+ *Input para: double, the time of the sample
+ *            double*, the values of the variables
+ */
+void TrajectoryWriter::addSample(double timeValue, double* varVals)
+{
+    if (file < 0) {
+        return;
+    }
+    timeBuffer[numBuffered] = timeValue;
+    for (int i = 0; i < numVars; i++) {
+        valueBuffer[(size_t)i * CHUNK_SIZE + numBuffered] = varVals[i];
+    }
+    numBuffered++;
+    numSamples++;
+    if (numBuffered == CHUNK_SIZE) {
+        flush();
+    }
+}//end of method addSample()
+
+/*
+ *Write the buffered samples at the end of the datasets, extended to hold them.
+ *Throws runtime_error if they cannot be written, the buffer is emptied either way.
+ */
+void TrajectoryWriter::flush()
+{
+    if (numBuffered == 0 || file < 0) {
+        return;
+    }
+    hsize_t start = numSamples - numBuffered;
+
+    hsize_t timesDim[1] = {(hsize_t)numSamples};
+    bool bWritten = H5Dset_extent(timesDataset, timesDim) >= 0;
+    if (bWritten) {
+        hid_t fileSpace = H5Dget_space(timesDataset);
+        hsize_t timesStart[1] = {start};
+        hsize_t timesCount[1] = {(hsize_t)numBuffered};
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, timesStart, NULL, timesCount, NULL);
+        hid_t memSpace = H5Screate_simple(1, timesCount, NULL);
+        bWritten = H5Dwrite(timesDataset, H5T_NATIVE_DOUBLE, memSpace, fileSpace, H5P_DEFAULT, timeBuffer.data()) >= 0;
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+    }
+
+    if (bWritten && numVars > 0) {
+        hsize_t valuesDim[2] = {(hsize_t)numVars, (hsize_t)numSamples};
+        bWritten = H5Dset_extent(valuesDataset, valuesDim) >= 0;
+    }
+    if (bWritten && numVars > 0) {
+        hid_t fileSpace = H5Dget_space(valuesDataset);
+        hsize_t valuesStart[2] = {0, start};
+        hsize_t valuesCount[2] = {(hsize_t)numVars, (hsize_t)numBuffered};
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, valuesStart, NULL, valuesCount, NULL);
+        //the buffer holds CHUNK_SIZE samples per variable, the first numBuffered are written
+        hsize_t bufferDim[2] = {(hsize_t)numVars, CHUNK_SIZE};
+        hsize_t bufferStart[2] = {0, 0};
+        hid_t memSpace = H5Screate_simple(2, bufferDim, NULL);
+        H5Sselect_hyperslab(memSpace, H5S_SELECT_SET, bufferStart, NULL, valuesCount, NULL);
+        bWritten = H5Dwrite(valuesDataset, H5T_NATIVE_DOUBLE, memSpace, fileSpace, H5P_DEFAULT, valueBuffer.data()) >= 0;
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+    }
+    numBuffered = 0;
+    if (!bWritten) {
+        VCELL_EXCEPTION(runtime_error, "Unable to write samples " << start << " to " << numSamples - 1 << " of HDF5 file " << filename);
+    }
+}//end of method flush()
+
+/*
+ *Write the buffered samples and close the file, samples added after are dropped.
+ *Throws runtime_error if the samples or the file cannot be written, the file is closed either way.
+ */
+void TrajectoryWriter::close()
+{
+    if (file < 0) {
+        return;
+    }
+    try {
+        flush();
+    } catch (...) {
+        closeFile();
+        throw;
+    }
+    if (!closeFile()) {
+        VCELL_EXCEPTION(runtime_error, "Unable to close HDF5 file " << filename);
+    }
+}//end of method close()
+
+/*
+ *Release the datasets and the file, returns false if the file could not be closed.
+ */
+bool TrajectoryWriter::closeFile()
+{
+    if (timesDataset >= 0) {
+        H5Dclose(timesDataset);
+    }
+    if (valuesDataset >= 0) {
+        H5Dclose(valuesDataset);
+    }
+    bool bClosed = H5Fclose(file) >= 0;
+    file = -1;
+    return bClosed;
+}//end of method closeFile()
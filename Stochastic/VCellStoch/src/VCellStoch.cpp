@@ -8,11 +8,12 @@
 #include <VCELL/SimulationMessaging.h>
 #endif
 #include "../include/Gibson.h"
+#include "../include/TauLeaping.h"
 #include <VCELL/GitDescribe.h>
 using namespace std;
 
 static void printUsage() {
-	cout << "Usage: VCellStoch {gibson|gillespie} input_filename output_filename";
+	cout << "Usage: VCellStoch {gibson|tauleaping|gillespie} input_filename output_filename";
 #ifdef USE_MESSAGING
 	cout << " [-tid 0]" << endl;
 #endif
@@ -94,7 +95,7 @@ static void errExit(int returnCode, string& errorMsg) {
 /* This file is the entrance of the Virtual Cell stochastic simulation package.
  * It parses the commandline arguments to load different simulators. Four parameters
  * are required for the command. The Usage is: 
- * VCellStoch gibson[gillespie] input_filename output_filename. 
+ * VCellStoch gibson[tauleaping][gillespie] input_filename output_filename. 
  *
  * @Author: Tracy LI
  * @version:1.0 Beta
@@ -159,6 +160,12 @@ int main(int argc, char *argv[])
    			gb->march();
 			delete gb;
 		}
+		else if (s2.compare("tauleaping")==0)
+		{
+			TauLeaping *tl=new TauLeaping(inputfile, outputfile);
+			tl->march();
+			delete tl;
+		}
 		else if (s2.compare("gillespie")==0)
 		{
 			cout << "Gillespie method is under development.";
@@ -5,6 +5,9 @@
 #ifndef ALGEBRAICSYSTEM_H
 #define ALGEBRAICSYSTEM_H
 
+// Newton iterations of solveSystem()
+#define ALGEBRAIC_SYSTEM_MAX_ITERATIONS 100
+
 class AlgebraicSystem
 {
 public:
@@ -13,6 +16,7 @@ public:
 	inline double getX(int index) {return x[index];} 
 	inline int getDimension() {return dimension;} 
 	inline void setTolerance(double tol){tolerance = tol;}   
+	inline double getTolerance() {return tolerance;}
 
 protected:
     AlgebraicSystem(int dimension);
@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef CONVOLUTION_ENGINE_H
+#define CONVOLUTION_ENGINE_H
+
+#include <complex>
+#include <vector>
+using std::vector;
+
+/*
+ * convolution of images on a numX * numY * numZ grid (x fastest) by a kernel,
+ * the image being zero outside the grid:
+ * - a separable kernel kx(i) ky(j) kz(k), e.g. a gaussian, by three one dimensional passes
+ * - any other kernel by FFT, with the transform of the kernel computed once, or by
+ *   direct sums when the kernel is small enough for them to cost less
+ * Lines of a pass and planes of the direct sums are divided among OpenMP threads.
+ */
+class ConvolutionEngine
+{
+public:
+	ConvolutionEngine(int numX, int numY, int numZ);
+
+	/*
+	 * kernel of kernelNx * kernelNy * kernelNz samples, x fastest. Sample (i, j, k) weighs the
+	 * input at offset (i - kernelNx/2, j - kernelNy/2, k - kernelNz/2) from each output voxel,
+	 * or with bScatter, the output at that offset from each input voxel
+	 */
+	void setKernel(const double* kernel, int kernelNx, int kernelNy, int kernelNz, bool bScatter);
+	// kernel kx(i) ky(j) kz(k), same offsets
+	void setSeparableKernel(const vector<double>& kx, const vector<double>& ky, const vector<double>& kz, bool bScatter);
+
+	// out = in convolved by the kernel, both of numX * numY * numZ values
+	void convolve(const double* in, double* out);
+
+	bool usesFFT() { return bFFT; }
+
+private:
+	typedef std::complex<double> Complex;
+
+	int numX, numY, numZ;
+
+	// the kernel along each axis as a function of the displacement d = output - input,
+	// kernels[a][e] being the weight at d = kernelStarts[a] + e
+	bool bSeparable;
+	int kernelStarts[3];
+	vector<double> kernels[3];
+	// non separable kernel, x fastest
+	int kernelSizes[3];
+	vector<double> kernel;
+
+	// FFT of images padded to fftSizes, no wrap around
+	bool bFFT;
+	int fftSizes[3];
+	vector<Complex> kernelTransform;
+	vector<Complex> fftData;
+	// twiddle factors and bit reversal of each axis
+	vector<Complex> twiddles[3];
+	vector<int> bitReversals[3];
+
+	vector<double> work1;
+	vector<double> work2;
+
+	static void mirror(const double* samples, int n, bool bScatter, int& start, vector<double>& weights);
+	void convolveLines(int axis, const double* in, double* out);
+	void convolveDirect(const double* in, double* out);
+	void initFFT();
+	void transform(vector<Complex>& data, bool bInverse);
+	void transformLine(Complex* line, int axis, bool bInverse);
+};
+
+#endif
@@ -29,6 +29,10 @@ public:
 	void initEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 	void buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 	void postProcess();
+	bool getVolumeIndexes(const int*& volumeIndexes) {
+		volumeIndexes = LocalToGlobalMap;
+		return true;
+	}
 
 	bool isElliptic() { 
 		return true; 
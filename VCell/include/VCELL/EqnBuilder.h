@@ -7,6 +7,7 @@
 
 class Mesh;
 class Variable;
+class EvalContext;
 
 class EqnBuilder
 {
@@ -19,7 +20,22 @@ public:
 	Mesh* getMesh() { return mesh; };
 	virtual bool isElliptic() { return false; }
 
+	/*
+	 * a slab builder's equations at an element only depend on the old values, so the SlabScheduler
+	 * can build slabs of the mesh at once: beginSlabs(), buildEquation() of each slab with a context
+	 * per thread, then endSlabs() for what couples the slabs
+	 */
+	virtual bool isSlabBuilder() { return false; }
+	virtual void beginSlabs(double deltaTime) {}
+	virtual void buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
+	virtual void endSlabs(double deltaTime) {}
+
 protected:
+	// the time of evaluations between advanceTimeOn() and advanceTimeOff() of the simulation
+	double getAdvancedTime();
+	// a context at the current time
+	void initEvalContext(EvalContext& context);
+
 	Variable   *var;
 	Mesh       *mesh;
 };    
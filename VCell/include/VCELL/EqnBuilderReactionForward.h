@@ -19,6 +19,8 @@ public:
 	void initEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
 	{ }
 	void buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
+	bool isSlabBuilder() { return true; }
+	void buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 
 private:
 	ODESolver* odeSolver;
@@ -5,15 +5,35 @@
 #ifndef FVDATASET_H
 #define FVDATASET_H
 
+#include <VCELL/DataSet.h>
+#include <vector>
+using std::vector;
+
 class Simulation;
 class SimulationExpression;
 class Variable;
 
+/*
+ * the contents of a .sim file taken from the simulation, to be written
+ * while the simulation goes on; its vectors keep their storage when reused
+ */
+struct FVDataSetSnapshot
+{
+	FileHeader fileHeader;
+	vector<DataBlock> dataBlocks;
+	// the data of all the blocks, one after the other
+	vector<double> data;
+};
+
 class FVDataSet
 {
 public:
 	static void read(const char *filename, Simulation *sim);
+	// the variable of sim that the data of block varName is read into, NULL if there is none
+	static Variable* findVariable(Simulation *sim, const char *varName, int size);
 	static void write(const char *filename, SimulationExpression *sim, bool bCompress);
+	static void snapshot(SimulationExpression *sim, FVDataSetSnapshot& snapshot);
+	static void write(const char *filename, FVDataSetSnapshot& snapshot, bool bCompress);
 	static void convolve(Simulation* sim, Variable* var, double* values);
 	static void readRandomVariables(char* filename, SimulationExpression* sim);
 };
@@ -23,6 +23,11 @@ public:
     void showVars();
     virtual void resolveReferences(Simulation *sim)=0;
 	virtual void setCoordinates(double time_sec, WorldCoord& wc){};
+	/*
+	 * initVars(), solveSystem() and updateVars() at each of the volume elements
+	 * (or membrane elements) indexes of sim's mesh
+	 */
+	virtual void solveElements(Simulation* sim, int numElements, const long* indexes, bool bMembrane);
 
 protected:
     long currIndex;
@@ -3,12 +3,15 @@
 
 #include <VCELL/FastSystem.h>
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
 
 class SimulationExpression;
 class SimpleSymbolTable;
 namespace VCell {
 	class Expression;
+	class FusedExpressionProgram;
 }
 
 //-----------------------------------------------------------------
@@ -29,6 +32,7 @@ public:
 	void setFastDependencyExpressions(string* symbols, VCell::Expression** expressions);
 	void setJacobianExpressions(VCell::Expression** expressions);
 	void setCoordinates(double time_sec, WorldCoord& wc);
+	void solveElements(Simulation* sim, int numElements, const long* indexes, bool bMembrane);
 
     void initVars();
 	void setDependentVariables(string* vars); // must be called before other setters
@@ -47,8 +51,17 @@ private:
 	VCell::Expression** fastDependencyExpressions;
 	VCell::Expression** jacobianExpressions;
 
+	// pseudo constants, jacobian and fast rates, and fast dependencies of many elements at once
+	VCell::FusedExpressionProgram* pseudoConstantProgram;
+	VCell::FusedExpressionProgram* newtonProgram;
+	VCell::FusedExpressionProgram* dependencyProgram;
+	bool bProgramsBuilt;
+
 	void bindAllExpressions();
 	SimpleSymbolTable* getFastSymbolTable();
+	void buildPrograms();
+	struct BatchWorkspace;
+	void solveBlock(BatchWorkspace& workspace, int numElements, const long* indexes, bool bMembrane, vector<long>& failedIndexes);
 };
 
 #endif
@@ -14,6 +14,9 @@ class VolumeRegionVarContextExpression;
 //class VolumeParticleContext;
 //class ContourParticleContext;
 class FastSystem;
+namespace VCell {
+	class ExpressionCompiler;
+}
 class Feature;
 class Simulation;
 class VolumeVariable;
@@ -43,6 +46,8 @@ public:
 	void addVolumeRegionVarContext(VolumeRegionVarContextExpression *vc);	
 	   
 	void reinitConstantValues();
+	void addExpressionsToCompiler(VCell::ExpressionCompiler* compiler);
+	void createStackMachines();
 
 	//VolumeParticleContext     *getVolumeParticleContext(){return vpc;}
 	//MembraneParticleContext   *getMembraneParticleContext(){return mpc;}
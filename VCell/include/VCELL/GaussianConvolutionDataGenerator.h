@@ -6,7 +6,10 @@
 #define GAUSSIAN_CONVOLUTION_DATA_GENERATOR_H
 
 #include <VCELL/DataGenerator.h>
+#include <vector>
+using std::vector;
 
+class ConvolutionEngine;
 namespace VCell {
 	class Expression;
 }
@@ -25,14 +28,21 @@ private:
 	double sigmaXY;
 	double sigmaZ;
 	double sigmaRatio;
-	double* gaussianPsfSamples;
+	// the gaussian is symmetric, the same convolution spreads the membrane values
+	ConvolutionEngine* convolutionEngine;
 	double* functionValues;
+	// membrane values on the volume grid, and their convolution
+	double* membraneSourceValues;
+	double* membraneConvolvedValues;
 	int funcValueSize;
 	int gaussianPsfSampleNx;
 	int gaussianPsfSampleNy;
 	int gaussianPsfSampleNz;
 	VCell::Expression* volFunction;
 	VCell::Expression* memFunction;
+
+	// samples of a normalized gaussian h apart, centered at samples.size()/2
+	static void sampleGaussian(vector<double>& samples, double h, double sigma);
 };
 
 #endif
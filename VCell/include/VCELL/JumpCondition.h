@@ -8,6 +8,7 @@ namespace VCell {
 class SymbolTable;
 struct MembraneElement;
 class SimulationExpression;
+class EvalContext;
 
 class JumpCondition
 {
@@ -25,6 +26,7 @@ public:
 	void bindExpression(SymbolTable*);
 	double evaluateExpression(double* values);
 	double evaluateExpression(SimulationExpression*, MembraneElement*);
+	double evaluateExpression(EvalContext&, SimulationExpression*, MembraneElement*);
 	void reinitConstantValues();
 
 private:
@@ -12,6 +12,9 @@ class MembraneVarContextExpression;
 class MembraneRegionVarContextExpression;
 class MembraneVariable;
 class MembraneRegionVariable;
+namespace VCell {
+	class ExpressionCompiler;
+}
 
 class Membrane : public Structure
 {
@@ -40,6 +43,8 @@ public:
 	}
 	bool inBetween(Feature* f1, Feature* f2);
 	void reinitConstantValues();
+	void addExpressionsToCompiler(VCell::ExpressionCompiler* compiler);
+	void createStackMachines();
 
 private:
 	Feature* feature1;
@@ -22,9 +22,14 @@ public:
 	void initEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize) 
 	{}
 	void buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
+	bool isSlabBuilder() { return true; }
+	void beginSlabs(double deltaTime);
+	void buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 
 private:
 	ODESolver* odeSolver;
+	// the rates are evaluated at the end of the time step
+	double advancedTime;
 };    
 
 #endif
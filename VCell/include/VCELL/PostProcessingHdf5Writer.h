@@ -17,6 +17,16 @@ namespace H5 {
 	class DataSet;
 }
 
+/*
+ * the post processing data of a save point, to be written while the simulation goes on
+ */
+struct PostProcessingSnapshot
+{
+	double time;
+	// the data of each data generator
+	vector<vector<double> > data;
+};
+
 class PostProcessingHdf5Writer
 {
 public:
@@ -24,12 +34,20 @@ public:
 	virtual ~PostProcessingHdf5Writer();
 
 	void writeOutput();
+	// computes the data of the current time, which writeOutput(snapshot) then writes
+	void computeOutput(PostProcessingSnapshot& snapshot);
+	void writeOutput(PostProcessingSnapshot& snapshot);
 
 	static const char* PPGroupName;
 	static const char* TimesDataSetName;
 
 	bool loadFinal(int numTimes);
 
+	// creates name in h5File as an extendable, chunked dataset of times
+	static H5::DataSet* createTimesDataSet(H5::H5File* h5File, const char* name);
+	// writes time at timeIndex of timesDataSet, extending it to timeIndex + 1 times
+	static void writeTime(H5::DataSet* timesDataSet, int timeIndex, double time);
+
 private:
 	vector<double> timeList;
 	PostProcessingBlock* postProcessingBlock;
@@ -37,7 +55,7 @@ private:
 	string h5PPFileName;
 	H5::H5File* h5PPFile;
 	H5::DataSet* timesDataSet;
-	void writeDataGenerator(DataGenerator* dataGenerator, int timeIndex);
+	void writeDataGenerator(DataGenerator* dataGenerator, int timeIndex, double* data);
 	void createGroups();
 };
 
@@ -0,0 +1,93 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+using std::string;
+
+#define MAX_NUM_PROFILE_SECTIONS 256
+// cycles, instructions and cache misses
+#define NUM_PROFILE_COUNTERS 3
+
+typedef int ProfileHandle;
+
+/*----------------------------------------------------------------------------
+	Time spent in the sections of the solvers, for production runs (PROFILE in
+	the input file). A section adds up the wall clock time and the number of
+	calls of the code between start() and stop(). The usual way to time a
+	section is a ProfileScope, with the handle looked up once:
+
+		static ProfileHandle handle = Profiler::getHandle("pcSolve");
+		ProfileScope scope(handle);
+
+	While the profiler is not enabled, start() and stop() return at once.
+
+	With hardware counters (Linux perf events), a section also adds up the
+	cycles, instructions and cache misses of the thread that enabled the
+	profiler. Sections timed on other threads, or inside their parallel
+	regions, only get time. A section is timed by one thread at a time. If a
+	running section is started again, the outermost call times it.
+ --------------------------------------------------------------------------------------*/
+class Profiler
+{
+public:
+	static ProfileHandle getHandle(const string& name);
+
+	// starts a new summary, also after an earlier run in the same process
+	static void enable(bool bHardwareCounters);
+	static bool isEnabled() { return bEnabled; }
+
+	static void start(ProfileHandle handle);
+	static void stop(ProfileHandle handle);
+
+	// calls and seconds of a section since enable()
+	static long getNumCalls(ProfileHandle handle) { return sections[handle].numCalls; }
+	static double getSeconds(ProfileHandle handle) { return sections[handle].seconds; }
+
+	// calls, seconds and counters of each section used since enable()
+	static void writeJSON(const string& fileName);
+
+private:
+	struct Section {
+		string name;
+		long numCalls;
+		int depth;
+		double seconds;
+		double startTime;
+		bool bCounting;
+		long long counters[NUM_PROFILE_COUNTERS];
+		long long startCounters[NUM_PROFILE_COUNTERS];
+	};
+	static Section sections[MAX_NUM_PROFILE_SECTIONS];
+	static int numSections;
+	static bool bEnabled;
+	static double enableTime;
+
+	// perf event group, counterFds[0] leads; -1 without hardware counters
+	static int counterFds[NUM_PROFILE_COUNTERS];
+
+	static double now();
+	static void openCounters();
+	static bool isCounterThread();
+	static bool readCounters(long long* values);
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(ProfileHandle handle) {
+		this->handle = handle;
+		Profiler::start(handle);
+	}
+	~ProfileScope() {
+		Profiler::stop(handle);
+	}
+
+private:
+	ProfileHandle handle;
+};
+
+#endif
@@ -5,7 +5,11 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include <vector>
+using std::vector;
+
 class Simulation;
+class FastSystem;
 
 class Scheduler
 {
@@ -20,6 +24,13 @@ protected:
 	Simulation *sim;
 	bool    bFirstTime;
 	bool    bHasFastSystem;
+
+private:
+	// the elements of each fast system, solved together
+	vector<FastSystem*> fastSystems;
+	vector<vector<long> > fastSystemElements;
+	void addFastSystemElement(FastSystem* fs, long index);
+	void solveFastSystemElements(bool bMembrane);
 };
 
 #endif
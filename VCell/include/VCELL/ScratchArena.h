@@ -0,0 +1,70 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <stddef.h>
+#include <vector>
+using std::vector;
+
+// bytes of a block of the arena, and the alignment of what it hands out
+#define SCRATCH_ARENA_BLOCK_SIZE (1 << 20)
+#define SCRATCH_ARENA_ALIGNMENT 64
+
+/*----------------------------------------------------------------------------
+	Scratch memory of a solver. Arrays are carved one after the other out of
+	large blocks and given back all at once by release(mark), so a loop that
+	marks, allocates and releases reuses the same memory every time and only
+	touches the heap while the blocks still have to grow. The blocks are
+	freed with the arena.
+
+	The counters tell how often that happened: getNumHeapAllocations() does
+	not change over a stretch of code that the arena serves from its blocks.
+	Not thread safe, allocate on one thread and hand the arrays out.
+ --------------------------------------------------------------------------------------*/
+class ScratchArena
+{
+public:
+	ScratchArena(size_t blockSize=SCRATCH_ARENA_BLOCK_SIZE);
+	~ScratchArena();
+
+	// n values of T set to 0, aligned to SCRATCH_ARENA_ALIGNMENT bytes
+	template <class T> T* allocate(size_t n) {
+		return (T*)allocateBytes(n * sizeof(T));
+	}
+
+	struct Mark {
+		size_t block;
+		size_t used;
+	};
+	// release(mark()) gives back everything allocated after mark()
+	Mark mark();
+	void release(const Mark& m);
+
+	long getNumAllocations() { return numAllocations; }
+	long getNumHeapAllocations() { return (long)blocks.size(); }
+	size_t getCapacity();
+	size_t getBytesInUse() { return bytesInUse; }
+	size_t getPeakBytesInUse() { return peakBytesInUse; }
+
+private:
+	struct Block {
+		char* memory;
+		char* data; // memory aligned
+		size_t size;
+		size_t used;
+	};
+	vector<Block> blocks;
+	size_t currentBlock;
+	size_t blockSize;
+
+	long numAllocations;
+	size_t bytesInUse;
+	size_t peakBytesInUse;
+
+	void* allocateBytes(size_t bytes);
+};
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SIM_DATA_HDF5_WRITER_H
+#define SIM_DATA_HDF5_WRITER_H
+
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+class Simulation;
+struct FVDataSetSnapshot;
+namespace H5 {
+	class H5File;
+	class DataSet;
+}
+
+/*
+ * all the save points of a simulation in one HDF5 file instead of a .sim file each:
+ * /SimData/Times holds the time of each save point and each data block of the .sim
+ * format is a dataset /SimData/Variables/<block name> of one row per time index,
+ * extended as the simulation goes on, chunked and optionally deflated
+ */
+class SimDataHdf5Writer
+{
+public:
+	SimDataHdf5Writer(string fileName, int deflateLevel);
+	~SimDataHdf5Writer();
+
+	const string& getFileName() { return h5FileName; }
+
+	// appends a save point, returns its time index
+	int writeOutput(double time, FVDataSetSnapshot& snapshot);
+	/*
+	 * reopens the file to go on from the save point numTimes - 1: drops the save points
+	 * after it and reads the variables of sim from it; returns false if the file
+	 * doesn't have numTimes save points
+	 */
+	bool loadFinal(int numTimes, Simulation* sim);
+	// the next writeOutput() starts a new file
+	void close();
+
+	static const char* SimDataGroupName;
+	static const char* TimesDataSetName;
+	static const char* VariablesGroupName;
+
+private:
+	string h5FileName;
+	int deflateLevel;
+	int numTimes;
+
+	H5::H5File* h5File;
+	H5::DataSet* timesDataSet;
+	// a dataset for each data block of the snapshot
+	vector<H5::DataSet*> dataSets;
+
+	void openDataSets(FVDataSetSnapshot& snapshot);
+};
+
+#endif
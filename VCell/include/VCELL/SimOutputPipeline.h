@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SIMOUTPUTPIPELINE_H
+#define SIMOUTPUTPIPELINE_H
+
+#include <VCELL/FVDataSet.h>
+#include <VCELL/PostProcessingHdf5Writer.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+using std::string;
+using std::vector;
+
+/*----------------------------------------------------------------------------
+	A save point of SimTool: the data of its .sim file and post processing,
+	and the log entry they are written under.
+ --------------------------------------------------------------------------------------*/
+struct SimOutputBuffer
+{
+	double progress;
+	double time;
+	int iteration;
+	int simFileCount;
+	string simFileName;
+	FVDataSetSnapshot dataSet;
+	bool bPostProcessing;
+	PostProcessingSnapshot postProcessing;
+};
+
+/*----------------------------------------------------------------------------
+	Writes the save points of SimTool in a background thread, so that time
+	stepping goes on while a .sim file is written and zipped, the post
+	processing data appended and the log entry made.
+
+	Save points are written one at a time in the order they are submitted,
+	with the same steps as in the solver thread, so the log only lists data
+	that is complete on disk. The numBuffers buffers are reused from one save
+	point to the next; acquire() waits while all of them are queued or being
+	written.
+
+	Once a save point fails the later ones are dropped, and the next acquire()
+	or finish() throws its error.
+ --------------------------------------------------------------------------------------*/
+class SimOutputPipeline
+{
+public:
+	typedef std::function<void(SimOutputBuffer&)> WriteFunction;
+
+	SimOutputPipeline(int numBuffers, WriteFunction write);
+	// writes the save points still queued, errors are only printed
+	~SimOutputPipeline();
+
+	// a free buffer to fill and submit
+	SimOutputBuffer* acquire();
+	void submit(SimOutputBuffer* buffer);
+	// waits until all submitted save points are written
+	void finish();
+	// progress and time of the next save point written since the last call, false if none
+	bool nextWritten(double& progress, double& time);
+
+private:
+	WriteFunction write;
+	vector<SimOutputBuffer*> buffers;
+	vector<SimOutputBuffer*> freeBuffers;
+	std::deque<SimOutputBuffer*> queue;
+	std::deque<std::pair<double, double> > written;
+	bool bWriting;
+	bool bStop;
+	string error;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
+
+	void run();
+};
+
+#endif
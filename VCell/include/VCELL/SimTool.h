@@ -26,6 +26,20 @@ class Mesh;
 class Simulation;
 class Variable;
 class PostProcessingHdf5Writer;
+class SimDataHdf5Writer;
+class SimOutputPipeline;
+struct SimOutputBuffer;
+
+// solver of the sparse systems of FV_SOLVER
+typedef enum {
+	LINEAR_SOLVER_PCGPAK,
+	// SparseKrylovSolver with an incomplete factorization
+	LINEAR_SOLVER_NATIVE,
+	// SparseKrylovSolver preconditioned by multigrid
+	LINEAR_SOLVER_NATIVE_MULTIGRID,
+	// SparseMultigridSolver alone
+	LINEAR_SOLVER_MULTIGRID
+} LinearSolverType;
 
 class SimTool {
 public:
@@ -61,6 +75,15 @@ public:
 	void setFileCompress(bool compress) {
 		bSimFileCompress = compress;
 	}
+	// save points held for the background writer, 0 writes them in the solver thread
+	void setNumOutputBuffers(int n) {
+		numOutputBuffers = n;
+	}
+	// all save points in one hdf5 file rather than a zipped .sim file each
+	void setSimDataHdf5(bool b, int deflateLevel) {
+		bSimDataHdf5 = b;
+		simDataDeflateLevel = deflateLevel;
+	}
 	void requestNoZip();
 
 	Simulation* getSimulation() { return simulation; }
@@ -104,8 +127,25 @@ public:
 	double getSimStartTime() { return simStartTime; }
 	void setSundialsOneStepOutput() { bSundialsOneStepOutput = true; }
 	bool isSundialsOneStepOutput() { return bSundialsOneStepOutput; }
+	void setCompileExpressions() { bCompileExpressions = true; }
+	bool isCompileExpressions() { return bCompileExpressions; }
+	void setLinearSolver(LinearSolverType type) { linearSolver = type; }
+	LinearSolverType getLinearSolver() { return linearSolver; }
+	bool isNativeLinearSolver() { return linearSolver != LINEAR_SOLVER_PCGPAK; }
+	// slabs of the mesh FV_SOLVER builds at once (SlabScheduler), 0 for one per thread
+	void setNumSlabs(int n) { numSlabs = n; }
+	int getNumSlabs() { return numSlabs; }
+	// time the solver sections (Profiler), summary in <base file name>.profile.json
+	void setProfile(bool bHardwareCounters) {
+		bProfile = true;
+		bProfileHardwareCounters = bHardwareCounters;
+	}
 	
 	void setSerialParameterScans(int numScans, double** values);
+	// serial parameter scans run at the same time, 0 for one per processor
+	void setNumParallelScans(int n) {
+		numParallelScans = n;
+	}
 	void setLoadFinal(bool b) {
 		bLoadFinal = b;
 	}
@@ -120,10 +160,16 @@ private:
 
 	bool checkSpatiallyUniform(Variable*);	
 	void updateLog(double progress,double time,int iteration);
+	void writeSavePoint(SimOutputBuffer& buffer);
+	void sendOutputEvents();
 	void clearLog();
 	int	getZipCount(char* zipFileName);
 	int	getZipCount(const std::string* zipFileName);
 	void start1();
+	void runSimulation();
+	void writeProfile();
+	void startSerialScans();
+	void startParallelScans();
 	void copyParticleCountsToConcentration();
 
 	static SimTool* instance;
@@ -157,13 +203,26 @@ private:
 
 	bool bSundialsOneStepOutput;
 	int keepAtMost;
+	bool bCompileExpressions;
+	LinearSolverType linearSolver;
+	int numSlabs;
+	bool bProfile;
+	bool bProfileHardwareCounters;
 
 	double** serialScanParameterValues;
 	int numSerialParameterScans;
+	int numParallelScans;
 
 	PostProcessingHdf5Writer* postProcessingHdf5Writer;
+	bool bSimDataHdf5;
+	int simDataDeflateLevel;
+	SimDataHdf5Writer* simDataHdf5Writer;
 	simptr smoldynSim;
 	string smoldynInputFile;
+
+	int numOutputBuffers;
+	SimOutputPipeline* outputPipeline;
+	SimOutputBuffer* syncOutputBuffer;
 };
 
 #endif
@@ -21,6 +21,7 @@ class RandomVariable;
 class RegionSizeVariable;
 class SymbolTable;
 class ScalarValueProxy;
+class EvalContext;
 class VolumeParticleVariable;
 class MembraneParticleVariable;
 
@@ -61,6 +62,10 @@ public:
 		return symbolTable; 
 	};
 	void setCurrentCoordinate(WorldCoord& wc);
+	// the indices, coordinates and time of one thread's evaluations (see Expression::evaluate(EvalContext&)),
+	// a new context starts at the current time of the simulation
+	void setCurrentCoordinate(EvalContext& context, WorldCoord& wc);
+	void initEvalContext(EvalContext& context);
 
 	bool isVolumeVariableDefinedInRegion(int volVarIndex, int regionIndex) {
 		if (volVariableRegionMap[volVarIndex] == 0) {
@@ -71,6 +76,8 @@ public:
 
 	void addParameter(string& param);
 	void setParameterValues(double* paramValues);
+	// native code for the expressions evaluated with a value array (sundials pde)
+	void compileExpressions();
 	int getNumParameters() {
 		return (int)paramList.size();
 	}
@@ -0,0 +1,44 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SLABSCHEDULER_H
+#define SLABSCHEDULER_H
+
+#include <VCELL/SerialScheduler.h>
+#include <vector>
+using std::vector;
+
+class Simulation;
+class EqnBuilder;
+class Solver;
+
+/*----------------------------------------------------------------------------
+	SerialScheduler on all threads. The volume elements are divided into slabs
+	of whole z planes (y rows in 2D), the membrane elements into as many ranges.
+
+	The slab builders (EqnBuilder::isSlabBuilder()) only read the old values,
+	so each thread builds their equations on a slab at a time and solves the
+	ODEs there. What couples the slabs is then done over the whole mesh: the
+	boundary and periodic terms of endSlabs(), the linear systems of the PDEs
+	(multithreaded with the native linear solvers) and the fast systems
+	(multithreaded by blocks of elements). Other builders build serially.
+ --------------------------------------------------------------------------------------*/
+class SlabScheduler : public SerialScheduler
+{
+public:
+	// numSlabs 0 for one per thread
+	SlabScheduler(Simulation *Asim, int numSlabs);
+	virtual void iterate();
+
+	int getNumSlabs() { return (int)volumeSlabStarts.size() - 1; }
+
+private:
+	// first volume element and membrane element of each slab, and the ends
+	vector<int> volumeSlabStarts;
+	vector<int> membraneSlabStarts;
+
+	void runSlabs(vector<EqnBuilder*>& builders, vector<Solver*>& solvers);
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SPARSEILUPRECONDITIONER_H
+#define SPARSEILUPRECONDITIONER_H
+
+#include <VCELL/SimTypes.h>
+#include <vector>
+using std::vector;
+
+class SparseMatrixPCG;
+
+/*----------------------------------------------------------------------------
+	Incomplete LU factorization of a SparseMatrixPCG, L has a unit diagonal and
+	is stored with U in one compressed row matrix. For symmetric storage the
+	lower triangle is the transpose of the stored upper one.
+
+	The sparsity of the factors, ILU(k) by level of fill (0 keeps the pattern of
+	the matrix), is computed once in the constructor, so all storage is
+	allocated up front. The pattern of the matrix must not change afterwards,
+	factor() only reads its current values.
+
+	With blocks, entries coupling two blocks are dropped (block Jacobi) and the
+	blocks are factored and solved independently, in parallel with OpenMP.
+ --------------------------------------------------------------------------------------*/
+class SparseILUPreconditioner
+{
+public:
+	/*
+	 * blockStarts holds numBlocks + 1 row offsets, the first 0 and the last N;
+	 * one block of all rows if numBlocks is 1
+	 */
+	SparseILUPreconditioner(SparseMatrixPCG* A, int fillLevel, int numBlocks = 1, const int* blockStarts = 0);
+	~SparseILUPreconditioner();
+
+	// factors the current values of A, throws on a zero pivot
+	void factor();
+	// z = (LU)^-1 r, r and z may be the same vector
+	void solve(const double* r, double* z);
+
+	bool isFactored() { return numFactorizations > 0; }
+	int getNumFactorizations() { return numFactorizations; }
+	long getNumFactorNonZeros() { return (long)cols.size(); }
+	int getNumBlocks() { return (int)blockStarts.size() - 1; }
+
+private:
+	SparseMatrixPCG* A;
+	long N;
+	vector<int> blockStarts;
+
+	// rows of L and U, columns in ascending order; the diagonal holds 1/u_ii
+	vector<long> rowStarts;
+	vector<int> cols;
+	vector<long> diagPositions;
+	vector<double> values;
+	// off diagonal entries of A by row (those of row i start at entryStarts[i]):
+	// index in A->getsa() and position in values, -1 if dropped
+	vector<long> entryStarts;
+	vector<long> entrySources;
+	vector<long> entryPositions;
+	// position of each column in the current row, -1 outside
+	vector<long> rowMarkers;
+
+	int numFactorizations;
+
+	void computePattern(int fillLevel, const vector<int32>& entryColumns);
+	// returns the first row with a zero pivot, -1 if none
+	long factorBlock(int block);
+	void solveBlock(int block, const double* r, double* z);
+};
+
+#endif
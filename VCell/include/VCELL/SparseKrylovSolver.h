@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SPARSEKRYLOVSOLVER_H
+#define SPARSEKRYLOVSOLVER_H
+
+#include <VCELL/SimTypes.h>
+#include <vector>
+using std::vector;
+
+class SparseMatrixPCG;
+class SparseMatrixSELL;
+class SparseILUPreconditioner;
+class SparseMultigridSolver;
+
+/*----------------------------------------------------------------------------
+	Preconditioned Krylov solver for A x = b: conjugate gradients if A has
+	symmetric storage, BiCGStab otherwise.
+
+	Products with A use SparseMatrixSELL. The preconditioner is ILU(fillLevel)
+	in block Jacobi form with one block of rows per OpenMP thread, so that it
+	runs in parallel too; with one thread it is the ILU of the whole matrix.
+	Alternatively a multigrid V-cycle preconditions.
+ --------------------------------------------------------------------------------------*/
+class SparseKrylovSolver
+{
+public:
+	SparseKrylovSolver(SparseMatrixPCG* A, int fillLevel);
+	// preconditioned by multigrid->cycle(), multigrid is updated by the caller
+	SparseKrylovSolver(SparseMatrixPCG* A, SparseMultigridSolver* multigrid);
+	~SparseKrylovSolver();
+
+	// rereads the values of A and refactors, rebuilds all if the pattern of A changed
+	void update();
+	/*
+	 * x holds the initial guess; iterates until ||b - A x|| <= relTol ||b||,
+	 * returns false if that takes more than maxIterations or the method breaks down
+	 */
+	bool solve(const double* b, double* x, double relTol, int maxIterations);
+
+	int getNumIterations() { return numIterations; }
+	double getRelativeResidual() { return relativeResidual; }
+
+private:
+	SparseMatrixPCG* A;
+	int fillLevel;
+	SparseMatrixSELL* sellMatrix;
+	SparseILUPreconditioner* preconditioner;
+	SparseMultigridSolver* multigrid;
+	// pattern of A the kernels are built for
+	vector<long> patternRowStarts;
+	vector<int32> patternColumns;
+
+	long N;
+	vector<double> r, rHat, z, p, q, s, t, u;
+	int numIterations;
+	double relativeResidual;
+
+	void build();
+	void resizeVectors();
+	// z = M^-1 r
+	void precondition(const double* r, double* z);
+	// start from the residual in r
+	bool solvePCG(double* x, double bNorm, double tolerance, int maxIterations);
+	bool solveBiCGStab(double* x, double bNorm, double tolerance, int maxIterations);
+
+	double dot(const double* u, const double* v);
+	// y = a * x + y
+	void axpy(double a, const double* x, double* y);
+};
+
+#endif
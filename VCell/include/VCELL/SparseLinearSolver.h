@@ -4,6 +4,8 @@
 #include <VCELL/PDESolver.h>
 
 class SparseMatrixEqnBuilder;
+class SparseKrylovSolver;
+class SparseMultigridSolver;
 class Variable;
 
 class SparseLinearSolver : public PDESolver
@@ -21,6 +23,10 @@ private:
 
 protected:
 	int* PCGSolve(bool bRecomputeIncompleteFactorization);
+	// same with SparseKrylovSolver or SparseMultigridSolver instead of PCGPAK (SimTool::isNativeLinearSolver())
+	int* KrylovSolve(bool bRecomputeIncompleteFactorization);
+	SparseKrylovSolver* krylovSolver;
+	SparseMultigridSolver* multigridSolver;
 	SparseMatrixEqnBuilder* smEqnBuilder;    
 	double* pcg_workspace;	
 	long nWork;
@@ -24,6 +24,11 @@ public:
 
 	virtual double* getX(); // X is both initial guess and final solution to the linear system
 	virtual void postProcess() {}
+	/*
+	 * if the rows of A are volume elements: true, and row i is element volumeIndexes[i],
+	 * or element i if volumeIndexes is 0
+	 */
+	virtual bool getVolumeIndexes(const int*& volumeIndexes) { return false; }
 
 protected:
 	SparseMatrixPCG* A;
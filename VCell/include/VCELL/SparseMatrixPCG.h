@@ -2,6 +2,8 @@
 #define SPARSEMATRIXPCG
 
 #include <VCELL/SimTypes.h>
+#include <vector>
+using std::vector;
 
 /*----------------------------------------------------------------------------
 	Sparse matrix stored in PCGPAK2 form
@@ -33,6 +35,12 @@ public:
 	int32* getFortranIJA();
 	double* getsa() { return sa; };
 	int getColumns(long i, int32*& columns, double*& values);
+	/*
+	 * off diagonal entries of the whole matrix by row (for symmetric storage the lower
+	 * triangle mirrors the stored upper one); those of row i are [rowStarts[i], rowStarts[i+1])
+	 * with their columns and indexes in getsa()
+	 */
+	void getOffDiagonalRows(vector<long>& rowStarts, vector<int32>& columns, vector<long>& sources);
 	void clear();
 
 	void scaleOffDiagonals(double gamma);
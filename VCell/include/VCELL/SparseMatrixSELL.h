@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SPARSEMATRIXSELL_H
+#define SPARSEMATRIXSELL_H
+
+#include <VCELL/SimTypes.h>
+#include <vector>
+using std::vector;
+
+class SparseMatrixPCG;
+
+// rows computed together by SparseMatrixSELL::multiply()
+#define SELL_CHUNK_SIZE 8
+
+/*----------------------------------------------------------------------------
+	A SparseMatrixPCG (general or symmetric storage) in SELL-C-sigma form for a
+	multithreaded y = A x.
+
+	Rows are sorted by length within windows of sigma rows and cut into chunks of
+	SELL_CHUNK_SIZE rows. A chunk is stored column by column and padded to its
+	longest row, so its rows are computed together with contiguous loads. The
+	rows of a CartesianMesh stencil have nearly the same length and need little
+	padding.
+
+	Each row adds its entries in the same order whatever the number of threads.
+	The form is built from the pattern of A, updateValues() reloads its values.
+ --------------------------------------------------------------------------------------*/
+class SparseMatrixSELL
+{
+public:
+	SparseMatrixSELL(SparseMatrixPCG* A, int sortWindow = 256);
+	~SparseMatrixSELL();
+
+	void updateValues();
+	// y = A x, y must not be x
+	void multiply(const double* x, double* y);
+
+	long getN() { return N; }
+	// stored entries, including padding, per nonzero of A
+	double getFillRatio();
+
+private:
+	SparseMatrixPCG* A;
+	long N;
+	long numNonZeros;
+
+	int numChunks;
+	// entries of chunk c start at chunkStarts[c], entry k of its row r is at chunkStarts[c] + k * SELL_CHUNK_SIZE + r
+	vector<long> chunkStarts;
+	// row at each chunk position, -1 past the last row
+	vector<int> chunkRows;
+	vector<int32> columns;
+	vector<double> values;
+	// index in A->getsa() of each entry, -1 for padding
+	vector<long> sources;
+};
+
+#endif
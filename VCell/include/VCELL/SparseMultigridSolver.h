@@ -0,0 +1,107 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef SPARSEMULTIGRIDSOLVER_H
+#define SPARSEMULTIGRIDSOLVER_H
+
+#include <VCELL/SimTypes.h>
+#include <vector>
+using std::vector;
+
+class SparseMatrixPCG;
+class CartesianMesh;
+
+/*----------------------------------------------------------------------------
+	Geometric multigrid for A x = b where the rows of A are volume elements of
+	a CartesianMesh.
+
+	Each coarser level agglomerates 2x2x2 blocks of elements: the rows of a
+	block that A connects within the block become one coarse row. Rows across
+	a membrane, in another region or at a Dirichlet boundary are not connected
+	by A, so they are never merged. Coarse matrices are the Galerkin products
+	P^T A P of the piecewise constant prolongation P. Their pattern is computed
+	once, update() only adds up the current values of A.
+
+	A cycle smooths by Gauss-Seidel, forward before and backward after the
+	coarse correction, and solves the coarsest level exactly. It is thus
+	symmetric for symmetric A and can precondition conjugate gradients. Rows are
+	smoothed in one block per OpenMP thread, blocks coupled as in Jacobi.
+ --------------------------------------------------------------------------------------*/
+class SparseMultigridSolver
+{
+public:
+	/*
+	 * row i of A is volume element volumeIndexes[i] of mesh; all the volume elements
+	 * in order if volumeIndexes is 0
+	 */
+	SparseMultigridSolver(SparseMatrixPCG* A, CartesianMesh* mesh, const int* volumeIndexes);
+	~SparseMultigridSolver();
+
+	// rereads the values of A, rebuilds the levels if the pattern of A changed
+	void update();
+	// z = one V-cycle for A z = r from 0, r and z may not be the same vector
+	void cycle(const double* r, double* z);
+	/*
+	 * V-cycles from the initial guess x until ||b - A x|| <= relTol ||b||, returns false
+	 * if that takes more than maxIterations. For symmetric A the coarse corrections are
+	 * scaled to the best step, these cycles can't precondition conjugate gradients.
+	 */
+	bool solve(const double* b, double* x, double relTol, int maxIterations);
+
+	int getNumLevels() { return (int)levels.size(); }
+	long getNumRows(int level) { return levels[level]->N; }
+	int getNumIterations() { return numIterations; }
+	double getRelativeResidual() { return relativeResidual; }
+
+private:
+	struct Level {
+		long N;
+		// off diagonal entries by row, and the diagonal
+		vector<long> rowStarts;
+		vector<int32> columns;
+		vector<double> values;
+		vector<double> diagonal;
+		// rows smoothed by each thread
+		vector<long> blockStarts;
+		// row of the next level each row belongs to, and the position in the next level's
+		// values each entry adds to (-1 for its diagonal)
+		vector<long> aggregates;
+		vector<long> coarsePositions;
+		vector<double> x, b, r, xOld;
+	};
+
+	SparseMatrixPCG* A;
+	CartesianMesh* mesh;
+	vector<int> volumeIndexes;
+	// pattern of A the levels are built for, with the index in A->getsa() of each entry
+	vector<long> patternRowStarts;
+	vector<int32> patternColumns;
+	vector<long> patternSources;
+	vector<Level*> levels;
+
+	// LU of the coarsest level with partial pivoting
+	vector<double> coarseLU;
+	vector<long> coarsePivots;
+
+	// scale coarse corrections, only when the cycles needn't be linear
+	bool bScaleCorrections;
+	int numIterations;
+	double relativeResidual;
+
+	void build();
+	void clear();
+	void setBlocks(Level* level);
+	// the next level from the coordinates of the rows of level, and the coordinates of its rows
+	Level* coarsen(Level* level, const vector<int>& coords, vector<int>& coarseCoords);
+	void computeValues();
+	void factorCoarsest();
+	void solveCoarsest(Level* level);
+	void cycle(int l);
+	double correctionScale(Level* coarse);
+	void smooth(Level* level, bool bForward);
+	// r = b - A x at level
+	void residual(Level* level, const double* b, const double* x, double* r);
+};
+
+#endif
@@ -29,6 +29,14 @@ public:
 	void initEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 	void buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
 	void postProcess();
+	bool isSlabBuilder() { return true; }
+	void beginSlabs(double deltaTime);
+	void buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize);
+	void endSlabs(double deltaTime);
+	bool getVolumeIndexes(const int*& volumeIndexes) {
+		volumeIndexes = LocalToGlobalMap;
+		return true;
+	}
 
 private:
 	bool bSymmetricStorage; // no convection, A would be symmetric
@@ -49,10 +57,14 @@ private:
 	int* LocalToGlobalMap; // local to global mapping, total number of elements is sum of region sizes.
 	int* RegionFirstRow; // list of indexes of first row of each region (cummulative sum of number of nodes);
 	bool bSolveWholeMesh;	
+	// boundary conditions and jump conditions are evaluated at the end of the time step
+	double advancedTime;
 
 	void init();
 	void computeLHS(int index, double* lambdas, double& Aii, int& numCols, int* columnIndices, double* columnValues, bool& bSort);
-	double computeRHS(int index, double deltaTime, double* lambdas, double bInit);
+	double computeRHS(EvalContext& context, int index, double deltaTime, double* lambdas, double bInit);
+	double evaluateAdvanced(EvalContext& context, VarContext* varContext, int index, long expIndex);
+	double evaluateAdvancedFlux(EvalContext& context, VarContext* varContext, MembraneElement* element);
 	void preProcess();
 	bool checkPeriodicCoupledPairsInRegions(int indexm, int indexp);
 };    
@@ -9,15 +9,24 @@
 #include <nvector/nvector_serial.h>
 #include <sundials/sundials_types.h>
 #include <VCELL/SundialsSolverOptions.h>
+#include <VCELL/ScratchArena.h>
+#include <vector>
+using std::vector;
 
 class Variable;
+class VolumeVariable;
+class VolumeVarContextExpression;
 class CartesianMesh;
 class SparseMatrixPCG;
+class SparseILUPreconditioner;
 struct MembraneElement;
 struct VolumeElement;
 class SimulationExpression;
 class VarContext;
 class Feature;
+namespace VCell {
+	class FusedExpressionProgram;
+}
 
 class SundialsPdeScheduler : public Scheduler
 {
@@ -172,8 +181,6 @@ private:
 	void setupOrderMaps();
 	void applyVolumeOperatorOld(double t, double* yinput, double* rhs);
 	void applyVolumeOperator(double t, double* yinput, double* rhs);
-	void regionApplyVolumeOperatorConstant(int regionID, double t, double* yinput, double* rhs);
-	void regionApplyVolumeOperatorVariable(int regionID, double t, double* yinput, double* rhs);
 	void applyMembraneDiffusionReactionOperator(double t, double* yinput, double* rhs);
 	void applyMembraneFluxOperator(double t, double* yinput, double* rhs);
 	void applyVolumeRegionReactionOperator(double t, double* yinput, double* rhs);
@@ -181,11 +188,70 @@ private:
 	void initSundialsSolver();
 	void solve();
 
-	double *statePointValues, **neighborStatePointValues;
+	// the arrays the RHS works in (state values, workspaces, rates, gradients) are carved out of
+	// scratch at the start, only the COMPARE_WITH_OLD buffers are carved (and released) per RHS
+	ScratchArena scratch;
+	long numRhsEvaluations;
+
+	double *statePointValues;
 	void updateVolumeStatePointValues(int volIndex, double t, double* yinput, double* values);
 	void updateMembraneStatePointValues(MembraneElement& me, double t, double* yinput, double* values);
 	void updateRegionStatePointValues(int regionID, double t, double* yinput, bool bVolumeRegion, double* values);
 
+	// scratch of one thread evaluating expressions in batches, state values of a block of points
+	// are stored by column (see Expression::evaluateBatch)
+	struct RhsWorkspace {
+		double* statePointValues;
+		double* batchValues;
+		double** batchColumns;
+		double* batchRates; // one block of results per variable
+		int* batchIndexes;
+		int* batchPointSlots; // column of each point in the block
+		double** batchRateRows; // output k of a reaction program goes to batchRateRows[k]
+		double* programWorkspace; // large enough for every reaction program
+		double* neighborStatePointValues[3]; // XP, YP, ZP neighbors, regions with variable coefficients
+		double txyzValues[4];
+	};
+	int valueArraySize;
+	int numRhsWorkspaces;
+	RhsWorkspace* rhsWorkspaces; // one per thread, the first one is also used by the serial operators
+	void loadVolumeBatch(RhsWorkspace& workspace, int numPoints, int* volIndexes, double t, double* yinput);
+	void loadMembraneBatch(RhsWorkspace& workspace, int numPoints, int* memIndexes, double t, double* yinput);
+
+	// the expression evaluation of the RHS runs on all threads before the operators assemble it,
+	// in blocks of RHS_BATCH_SIZE volume points (of one region) or membrane elements
+	double* reactionRates; // reaction rate of each volume and membrane unknown
+	double* membraneFluxes; // jump condition of each volume variable at each membrane element
+	// diffusion rate and velocity components of each diffusing volume unknown of the regions with variable
+	// coefficients, except diffusion rates that are constant or precomputed in diffCoeffs
+	double* diffusionRates;
+	double* velocities[3];
+	vector<int> rateBlockRegions; // region of each volume block, -1 for membrane blocks
+	vector<int> rateBlockStarts;
+	typedef void (SundialsPdeScheduler::*RhsBlockFunction)(RhsWorkspace& workspace, int block, double t, double* yinput, double* rhs);
+	void runRhsBlocks(RhsBlockFunction function, int numBlocks, double t, double* yinput, double* rhs);
+	void computeReactionRateBlock(RhsWorkspace& workspace, int block, double t, double* yinput, double* rhs);
+	void computeMembraneFluxBlock(RhsWorkspace& workspace, int block, double t, double* yinput, double* rhs);
+	void computeRegionReactionRates(RhsWorkspace& workspace, int regionID, int regionPointStart, double t, double* yinput);
+	void scatterRegionBatch(int regionID, int regionPointStart, int numPoints, int activeVarCount, int* batchPointSlots, double* batchResults, double* values);
+	void computeMembraneReactionRates(RhsWorkspace& workspace, int memIndexStart, double t, double* yinput);
+
+	// the operators then assemble the RHS by region on all threads: a region only writes the
+	// entries of its own unknowns (its stencil neighbors are in the region)
+	void regionApplyVolumeOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs);
+	void regionApplyVolumeOperatorConstant(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs);
+	void regionApplyVolumeOperatorVariable(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs);
+	void regionApplyVolumeRegionReactionOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs);
+	void regionApplyMembraneRegionReactionOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs);
+
+	// reaction rates of all the variables of a volume region (or a membrane) as one program,
+	// regions with the same feature and variables share it; 0 if some rate cannot be fused
+	vector<VCell::FusedExpressionProgram*> reactionPrograms;
+	VCell::FusedExpressionProgram** regionReactionPrograms;
+	VCell::FusedExpressionProgram** membraneReactionPrograms;
+	void buildReactionPrograms();
+	void deleteReactionPrograms();
+
 	void updateSolutions();
 
 	double* discontinuityTimes;
@@ -194,9 +260,7 @@ private:
 
 	SundialsSolverOptions sundialsSolverOptions;
 	SparseMatrixPCG* M; //
-	double* pcg_workspace;
-	long nsp; // size of ISP and RSP
-	bool bPcReinit;
+	SparseILUPreconditioner* preconditioner;
 
 	void preallocateM();
 	void buildM_Volume(double t, double* yinput, double gamma);
@@ -207,20 +271,36 @@ private:
 	int getVolumeRegionVectorOffset(int regionID);
 	int getMembraneRegionVectorOffset(int regionID);
 
-	bool bLUcomputed;
 	double oldGamma;
+	double factorGamma; // gamma of the factored M
 	double currentTime;
 	bool bSundialsOneStepOutput;
 
 	bool bHasVariableDiffusionAdvection, bHasAdvection;
 
-	double txyzValues[4];
-	void dirichletPointSetup(int volIndex, Feature* feature, VarContext* varContext, int mask, int* volumeNeighbors, double& ypoint);
-	double computeNeumannCondition(Feature* feature, VarContext* varContext, int mask, double* scaleSs);
+	void dirichletPointSetup(int volIndex, Feature* feature, VarContext* varContext, int mask, int* volumeNeighbors, double* values, double& ypoint);
+	double computeNeumannCondition(Feature* feature, VarContext* varContext, int mask, double* scaleSs, double* values);
 
 	double* diffCoeffs;
 	void precomputeDiffusionCoefficients();
 
+	// what the volume operators need of each point of a region, compiled once and stored by
+	// column: entry i of each array belongs to the i-th point of the region
+	struct VolumeStencil {
+		vector<int> volIndexes;
+		vector<int> masks;
+		vector<unsigned char> bBoundary; // boundary conditions apply to the point or to a neighbor
+		vector<int> neighborVectorOffsets[3]; // first unknown of the XP, YP, ZP neighbor, -1 if none
+		vector<double> fluxScales[3]; // cross section scale over h
+		// by defined variable
+		vector<VolumeVariable*> vars;
+		vector<VolumeVarContextExpression*> varContexts;
+		vector<double> diffusionRates; // constant coefficient regions
+		vector<double> advectTerms; // Aii and Aij along X, Y, Z, constant coefficient regions
+	};
+	VolumeStencil* volumeStencils;
+	void buildVolumeStencils();
+
 	double* rhsGradients;
 	bool bHasGradient;
 };
@@ -5,11 +5,19 @@
 #ifndef SUNDIALSSOLVEROPTIONS_H
 #define SUNDIALSSOLVEROPTIONS_H
 
+// preconditioner of the Krylov iterations of the PDE solver
+enum SundialsPreconditionerType {
+	SUNDIALS_PRECONDITIONER_ILU,			// ILU(k) of the whole matrix
+	SUNDIALS_PRECONDITIONER_BLOCK_JACOBI	// ILU(k) of each region independently
+};
+
 struct SundialsSolverOptions {
 	double relTol, absTol;
 	double maxStep;
 	int maxOrderAdvection;
 	bool borderExtrapolationDisable;
+	SundialsPreconditionerType preconditioner;
+	int preconditionerFillLevel;
 
 	SundialsSolverOptions() {
 		relTol = 1e-7;
@@ -17,6 +25,8 @@ struct SundialsSolverOptions {
 		maxStep = 0.1;
 		maxOrderAdvection = 2;
 		borderExtrapolationDisable = false;
+		preconditioner = SUNDIALS_PRECONDITIONER_ILU;
+		preconditionerFillLevel = 0;
 	}
 };
 #endif
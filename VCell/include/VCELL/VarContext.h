@@ -36,9 +36,12 @@ class EqnBuilder;
 class SimulationExpression;
 class Membrane;
 class JumpCondition;
+class EvalContext;
 struct MembraneElement;
 namespace VCell {
 	class Expression;
+	class ExpressionCompiler;
+	class FusedExpressionProgram;
 }
 
 class VarContext {
@@ -65,11 +68,25 @@ public:
 	// exclusively for sundials pde
 	double evaluateJumpCondition(MembraneElement*, double* values);
 	double evaluateExpression(long expIndex, double* values);
+	void evaluateExpressionBatch(long expIndex, int numPoints, double** columns, double* result);
 	double evaluateConstantExpression(long expIndex);
 
 	void addJumpCondition(Membrane* membrane, VCell::Expression* exp);	
 	JumpCondition* getJumpCondition();
 	void reinitConstantValues();
+	void addExpressionsToCompiler(VCell::ExpressionCompiler* compiler);
+	// creates the stack machines of all the expressions, which threads can then share
+	void createStackMachines();
+	// adds the expression as the next output of program (as evaluateExpressionBatch computes it), false if it is not defined
+	bool addExpressionToProgram(long expIndex, VCell::FusedExpressionProgram* program);
+
+	// same as the element and region evaluations below with the indices and coordinates set in context
+	// instead of the simulation, threads evaluating with different contexts don't interfere
+	double evaluateExpression(EvalContext& context, long volIndex, long expIndex); // for volume
+	double evaluateExpression(EvalContext& context, MembraneElement* element, long expIndex); // for membrane
+	double evaluateVolumeRegionExpression(EvalContext& context, long volRegionIndex, long expIndex);
+	double evaluateMembraneRegionExpression(EvalContext& context, long memRegionIndex, long expIndex);
+	double evaluateJumpCondition(EvalContext& context, MembraneElement* element);
 
 protected:
     VarContext(Structure *s, Variable* var);
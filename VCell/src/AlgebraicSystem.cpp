@@ -88,7 +88,7 @@ void AlgebraicSystem::solveSystem()
 				diff += fabs(varIncrements[i]/x[i]);
 			}
 		}
-	} while((tolerance < diff)&&(count<100));
+	} while((tolerance < diff)&&(count<ALGEBRAIC_SYSTEM_MAX_ITERATIONS));
 	if(tolerance<diff){	
 		throw "AlgebraicSystem::solveSystem() : Iterations do not converge";
 	}
@@ -0,0 +1,344 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/ConvolutionEngine.h>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// operations per point of an FFT convolution relative to a term of the direct sums
+#define FFT_COST_FACTOR 5.0
+
+ConvolutionEngine::ConvolutionEngine(int numX, int numY, int numZ)
+{
+	this->numX = numX;
+	this->numY = numY;
+	this->numZ = numZ;
+	bSeparable = false;
+	bFFT = false;
+	for (int a = 0; a < 3; a ++) {
+		kernelStarts[a] = 0;
+		kernelSizes[a] = 1;
+		fftSizes[a] = 1;
+	}
+}
+
+/*
+ * weights[e] : the weight of displacement output - input = start + e along an axis,
+ * from the n samples centered at n/2
+ */
+void ConvolutionEngine::mirror(const double* samples, int n, bool bScatter, int& start, vector<double>& weights)
+{
+	int mid = n / 2;
+	weights.resize(n);
+	if (bScatter) {
+		start = -mid;
+		for (int e = 0; e < n; e ++) {
+			weights[e] = samples[e];
+		}
+	} else {
+		start = mid - n + 1;
+		for (int e = 0; e < n; e ++) {
+			weights[e] = samples[n - 1 - e];
+		}
+	}
+}
+
+void ConvolutionEngine::setSeparableKernel(const vector<double>& kx, const vector<double>& ky, const vector<double>& kz, bool bScatter)
+{
+	if (kx.empty() || ky.empty() || kz.empty()) {
+		throw "ConvolutionEngine : empty kernel";
+	}
+	bSeparable = true;
+	bFFT = false;
+	mirror(&kx[0], (int)kx.size(), bScatter, kernelStarts[0], kernels[0]);
+	mirror(&ky[0], (int)ky.size(), bScatter, kernelStarts[1], kernels[1]);
+	mirror(&kz[0], (int)kz.size(), bScatter, kernelStarts[2], kernels[2]);
+	for (int a = 0; a < 3; a ++) {
+		kernelSizes[a] = (int)kernels[a].size();
+	}
+	kernel.clear();
+	kernelTransform.clear();
+	fftData.clear();
+}
+
+void ConvolutionEngine::setKernel(const double* samples, int kernelNx, int kernelNy, int kernelNz, bool bScatter)
+{
+	if (kernelNx < 1 || kernelNy < 1 || kernelNz < 1) {
+		throw "ConvolutionEngine : empty kernel";
+	}
+	bSeparable = false;
+	int n[3] = {kernelNx, kernelNy, kernelNz};
+	for (int a = 0; a < 3; a ++) {
+		kernelSizes[a] = n[a];
+		kernelStarts[a] = bScatter ? -(n[a] / 2) : n[a] / 2 - n[a] + 1;
+	}
+	kernel.resize(kernelNx * kernelNy * kernelNz);
+	long numNonZeros = 0;
+	for (int ez = 0; ez < kernelNz; ez ++) {
+		int k = bScatter ? ez : kernelNz - 1 - ez;
+		for (int ey = 0; ey < kernelNy; ey ++) {
+			int j = bScatter ? ey : kernelNy - 1 - ey;
+			for (int ex = 0; ex < kernelNx; ex ++) {
+				int i = bScatter ? ex : kernelNx - 1 - ex;
+				double w = samples[(k * kernelNy + j) * kernelNx + i];
+				kernel[(ez * kernelNy + ey) * kernelNx + ex] = w;
+				if (w != 0) {
+					numNonZeros ++;
+				}
+			}
+		}
+	}
+
+	// FFT if the direct sums cost more
+	int dims[3] = {numX, numY, numZ};
+	double fftSize = 1;
+	for (int a = 0; a < 3; a ++) {
+		fftSizes[a] = 1;
+		while (fftSizes[a] < dims[a] + n[a] - 1) {
+			fftSizes[a] *= 2;
+		}
+		fftSize *= fftSizes[a];
+	}
+	double directCost = (double)numX * numY * numZ * numNonZeros;
+	double fftCost = FFT_COST_FACTOR * fftSize * std::max(1.0, log(fftSize) / log(2.0));
+	bFFT = directCost > fftCost;
+	kernelTransform.clear();
+	fftData.clear();
+	if (bFFT) {
+		initFFT();
+	}
+}
+
+void ConvolutionEngine::convolve(const double* in, double* out)
+{
+	long size = (long)numX * numY * numZ;
+	if (bSeparable) {
+		work1.resize(size);
+		work2.resize(size);
+		convolveLines(0, in, &work1[0]);
+		convolveLines(1, &work1[0], &work2[0]);
+		convolveLines(2, &work2[0], out);
+	} else if (bFFT) {
+		int px = fftSizes[0], py = fftSizes[1];
+		std::fill(fftData.begin(), fftData.end(), Complex(0, 0));
+		for (int z = 0; z < numZ; z ++) {
+			for (int y = 0; y < numY; y ++) {
+				const double* row = in + ((long)z * numY + y) * numX;
+				Complex* fftRow = &fftData[((long)z * py + y) * px];
+				for (int x = 0; x < numX; x ++) {
+					fftRow[x] = row[x];
+				}
+			}
+		}
+		transform(fftData, false);
+		long fftSize = (long)fftData.size();
+		for (long i = 0; i < fftSize; i ++) {
+			fftData[i] *= kernelTransform[i];
+		}
+		transform(fftData, true);
+		double scale = 1.0 / fftSize;
+		for (int z = 0; z < numZ; z ++) {
+			for (int y = 0; y < numY; y ++) {
+				double* row = out + ((long)z * numY + y) * numX;
+				const Complex* fftRow = &fftData[((long)z * py + y) * px];
+				for (int x = 0; x < numX; x ++) {
+					row[x] = fftRow[x].real() * scale;
+				}
+			}
+		}
+	} else {
+		convolveDirect(in, out);
+	}
+}
+
+// one dimensional convolution of every line along axis
+void ConvolutionEngine::convolveLines(int axis, const double* in, double* out)
+{
+	int n = axis == 0 ? numX : (axis == 1 ? numY : numZ);
+	long stride = axis == 0 ? 1 : (axis == 1 ? numX : (long)numX * numY);
+	long numLines = (long)numX * numY * numZ / n;
+	const double* weights = &kernels[axis][0];
+	int numWeights = (int)kernels[axis].size();
+	int start = kernelStarts[axis];
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long line = 0; line < numLines; line ++) {
+		long base;
+		if (axis == 0) {
+			base = line * numX;
+		} else if (axis == 1) {
+			base = (line / numX) * numX * numY + line % numX;
+		} else {
+			base = line;
+		}
+		const double* lineIn = in + base;
+		double* lineOut = out + base;
+		for (int t = 0; t < n; t ++) {
+			// input t - start - e inside the line
+			int eBegin = std::max(0, t - start - n + 1);
+			int eEnd = std::min(numWeights, t - start + 1);
+			double sum = 0;
+			for (int e = eBegin; e < eEnd; e ++) {
+				sum += lineIn[(t - start - e) * stride] * weights[e];
+			}
+			lineOut[t * stride] = sum;
+		}
+	}
+}
+
+void ConvolutionEngine::convolveDirect(const double* in, double* out)
+{
+	int nx = kernelSizes[0], ny = kernelSizes[1], nz = kernelSizes[2];
+	long numXY = (long)numX * numY;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (int tz = 0; tz < numZ; tz ++) {
+		double* plane = out + tz * numXY;
+		memset(plane, 0, numXY * sizeof(double));
+		for (int ez = 0; ez < nz; ez ++) {
+			int cz = tz - kernelStarts[2] - ez;
+			if (cz < 0 || cz >= numZ) {
+				continue;
+			}
+			for (int ey = 0; ey < ny; ey ++) {
+				// outputs ty whose input cy = ty - start - ey is inside
+				int dy = kernelStarts[1] + ey;
+				int tyBegin = std::max(0, dy), tyEnd = std::min(numY, numY + dy);
+				for (int ex = 0; ex < nx; ex ++) {
+					double w = kernel[(ez * ny + ey) * nx + ex];
+					if (w == 0) {
+						continue;
+					}
+					int dx = kernelStarts[0] + ex;
+					int txBegin = std::max(0, dx), txEnd = std::min(numX, numX + dx);
+					for (int ty = tyBegin; ty < tyEnd; ty ++) {
+						double* row = plane + (long)ty * numX;
+						const double* inRow = in + cz * numXY + (long)(ty - dy) * numX - dx;
+						for (int tx = txBegin; tx < txEnd; tx ++) {
+							row[tx] += w * inRow[tx];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void ConvolutionEngine::initFFT()
+{
+	const double pi = 3.14159265358979323846;
+	for (int a = 0; a < 3; a ++) {
+		int p = fftSizes[a];
+		twiddles[a].resize(p / 2);
+		for (int k = 0; k < p / 2; k ++) {
+			twiddles[a][k] = Complex(cos(2 * pi * k / p), -sin(2 * pi * k / p));
+		}
+		bitReversals[a].resize(p);
+		int numBits = 0;
+		while ((1 << numBits) < p) {
+			numBits ++;
+		}
+		for (int i = 0; i < p; i ++) {
+			int r = 0;
+			for (int b = 0; b < numBits; b ++) {
+				if (i & (1 << b)) {
+					r |= 1 << (numBits - 1 - b);
+				}
+			}
+			bitReversals[a][i] = r;
+		}
+	}
+
+	// the kernel at displacement d is at d modulo the padded size
+	int px = fftSizes[0], py = fftSizes[1], pz = fftSizes[2];
+	int nx = kernelSizes[0], ny = kernelSizes[1], nz = kernelSizes[2];
+	kernelTransform.assign((long)px * py * pz, Complex(0, 0));
+	for (int ez = 0; ez < nz; ez ++) {
+		int iz = ((kernelStarts[2] + ez) % pz + pz) % pz;
+		for (int ey = 0; ey < ny; ey ++) {
+			int iy = ((kernelStarts[1] + ey) % py + py) % py;
+			for (int ex = 0; ex < nx; ex ++) {
+				int ix = ((kernelStarts[0] + ex) % px + px) % px;
+				kernelTransform[((long)iz * py + iy) * px + ix] += kernel[(ez * ny + ey) * nx + ex];
+			}
+		}
+	}
+	transform(kernelTransform, false);
+	fftData.resize(kernelTransform.size());
+}
+
+// three dimensional FFT, one axis after the other (unscaled inverse)
+void ConvolutionEngine::transform(vector<Complex>& data, bool bInverse)
+{
+	long total = (long)data.size();
+	for (int a = 0; a < 3; a ++) {
+		int p = fftSizes[a];
+		if (p == 1) {
+			continue;
+		}
+		long stride = a == 0 ? 1 : (a == 1 ? fftSizes[0] : (long)fftSizes[0] * fftSizes[1]);
+		long numLines = total / p;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+		{
+			vector<Complex> line(p);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+			for (long l = 0; l < numLines; l ++) {
+				long base = (l / stride) * stride * p + l % stride;
+				Complex* lineData = &data[base];
+				if (stride == 1) {
+					transformLine(lineData, a, bInverse);
+					continue;
+				}
+				for (int i = 0; i < p; i ++) {
+					line[i] = lineData[i * stride];
+				}
+				transformLine(&line[0], a, bInverse);
+				for (int i = 0; i < p; i ++) {
+					lineData[i * stride] = line[i];
+				}
+			}
+		}
+	}
+}
+
+// iterative radix 2 FFT
+void ConvolutionEngine::transformLine(Complex* line, int axis, bool bInverse)
+{
+	int p = fftSizes[axis];
+	const int* bitReversal = &bitReversals[axis][0];
+	const Complex* twiddle = &twiddles[axis][0];
+	for (int i = 0; i < p; i ++) {
+		int r = bitReversal[i];
+		if (r > i) {
+			std::swap(line[i], line[r]);
+		}
+	}
+	for (int len = 2; len <= p; len *= 2) {
+		int half = len / 2;
+		int step = p / len;
+		for (int i = 0; i < p; i += len) {
+			for (int j = 0; j < half; j ++) {
+				Complex w = bInverse ? conj(twiddle[j * step]) : twiddle[j * step];
+				Complex u = line[i + j];
+				Complex v = line[i + j + half] * w;
+				line[i + j] = u + v;
+				line[i + j + half] = u - v;
+			}
+		}
+	}
+}
@@ -5,9 +5,30 @@
 #include <VCELL/Variable.h>
 #include <VCELL/Mesh.h>
 #include <VCELL/EqnBuilder.h>
+#include <VCELL/SimTool.h>
+#include <VCELL/SimulationExpression.h>
 
 EqnBuilder::EqnBuilder(Variable *Avar, Mesh *Amesh)
 {
 	var     = Avar;
 	mesh    = Amesh;
 }
+
+void EqnBuilder::buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
+{
+	throw "EqnBuilder::buildEquation(EvalContext&) : not a slab builder";
+}
+
+double EqnBuilder::getAdvancedTime()
+{
+	Simulation* sim = SimTool::getInstance()->getSimulation();
+	sim->advanceTimeOn();
+	double time = sim->getTime_sec();
+	sim->advanceTimeOff();
+	return time;
+}
+
+void EqnBuilder::initEvalContext(EvalContext& context)
+{
+	((SimulationExpression*)SimTool::getInstance()->getSimulation())->initEvalContext(context);
+}
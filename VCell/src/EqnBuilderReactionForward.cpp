@@ -11,6 +11,7 @@
 #include <VCELL/EqnBuilderReactionForward.h>
 #include <VCELL/SimTool.h>
 #include <VCELL/Element.h>
+#include <EvalContext.h>
 
 EqnBuilderReactionForward::EqnBuilderReactionForward(VolumeVariable *Avar, Mesh *Amesh, ODESolver *Asolver)
 : EqnBuilder(Avar,Amesh)
@@ -21,11 +22,19 @@ EqnBuilderReactionForward::EqnBuilderReactionForward(VolumeVariable *Avar, Mesh
 void EqnBuilderReactionForward::buildEquation(double deltaTime, 
                             int volumeIndexStart, int volumeIndexSize, 
 			    int membraneIndexStart, int membraneIndexSize)
+{
+	EvalContext context;
+	initEvalContext(context);
+	buildEquation(context, deltaTime, volumeIndexStart, volumeIndexSize, membraneIndexStart, membraneIndexSize);
+}
+
+void EqnBuilderReactionForward::buildEquation(EvalContext& context, double deltaTime, 
+                            int volumeIndexStart, int volumeIndexSize, 
+			    int membraneIndexStart, int membraneIndexSize)
 {
 	Feature *feature;
 	VolumeVarContextExpression *varContext;
 
-	Simulation *sim = SimTool::getInstance()->getSimulation();
 	long arraySize = odeSolver->getArraySize();
 	if(arraySize==0){
 		ASSERTION((volumeIndexStart>=0) && ((volumeIndexStart+volumeIndexSize)<=mesh->getNumVolumeElements()));
@@ -42,27 +51,25 @@ void EqnBuilderReactionForward::buildEquation(double deltaTime,
 
 			varContext = feature->getVolumeVarContext((VolumeVariable*)var);
 
-		// sim->advanceTimeOn();
-			*pRate = varContext->getReactionRate(volIndex);
-		// sim->advanceTimeOff();
+			*pRate = varContext->evaluateExpression(context, volIndex, REACT_RATE_EXP);
 
 			pVolumeElement++;
 			pRate++;
 		} // end volIndex
 	}else if(arraySize>0){
 		ASSERTION(arraySize<=mesh->getNumVolumeElements());
+		// the solve regions' elements in the range
 		for(long i=0; i<arraySize; i++){
 			long index = odeSolver->getGlobalIndex(i);
+			if (index < volumeIndexStart || index >= volumeIndexStart + volumeIndexSize) {
+				continue;
+			}
 			double *pRate = odeSolver->getRates() + index;
 			VolumeElement *pVolumeElement = mesh->getVolumeElements() + index;
 			ASSERTION(pVolumeElement);
 			varContext = (pVolumeElement->getFeature())->getVolumeVarContext((VolumeVariable*)var);
 
-			// sim->advanceTimeOn();
-			*pRate = varContext->getReactionRate(index);
-			// sim->advanceTimeOff();
-
+			*pRate = varContext->evaluateExpression(context, index, REACT_RATE_EXP);
 		}
 	}
 }
-
@@ -21,6 +21,9 @@
 #include <VCELL/DataGenerator.h>
 #include <VCELL/VolumeParticleVariable.h>
 #include <VCELL/MembraneParticleVariable.h>
+#include <VCELL/ConvolutionEngine.h>
+#include <algorithm>
+#include <memory>
 using std::endl;
 
 #define CONVOLVE_SUFFIX "_Convolved"
@@ -100,6 +103,22 @@ static string extractVarNameFromQualifiedName(char* varName) {
 	return str;
 }
 
+Variable* FVDataSet::findVariable(Simulation *sim, const char *varName, int size)
+{
+	string name = extractVarNameFromQualifiedName((char*)varName);
+	Variable *var = sim->getVariableFromName(name);
+	if (var==NULL){
+		cout << "DataSet::read() - variable '" << varName << "' not found in Simulation" << endl;
+		return NULL;
+	}
+	if (var->getSize()!=size){
+		char errmsg[512];
+		sprintf(errmsg, "DataSet::read() - size mismatch for var '%s', file=%d, var=%ld.", varName, size, var->getSize());
+		throw errmsg;
+	}
+	return var;
+}
+
 void FVDataSet::read(const char *filename, Simulation *sim)
 {
 	FILE *fp=NULL;
@@ -135,17 +154,10 @@ void FVDataSet::read(const char *filename, Simulation *sim)
 	}
 
 	for (int i=0;i<fileHeader.numBlocks;i++){
-		string varName = extractVarNameFromQualifiedName(dataBlock[i].varName);
-		Variable *var = sim->getVariableFromName(varName);
+		Variable *var = findVariable(sim, dataBlock[i].varName, dataBlock[i].size);
 		if (var==NULL){
-			cout << "DataSet::read() - variable '" << dataBlock[i].varName << "' not found in Simulation" << endl;
 			continue;
 		}
-		if (var->getSize()!=dataBlock[i].size){
-			char errmsg[512];
-			sprintf(errmsg, "DataSet::read() - size mismatch for var '%s', file=%d, var=%ld.", dataBlock[i].varName, dataBlock[i].size, var->getSize());
-			throw errmsg;
-		}
 	      
 		if (fseek(fp, dataBlock[i].dataOffset, SEEK_SET)){
 			char errmsg[512];
@@ -162,6 +174,17 @@ void FVDataSet::read(const char *filename, Simulation *sim)
 }
 
 void FVDataSet::convolve(Simulation* sim, Variable* var, double* values) {
+	/*
+	 * the psf convolutions, set up for the psf samples and mesh of the last call and freed at exit;
+	 * the volume loops took the psf around each output element, the membrane loops
+	 * spread it around each membrane's volume elements
+	 */
+	static vector<double> convolutionPsf;
+	static int convolutionPsfSize[3] = {0, 0, 0};
+	static int convolutionMeshSize[3] = {0, 0, 0};
+	static std::unique_ptr<ConvolutionEngine> volumeConvolution;
+	static std::unique_ptr<ConvolutionEngine> membraneConvolution;
+	static vector<double> convolutionSourceValues;
 
 	FieldData* psfFieldData = getPSFFieldData();
 	if (psfFieldData == 0) {
@@ -174,52 +197,45 @@ void FVDataSet::convolve(Simulation* sim, Variable* var, double* values) {
 	int meshY = mesh->getNumVolumeY();
 	int meshZ = mesh->getNumVolumeZ();
 	int meshXY = meshX * meshY;
+	int meshXYZ = meshXY * meshZ;
+
+	// a psf is compared by its samples, another one may be loaded at the address of a freed one
+	double* psf = psfFieldData->getData();
+	int psfSize[3] = {psfFieldData->getSizeX(), psfFieldData->getSizeY(), psfFieldData->getSizeZ()};
+	int psfLength = psfSize[0] * psfSize[1] * psfSize[2];
+	bool bSamePsf = psfSize[0] == convolutionPsfSize[0] && psfSize[1] == convolutionPsfSize[1] && psfSize[2] == convolutionPsfSize[2]
+		&& std::equal(psf, psf + psfLength, convolutionPsf.begin());
+	if (!bSamePsf || meshX != convolutionMeshSize[0] || meshY != convolutionMeshSize[1] || meshZ != convolutionMeshSize[2]) {
+		volumeConvolution.reset(new ConvolutionEngine(meshX, meshY, meshZ));
+		volumeConvolution->setKernel(psf, psfSize[0], psfSize[1], psfSize[2], false);
+		membraneConvolution.reset(new ConvolutionEngine(meshX, meshY, meshZ));
+		membraneConvolution->setKernel(psf, psfSize[0], psfSize[1], psfSize[2], true);
+		convolutionPsf.assign(psf, psf + psfLength);
+		convolutionPsfSize[0] = psfSize[0];
+		convolutionPsfSize[1] = psfSize[1];
+		convolutionPsfSize[2] = psfSize[2];
+		convolutionMeshSize[0] = meshX;
+		convolutionMeshSize[1] = meshY;
+		convolutionMeshSize[2] = meshZ;
+		convolutionSourceValues.resize(meshXYZ);
+	}
 
-	int psfX = psfFieldData->getSizeX();
-	int psfY = psfFieldData->getSizeY();
-	int psfZ = psfFieldData->getSizeZ();
-	int psfZOffset = -psfZ/2;
-	int psfYOffset = -psfY/2;
-	int psfXOffset = -psfX/2;
-
-	double* psfData = psfFieldData->getData();
-	memset(values, 0, meshX * meshY * meshZ * sizeof(double));
-
-	if (var->getVarType() == VAR_VOLUME || var->getVarType() == VAR_VOLUME_REGION) {
-		for (int z = 0; z < meshZ; z ++) {
-			for (int y = 0; y < meshY; y ++) {
-				for (int x = 0; x < meshX; x ++) {
-					int volIndex = z * meshXY + y * meshX + x;
-					int psfindex = 0;
-					for (int zz = 0; zz < psfZ; zz ++) {						
-						for (int yy = 0; yy < psfY; yy ++) {
-							for (int xx = 0; xx < psfX; xx ++) {
-								int volIndex2X = x + psfXOffset + xx;
-								int volIndex2Y = y + psfYOffset + yy;
-								int volIndex2Z = z + psfZOffset + zz;
-								double psf_val = psfData[psfindex ++];
-
-								if (volIndex2X >= 0 && volIndex2Y >= 0 
-										&& volIndex2Z >= 0 && volIndex2X < meshX && volIndex2Y < meshY && volIndex2Z < meshZ) {
-									int volIndex2 = volIndex2Z * meshXY + volIndex2Y * meshX + volIndex2X;	
-									if (var->getVarType() == VAR_VOLUME_REGION) {
-										values[volIndex] += var->getCurr()[mesh->getVolumeElements()[volIndex2].getRegionIndex()] * psf_val;
-									} else {
-										values[volIndex] += var->getCurr()[volIndex2] * psf_val;
-									}
-								}
-							}
-						}
-					}
-				}
-			}
+	double* sourceValues = &convolutionSourceValues[0];
+	memset(values, 0, meshXYZ * sizeof(double));
+
+	if (var->getVarType() == VAR_VOLUME) {
+		volumeConvolution->convolve(var->getCurr(), values);
+	} else if (var->getVarType() == VAR_VOLUME_REGION) {
+		for (int volIndex = 0; volIndex < meshXYZ; volIndex ++) {
+			sourceValues[volIndex] = var->getCurr()[mesh->getVolumeElements()[volIndex].getRegionIndex()];
 		}
-	} else if (var->getVarType() == VAR_MEMBRANE || var->getVarType() == VAR_MEMBRANE_REGION) {				
+		volumeConvolution->convolve(sourceValues, values);
+	} else if (var->getVarType() == VAR_MEMBRANE || var->getVarType() == VAR_MEMBRANE_REGION) {
+		// half of each membrane value goes to each of its volume elements
+		memset(sourceValues, 0, meshXYZ * sizeof(double));
 		for (int m = 0; m < mesh->getNumMembraneElements(); m++) {
 			int insideVolIndex = mesh->getMembraneElements()[m].vindexFeatureLo;
 			int outsideVolIndex = mesh->getMembraneElements()[m].vindexFeatureHi;
-			MeshCoord insideMC = mesh->getMeshCoord(insideVolIndex);
-			MeshCoord outsideMC = mesh->getMeshCoord(outsideVolIndex);
 			double fullArea = mesh->getXArea_squm();
 			int diffVolIndex = abs(outsideVolIndex - insideVolIndex);
 			if (diffVolIndex  == meshX) {
@@ -229,63 +245,41 @@ void FVDataSet::convolve(Simulation* sim, Variable* var, double* values) {
 			}
 
 			double memareaRatio = mesh->getMembraneElements()[m].area/fullArea;
-			int psfindex = 0;
-			for (int zz = 0; zz < psfZ; zz ++) {								
-				for (int yy = 0; yy < psfY; yy ++) {									
-					for (int xx = 0; xx < psfX; xx ++) {
-						double psf_val = psfData[psfindex ++];
-
-						// inside
-						int volIndex2X = insideMC.x + psfXOffset + xx;
-						int volIndex2Y = insideMC.y + psfYOffset + yy;
-						int volIndex2Z = insideMC.z + psfZOffset + zz;
-						if (volIndex2X >= 0 && volIndex2Y >= 0 && volIndex2Z >= 0 && volIndex2X < meshX && volIndex2Y < meshY && volIndex2Z < meshZ) {
-							int volIndex2 = volIndex2Z * meshXY + volIndex2Y * meshX + volIndex2X;
-							if (var->getVarType() == VAR_MEMBRANE_REGION) {
-								values[volIndex2] += var->getCurr()[mesh->getMembraneElements()[m].getRegionIndex()] * psf_val/2 * memareaRatio;
-							} else {
-								values[volIndex2] += var->getCurr()[m] * psf_val/2 * memareaRatio;
-							}
-						}
-
-						// outside
-						volIndex2X = outsideMC.x + psfXOffset + xx;
-						volIndex2Y = outsideMC.y + psfYOffset + yy;
-						volIndex2Z = outsideMC.z + psfZOffset + zz;
-						if (volIndex2X >= 0 && volIndex2Y >= 0 && volIndex2Z >= 0 && volIndex2X < meshX && volIndex2Y < meshY && volIndex2Z < meshZ) {
-							int volIndex2 = volIndex2Z * meshXY + volIndex2Y * meshX + volIndex2X;
-							if (var->getVarType() == VAR_MEMBRANE_REGION) {
-								values[volIndex2] += var->getCurr()[mesh->getMembraneElements()[m].getRegionIndex()] * psf_val/2 * memareaRatio;
-							} else {
-								values[volIndex2] += var->getCurr()[m] * psf_val/2 * memareaRatio;
-							}
-						}
-					}						
-				}
+			double value;
+			if (var->getVarType() == VAR_MEMBRANE_REGION) {
+				value = var->getCurr()[mesh->getMembraneElements()[m].getRegionIndex()];
+			} else {
+				value = var->getCurr()[m];
 			}
+			sourceValues[insideVolIndex] += value/2 * memareaRatio;
+			sourceValues[outsideVolIndex] += value/2 * memareaRatio;
 		}
-	}			
+		membraneConvolution->convolve(sourceValues, values);
+	}
 }
 
 void FVDataSet::write(const char *filename, SimulationExpression *sim, bool bCompress)
 {
-	FILE *fp=NULL;
-	FileHeader fileHeader;
-	DataBlock *dataBlock;
-	static double *writeBuffer = NULL;
-
-	if (writeBuffer==NULL){
-		writeBuffer = new double[sim->getMesh()->getNumVolumeElements()];
-	}
-
-	if ((fp=fopen(filename, "wb"))==NULL){
-		char errmsg[512];
-		sprintf(errmsg, "DataSet::write() - could not open file '%s'.", filename); 
-		throw errmsg;
-	}
+	FVDataSetSnapshot dataSetSnapshot;
+	snapshot(sim, dataSetSnapshot);
+	write(filename, dataSetSnapshot, bCompress);
+}
 
-	rewind(fp);
+static void addDataBlock(FVDataSetSnapshot& snapshot, const string& varName, int varType, int size)
+{
+	DataBlock dataBlock;
+	memset(dataBlock.varName, 0, DATABLOCK_STRING_SIZE * sizeof(char));
+	strcpy(dataBlock.varName, varName.c_str());
+	dataBlock.varType = varType;
+	dataBlock.size = size;
+	dataBlock.dataOffset = (int32)(snapshot.fileHeader.firstBlockOffset + snapshot.fileHeader.numBlocks * sizeof(DataBlock)
+		+ snapshot.data.size() * sizeof(double));
+	snapshot.dataBlocks.push_back(dataBlock);
+}
 
+void FVDataSet::snapshot(SimulationExpression *sim, FVDataSetSnapshot& snapshot)
+{
+	FileHeader& fileHeader = snapshot.fileHeader;
 	strcpy(fileHeader.magicString, MAGIC_STRING);
 	strcpy(fileHeader.versionString, VERSION_STRING);
 	int numVars = sim->getNumVariables();
@@ -311,103 +305,18 @@ void FVDataSet::write(const char *filename, SimulationExpression *sim, bool bCom
 	fileHeader.numBlocks = numBlocks;
 	fileHeader.firstBlockOffset = sizeof(FileHeader);
 
-	//
-	// write file header
-	//   
-	DataSet::writeHeader(fp, &fileHeader);
-	long ftell_pos = ftell(fp);
-	if (ftell_pos != fileHeader.firstBlockOffset){
-		char errmsg[512];
-		sprintf(errmsg, "DataSet::write() - file offset for first block is incorrect, ftell() says %ld, should be %d", ftell_pos, fileHeader.firstBlockOffset);
-		throw errmsg;
-	}
-   
-	dataBlock = new DataBlock[numBlocks];
-	   
-	//
-	// write data blocks (describing data)
-	//   
-	int blockIndex = 0;
-	int32 dataOffset = fileHeader.firstBlockOffset + numBlocks * sizeof(DataBlock);
-	for (int i = 0; i < numVars; i ++) {
-		Variable* var = sim->getVariable(i);
-		memset(dataBlock[blockIndex].varName, 0, DATABLOCK_STRING_SIZE * sizeof(char));
-		strcpy(dataBlock[blockIndex].varName, var->getQualifiedName().c_str());
-		
-		dataBlock[blockIndex].varType = var->getVarType();
-		dataBlock[blockIndex].size = var->getSize();
-		dataBlock[blockIndex].dataOffset = dataOffset;
-		DataSet::writeDataBlock(fp,dataBlock+blockIndex);
-		dataOffset += dataBlock[blockIndex].size*sizeof(double);
-		blockIndex ++;
-	}
-
-	// write data blocks for _Convolved variables
-	if (psfFieldData != 0) {
-		for (int i = 0; i < numVars; i ++) {
-			Variable* var = sim->getVariable(i);			
-			string varz_name = var->getQualifiedName() + CONVOLVE_SUFFIX;
-			memset(dataBlock[blockIndex].varName, 0, DATABLOCK_STRING_SIZE * sizeof(char));
-			strcpy(dataBlock[blockIndex].varName, varz_name.c_str());
-	       
-			dataBlock[blockIndex].varType = VAR_VOLUME;
-			dataBlock[blockIndex].size = volVarSize;
-			dataBlock[blockIndex].dataOffset = dataOffset;
-			DataSet::writeDataBlock(fp,dataBlock + blockIndex);
-			dataOffset += dataBlock[blockIndex].size*sizeof(double);
-			blockIndex ++;
-		}
-	}
-
-	// region size variable
-	for (int i = 0; i < numRegionSizeVars; i ++) {
-		RegionSizeVariable* rsv = sim->getRegionSizeVariable(i);			
-		memset(dataBlock[blockIndex].varName, 0, DATABLOCK_STRING_SIZE * sizeof(char));
-		strcpy(dataBlock[blockIndex].varName, rsv->getQualifiedName().c_str());
-	
-		dataBlock[blockIndex].varType = rsv->getVarType();
-		dataBlock[blockIndex].size = rsv->getSize();
-		dataBlock[blockIndex].dataOffset = dataOffset;
-		DataSet::writeDataBlock(fp,dataBlock + blockIndex);
-		dataOffset += dataBlock[blockIndex].size*sizeof(double);
-		blockIndex ++;
-	}
-
-	
-	for (int i = 0; i < numRandVars; i ++) {
-		RandomVariable* rv = sim->getRandomVariable(i);
-		memset(dataBlock[blockIndex].varName, 0, DATABLOCK_STRING_SIZE * sizeof(char));
-		strcpy(dataBlock[blockIndex].varName, rv->getName().c_str());
-	
-		dataBlock[blockIndex].varType = rv->getVariableType();
-		dataBlock[blockIndex].size = rv->getSize();
-		dataBlock[blockIndex].dataOffset = dataOffset;
-		DataSet::writeDataBlock(fp,dataBlock + blockIndex);
-		dataOffset += dataBlock[blockIndex].size*sizeof(double);
-		blockIndex ++;
-	}
+	snapshot.dataBlocks.clear();
+	snapshot.data.clear();
 
 	//
-	// write data
+	// copy data
 	//
-	blockIndex = 0;
 	for (int i = 0; i < numVars; i ++) {
 		Variable* var = sim->getVariable(i);
 		if (!var){
-			char errmsg[512];
-			sprintf(errmsg, "DataSet::write() - variable '%s' not found during write", dataBlock[blockIndex].varName);
-			throw errmsg;
-		}
-		ftell_pos = ftell(fp);
-		if (ftell_pos != dataBlock[blockIndex].dataOffset){
-			char errmsg[512];
-			sprintf(errmsg, "DataSet::write() - offset for data is incorrect (block %d, var=%s), ftell() says %ld, should be %d", blockIndex, dataBlock[blockIndex].varName, ftell_pos, dataBlock[blockIndex].dataOffset);
-			throw errmsg;
-		}
-
-		if (var->getSize() != dataBlock[blockIndex].size) {
-			throw "DataSet::write() : inconsistent number of data blocks for variable";
+			throw "DataSet::write() - variable not found during write";
 		}
+		addDataBlock(snapshot, var->getQualifiedName(), var->getVarType(), var->getSize());
 
 		double* dataVal = 0;
 		if(var->getVarType() == VAR_VOLUME_PARTICLE){
@@ -419,79 +328,89 @@ void FVDataSet::write(const char *filename, SimulationExpression *sim, bool bCom
 		}else{
 			dataVal = var->getCurr();
 		}
-		
-		DataSet::writeDoubles(fp, dataVal, var->getSize());
-		blockIndex ++;
+		snapshot.data.insert(snapshot.data.end(), dataVal, dataVal + var->getSize());
 	}
 	
 	//
-	// write data for _Convolved variables
+	// copy data for _Convolved variables
 	//
 	if (psfFieldData != 0) {
-		double* values = new double[volVarSize];
-
 		for (int i = 0; i < numVars; i ++) {
 			Variable* var = sim->getVariable(i);
-			convolve(sim, var, values);
-
-			ftell_pos = ftell(fp);
-			if (ftell_pos != dataBlock[blockIndex].dataOffset){
-				char errmsg[512];
-				sprintf(errmsg, "DataSet::write() - offset for data is "
-					"incorrect (block %d, var=%s), ftell() says %ld, should be %d",
-					blockIndex, dataBlock[blockIndex].varName, ftell_pos, dataBlock[blockIndex].dataOffset);
-				throw errmsg;
-			}
-			if (volVarSize != dataBlock[blockIndex].size) {
-				throw "DataSet::write() : inconsistent number of data blocks for variable";
-			}
+			addDataBlock(snapshot, var->getQualifiedName() + CONVOLVE_SUFFIX, VAR_VOLUME, volVarSize);
 
-			DataSet::writeDoubles(fp, values, volVarSize);
-			blockIndex ++;
+			size_t start = snapshot.data.size();
+			snapshot.data.resize(start + volVarSize);
+			convolve(sim, var, &snapshot.data[start]);
 		}	
 	}
 
 	//
-	// write data for region size variables
+	// copy data for region size variables
 	//	
 	for (int i = 0; i < numRegionSizeVars; i ++) {
 		RegionSizeVariable* rsv = sim->getRegionSizeVariable(i);
-		ftell_pos = ftell(fp);
-		if (ftell_pos != dataBlock[blockIndex].dataOffset){
-			char errmsg[512];
-			sprintf(errmsg, "DataSet::write() - offset for data is "
-				"incorrect (block %d, var=%s), ftell() says %ld, should be %d",
-				blockIndex, dataBlock[blockIndex].varName, ftell_pos, dataBlock[blockIndex].dataOffset);
-			throw errmsg;
-		}
-
-		if (rsv->getSize() != dataBlock[blockIndex].size) {
-			throw "DataSet::write() : inconsistent number of data blocks for variable";
-		}
-		DataSet::writeDoubles(fp, rsv->getCurr(), rsv->getSize());
-		blockIndex ++;
+		addDataBlock(snapshot, rsv->getQualifiedName(), rsv->getVarType(), rsv->getSize());
+		snapshot.data.insert(snapshot.data.end(), rsv->getCurr(), rsv->getCurr() + rsv->getSize());
 	}
 
 	//
-	// write data for random variables
+	// copy data for random variables
 	//	
 	for (int i = 0; i < numRandVars; i ++) {
-		RandomVariable* rv = sim->getRandomVariable(i);						
+		RandomVariable* rv = sim->getRandomVariable(i);
+		addDataBlock(snapshot, rv->getName(), rv->getVariableType(), rv->getSize());
+		snapshot.data.insert(snapshot.data.end(), rv->getRandomNumbers(), rv->getRandomNumbers() + rv->getSize());
+	}	
+}
+
+void FVDataSet::write(const char *filename, FVDataSetSnapshot& snapshot, bool bCompress)
+{
+	FILE *fp=NULL;
+
+	if ((fp=fopen(filename, "wb"))==NULL){
+		char errmsg[512];
+		sprintf(errmsg, "DataSet::write() - could not open file '%s'.", filename); 
+		throw errmsg;
+	}
+
+	rewind(fp);
+
+	//
+	// write file header
+	//   
+	FileHeader& fileHeader = snapshot.fileHeader;
+	DataSet::writeHeader(fp, &fileHeader);
+	long ftell_pos = ftell(fp);
+	if (ftell_pos != fileHeader.firstBlockOffset){
+		char errmsg[512];
+		sprintf(errmsg, "DataSet::write() - file offset for first block is incorrect, ftell() says %ld, should be %d", ftell_pos, fileHeader.firstBlockOffset);
+		throw errmsg;
+	}
+	   
+	//
+	// write data blocks (describing data)
+	//   
+	int numBlocks = (int)snapshot.dataBlocks.size();
+	for (int blockIndex = 0; blockIndex < numBlocks; blockIndex ++) {
+		DataSet::writeDataBlock(fp, &snapshot.dataBlocks[blockIndex]);
+	}
+
+	//
+	// write data
+	//
+	double* data = snapshot.data.empty() ? 0 : &snapshot.data[0];
+	for (int blockIndex = 0; blockIndex < numBlocks; blockIndex ++) {
+		DataBlock& dataBlock = snapshot.dataBlocks[blockIndex];
 		ftell_pos = ftell(fp);
-		if (ftell_pos != dataBlock[blockIndex].dataOffset){
+		if (ftell_pos != dataBlock.dataOffset){
 			char errmsg[512];
-			sprintf(errmsg, "DataSet::write() - offset for data is "
-				"incorrect (block %d, var=%s), ftell() says %ld, should be %d",
-				blockIndex, dataBlock[blockIndex].varName, ftell_pos, dataBlock[blockIndex].dataOffset);
+			sprintf(errmsg, "DataSet::write() - offset for data is incorrect (block %d, var=%s), ftell() says %ld, should be %d", blockIndex, dataBlock.varName, ftell_pos, dataBlock.dataOffset);
 			throw errmsg;
 		}
-
-		if (rv->getSize() != dataBlock[blockIndex].size) {
-			throw "DataSet::write() : inconsistent number of data blocks for variable";
-		}
-		DataSet::writeDoubles(fp, rv->getRandomNumbers(), rv->getSize());
-		blockIndex ++;
-	}	
+		DataSet::writeDoubles(fp, data, dataBlock.size);
+		data += dataBlock.size;
+	}
 
 	fclose(fp);
 	if (bCompress){
@@ -499,6 +418,4 @@ void FVDataSet::write(const char *filename, SimulationExpression *sim, bool bCom
 		sprintf(commandBuffer,"compress %s",filename);
 		system(commandBuffer);
 	}
-
-	delete[] dataBlock;
 }
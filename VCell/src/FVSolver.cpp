@@ -1038,7 +1038,7 @@ void FVSolver::loadSimulationParameters(istream& ifsInput) {
 				for (std::string s; lineInput >> s;) {
 					result.push_back(s);
 				}
-				SundialsSolverOptions sso;
+				SundialsSolverOptions sso = simTool->getSundialsSolverOptions();
 				sso.relTol = std::atof(result[0].data());
 				sso.absTol = std::atof(result[1].data());
 				sso.maxStep= std::atof(result[2].data());
@@ -1123,6 +1123,88 @@ void FVSolver::loadSimulationParameters(istream& ifsInput) {
 			int keep_at_most;
 			lineInput >> keep_at_most;
 			simTool->setKeepAtMost(keep_at_most);
+		} else if (nextToken == "COMPILE_EXPRESSIONS") {
+			simTool->setCompileExpressions();
+		} else if (nextToken == "OUTPUT_BUFFERS") {
+			// save points queued for the background writer, 0 to write them in the solver thread
+			int numOutputBuffers = 0;
+			lineInput >> numOutputBuffers;
+			if (numOutputBuffers < 0) {
+				throw "loadSimulationParameters(), OUTPUT_BUFFERS must not be negative";
+			}
+			simTool->setNumOutputBuffers(numOutputBuffers);
+		} else if (nextToken == "PARALLEL_SCANS") {
+			// serial parameter scans run at the same time in a local run, 0 for one per processor
+			int numParallelScans = 1;
+			lineInput >> numParallelScans;
+			if (numParallelScans < 0) {
+				throw "loadSimulationParameters(), PARALLEL_SCANS must not be negative";
+			}
+			simTool->setNumParallelScans(numParallelScans);
+		} else if (nextToken == "SLABS") {
+			// slabs of the mesh whose equations FV_SOLVER builds at once, 0 for one per thread
+			int numSlabs = 1;
+			lineInput >> numSlabs;
+			if (numSlabs < 0) {
+				throw "loadSimulationParameters(), SLABS must not be negative";
+			}
+			simTool->setNumSlabs(numSlabs);
+		} else if (nextToken == "PROFILE") {
+			// time the solver sections, HARDWARE_COUNTERS adds cycles, instructions and cache misses
+			string counters;
+			lineInput >> counters;
+			if (counters != "" && counters != "HARDWARE_COUNTERS") {
+				throw "loadSimulationParameters(), PROFILE takes nothing or HARDWARE_COUNTERS";
+			}
+			simTool->setProfile(counters == "HARDWARE_COUNTERS");
+		} else if (nextToken == "OUTPUT_FORMAT") {
+			// SIM : a .sim file per save point in zip files, HDF5 [deflate level] : all save points in one hdf5 file
+			string format;
+			int deflateLevel = 0;
+			lineInput >> format >> deflateLevel;
+			if (format == "SIM") {
+				simTool->setSimDataHdf5(false, 0);
+			} else if (format == "HDF5") {
+				if (deflateLevel < 0 || deflateLevel > 9) {
+					throw "loadSimulationParameters(), OUTPUT_FORMAT HDF5 deflate level must be 0 to 9";
+				}
+				simTool->setSimDataHdf5(true, deflateLevel);
+			} else {
+				throw "loadSimulationParameters(), OUTPUT_FORMAT must be SIM or HDF5";
+			}
+		} else if (nextToken == "LINEAR_SOLVER") {
+			// solver of the sparse systems of FV_SOLVER: PCGPAK, NATIVE, NATIVE_MULTIGRID or MULTIGRID
+			string linearSolver;
+			lineInput >> linearSolver;
+			if (linearSolver == "NATIVE") {
+				simTool->setLinearSolver(LINEAR_SOLVER_NATIVE);
+			} else if (linearSolver == "NATIVE_MULTIGRID") {
+				simTool->setLinearSolver(LINEAR_SOLVER_NATIVE_MULTIGRID);
+			} else if (linearSolver == "MULTIGRID") {
+				simTool->setLinearSolver(LINEAR_SOLVER_MULTIGRID);
+			} else if (linearSolver == "PCGPAK") {
+				simTool->setLinearSolver(LINEAR_SOLVER_PCGPAK);
+			} else {
+				throw "loadSimulationParameters(), LINEAR_SOLVER must be PCGPAK, NATIVE, NATIVE_MULTIGRID or MULTIGRID";
+			}
+		} else if (nextToken == "SUNDIALS_PRECONDITIONER") {
+			// ILU [fill level] or BLOCK_JACOBI [fill level]
+			string type;
+			int fillLevel = 0;
+			lineInput >> type >> fillLevel;
+			SundialsSolverOptions sso = simTool->getSundialsSolverOptions();
+			if (type == "ILU") {
+				sso.preconditioner = SUNDIALS_PRECONDITIONER_ILU;
+			} else if (type == "BLOCK_JACOBI") {
+				sso.preconditioner = SUNDIALS_PRECONDITIONER_BLOCK_JACOBI;
+			} else {
+				throw "loadSimulationParameters(), SUNDIALS_PRECONDITIONER must be ILU or BLOCK_JACOBI";
+			}
+			if (fillLevel < 0) {
+				throw "loadSimulationParameters(), SUNDIALS_PRECONDITIONER fill level must not be negative";
+			}
+			sso.preconditionerFillLevel = fillLevel;
+			simTool->setSundialsSolverOptions(sso);
 		} else if (nextToken == "STORE_ENABLE") {
 			int bStoreEnable=1;
 			lineInput >> bStoreEnable;
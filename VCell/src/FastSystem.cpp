@@ -4,6 +4,9 @@
  */
 #include <VCELL/FastSystem.h>
 #include <VCELL/Variable.h>
+#include <VCELL/Simulation.h>
+#include <VCELL/Mesh.h>
+#include <VCELL/DoubleVector3.h>
 #include <iostream>
 using std::cout;
 using std::endl;
@@ -34,6 +37,19 @@ void FastSystem::updateVars()
 	updateDependentVars();
 }
 
+void FastSystem::solveElements(Simulation* sim, int numElements, const long* indexes, bool bMembrane)
+{
+	Mesh* mesh = sim->getMesh();
+	for (int e = 0; e < numElements; e ++) {
+		setCurrIndex(indexes[e]);
+		WorldCoord wc = bMembrane ? mesh->getMembraneWorldCoord(indexes[e]) : mesh->getVolumeWorldCoord(indexes[e]);
+		setCoordinates(sim->getTime_sec(), wc);
+		initVars();
+		solveSystem();
+		updateVars();
+	}
+}
+
 void FastSystem::showVars()
 {
 	int dim = getDimension();
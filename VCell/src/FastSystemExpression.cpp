@@ -13,12 +13,82 @@
 
 #include <SimpleSymbolTable.h>
 #include <Expression.h>
+#include <FusedExpressionProgram.h>
 using VCell::Expression;
+using VCell::FusedExpressionProgram;
 
 #include <sstream>
 using std::stringstream;
 
 #include <string.h>
+#include <math.h>
+#include <algorithm>
+
+// elements solved together by solveElements()
+#define FAST_SYSTEM_BLOCK_SIZE 128
+
+/*
+ * a block of elements of solveElements() by symbol (or matrix entry) then element:
+ * the values of the fast symbol table, the values of the pseudo constant symbols,
+ * the Newton matrix and increments and the fast dependencies
+ */
+struct FastSystemExpression::BatchWorkspace {
+	int numFastSymbols;
+	int numPseudoSymbols;
+	vector<long> indexes;
+	vector<double> fastValues;
+	vector<double*> fastColumns;
+	vector<double> pseudoValues;
+	vector<double*> pseudoColumns;
+	vector<double> pseudoConstants;
+	vector<double*> pseudoConstantOutputs;
+	// J row by row then the fast rates
+	vector<double> newtonValues;
+	vector<double*> newtonOutputs;
+	// the augmented matrix [J | -F], row by row
+	vector<double> matrix;
+	vector<double> increments;
+	vector<double> dependents;
+	vector<double*> dependentOutputs;
+	// 0 active, 1 converged, 2 failed
+	vector<char> states;
+	vector<double> programWorkspace;
+	vector<double> fieldValues;
+	vector<double> randomValues;
+
+	BatchWorkspace(int numFastSymbols, int numPseudoSymbols, int dimension, int numDependents, int numFields, int numRandomVariables) {
+		this->numFastSymbols = numFastSymbols;
+		this->numPseudoSymbols = numPseudoSymbols;
+		indexes.resize(FAST_SYSTEM_BLOCK_SIZE);
+		setColumns(fastValues, fastColumns, numFastSymbols);
+		setColumns(pseudoValues, pseudoColumns, numPseudoSymbols);
+		setColumns(pseudoConstants, pseudoConstantOutputs, numDependents);
+		setColumns(newtonValues, newtonOutputs, dimension * dimension + dimension);
+		matrix.resize(dimension * (dimension + 1) * FAST_SYSTEM_BLOCK_SIZE);
+		increments.resize(dimension * FAST_SYSTEM_BLOCK_SIZE);
+		setColumns(dependents, dependentOutputs, numDependents);
+		states.resize(FAST_SYSTEM_BLOCK_SIZE);
+		fieldValues.resize(numFields + 1);
+		randomValues.resize(numRandomVariables + 1);
+	}
+
+	static void setColumns(vector<double>& values, vector<double*>& columns, int numColumns) {
+		values.resize(numColumns * FAST_SYSTEM_BLOCK_SIZE + 1);
+		columns.resize(numColumns + 1);
+		for (int i = 0; i < numColumns; i ++) {
+			columns[i] = &values[i * FAST_SYSTEM_BLOCK_SIZE];
+		}
+	}
+
+	// exchanges the elements at p and q of the block
+	void swapElements(int p, int q) {
+		for (int s = 0; s < numFastSymbols; s ++) {
+			std::swap(fastColumns[s][p], fastColumns[s][q]);
+		}
+		std::swap(indexes[p], indexes[q]);
+		std::swap(states[p], states[q]);
+	}
+};
 
 FastSystemExpression::FastSystemExpression(int dimension, int numDepend, SimulationExpression* sim) 
 : FastSystem(dimension, numDepend)
@@ -47,6 +117,10 @@ FastSystemExpression::FastSystemExpression(int dimension, int numDepend, Simulat
 	fastDependencyExpressions = NULL;
 	jacobianExpressions = NULL;	
 	pseudoSymbols = 0;
+	pseudoConstantProgram = NULL;
+	newtonProgram = NULL;
+	dependencyProgram = NULL;
+	bProgramsBuilt = false;
 
 	setTolerance(1e-7);
 }
@@ -56,6 +130,9 @@ FastSystemExpression::~FastSystemExpression()
 	delete[] pseudoConstants;
 	delete[] fastSymbolTable;
 	delete[] fastValues;
+	delete pseudoConstantProgram;
+	delete newtonProgram;
+	delete dependencyProgram;
 	for (int i = 0; i < dimension; i ++) {
 		delete fastRateExpressions[i];
 		for (int j = 0; j < dimension; j ++) {
@@ -285,3 +362,279 @@ void FastSystemExpression::updateMatrix()
 		setMatrix(i, j, mvalue);
 	}	 
 }
+
+void FastSystemExpression::buildPrograms() {
+	bProgramsBuilt = true;
+	pseudoConstantProgram = new FusedExpressionProgram();
+	newtonProgram = new FusedExpressionProgram();
+	dependencyProgram = new FusedExpressionProgram();
+	bool bFused = true;
+	for (int i = 0; i < numDependents; i ++) {
+		bFused = pseudoConstantProgram->add(pseudoConstantExpressions[i]) && bFused;
+		bFused = dependencyProgram->add(fastDependencyExpressions[i]) && bFused;
+	}
+	for (int i = 0; i < dimension * dimension; i ++) {
+		bFused = newtonProgram->add(jacobianExpressions[i]) && bFused;
+	}
+	for (int i = 0; i < dimension; i ++) {
+		bFused = newtonProgram->add(fastRateExpressions[i]) && bFused;
+	}
+	if (!bFused) {
+		delete pseudoConstantProgram;
+		delete newtonProgram;
+		delete dependencyProgram;
+		pseudoConstantProgram = NULL;
+		newtonProgram = NULL;
+		dependencyProgram = NULL;
+		return;
+	}
+	// finished before the threads evaluate them
+	pseudoConstantProgram->getNumOperations();
+	newtonProgram->getNumOperations();
+	dependencyProgram->getNumOperations();
+}
+
+/*
+ * Newton iterations of solveSystem() on blocks of elements, the elements of a block
+ * side by side so that the programs and the elimination loops run over a block;
+ * each element does the arithmetic of solveGauss() in the same order and leaves
+ * the block once converged, so the results are those of the element by element
+ * solve. An element the block can't solve (the programs fail, the matrix is
+ * singular or the iterations do not converge) is solved again by itself after
+ * the blocks, which throws the error of the element by element solve.
+ */
+void FastSystemExpression::solveElements(Simulation* sim, int numElements, const long* indexes, bool bMembrane) {
+	if (!bProgramsBuilt) {
+		buildPrograms();
+	}
+	if (newtonProgram == NULL) {
+		FastSystem::solveElements(sim, numElements, indexes, bMembrane);
+		return;
+	}
+
+	int numFields = simulation->getNumFields();
+	int numRandomVariables = simulation->getNumRandomVariables();
+	int numFastSymbols = 4 + numFields + numRandomVariables + dimension + numDependents;
+	int numPseudoSymbols = 4 + dimension + numDependents;
+	int numBlocks = (numElements + FAST_SYSTEM_BLOCK_SIZE - 1) / FAST_SYSTEM_BLOCK_SIZE;
+	vector<long> failedIndexes;
+#ifdef _OPENMP
+#pragma omp parallel if (numBlocks > 1)
+#endif
+	{
+		BatchWorkspace workspace(numFastSymbols, numPseudoSymbols, dimension, numDependents, numFields, numRandomVariables);
+		vector<long> threadFailedIndexes;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+		for (int b = 0; b < numBlocks; b ++) {
+			int blockStart = b * FAST_SYSTEM_BLOCK_SIZE;
+			int blockSize = std::min(FAST_SYSTEM_BLOCK_SIZE, numElements - blockStart);
+			solveBlock(workspace, blockSize, indexes + blockStart, bMembrane, threadFailedIndexes);
+		}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		failedIndexes.insert(failedIndexes.end(), threadFailedIndexes.begin(), threadFailedIndexes.end());
+	}
+
+	if (!failedIndexes.empty()) {
+		std::sort(failedIndexes.begin(), failedIndexes.end());
+		FastSystem::solveElements(sim, (int)failedIndexes.size(), &failedIndexes[0], bMembrane);
+	}
+}
+
+void FastSystemExpression::solveBlock(BatchWorkspace& workspace, int numElements, const long* indexes, bool bMembrane, vector<long>& failedIndexes) {
+	const int B = FAST_SYSTEM_BLOCK_SIZE;
+	int numFields = simulation->getNumFields();
+	int numRandomVariables = simulation->getNumRandomVariables();
+	int indepOffset = 4 + numFields + numRandomVariables;
+	int pseudoConstantOffset = indepOffset + dimension;
+	double** fastColumns = &workspace.fastColumns[0];
+	double** pseudoColumns = &workspace.pseudoColumns[0];
+	double* matrix = &workspace.matrix[0];
+	double* increments = &workspace.increments[0];
+	long* elementIndexes = &workspace.indexes[0];
+	char* states = &workspace.states[0];
+	Mesh* mesh = simulation->getMesh();
+	double time = simulation->getTime_sec();
+
+	// setCoordinates() and initVars()
+	for (int p = 0; p < numElements; p ++) {
+		long index = indexes[p];
+		elementIndexes[p] = index;
+		states[p] = 0;
+		WorldCoord wc = bMembrane ? mesh->getMembraneWorldCoord(index) : mesh->getVolumeWorldCoord(index);
+		fastColumns[0][p] = time;
+		fastColumns[1][p] = wc.x;
+		fastColumns[2][p] = wc.y;
+		fastColumns[3][p] = wc.z;
+		simulation->populateFieldValues(&workspace.fieldValues[0], index);
+		for (int i = 0; i < numFields; i ++) {
+			fastColumns[4 + i][p] = workspace.fieldValues[i];
+		}
+		simulation->populateRandomValues(&workspace.randomValues[0], index);
+		for (int i = 0; i < numRandomVariables; i ++) {
+			fastColumns[4 + numFields + i][p] = workspace.randomValues[i];
+		}
+
+		// pseudo constants are functions of the volume coordinates, as in initVars()
+		WorldCoord volumeWc = mesh->getVolumeWorldCoord(index);
+		pseudoColumns[0][p] = time;
+		pseudoColumns[1][p] = volumeWc.x;
+		pseudoColumns[2][p] = volumeWc.y;
+		pseudoColumns[3][p] = volumeWc.z;
+		for (int i = 0; i < dimension; i ++) {
+			pseudoColumns[4 + i][p] = fastColumns[indepOffset + i][p] = pVars[i]->getCurr(index);
+		}
+		for (int i = 0; i < numDependents; i ++) {
+			pseudoColumns[4 + dimension + i][p] = pDependentVars[i]->getCurr(index);
+		}
+	}
+	if (!pseudoConstantProgram->evaluateBatch(numElements, pseudoColumns, &workspace.pseudoConstantOutputs[0], workspace.programWorkspace)) {
+		failedIndexes.insert(failedIndexes.end(), indexes, indexes + numElements);
+		return;
+	}
+	for (int i = 0; i < numDependents; i ++) {
+		memcpy(fastColumns[pseudoConstantOffset + i], workspace.pseudoConstantOutputs[i], numElements * sizeof(double));
+	}
+
+	// solveSystem(), the active elements are the first numActive of the block
+	double tolerance = getTolerance();
+	int numActive = numElements;
+	for (int count = 1; count <= ALGEBRAIC_SYSTEM_MAX_ITERATIONS && numActive > 0; count ++) {
+		// updateMatrix()
+		double** newtonOutputs = &workspace.newtonOutputs[0];
+		if (!newtonProgram->evaluateBatch(numActive, fastColumns, newtonOutputs, workspace.programWorkspace)) {
+			for (int p = 0; p < numActive; p ++) {
+				states[p] = 2;
+			}
+			break;
+		}
+		for (int i = 0; i < dimension; i ++) {
+			for (int j = 0; j < dimension; j ++) {
+				memcpy(matrix + (i * (dimension + 1) + j) * B, newtonOutputs[i * dimension + j], numActive * sizeof(double));
+			}
+			double* rhs = matrix + (i * (dimension + 1) + dimension) * B;
+			double* rate = newtonOutputs[dimension * dimension + i];
+			for (int p = 0; p < numActive; p ++) {
+				rhs[p] = -rate[p];
+			}
+		}
+
+		// solveGauss()
+		for (int k = 0; k < dimension - 1; k ++) {
+			for (int p = 0; p < numActive; p ++) {
+				if (matrix[(k * (dimension + 1) + k) * B + p] != 0) {
+					continue;
+				}
+				int m = k + 1;
+				while (m < dimension && matrix[(m * (dimension + 1) + k) * B + p] == 0) {
+					m ++;
+				}
+				if (m == dimension) {
+					// singular, the entries are left as they are
+					states[p] = 2;
+					continue;
+				}
+				for (int j = k; j < dimension + 1; j ++) {
+					std::swap(matrix[(k * (dimension + 1) + j) * B + p], matrix[(m * (dimension + 1) + j) * B + p]);
+				}
+			}
+			double* pivot = matrix + (k * (dimension + 1) + k) * B;
+			for (int j = k + 1; j < dimension + 1; j ++) {
+				double* akj = matrix + (k * (dimension + 1) + j) * B;
+				for (int p = 0; p < numActive; p ++) {
+					akj[p] /= pivot[p];
+				}
+			}
+			for (int i = k + 1; i < dimension; i ++) {
+				double* aik = matrix + (i * (dimension + 1) + k) * B;
+				for (int j = k + 1; j < dimension + 1; j ++) {
+					double* aij = matrix + (i * (dimension + 1) + j) * B;
+					double* akj = matrix + (k * (dimension + 1) + j) * B;
+					for (int p = 0; p < numActive; p ++) {
+						aij[p] -= aik[p] * akj[p];
+					}
+				}
+			}
+		}
+		double* last = matrix + ((dimension - 1) * (dimension + 1) + dimension - 1) * B;
+		double* lastRhs = matrix + ((dimension - 1) * (dimension + 1) + dimension) * B;
+		for (int p = 0; p < numActive; p ++) {
+			if (last[p] == 0) {
+				states[p] = 2;
+			}
+			increments[(dimension - 1) * B + p] = lastRhs[p] / last[p];
+		}
+		for (int i = 1; i < dimension; i ++) {
+			int row = dimension - 1 - i;
+			double* increment = increments + row * B;
+			for (int p = 0; p < numActive; p ++) {
+				double sum = 0;
+				for (int j = dimension - i; j < dimension; j ++) {
+					sum += matrix[(row * (dimension + 1) + j) * B + p] * increments[j * B + p];
+				}
+				increment[p] = matrix[(row * (dimension + 1) + dimension) * B + p] - sum;
+			}
+		}
+
+		// x += increments and the convergence test of solveSystem()
+		for (int p = 0; p < numActive; p ++) {
+			double diff = 0;
+			for (int i = 0; i < dimension; i ++) {
+				double& x = fastColumns[indepOffset + i][p];
+				double increment = increments[i * B + p];
+				x += increment;
+				if (fabs(x) < 1e-5) {
+					diff += fabs(increment);
+				} else {
+					diff += fabs(increment / x);
+				}
+			}
+			if (states[p] == 0 && !(tolerance < diff)) {
+				states[p] = 1;
+			}
+		}
+
+		// move the finished elements past the active ones
+		for (int p = 0; p < numActive; ) {
+			if (states[p] != 0) {
+				workspace.swapElements(p, -- numActive);
+			} else {
+				p ++;
+			}
+		}
+	}
+
+	// elements still active didn't converge; the converged ones go first for updateVars()
+	int numConverged = 0;
+	for (int p = 0; p < numElements; p ++) {
+		if (states[p] == 1) {
+			if (p != numConverged) {
+				workspace.swapElements(p, numConverged);
+			}
+			numConverged ++;
+		} else {
+			failedIndexes.push_back(elementIndexes[p]);
+		}
+	}
+	if (numConverged == 0) {
+		return;
+	}
+	if (numDependents > 0 && !dependencyProgram->evaluateBatch(numConverged, fastColumns, &workspace.dependentOutputs[0], workspace.programWorkspace)) {
+		failedIndexes.insert(failedIndexes.end(), elementIndexes, elementIndexes + numConverged);
+		return;
+	}
+
+	// updateVars()
+	for (int p = 0; p < numConverged; p ++) {
+		long index = elementIndexes[p];
+		for (int i = 0; i < dimension; i ++) {
+			pVars[i]->setCurr(index, fastColumns[indepOffset + i][p]);
+		}
+		for (int i = 0; i < numDependents; i ++) {
+			pDependentVars[i]->setCurr(index, workspace.dependentOutputs[i][p]);
+		}
+	}
+}
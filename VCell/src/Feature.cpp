@@ -129,3 +129,23 @@ void Feature::reinitConstantValues() {
 		volumeRegionVarContextList[i]->reinitConstantValues();
 	}
 }
+
+void Feature::addExpressionsToCompiler(VCell::ExpressionCompiler* compiler) {
+	for (int i = 0; i < (int)volumeVarContextList.size(); i ++) {
+		volumeVarContextList[i]->addExpressionsToCompiler(compiler);
+	}
+
+	for (int i = 0; i < (int)volumeRegionVarContextList.size(); i ++) {
+		volumeRegionVarContextList[i]->addExpressionsToCompiler(compiler);
+	}
+}
+
+void Feature::createStackMachines() {
+	for (int i = 0; i < (int)volumeVarContextList.size(); i ++) {
+		volumeVarContextList[i]->createStackMachines();
+	}
+
+	for (int i = 0; i < (int)volumeRegionVarContextList.size(); i ++) {
+		volumeRegionVarContextList[i]->createStackMachines();
+	}
+}
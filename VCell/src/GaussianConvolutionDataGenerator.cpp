@@ -6,6 +6,7 @@
 #include <VCELL/SimulationExpression.h>
 #include <VCELL/CartesianMesh.h>
 #include <VCELL/Element.h>
+#include <VCELL/ConvolutionEngine.h>
 #include <Expression.h>
 using VCell::Expression;
 
@@ -21,15 +22,19 @@ GaussianConvolutionDataGenerator::GaussianConvolutionDataGenerator(string& name,
 		sigmaRatio = sigmaZ/sigmaXY;
 	this->volFunction = volFunc;
 	this->memFunction = memFunc;
-	gaussianPsfSamples = NULL;
+	convolutionEngine = NULL;
 	functionValues = NULL;
+	membraneSourceValues = NULL;
+	membraneConvolvedValues = NULL;
 }
 
 GaussianConvolutionDataGenerator::~GaussianConvolutionDataGenerator() {
 	delete volFunction;
 	delete memFunction;
-	delete[] gaussianPsfSamples;
+	delete convolutionEngine;
 	delete[] functionValues;
+	delete[] membraneSourceValues;
+	delete[] membraneConvolvedValues;
 }
 
 void GaussianConvolutionDataGenerator::resolveReferences(SimulationExpression* sim) {
@@ -67,30 +72,29 @@ void GaussianConvolutionDataGenerator::resolveReferences(SimulationExpression* s
 	if (gaussianPsfSampleNz % 2 == 0) {
 		++gaussianPsfSampleNz;
 	}
-	int gaussianPsfSampleNxy = gaussianPsfSampleNx * gaussianPsfSampleNy;
-	gaussianPsfSamples = new double[gaussianPsfSampleNx * gaussianPsfSampleNy * gaussianPsfSampleNz];
-	int midI = gaussianPsfSampleNx / 2;
-	int midJ = gaussianPsfSampleNy / 2;
-	int midK = gaussianPsfSampleNz / 2;
+	// exp(-(x*x + y*y + z*z/(sigmaRatio*sigmaRatio))/(2*sigmaXY*sigmaXY)) normalized
+	// is the product of a normalized gaussian along each axis
+	vector<double> psfX(gaussianPsfSampleNx), psfY(gaussianPsfSampleNy), psfZ(gaussianPsfSampleNz);
+	sampleGaussian(psfX, dx, sigmaXY);
+	sampleGaussian(psfY, dy, sigmaXY);
+	sampleGaussian(psfZ, dz, sigmaZ);
+	convolutionEngine = new ConvolutionEngine(mesh->getNumVolumeX(), mesh->getNumVolumeY(), mesh->getNumVolumeZ());
+	convolutionEngine->setSeparableKernel(psfX, psfY, psfZ, false);
+
+	membraneSourceValues = new double[dataSize];
+	membraneConvolvedValues = new double[dataSize];
+}
+
+void GaussianConvolutionDataGenerator::sampleGaussian(vector<double>& samples, double h, double sigma) {
+	int n = (int)samples.size();
 	double sum = 0;
-	int volIndex = -1;
-	for (int k = 0; k < gaussianPsfSampleNz; ++k) {
-		double z = (k - midK) * dz;
-		for (int j = 0; j < gaussianPsfSampleNy; ++j) {
-			double y = (j - midJ) * dy;
-			for (int i = 0; i < gaussianPsfSampleNx; ++i) {				
-				double x = (i - midI) * dx;
-
-				++ volIndex;
-				double r2 = x*x + y*y + z*z/(sigmaRatio*sigmaRatio);
-				double d = exp(-r2/(2*sigmaXY*sigmaXY));
-				gaussianPsfSamples[volIndex] = d;
-				sum += d;
-			}
-		}
+	for (int i = 0; i < n; ++i) {
+		double x = (i - n / 2) * h;
+		samples[i] = exp(-x*x/(2*sigma*sigma));
+		sum += samples[i];
 	}
-	for (int i = 0; i < gaussianPsfSampleNxy * gaussianPsfSampleNz; ++ i) {
-		gaussianPsfSamples[i] /= sum;
+	for (int i = 0; i < n; ++i) {
+		samples[i] /= sum;
 	}
 }
 
@@ -123,46 +127,7 @@ void GaussianConvolutionDataGenerator::computePPData(SimulationExpression* sim)
 			functionValues[volIndex] = value;
 		}
 
-		int midI = gaussianPsfSampleNx / 2;
-		int midJ = gaussianPsfSampleNy / 2;
-		int midK = gaussianPsfSampleNz / 2;
-		int gaussianPsfSampleNxy = gaussianPsfSampleNx * gaussianPsfSampleNy;
-		volIndex = -1;
-		for (int k = 0; k < numZ; ++k) {
-			for (int j = 0; j < numY; ++j) {
-				for (int i = 0; i < numX; ++i) {
-					++ volIndex;
-
-					data[volIndex] = 0;
-					int kkOffset = 0;
-					for (int kk = 0; kk < gaussianPsfSampleNz; kk ++, kkOffset += gaussianPsfSampleNxy) {
-						int k2 = k - midK + kk;
-						if (k2 < 0 || k2 >= numZ) {
-							continue;
-						}
-						int jjOffset = kkOffset;
-						for (int jj = 0; jj < gaussianPsfSampleNy; jj ++, jjOffset += gaussianPsfSampleNx) {
-							int j2 = j - midJ + jj;
-							if (j2 < 0 || j2 >= numY) {
-								continue;
-							}
-							int iiOffset = jjOffset;
-							for (int ii = 0; ii < gaussianPsfSampleNx; ii ++, ++iiOffset) {
-								int i2 = i - midI + ii;
-								if (i2 < 0 || i2 >= numX) {
-									continue;
-								}
-								int psfIndex = iiOffset; 
-								int volIndex2 = k2 * numXY + j2 * numX + i2;
-								data[volIndex] += functionValues[volIndex2] * gaussianPsfSamples[psfIndex];
-							
-							} // end ii
-						} // end jj
-					} // end kk
-
-				} // end i
-			} // end j
-		} // end k
+		convolutionEngine->convolve(functionValues, data);
 	}//end of convolve volume function
 	if(memFunction != 0){
 		memset(functionValues, 0, funcValueSize * sizeof(double));
@@ -181,14 +146,11 @@ void GaussianConvolutionDataGenerator::computePPData(SimulationExpression* sim)
 			functionValues[m] = value;
 		}
 		
-		int psfZOffset = -gaussianPsfSampleNz/2;
-		int psfYOffset = -gaussianPsfSampleNy/2;
-		int psfXOffset = -gaussianPsfSampleNx/2;
+		// half of each membrane value goes to each of its volume elements
+		memset(membraneSourceValues, 0, numXYZ * sizeof(double));
 		for (int m = 0; m < mesh->getNumMembraneElements(); m++) {
 			int insideVolIndex = mesh->getMembraneElements()[m].vindexFeatureLo;
 			int outsideVolIndex = mesh->getMembraneElements()[m].vindexFeatureHi;
-			MeshCoord insideMC = mesh->getMeshCoord(insideVolIndex);
-			MeshCoord outsideMC = mesh->getMeshCoord(outsideVolIndex);
 			double fullArea = mesh->getXArea_squm();
 			int diffVolIndex = abs(outsideVolIndex - insideVolIndex);
 			if (diffVolIndex  == numX) {
@@ -198,32 +160,12 @@ void GaussianConvolutionDataGenerator::computePPData(SimulationExpression* sim)
 			}
 
 			double memareaRatio = mesh->getMembraneElements()[m].area/fullArea;
-			int psfindex = 0;
-			for (int zz = 0; zz < gaussianPsfSampleNz; zz ++) {								
-				for (int yy = 0; yy < gaussianPsfSampleNy; yy ++) {									
-					for (int xx = 0; xx < gaussianPsfSampleNx; xx ++) {
-						double psf_val = gaussianPsfSamples[psfindex ++];
-
-						// inside
-						int volIndex2X = insideMC.x + psfXOffset + xx;
-						int volIndex2Y = insideMC.y + psfYOffset + yy;
-						int volIndex2Z = insideMC.z + psfZOffset + zz;
-						if (volIndex2X >= 0 && volIndex2Y >= 0 && volIndex2Z >= 0 && volIndex2X < numX && volIndex2Y < numY && volIndex2Z < numZ) {
-							int volIndex2 = volIndex2Z * numXY + volIndex2Y * numX + volIndex2X;
-							data[volIndex2] += functionValues[m] * psf_val/2 * memareaRatio;
-						}
-
-						// outside
-						volIndex2X = outsideMC.x + psfXOffset + xx;
-						volIndex2Y = outsideMC.y + psfYOffset + yy;
-						volIndex2Z = outsideMC.z + psfZOffset + zz;
-						if (volIndex2X >= 0 && volIndex2Y >= 0 && volIndex2Z >= 0 && volIndex2X < numX && volIndex2Y < numY && volIndex2Z < numZ) {
-							int volIndex2 = volIndex2Z * numXY + volIndex2Y * numX + volIndex2X;
-							data[volIndex2] += functionValues[m] * psf_val/2 * memareaRatio;
-						}
-					}						
-				}
-			}
+			membraneSourceValues[insideVolIndex] += functionValues[m]/2 * memareaRatio;
+			membraneSourceValues[outsideVolIndex] += functionValues[m]/2 * memareaRatio;
+		}
+		convolutionEngine->convolve(membraneSourceValues, membraneConvolvedValues);
+		for (int volIndex = 0; volIndex < numXYZ; volIndex ++) {
+			data[volIndex] += membraneConvolvedValues[volIndex];
 		}
 	}
 }
@@ -9,6 +9,7 @@ using std::stringstream;
 #include <VCELL/CartesianMesh.h>
 #include <VCELL/SimTool.h>
 #include <Expression.h>
+#include <EvalContext.h>
 using VCell::Expression;
 
 JumpCondition::JumpCondition(Membrane* m, Expression* e)
@@ -57,6 +58,22 @@ double JumpCondition::evaluateExpression(SimulationExpression* simulation, Membr
 	return expression->evaluateProxy();	
 }
 
+double JumpCondition::evaluateExpression(EvalContext& context, SimulationExpression* simulation, MembraneElement* element) {
+	if (constantValue != 0) {
+		return *constantValue;
+	}	
+	if (bNeedsXYZ) {
+		CartesianMesh* mesh = (CartesianMesh*)simulation->getMesh();
+		WorldCoord wc = mesh->getMembraneWorldCoord(element);
+		simulation->setCurrentCoordinate(context, wc);
+	}
+	context.indices[VAR_VOLUME_INDEX] = -1;
+	context.indices[VAR_VOLUME_REGION_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_INDEX] = element->index;
+	context.indices[VAR_MEMBRANE_REGION_INDEX] = element->getRegionIndex();
+	return expression->evaluate(context);	
+}
+
 double JumpCondition::evaluateExpression(double* values) {
 	if (constantValue != 0) {
 		return *constantValue;
@@ -113,3 +113,21 @@ void Membrane::reinitConstantValues() {
 		membraneRegionVarContextList[i]->reinitConstantValues();
 	}
 }
+
+void Membrane::addExpressionsToCompiler(VCell::ExpressionCompiler* compiler) {
+	for (int i = 0; i < (int)membraneVarContextList.size(); i ++) {
+		membraneVarContextList[i]->addExpressionsToCompiler(compiler);
+	}
+	for (int i = 0; i < (int)membraneRegionVarContextList.size(); i ++) {
+		membraneRegionVarContextList[i]->addExpressionsToCompiler(compiler);
+	}
+}
+
+void Membrane::createStackMachines() {
+	for (int i = 0; i < (int)membraneVarContextList.size(); i ++) {
+		membraneVarContextList[i]->createStackMachines();
+	}
+	for (int i = 0; i < (int)membraneRegionVarContextList.size(); i ++) {
+		membraneRegionVarContextList[i]->createStackMachines();
+	}
+}
@@ -11,6 +11,7 @@
 #include <VCELL/MembraneEqnBuilderForward.h>
 #include <VCELL/SimTool.h>
 #include <VCELL/Element.h>
+#include <EvalContext.h>
 
 MembraneEqnBuilderForward::MembraneEqnBuilderForward(MembraneVariable *Avar, Mesh *Amesh, ODESolver *Asolver) : EqnBuilder(Avar,Amesh) {
 	odeSolver = Asolver;
@@ -18,14 +19,27 @@ MembraneEqnBuilderForward::MembraneEqnBuilderForward(MembraneVariable *Avar, Mes
 
 void MembraneEqnBuilderForward::buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
 {
-	Simulation *sim = SimTool::getInstance()->getSimulation();
+	EvalContext context;
+	initEvalContext(context);
+	beginSlabs(deltaTime);
+	buildEquation(context, deltaTime, volumeIndexStart, volumeIndexSize, membraneIndexStart, membraneIndexSize);
+}
 
+void MembraneEqnBuilderForward::beginSlabs(double deltaTime)
+{
+	advancedTime = getAdvancedTime();
+}
+
+void MembraneEqnBuilderForward::buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
+{
 	ASSERTION((membraneIndexStart>=0) && ((membraneIndexStart+membraneIndexSize)<=mesh->getNumMembraneElements()));
 
 	MembraneElement *pMembraneElement = mesh->getMembraneElements() + membraneIndexStart;
 	double *pRate = odeSolver->getRates() + membraneIndexStart;
 	ASSERTION(pMembraneElement);
 
+	double time = context.time;
+	context.time = advancedTime;
 	for (long memIndex=membraneIndexStart;memIndex<(membraneIndexStart+membraneIndexSize);memIndex++, pMembraneElement++, pRate++){
 
 		Membrane* membrane = pMembraneElement->getMembrane();
@@ -35,8 +49,7 @@ void MembraneEqnBuilderForward::buildEquation(double deltaTime, int volumeIndexS
 
 		MembraneVarContextExpression* memVarContext = membrane->getMembraneVarContext((MembraneVariable*)var);
 
-		sim->advanceTimeOn();
-		*pRate = memVarContext->getMembraneReactionRate(pMembraneElement);
-		sim->advanceTimeOff();
+		*pRate = memVarContext->evaluateExpression(context, pMembraneElement, REACT_RATE_EXP);
 	} // end memIndex
+	context.time = time;
 }
@@ -35,6 +35,7 @@ using std::endl;
 #include <VCELL/VCellModel.h>
 #include <SimpleSymbolTable.h>
 #include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/Profiler.h>
 
 #include <assert.h>
 #include <string.h>
@@ -309,13 +310,38 @@ PetscErrorCode PetscPdeScheduler::rhs(PetscReal t, double* yinput, double* rhs)
 	//if (MathUtil::isInfinity(yinput[14008]) || MathUtil::isNaN(yinput[14008])) {
 	//	exit(1);
 	//}
+	static ProfileHandle rhsHandle = Profiler::getHandle("rhs");
+	static ProfileHandle operatorHandles[5] = {
+		Profiler::getHandle("rhs.volumeOperator"),
+		Profiler::getHandle("rhs.membraneDiffusionReactionOperator"),
+		Profiler::getHandle("rhs.volumeRegionReactionOperator"),
+		Profiler::getHandle("rhs.membraneRegionReactionOperator"),
+		Profiler::getHandle("rhs.membraneFluxOperator")
+	};
+	ProfileScope rhsScope(rhsHandle);
+
 	memset(rhs, 0, numUnknowns * sizeof(double));
 
-	applyVolumeOperator(t, yinput, rhs);
-	applyMembraneDiffusionReactionOperator(t, yinput, rhs);
-	applyVolumeRegionReactionOperator(t, yinput, rhs);
-	applyMembraneRegionReactionOperator(t, yinput, rhs);
-	applyMembraneFluxOperator(t, yinput, rhs);
+	{
+		ProfileScope scope(operatorHandles[0]);
+		applyVolumeOperator(t, yinput, rhs);
+	}
+	{
+		ProfileScope scope(operatorHandles[1]);
+		applyMembraneDiffusionReactionOperator(t, yinput, rhs);
+	}
+	{
+		ProfileScope scope(operatorHandles[2]);
+		applyVolumeRegionReactionOperator(t, yinput, rhs);
+	}
+	{
+		ProfileScope scope(operatorHandles[3]);
+		applyMembraneRegionReactionOperator(t, yinput, rhs);
+	}
+	{
+		ProfileScope scope(operatorHandles[4]);
+		applyMembraneFluxOperator(t, yinput, rhs);
+	}
 
 #ifdef SHOW_RHS
 	cout << endl << "-----------RHS----at time " << t << "--------------" << endl;
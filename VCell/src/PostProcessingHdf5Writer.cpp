@@ -7,6 +7,7 @@
 #include <VCELL/VariableStatisticsDataGenerator.h>
 #include <VCELL/Variable.h>
 #include <VCELL/CartesianMesh.h>
+#include <VCELL/Profiler.h>
 #include <typeinfo>
 #include <H5Cpp.h>
 #include <iostream>
@@ -82,7 +83,9 @@ bool PostProcessingHdf5Writer::loadFinal(int numTimes) {
 		hsize_t offset = 0;
 		H5::DataSpace fspace = timesDataSet->getSpace();
 		fspace.selectHyperslab(H5S_SELECT_SET, &dim, &offset);
-		timesDataSet->write(times, H5::PredType::NATIVE_DOUBLE, copyTimesDataSpace, fspace);
+		// only the first numTimes of the copy
+		H5::DataSpace mspace(1, &dim);
+		timesDataSet->write(times, H5::PredType::NATIVE_DOUBLE, mspace, fspace);
 		delete[] times;
 
 		for (int timeIndex = 0; timeIndex < numTimes; timeIndex ++) {
@@ -97,7 +100,7 @@ bool PostProcessingHdf5Writer::loadFinal(int numTimes) {
 				H5::DataSet dataSet = hdf5Copy.openDataSet(dataSetName);
 				dataSet.read(dataGenerator->data, H5::PredType::NATIVE_DOUBLE);
 
-				writeDataGenerator(dataGenerator, timeIndex);
+				writeDataGenerator(dataGenerator, timeIndex, dataGenerator->data);
 			}
 		}
 		hdf5Copy.close();
@@ -130,18 +133,7 @@ void PostProcessingHdf5Writer::createGroups() {
 	h5PPFile->createGroup(PPGroupName);
 
 	// create /PostProcessing/Times
-	int timesRank = 1;
-	hsize_t timesDims = 10;	
-	hsize_t maxDims = H5S_UNLIMITED;
-	H5::DataSpace timesDataSpace(timesRank, &timesDims, &maxDims);
-	// enable chunking
-	H5::DSetCreatPropList cparms;
-	hsize_t chunkDims = 500;
-	cparms.setChunk(timesRank, &chunkDims);
-	int fill_val = -1;
-	cparms.setFillValue(H5::PredType::NATIVE_INT, &fill_val);
-	// create dataset
-	timesDataSet = new H5::DataSet(h5PPFile->createDataSet(TimesDataSetName, H5::PredType::NATIVE_DOUBLE, timesDataSpace, cparms));
+	timesDataSet = createTimesDataSet(h5PPFile, TimesDataSetName);
 
 	// create a group for each data generator
 	char dataGeneratorGroupName[128];
@@ -177,33 +169,71 @@ void PostProcessingHdf5Writer::createGroups() {
 	}
 }
 
+H5::DataSet* PostProcessingHdf5Writer::createTimesDataSet(H5::H5File* h5File, const char* name) {
+	int timesRank = 1;
+	hsize_t timesDims = 10;	
+	hsize_t maxDims = H5S_UNLIMITED;
+	H5::DataSpace timesDataSpace(timesRank, &timesDims, &maxDims);
+	// enable chunking
+	H5::DSetCreatPropList cparms;
+	hsize_t chunkDims = 500;
+	cparms.setChunk(timesRank, &chunkDims);
+	int fill_val = -1;
+	cparms.setFillValue(H5::PredType::NATIVE_INT, &fill_val);
+	// create dataset
+	return new H5::DataSet(h5File->createDataSet(name, H5::PredType::NATIVE_DOUBLE, timesDataSpace, cparms));
+}
+
+void PostProcessingHdf5Writer::writeTime(H5::DataSet* timesDataSet, int timeIndex, double time) {
+	int timesRank = 1;
+	hsize_t timesDims = 1;	
+	hsize_t maxDims = H5S_UNLIMITED;
+	H5::DataSpace timesDataSpace(timesRank, &timesDims, &maxDims);
+
+	hsize_t size = timeIndex + 1;
+	timesDataSet->extend(&size);
+	hsize_t dim = 1;
+	hsize_t offset = timeIndex;
+	H5::DataSpace fspace = timesDataSet->getSpace();
+	fspace.selectHyperslab(H5S_SELECT_SET, &dim, &offset);
+	timesDataSet->write(&time, H5::PredType::NATIVE_DOUBLE, timesDataSpace, fspace);
+}
+
 void PostProcessingHdf5Writer::writeOutput() {
-	try {
-		int timesRank = 1;
-		hsize_t timesDims = 1;	
-		hsize_t maxDims = H5S_UNLIMITED;
-		H5::DataSpace timesDataSpace(timesRank, &timesDims, &maxDims);
+	PostProcessingSnapshot snapshot;
+	computeOutput(snapshot);
+	writeOutput(snapshot);
+}
 
+void PostProcessingHdf5Writer::computeOutput(PostProcessingSnapshot& snapshot) {
+	try {
 		createGroups();
+	} catch(H5::Exception error ) {
+		throw error.getDetailMsg();
+	}
+
+	static ProfileHandle profileHandle = Profiler::getHandle("dataGenerators");
+	ProfileScope profileScope(profileHandle);
+	snapshot.time = postProcessingBlock->simulation->getTime_sec();
+	snapshot.data.resize(postProcessingBlock->dataGeneratorList.size());
+	for (int i = 0; i < (int)postProcessingBlock->dataGeneratorList.size(); i ++) {
+		DataGenerator* dataGenerator = postProcessingBlock->dataGeneratorList[i];
+		dataGenerator->computePPData(postProcessingBlock->simulation);
+		snapshot.data[i].assign(dataGenerator->getData(), dataGenerator->getData() + dataGenerator->getDataSize());
+	}
+}
 
+void PostProcessingHdf5Writer::writeOutput(PostProcessingSnapshot& snapshot) {
+	try {
 		// write current time
-		double currTime = postProcessingBlock->simulation->getTime_sec();
-		hsize_t size = timeList.size() + 1;
-		timesDataSet->extend(&size);
-		hsize_t dim = 1;
-		hsize_t offset = timeList.size();
-		H5::DataSpace fspace = timesDataSet->getSpace();
-		fspace.selectHyperslab(H5S_SELECT_SET, &dim, &offset);
-		timesDataSet->write(&currTime, H5::PredType::NATIVE_DOUBLE, timesDataSpace, fspace);
+		double currTime = snapshot.time;
+		writeTime(timesDataSet, (int)timeList.size(), currTime);
 
 		timeList.push_back(currTime);
 
 		int timeIndex = timeList.size() - 1;
-		vector<DataGenerator*>::iterator it;
-		for(it = postProcessingBlock->dataGeneratorList.begin(); it < postProcessingBlock->dataGeneratorList.end(); ++ it) {
-			DataGenerator* dataGenerator = *it;
-			dataGenerator->computePPData(postProcessingBlock->simulation);
-			writeDataGenerator(dataGenerator, timeIndex);
+		for (int i = 0; i < (int)postProcessingBlock->dataGeneratorList.size(); i ++) {
+			writeDataGenerator(postProcessingBlock->dataGeneratorList[i], timeIndex, snapshot.data[i].data());
 		}
 		
 		h5PPFile->flush(H5F_SCOPE_GLOBAL);
@@ -212,7 +242,7 @@ void PostProcessingHdf5Writer::writeOutput() {
 	}
 }
 
-void PostProcessingHdf5Writer::writeDataGenerator(DataGenerator* dataGenerator, int timeIndex) {
+void PostProcessingHdf5Writer::writeDataGenerator(DataGenerator* dataGenerator, int timeIndex, double* data) {
 	H5::DataSpace attributeDataSpace(H5S_SCALAR);
 	H5::StrType attributeNameStrType(0, 64);
 
@@ -225,7 +255,7 @@ void PostProcessingHdf5Writer::writeDataGenerator(DataGenerator* dataGenerator,
 	H5::DataSet dataSet = h5PPFile->createDataSet(dataSetName, H5::PredType::NATIVE_DOUBLE, dataspace);
 
 	// write dataset
-	dataSet.write(dataGenerator->getData(), H5::PredType::NATIVE_DOUBLE, H5S_ALL, H5S_ALL);
+	dataSet.write(data, H5::PredType::NATIVE_DOUBLE, H5S_ALL, H5S_ALL);
 
 	// close dataset
 	dataspace.close();
@@ -0,0 +1,206 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/Profiler.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* counterNames[NUM_PROFILE_COUNTERS] = {"cycles", "instructions", "cache_misses"};
+
+Profiler::Section Profiler::sections[MAX_NUM_PROFILE_SECTIONS];
+int Profiler::numSections = 0;
+bool Profiler::bEnabled = false;
+double Profiler::enableTime = 0;
+int Profiler::counterFds[NUM_PROFILE_COUNTERS] = {-1, -1, -1};
+
+static std::mutex profilerMutex;
+static std::thread::id counterThread;
+
+ProfileHandle Profiler::getHandle(const string& name)
+{
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	for (int i = 0; i < numSections; i ++) {
+		if (sections[i].name == name) {
+			return i;
+		}
+	}
+	if (numSections >= MAX_NUM_PROFILE_SECTIONS) {
+		throw "Profiler::getHandle(), too many sections";
+	}
+	Section& section = sections[numSections];
+	section.name = name;
+	section.numCalls = 0;
+	section.depth = 0;
+	section.seconds = 0;
+	section.startTime = 0;
+	section.bCounting = false;
+	memset(section.counters, 0, sizeof(section.counters));
+	memset(section.startCounters, 0, sizeof(section.startCounters));
+	return numSections ++;
+}
+
+void Profiler::enable(bool bHardwareCounters)
+{
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	for (int i = 0; i < numSections; i ++) {
+		sections[i].numCalls = 0;
+		sections[i].seconds = 0;
+		memset(sections[i].counters, 0, sizeof(sections[i].counters));
+	}
+	if (bHardwareCounters && counterFds[0] < 0) {
+		openCounters();
+	}
+	enableTime = now();
+	bEnabled = true;
+}
+
+double Profiler::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::start(ProfileHandle handle)
+{
+	if (!bEnabled) {
+		return;
+	}
+	Section& section = sections[handle];
+	if (section.depth ++ > 0) {
+		return;
+	}
+	section.bCounting = counterFds[0] >= 0 && isCounterThread() && readCounters(section.startCounters);
+	section.startTime = now();
+}
+
+void Profiler::stop(ProfileHandle handle)
+{
+	if (!bEnabled) {
+		return;
+	}
+	Section& section = sections[handle];
+	// not started since enable()
+	if (section.depth == 0 || -- section.depth > 0) {
+		return;
+	}
+	section.seconds += now() - section.startTime;
+	section.numCalls ++;
+	long long values[NUM_PROFILE_COUNTERS];
+	if (section.bCounting && readCounters(values)) {
+		for (int c = 0; c < NUM_PROFILE_COUNTERS; c ++) {
+			section.counters[c] += values[c] - section.startCounters[c];
+		}
+	}
+}
+
+bool Profiler::isCounterThread()
+{
+	return std::this_thread::get_id() == counterThread;
+}
+
+void Profiler::openCounters()
+{
+#ifdef __linux__
+	unsigned long long configs[NUM_PROFILE_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+	for (int c = 0; c < NUM_PROFILE_COUNTERS; c ++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[c];
+		attr.disabled = c == 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		// this thread on any cpu
+		counterFds[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, c == 0 ? -1 : counterFds[0], 0);
+		if (counterFds[c] < 0) {
+			cout << "Profiler : hardware counters not available (" << strerror(errno) << ")" << endl;
+			for (int i = 0; i < c; i ++) {
+				close(counterFds[i]);
+				counterFds[i] = -1;
+			}
+			return;
+		}
+	}
+	ioctl(counterFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(counterFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	counterThread = std::this_thread::get_id();
+#else
+	cout << "Profiler : hardware counters not available on this platform" << endl;
+#endif
+}
+
+bool Profiler::readCounters(long long* values)
+{
+#ifdef __linux__
+	// number of counters, then their values
+	unsigned long long group[NUM_PROFILE_COUNTERS + 1];
+	if (read(counterFds[0], group, sizeof(group)) != (ssize_t)sizeof(group)) {
+		return false;
+	}
+	for (int c = 0; c < NUM_PROFILE_COUNTERS; c ++) {
+		values[c] = (long long)group[c + 1];
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Profiler::writeJSON(const string& fileName)
+{
+	if (!bEnabled) {
+		return;
+	}
+	FILE* fp = fopen(fileName.c_str(), "w");
+	if (fp == NULL) {
+		cout << "Profiler : cannot open " << fileName << " for writing" << endl;
+		return;
+	}
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	bool bCounters = counterFds[0] >= 0;
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"seconds\": %.9g,\n", now() - enableTime);
+	fprintf(fp, "  \"hardware_counters\": %s,\n", bCounters ? "true" : "false");
+	fprintf(fp, "  \"sections\": [");
+	int numWritten = 0;
+	for (int i = 0; i < numSections; i ++) {
+		Section& section = sections[i];
+		if (section.numCalls == 0) {
+			continue;
+		}
+		fprintf(fp, "%s\n    {\"name\": \"", numWritten ++ == 0 ? "" : ",");
+		for (size_t k = 0; k < section.name.size(); k ++) {
+			char ch = section.name[k];
+			if (ch == '"' || ch == '\\') {
+				fputc('\\', fp);
+			}
+			fputc(ch, fp);
+		}
+		fprintf(fp, "\", \"calls\": %ld, \"seconds\": %.9g", section.numCalls, section.seconds);
+		if (bCounters) {
+			for (int c = 0; c < NUM_PROFILE_COUNTERS; c ++) {
+				fprintf(fp, ", \"%s\": %lld", counterNames[c], section.counters[c]);
+			}
+		}
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+	fclose(fp);
+}
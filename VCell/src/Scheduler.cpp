@@ -14,6 +14,7 @@
 #include <VCELL/SimTool.h>
 #include <VCELL/CartesianMesh.h>
 #include <VCELL/Element.h>
+#include <VCELL/Profiler.h>
 
 Scheduler::Scheduler(Simulation *Asim)
 {
@@ -85,6 +86,9 @@ void Scheduler::initValues()
 
 void Scheduler::solveFastSystem(int volStart, int volSize, int memStart, int memSize)
 {
+	static ProfileHandle profileHandle = Profiler::getHandle("fastSystem");
+	ProfileScope profileScope(profileHandle);
+
 	Feature *feature = NULL;
 	FastSystem *fs = NULL;
 	Mesh *mesh = sim->getMesh();
@@ -94,38 +98,55 @@ void Scheduler::solveFastSystem(int volStart, int volSize, int memStart, int mem
 	ASSERTION(volStart >= 0 && (volStart+volSize) <= mesh->getNumVolumeElements());
 	ASSERTION(memStart >= 0 && (memStart+memSize) <= mesh->getNumMembraneElements());
 	//
-	// perform pseudo-steady approximation on volume elements
+	// perform pseudo-steady approximation on volume elements,
+	// all the elements of a fast system at once
 	//
-	VolumeElement *pVolumeElement = mesh->getVolumeElements();
+	VolumeElement *pVolumeElement = mesh->getVolumeElements() + volStart;
 	long i;
 	for (i=volStart;i < volStart+volSize;i++){
 		feature = pVolumeElement->getFeature();
 		ASSERTION(feature);
 		if (fs = feature->getFastSystem()){
-			fs->setCurrIndex(i);
-			WorldCoord wc = mesh->getVolumeWorldCoord(i);
-			fs->setCoordinates(sim->getTime_sec(), wc);
-			fs->initVars();			
-			fs->solveSystem();
-			fs->updateVars();			
+			addFastSystemElement(fs, i);
 		}
 		pVolumeElement++;
 	}
+	solveFastSystemElements(false);
 	//
 	// perform pseudo-steady approximation on membrane elements
 	//
-	MembraneElement *pMembraneElement = mesh->getMembraneElements();
+	MembraneElement *pMembraneElement = mesh->getMembraneElements() + memStart;
 	for (i=memStart;i < memStart+memSize;i++){
 		Membrane* membrane = pMembraneElement->getMembrane();
 		ASSERTION(membrane);
 		if (fs = membrane->getFastSystem()){
-			fs->setCurrIndex(i);
-			WorldCoord wc = mesh->getMembraneWorldCoord(i);
-			fs->setCoordinates(sim->getTime_sec(), wc);
-			fs->initVars();
-			fs->solveSystem();
-			fs->updateVars();			
+			addFastSystemElement(fs, i);
 		}
 		pMembraneElement++;
 	}
+	solveFastSystemElements(true);
+}
+
+void Scheduler::addFastSystemElement(FastSystem* fs, long index)
+{
+	int k = 0;
+	while (k < (int)fastSystems.size() && fastSystems[k] != fs) {
+		k ++;
+	}
+	if (k == (int)fastSystems.size()) {
+		fastSystems.push_back(fs);
+		fastSystemElements.push_back(vector<long>());
+	}
+	fastSystemElements[k].push_back(index);
+}
+
+void Scheduler::solveFastSystemElements(bool bMembrane)
+{
+	for (int k = 0; k < (int)fastSystems.size(); k ++) {
+		vector<long>& elements = fastSystemElements[k];
+		if (!elements.empty()) {
+			fastSystems[k]->solveElements(sim, (int)elements.size(), &elements[0], bMembrane);
+			elements.clear();
+		}
+	}
 }
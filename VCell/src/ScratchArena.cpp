@@ -0,0 +1,84 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/ScratchArena.h>
+
+#include <string.h>
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t blockSize)
+{
+	this->blockSize = std::max<size_t>(blockSize, SCRATCH_ARENA_ALIGNMENT);
+	currentBlock = 0;
+	numAllocations = 0;
+	bytesInUse = 0;
+	peakBytesInUse = 0;
+}
+
+ScratchArena::~ScratchArena()
+{
+	for (size_t i = 0; i < blocks.size(); i ++) {
+		delete[] blocks[i].memory;
+	}
+}
+
+void* ScratchArena::allocateBytes(size_t bytes)
+{
+	bytes = (bytes + SCRATCH_ARENA_ALIGNMENT - 1) / SCRATCH_ARENA_ALIGNMENT * SCRATCH_ARENA_ALIGNMENT;
+
+	// the rest of a block that is too small stays unused until it is released
+	while (currentBlock < blocks.size() && blocks[currentBlock].size - blocks[currentBlock].used < bytes) {
+		currentBlock ++;
+	}
+	if (currentBlock == blocks.size()) {
+		Block block;
+		block.size = std::max(blockSize, bytes);
+		block.memory = new char[block.size + SCRATCH_ARENA_ALIGNMENT];
+		size_t misalignment = (size_t)block.memory % SCRATCH_ARENA_ALIGNMENT;
+		block.data = block.memory + (misalignment == 0 ? 0 : SCRATCH_ARENA_ALIGNMENT - misalignment);
+		block.used = 0;
+		blocks.push_back(block);
+	}
+
+	Block& block = blocks[currentBlock];
+	char* p = block.data + block.used;
+	block.used += bytes;
+	memset(p, 0, bytes);
+
+	numAllocations ++;
+	bytesInUse += bytes;
+	peakBytesInUse = std::max(peakBytesInUse, bytesInUse);
+	return p;
+}
+
+ScratchArena::Mark ScratchArena::mark()
+{
+	Mark m;
+	m.block = currentBlock;
+	m.used = currentBlock < blocks.size() ? blocks[currentBlock].used : 0;
+	return m;
+}
+
+void ScratchArena::release(const Mark& m)
+{
+	currentBlock = m.block;
+	bytesInUse = 0;
+	for (size_t i = 0; i < blocks.size(); i ++) {
+		if (i > currentBlock) {
+			blocks[i].used = 0;
+		} else if (i == currentBlock) {
+			blocks[i].used = m.used;
+		}
+		bytesInUse += blocks[i].used;
+	}
+}
+
+size_t ScratchArena::getCapacity()
+{
+	size_t capacity = 0;
+	for (size_t i = 0; i < blocks.size(); i ++) {
+		capacity += blocks[i].size;
+	}
+	return capacity;
+}
@@ -0,0 +1,192 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SimDataHdf5Writer.h>
+#include <VCELL/PostProcessingHdf5Writer.h>
+#include <VCELL/FVDataSet.h>
+#include <VCELL/Simulation.h>
+#include <VCELL/Variable.h>
+#include <H5Cpp.h>
+#include <algorithm>
+#include <iostream>
+#include <utility>
+using std::cout;
+using std::endl;
+#include <sys/stat.h>
+
+#define SIM_DATA_ROOT "/SimData"
+// values in a chunk of a variable dataset
+#define SIM_DATA_CHUNK_SIZE 65536
+// most save points in a chunk
+#define SIM_DATA_CHUNK_TIMES 16
+
+const char* SimDataHdf5Writer::SimDataGroupName = SIM_DATA_ROOT;
+const char* SimDataHdf5Writer::TimesDataSetName = SIM_DATA_ROOT"/Times";
+const char* SimDataHdf5Writer::VariablesGroupName = SIM_DATA_ROOT"/Variables";
+
+SimDataHdf5Writer::SimDataHdf5Writer(string fileName, int deflateLevel) {
+	this->h5FileName = std::move(fileName);
+	this->deflateLevel = deflateLevel;
+	numTimes = 0;
+	h5File = NULL;
+	timesDataSet = NULL;
+}
+
+SimDataHdf5Writer::~SimDataHdf5Writer() {
+	close();
+}
+
+void SimDataHdf5Writer::close() {
+	for (int i = 0; i < (int)dataSets.size(); i ++) {
+		delete dataSets[i];
+	}
+	dataSets.clear();
+	delete timesDataSet;
+	delete h5File;
+	timesDataSet = NULL;
+	h5File = NULL;
+	numTimes = 0;
+}
+
+void SimDataHdf5Writer::openDataSets(FVDataSetSnapshot& snapshot) {
+	if (h5File == NULL) {
+		if (deflateLevel > 0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) {
+			throw "SimDataHdf5Writer : the hdf5 library has no deflate filter";
+		}
+		h5File = new H5::H5File(h5FileName.c_str(), H5F_ACC_TRUNC);
+		h5File->createGroup(SimDataGroupName);
+		h5File->createGroup(VariablesGroupName);
+		timesDataSet = PostProcessingHdf5Writer::createTimesDataSet(h5File, TimesDataSetName);
+		numTimes = 0;
+	}
+	if (!dataSets.empty()) {
+		return;
+	}
+
+	H5::DataSpace attributeDataSpace(H5S_SCALAR);
+	for (int i = 0; i < (int)snapshot.dataBlocks.size(); i ++) {
+		DataBlock& dataBlock = snapshot.dataBlocks[i];
+
+		// create dataset /SimData/Variables/Cell::Dex, unless loadFinal() reopened the file
+		string dataSetName = string(VariablesGroupName) + "/" + dataBlock.varName;
+		if (H5Lexists(h5File->getId(), dataSetName.c_str(), H5P_DEFAULT) > 0) {
+			dataSets.push_back(new H5::DataSet(h5File->openDataSet(dataSetName.c_str())));
+			continue;
+		}
+
+		// a row per save point; an empty block can't have fixed size chunks
+		hsize_t size = dataBlock.size;
+		hsize_t dims[2] = {(hsize_t)numTimes, size};
+		hsize_t maxDims[2] = {H5S_UNLIMITED, size == 0 ? H5S_UNLIMITED : size};
+		H5::DataSpace dataSpace(2, dims, maxDims);
+		H5::DSetCreatPropList cparms;
+		hsize_t chunkDims[2];
+		chunkDims[1] = std::max((hsize_t)1, std::min(size, (hsize_t)SIM_DATA_CHUNK_SIZE));
+		chunkDims[0] = std::max((hsize_t)1, std::min((hsize_t)SIM_DATA_CHUNK_TIMES, SIM_DATA_CHUNK_SIZE / chunkDims[1]));
+		cparms.setChunk(2, chunkDims);
+		if (deflateLevel > 0) {
+			cparms.setShuffle();
+			cparms.setDeflate(deflateLevel);
+		}
+		H5::DataSet* dataSet = new H5::DataSet(h5File->createDataSet(dataSetName.c_str(), H5::PredType::NATIVE_DOUBLE, dataSpace, cparms));
+		dataSets.push_back(dataSet);
+
+		int varType = dataBlock.varType;
+		H5::Attribute attribute = dataSet->createAttribute("VariableType", H5::PredType::NATIVE_INT, attributeDataSpace);
+		attribute.write(H5::PredType::NATIVE_INT, &varType);
+	}
+}
+
+int SimDataHdf5Writer::writeOutput(double time, FVDataSetSnapshot& snapshot) {
+	try {
+		openDataSets(snapshot);
+
+		int timeIndex = numTimes;
+		PostProcessingHdf5Writer::writeTime(timesDataSet, timeIndex, time);
+
+		double* data = snapshot.data.empty() ? 0 : &snapshot.data[0];
+		for (int i = 0; i < (int)dataSets.size(); i ++) {
+			hsize_t size = snapshot.dataBlocks[i].size;
+			hsize_t dims[2] = {(hsize_t)timeIndex + 1, size};
+			dataSets[i]->extend(dims);
+			if (size > 0) {
+				hsize_t count[2] = {1, size};
+				hsize_t offset[2] = {(hsize_t)timeIndex, 0};
+				H5::DataSpace fspace = dataSets[i]->getSpace();
+				fspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+				H5::DataSpace mspace(2, count);
+				dataSets[i]->write(data, H5::PredType::NATIVE_DOUBLE, mspace, fspace);
+			}
+			data += size;
+		}
+
+		// on disk before the log lists it
+		h5File->flush(H5F_SCOPE_GLOBAL);
+		numTimes ++;
+		return timeIndex;
+	} catch(H5::Exception error ) {
+		throw error.getDetailMsg();
+	}
+}
+
+bool SimDataHdf5Writer::loadFinal(int numTimes, Simulation* sim) {
+	close();
+
+	struct stat buf;
+	// file doesn't exist
+	if (stat(h5FileName.c_str(), &buf) || buf.st_size == 0) {
+		return false;
+	}
+
+	try {
+		h5File = new H5::H5File(h5FileName.c_str(), H5F_ACC_RDWR);
+		timesDataSet = new H5::DataSet(h5File->openDataSet(TimesDataSetName));
+
+		// the log lists numTimes save points, a crash may have left more in the file
+		hsize_t timesDim;
+		timesDataSet->getSpace().getSimpleExtentDims(&timesDim, NULL);
+		if (timesDim < (hsize_t)numTimes) {
+			cout << "sim data hdf5 times don't match" << endl;
+			close();
+			return false;
+		}
+		hsize_t size = numTimes;
+		H5Dset_extent(timesDataSet->getId(), &size);
+
+		H5::Group variablesGroup = h5File->openGroup(VariablesGroupName);
+		for (hsize_t i = 0; i < variablesGroup.getNumObjs(); i ++) {
+			string dataSetName = variablesGroup.getObjnameByIdx(i);
+			H5::DataSet dataSet = variablesGroup.openDataSet(dataSetName);
+			hsize_t dims[2];
+			dataSet.getSpace().getSimpleExtentDims(dims, NULL);
+			if (dims[0] < (hsize_t)numTimes) {
+				cout << "sim data hdf5 times don't match for " << dataSetName << endl;
+				close();
+				return false;
+			}
+			dims[0] = numTimes;
+			H5Dset_extent(dataSet.getId(), dims);
+
+			Variable* var = FVDataSet::findVariable(sim, dataSetName.c_str(), (int)dims[1]);
+			if (var == NULL) {
+				continue;
+			}
+			hsize_t count[2] = {1, dims[1]};
+			hsize_t offset[2] = {(hsize_t)numTimes - 1, 0};
+			H5::DataSpace fspace = dataSet.getSpace();
+			fspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+			H5::DataSpace mspace(2, count);
+			dataSet.read(var->getCurr(), H5::PredType::NATIVE_DOUBLE, mspace, fspace);
+			var->update();
+			cout << "read data for variable '" << var->getName() << "'" << endl;
+		}
+		h5File->flush(H5F_SCOPE_GLOBAL);
+	} catch(H5::Exception error ) {
+		cout << "failed to reload sim data: " << error.getDetailMsg() << endl;
+		close();
+		return false;
+	}
+	this->numTimes = numTimes;
+	return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SimOutputPipeline.h>
+
+#include <exception>
+#include <iostream>
+using std::cout;
+using std::endl;
+
+SimOutputPipeline::SimOutputPipeline(int numBuffers, WriteFunction arg_write)
+{
+	write = arg_write;
+	for (int i = 0; i < numBuffers; i ++) {
+		buffers.push_back(new SimOutputBuffer());
+	}
+	freeBuffers = buffers;
+	bWriting = false;
+	bStop = false;
+	thread = std::thread(&SimOutputPipeline::run, this);
+}
+
+SimOutputPipeline::~SimOutputPipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStop = true;
+	}
+	condition.notify_all();
+	thread.join();
+	if (!error.empty()) {
+		cout << "SimOutputPipeline : " << error << endl;
+	}
+	for (int i = 0; i < (int)buffers.size(); i ++) {
+		delete buffers[i];
+	}
+}
+
+SimOutputBuffer* SimOutputPipeline::acquire()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return !freeBuffers.empty() || !error.empty(); });
+	if (!error.empty()) {
+		throw error;
+	}
+	SimOutputBuffer* buffer = freeBuffers.back();
+	freeBuffers.pop_back();
+	return buffer;
+}
+
+void SimOutputPipeline::submit(SimOutputBuffer* buffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(buffer);
+	}
+	condition.notify_all();
+}
+
+void SimOutputPipeline::finish()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return queue.empty() && !bWriting; });
+	if (!error.empty()) {
+		throw error;
+	}
+}
+
+bool SimOutputPipeline::nextWritten(double& progress, double& time)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (written.empty()) {
+		return false;
+	}
+	progress = written.front().first;
+	time = written.front().second;
+	written.pop_front();
+	return true;
+}
+
+void SimOutputPipeline::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this] { return bStop || !queue.empty(); });
+		if (queue.empty()) {
+			return;
+		}
+		SimOutputBuffer* buffer = queue.front();
+		queue.pop_front();
+		if (error.empty()) {
+			bWriting = true;
+			lock.unlock();
+			bool bSuccess = false;
+			string message;
+			try {
+				write(*buffer);
+				bSuccess = true;
+			} catch (const char* ex) {
+				message = ex;
+			} catch (string& ex) {
+				message = ex;
+			} catch (std::exception& ex) {
+				message = ex.what();
+			} catch (...) {
+				message = "unknown error";
+			}
+			lock.lock();
+			bWriting = false;
+			if (bSuccess) {
+				written.push_back(std::make_pair(buffer->progress, buffer->time));
+			} else {
+				error = message.empty() ? string("unknown error") : message;
+			}
+		}
+		freeBuffers.push_back(buffer);
+		condition.notify_all();
+	}
+}
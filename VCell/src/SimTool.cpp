@@ -24,6 +24,9 @@ using std::endl;
 #include <VCELL/FVUtils.h>
 #include <VCELL/PostProcessingBlock.h>
 #include <VCELL/PostProcessingHdf5Writer.h>
+#include <VCELL/SimDataHdf5Writer.h>
+#include <VCELL/SimOutputPipeline.h>
+#include <VCELL/Profiler.h>
 #include <VCELL/VolumeParticleVariable.h>
 #include <VCELL/MembraneParticleVariable.h>
 #include <VCELL/Element.h>
@@ -39,11 +42,18 @@ using std::endl;
 #include <VCELL/ZipUtils.h>
 
 #include <algorithm>
+#include <vector>
 using std::min;
 using std::max;
 
 #if ( !defined(WIN32) && !defined(WIN64) ) // UNIX
 #include <unistd.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <time.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
 #endif
 
 #define ZIP_FILE_LIMIT 1E9
@@ -56,6 +66,8 @@ using std::max;
 #define ZIP_FILE_EXT ".zip"
 #define TID_FILE_EXT ".tid"
 #define HDF5_FILE_EXT ".hdf5"
+#define SIMDATA_HDF5_FILE_EXT ".simdata.hdf5"
+#define PROFILE_FILE_EXT ".profile.json"
 
 /*
 #ifdef VCELL_HYBRID
@@ -110,17 +122,31 @@ SimTool::SimTool()
 
 	bSundialsOneStepOutput(false),
 	keepAtMost(5000),
+	bCompileExpressions(false),
+	linearSolver(LINEAR_SOLVER_PCGPAK),
+	numSlabs(1),
+	bProfile(false),
+	bProfileHardwareCounters(false),
 
 	 serialScanParameterValues(0),
 	numSerialParameterScans(0),
+	numParallelScans(1),
 
 	postProcessingHdf5Writer(0),
+	bSimDataHdf5(false),
+	simDataDeflateLevel(0),
+	simDataHdf5Writer(0),
 	smoldynSim(0 ),
-	smoldynInputFile("" )
+	smoldynInputFile("" ),
+
+	numOutputBuffers(0),
+	outputPipeline(0),
+	syncOutputBuffer(new SimOutputBuffer())
 { }
 
 SimTool::~SimTool()
 {
+	delete syncOutputBuffer;
 	if (baseSimName != baseDirName) {
 		delete[] baseSimName;
 	}
@@ -135,6 +161,12 @@ SimTool::~SimTool()
 	delete[] serialScanParameterValues;
 
 	delete postProcessingHdf5Writer;
+	delete simDataHdf5Writer;
+
+	// another simulation may run in the same process (bench)
+	if (instance == this) {
+		instance = 0;
+	}
 }
 
 void SimTool::setModel(VCellModel* model) {
@@ -327,7 +359,7 @@ void SimTool::loadFinal()
 	std::string logFileName{baseFileName};
 	logFileName.append(LOG_FILE_EXT);
 	std::string zipFileName{baseFileName};
-	const std::string dataFileName;
+	std::string dataFileName;
 
 
 	FILE* tidFP = lockForReadWrite();
@@ -338,7 +370,9 @@ void SimTool::loadFinal()
 		struct stat buf;
 		zipFileName.append("00").append(ZIP_FILE_EXT);
 
-		if (stat(zipFileName.c_str(), &buf)) {
+		if (simDataHdf5Writer != NULL) {
+			NUM_TOKENS_PER_LINE = 3;
+		} else if (stat(zipFileName.c_str(), &buf)) {
 			bSimZip = false;
 			NUM_TOKENS_PER_LINE = 3;
 		} else {
@@ -348,6 +382,7 @@ void SimTool::loadFinal()
 
 		simStartTime = -1;
 		int tempIteration = -1, tempFileCount = 0, tempZipCount = 0;
+		int tempTimeIndex = -1;
 		int numTimes = 0;
 
 		while (!feof(logFP)){
@@ -364,10 +399,20 @@ void SimTool::loadFinal()
 				// parse iteration number and time
 				//
 				int numTokens = 0;
-				if (bSimZip) {
-					numTokens = sscanf(logBuffer, "%d %s %s %lg", &tempIteration, dataFileName.c_str(), zipFileName.c_str(), &simStartTime);
+				char dataFileBuffer[1024], zipFileBuffer[1024];
+				if (simDataHdf5Writer != NULL) {
+					numTokens = sscanf(logBuffer, "%d %*s %d %lg", &tempIteration, &tempTimeIndex, &simStartTime);
+				} else if (bSimZip) {
+					numTokens = sscanf(logBuffer, "%d %1023s %1023s %lg", &tempIteration, dataFileBuffer, zipFileBuffer, &simStartTime);
+					if (numTokens == NUM_TOKENS_PER_LINE) {
+						dataFileName = dataFileBuffer;
+						zipFileName = zipFileBuffer;
+					}
 				} else {
-					numTokens = sscanf(logBuffer, "%d %s %lg", &tempIteration, dataFileName.c_str(), &simStartTime);
+					numTokens = sscanf(logBuffer, "%d %1023s %lg", &tempIteration, dataFileBuffer, &simStartTime);
+					if (numTokens == NUM_TOKENS_PER_LINE) {
+						dataFileName = dataFileBuffer;
+					}
 				}
 				if (numTokens != NUM_TOKENS_PER_LINE){
 					printf("SimTool::load(), error reading log file %s, reading iteration\n", logFileName.c_str());
@@ -386,7 +431,29 @@ void SimTool::loadFinal()
 			bStartOver = true;
 		}
 
-		if (!bStartOver) {
+		if (!bStartOver && simDataHdf5Writer != NULL) {
+			// the save points are rows of the hdf5 file, keyed by time index
+			try {
+				bStartOver = tempTimeIndex != numTimes - 1 || !simDataHdf5Writer->loadFinal(numTimes, simulation);
+				if (!bStartOver && postProcessingHdf5Writer != NULL) {
+					bStartOver = !postProcessingHdf5Writer->loadFinal(numTimes);
+				}
+				if (!bStartOver) {
+					simulation->setCurrIteration(tempIteration);
+					// set start time on sundials
+					if (isSundialsPdeSolver() || isVCellPetscSolver()) {
+						simulation->setSimStartTime(simStartTime);
+					}
+					simFileCount = tempFileCount;
+				}
+			} catch (const char* msg) {
+				cout << "SimTool::loadFinal() : reading " << simDataHdf5Writer->getFileName() << " failed : " << msg << endl;
+				bStartOver = true;
+			} catch (...) {
+				cout << "SimTool::loadFinal() : reading " << simDataHdf5Writer->getFileName() << " failed : unexpected error" << endl;
+				bStartOver = true;
+			}
+		} else if (!bStartOver) {
 			if (bSimZip) {
 				// check if zip file exists
 				std::string zipFileAbsoluteName;
@@ -522,14 +589,11 @@ std::string getFileName(const std::string& path){
 
 void SimTool::updateLog(double progress, double time, int iteration)
 {
+	static ProfileHandle profileHandle = Profiler::getHandle("updateLog");
+	ProfileScope profileScope(profileHandle);
 	if (bStoreEnable) {
-		FILE *logFP;
 		std::string simFileName;
 
-		bool bSuccess = true;
-		std::string errorMsg;
-		FILE* tidFP = lockForReadWrite();
-
 		struct stat buf;
 #if ( defined(WIN32) || defined(WIN64) ) // Windows
 		wstring TempPath;
@@ -565,7 +629,9 @@ void SimTool::updateLog(double progress, double time, int iteration)
 
 		std::stringstream simFileNameStream;
 		// write sim files to local
-		if (bSimZip && bUseTempDir) {
+		if (simDataHdf5Writer != NULL) {
+			simFileNameStream << simDataHdf5Writer->getFileName();
+		} else if (bSimZip && bUseTempDir) {
 			simFileNameStream << tempDir << getFileName(baseSimName) << std::setfill('0') << std::setw(4) << simFileCount << SIM_FILE_EXT;
 		} else {
 			simFileNameStream << baseFileName << std::setfill('0') << std::setw(4) << simFileCount << SIM_FILE_EXT;
@@ -573,88 +639,155 @@ void SimTool::updateLog(double progress, double time, int iteration)
 		simFileName = simFileNameStream.str();
 		std::cout << "sim file name is " << simFileName << std::endl;
 
-		std::string particleFileName{simFileName};
-		particleFileName.append(PARTICLE_FILE_EXT);
-		
-		simulation->writeData(simFileName.c_str(), bSimFileCompress);
+		// take the data of the save point, then write it here or in the background
+		SimOutputBuffer* buffer = outputPipeline == NULL ? syncOutputBuffer : outputPipeline->acquire();
+		buffer->progress = progress;
+		buffer->time = time;
+		buffer->iteration = iteration;
+		buffer->simFileCount = simFileCount;
+		buffer->simFileName = simFileName;
+		FVDataSet::snapshot((SimulationExpression*)simulation, buffer->dataSet);
+		// post processing is only written with zip files or the hdf5 file
+		buffer->bPostProcessing = (bSimZip || simDataHdf5Writer != NULL) && postProcessingHdf5Writer != NULL;
+		if (buffer->bPostProcessing) {
+			postProcessingHdf5Writer->computeOutput(buffer->postProcessing);
+		}
 
-		std::string logFileName{baseFileName};
-		logFileName.append(LOG_FILE_EXT);
+		if (outputPipeline != NULL) {
+			outputPipeline->submit(buffer);
+			simFileCount++;
+			sendOutputEvents();
+			return;
+		}
+		writeSavePoint(*buffer);
+		simFileCount++;
+	} else{
+		// write hdf5 post processing before writing log entry
+		if (postProcessingHdf5Writer != NULL) {
+			postProcessingHdf5Writer->writeOutput();
+		}
 
-		logFP = openFileWithRetry(logFileName.c_str(), "a");
+	}
 
-		if (logFP == 0) {
-			errorMsg.append("SimTool::updateLog() - error opening log file <").append(logFileName).append(">");
-			bSuccess = false;
-		} else {
-		   // write zip file first, then write log file, in case that
-		   // zipping fails
-			if (bSimZip) {
-				//int retcode = 0;
-				std::stringstream zipFileNameStream;
-				zipFileNameStream << baseFileName << std::setfill('0') << std::setw(2) << zipFileCount << ZIP_FILE_EXT;
-				std::string zipFileName{zipFileNameStream.str()};
-				if (stat(particleFileName.c_str(), &buf) == 0) {	// has particle
-				//	retcode = zip32(2, zipFileName, simFileName, particleFileName);
-					addFilesToZip(zipFileName.c_str(), simFileName.c_str(), particleFileName.c_str());
-					remove(particleFileName.c_str());
-				} else {
-					bSuccess = zipUnzipWithRetry(true, zipFileName.c_str(), simFileName.c_str(), &errorMsg);
-				}
-				remove(simFileName.c_str());
+	SimulationMessaging::getInstVar()->setWorkerEvent(new WorkerEvent(JOB_DATA, progress, time));
+}
 
-				// write the log file
-				if (bSuccess) {
-					// write hdf5 post processing before writing log entry
-					if (postProcessingHdf5Writer != NULL) {
-						postProcessingHdf5Writer->writeOutput();
-					}
+/*
+ * writes the .sim file of a save point, adds it to the zip file, appends the
+ * post processing data and then the log entry, so that the log only lists
+ * complete data; runs in the output pipeline thread if there is one
+ */
+void SimTool::writeSavePoint(SimOutputBuffer& buffer)
+{
+	static ProfileHandle profileHandle = Profiler::getHandle("writeSavePoint");
+	ProfileScope profileScope(profileHandle);
+	FILE *logFP;
+	const std::string& simFileName = buffer.simFileName;
 
+	bool bSuccess = true;
+	std::string errorMsg;
+	FILE* tidFP = lockForReadWrite();
 
+	struct stat buf;
+	std::string particleFileName{simFileName};
+	particleFileName.append(PARTICLE_FILE_EXT);
+	
+	if (simDataHdf5Writer == NULL) {
+		FVDataSet::write(simFileName.c_str(), buffer.dataSet, bSimFileCompress);
+	}
 
-					std::stringstream zipFileNameWithoutPathStream;
-					zipFileNameWithoutPathStream << baseSimName << std::setfill('0') << std::setw(2) <<
-						zipFileCount << ZIP_FILE_EXT;
-					std::stringstream simFileNameWithoutPathStream;
-					simFileNameWithoutPathStream << baseSimName << std::setfill('0') << std::setw(4) <<
-						simFileCount << SIM_FILE_EXT;
-					fprintf(logFP,"%4d %s %s %.15lg\n", iteration, simFileNameWithoutPathStream.str().c_str(),
-						zipFileNameWithoutPathStream.str().c_str(), time);
+	std::string logFileName{baseFileName};
+	logFileName.append(LOG_FILE_EXT);
 
-					if (stat(zipFileName.c_str(), &buf) == 0) { // if exists
-						if (buf.st_size > ZIP_FILE_LIMIT) {
-							zipFileCount ++;
-						}
-					}
+	logFP = openFileWithRetry(logFileName.c_str(), "a");
+
+	if (logFP == 0) {
+		errorMsg.append("SimTool::updateLog() - error opening log file <").append(logFileName).append(">");
+		bSuccess = false;
+	} else if (simDataHdf5Writer != NULL) {
+		// append to the hdf5 files, then write the log entry
+		try {
+			int timeIndex = simDataHdf5Writer->writeOutput(buffer.time, buffer.dataSet);
+			if (buffer.bPostProcessing) {
+				postProcessingHdf5Writer->writeOutput(buffer.postProcessing);
+			}
+			fprintf(logFP,"%4d %s%s %d %.15lg\n", buffer.iteration, baseSimName, SIMDATA_HDF5_FILE_EXT, timeIndex, buffer.time);
+		} catch (const char* msg) {
+			errorMsg.append(msg);
+			bSuccess = false;
+		} catch (std::string& msg) {
+			errorMsg = msg;
+			bSuccess = false;
+		}
+	} else {
+	   // write zip file first, then write log file, in case that
+	   // zipping fails
+		if (bSimZip) {
+			//int retcode = 0;
+			std::stringstream zipFileNameStream;
+			zipFileNameStream << baseFileName << std::setfill('0') << std::setw(2) << zipFileCount << ZIP_FILE_EXT;
+			std::string zipFileName{zipFileNameStream.str()};
+			if (stat(particleFileName.c_str(), &buf) == 0) {	// has particle
+			//	retcode = zip32(2, zipFileName, simFileName, particleFileName);
+				addFilesToZip(zipFileName.c_str(), simFileName.c_str(), particleFileName.c_str());
+				remove(particleFileName.c_str());
+			} else {
+				bSuccess = zipUnzipWithRetry(true, zipFileName.c_str(), simFileName.c_str(), &errorMsg);
+			}
+			remove(simFileName.c_str());
+
+			// write the log file
+			if (bSuccess) {
+				// write hdf5 post processing before writing log entry
+				if (buffer.bPostProcessing) {
+					postProcessingHdf5Writer->writeOutput(buffer.postProcessing);
 				}
-			} else { // old format, no zip
+
+
+
+				std::stringstream zipFileNameWithoutPathStream;
+				zipFileNameWithoutPathStream << baseSimName << std::setfill('0') << std::setw(2) <<
+					zipFileCount << ZIP_FILE_EXT;
 				std::stringstream simFileNameWithoutPathStream;
 				simFileNameWithoutPathStream << baseSimName << std::setfill('0') << std::setw(4) <<
-					simFileCount << SIM_FILE_EXT;
-				fprintf(logFP,"%4d %s %.15lg\n", iteration,
-					simFileNameWithoutPathStream.str().c_str(), time);
+					buffer.simFileCount << SIM_FILE_EXT;
+				fprintf(logFP,"%4d %s %s %.15lg\n", buffer.iteration, simFileNameWithoutPathStream.str().c_str(),
+					zipFileNameWithoutPathStream.str().c_str(), buffer.time);
+
+				if (stat(zipFileName.c_str(), &buf) == 0) { // if exists
+					if (buf.st_size > ZIP_FILE_LIMIT) {
+						zipFileCount ++;
+					}
+				}
 			}
+		} else { // old format, no zip
+			std::stringstream simFileNameWithoutPathStream;
+			simFileNameWithoutPathStream << baseSimName << std::setfill('0') << std::setw(4) <<
+				buffer.simFileCount << SIM_FILE_EXT;
+			fprintf(logFP,"%4d %s %.15lg\n", buffer.iteration,
+				simFileNameWithoutPathStream.str().c_str(), buffer.time);
 		}
-		// close log file
+	}
+	// close log file
+	if (logFP != 0) {
 		fclose(logFP);
-		// close tid file
-		if (tidFP != 0) {
-			fclose(tidFP);
-		}
-		if (bSuccess) {
-			simFileCount++;
-		} else {
-			throw errorMsg.c_str();
-		}
-	} else{
-		// write hdf5 post processing before writing log entry
-		if (postProcessingHdf5Writer != NULL) {
-			postProcessingHdf5Writer->writeOutput();
-		}
-
 	}
+	// close tid file
+	if (tidFP != 0) {
+		fclose(tidFP);
+	}
+	if (!bSuccess) {
+		throw errorMsg;
+	}
+}
 
-	SimulationMessaging::getInstVar()->setWorkerEvent(new WorkerEvent(JOB_DATA, progress, time));
+// JOB_DATA for the save points the output pipeline has written
+void SimTool::sendOutputEvents()
+{
+	double progress, time;
+	while (outputPipeline->nextWritten(progress, time)) {
+		SimulationMessaging::getInstVar()->setWorkerEvent(new WorkerEvent(JOB_DATA, progress, time));
+	}
 }
 
 int SimTool::getZipCount(char* zipFileName) {
@@ -671,7 +804,7 @@ int SimTool::getZipCount(char* zipFileName) {
 
 int SimTool::getZipCount(const std::string* zipFileName) {
 	// We need a char buffer because underlying ststr() call needs non-const char-ptr
-	char buffer[zipFileName->size()]; // C99 is great
+	char buffer[zipFileName->size() + 1]; // C99 is great
 	strcpy(buffer, zipFileName->c_str());
 	return this->getZipCount(buffer);
 }
@@ -709,29 +842,39 @@ void SimTool::clearLog()
 
 	logFileName.append(baseFileName).append(LOG_FILE_EXT);
 
+	// all the save points are in the hdf5 file
+	if (simDataHdf5Writer != NULL) {
+		simDataHdf5Writer->close();
+		remove(simDataHdf5Writer->getFileName().c_str());
+		printf("SimTool::clearLog(), removing log file %s\n",logFileName.c_str());
+		remove(logFileName.c_str());
+		return;
+	}
+
 	if ((fp=fopen(logFileName.c_str(), "r")) == NULL){
 		printf("error opening log file <%s>\n", logFileName.c_str());
 		return;
 	}
 
-	std::string simFileName;
 	std::string zipFileName;
 	int iteration, oldCount=-1;
 	double time;
 
 	while (true) {
 		int numTokens  = 0;
+		char simFileNameCharArray[1024], zipFileNameCharArray[1024];
 		if (bSimZip) {
-			numTokens =  fscanf(fp,"%d %s %s %lg\n", &iteration, simFileName.c_str(), zipFileName.c_str(), &time);
+			numTokens =  fscanf(fp,"%d %1023s %1023s %lg\n", &iteration, simFileNameCharArray, zipFileNameCharArray, &time);
 		} else {
-			numTokens =  fscanf(fp,"%d %s %lg\n", &iteration, simFileName.c_str(), &time);
+			numTokens =  fscanf(fp,"%d %1023s %lg\n", &iteration, simFileNameCharArray, &time);
 		}
 		if (numTokens != NUM_TOKENS_PER_LINE){
 			break;
 		}
+		if (bSimZip) {
+			zipFileName = zipFileNameCharArray;
+		}
 
-		char simFileNameCharArray[simFileName.size()];
-		strcpy(simFileNameCharArray, simFileName.c_str());
 		char *dotSim = strstr(simFileNameCharArray, SIM_FILE_EXT);
 		if (!dotSim) continue;
 
@@ -790,24 +933,140 @@ void SimTool::start() {
         SimulationExpression* sim = (SimulationExpression*)simulation;
         sim->setParameterValues(serialScanParameterValues[SimulationMessaging::getInstVar()->getJobIndex()]);
 		start1();
+	} else if (numParallelScans != 1) {
+		// Is paramScan, local run with the scans run at the same time
+		startParallelScans();
 	} else {
         // Is paramScan, the .fvinput had SERIAL_SCAN_PARAMETER_... section
-        // Is also a local (blue-button) run where each paramScan is run in the following loop
-		SimulationExpression* sim = (SimulationExpression*)simulation;
-		for (int scan = 0; scan < numSerialParameterScans; scan ++) {
-			if (scan > 0) {
-				string bfn(baseFileName);
-				char oldIndex[10], newIndex[10];
-				sprintf(oldIndex, "_%d_\0", scan - 1);
-				sprintf(newIndex, "_%d_\0", scan);
-				int p = (int)bfn.rfind(oldIndex);
-				bfn.replace(p, strlen(oldIndex), newIndex);
-				setBaseFilename((char*)bfn.c_str());
+        // Is also a local (blue-button) run where each paramScan is run in turn
+		startSerialScans();
+	}
+}
+
+/*
+ * runs the serial parameter scans of a local run one after another, each with
+ * its own output files, post processing included, as when they run in parallel.
+ */
+void SimTool::startSerialScans() {
+	SimulationExpression* sim = (SimulationExpression*)simulation;
+	for (int scan = 0; scan < numSerialParameterScans; scan ++) {
+		if (scan > 0) {
+			string bfn(baseFileName);
+			char oldIndex[10], newIndex[10];
+			sprintf(oldIndex, "_%d_\0", scan - 1);
+			sprintf(newIndex, "_%d_\0", scan);
+			int p = (int)bfn.rfind(oldIndex);
+			bfn.replace(p, strlen(oldIndex), newIndex);
+			setBaseFilename((char*)bfn.c_str());
+			// runSimulation() opens the post processing file of this scan
+			delete postProcessingHdf5Writer;
+			postProcessingHdf5Writer = NULL;
+		}
+		sim->setParameterValues(serialScanParameterValues[scan]);
+		start1();
+	}
+}
+
+/*
+ * runs the serial parameter scans of a local run numParallelScans at a time, each
+ * in a child process forked once the model, the mesh and the simulation are set up:
+ * they share all of that copy-on-write and each scan only pays for its own
+ * simulation state, solver and output files. The parent runs no parallel region (the
+ * solvers start the OpenMP threads), and each child gets its share of the threads.
+ * Without fork() (Windows) the scans run one after another.
+ */
+void SimTool::startParallelScans() {
+#if ( defined(WIN32) || defined(WIN64) )
+	cout << "SimTool::startParallelScans(), parallel scans are not supported on Windows, running them one after another" << endl;
+	startSerialScans();
+#else
+	int maxRunning = numParallelScans;
+	if (maxRunning <= 0) {
+		maxRunning = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+	}
+	string firstBaseFileName(baseFileName);
+	string::size_type indexPosition = firstBaseFileName.rfind("_0_");
+	if (indexPosition == string::npos) {
+		throw "SimTool::startParallelScans(), base file name has no scan index";
+	}
+
+#ifdef _OPENMP
+	int numChildThreads = std::max(1, omp_get_max_threads() / std::min(maxRunning, numSerialParameterScans));
+#endif
+
+	std::vector<pid_t> running;
+	int numFailed = 0;
+	int scan = 0;
+	while (scan < numSerialParameterScans || !running.empty()) {
+		if (scan < numSerialParameterScans && (int)running.size() < maxRunning) {
+			// the child would write out what is buffered again
+			cout.flush();
+			fflush(stdout);
+			pid_t pid = fork();
+			if (pid < 0) {
+				throw "SimTool::startParallelScans(), fork() failed";
+			}
+			if (pid == 0) {
+				int status = 0;
+#ifdef _OPENMP
+				omp_set_num_threads(numChildThreads);
+#endif
+				try {
+					stringstream ss;
+					ss << "_" << scan << "_";
+					string bfn(firstBaseFileName);
+					bfn.replace(indexPosition, 3, ss.str());
+					setBaseFilename((char*)bfn.c_str());
+					((SimulationExpression*)simulation)->setParameterValues(serialScanParameterValues[scan]);
+					start1();
+				} catch (const char* msg) {
+					cout << "parameter scan " << scan << " failed : " << msg << endl;
+					status = 1;
+				} catch (string& msg) {
+					cout << "parameter scan " << scan << " failed : " << msg << endl;
+					status = 1;
+				} catch (...) {
+					cout << "parameter scan " << scan << " failed : unexpected error" << endl;
+					status = 1;
+				}
+				cout.flush();
+				fflush(stdout);
+				// leave the state shared with the parent alone
+				_exit(status);
+			}
+			running.push_back(pid);
+			scan ++;
+			continue;
+		}
+
+		// only reap the scans, other children of the process are left to their owner
+		bool bReaped = false;
+		for (int i = 0; i < (int)running.size(); i ++) {
+			int status;
+			pid_t pid = waitpid(running[i], &status, WNOHANG);
+			if (pid < 0 && errno != EINTR) {
+				throw "SimTool::startParallelScans(), waitpid() failed";
+			}
+			if (pid == running[i]) {
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					numFailed ++;
+				}
+				running.erase(running.begin() + i);
+				bReaped = true;
+				break;
 			}
-			sim->setParameterValues(serialScanParameterValues[scan]);
-			start1();
 		}
+		if (!bReaped) {
+			struct timespec pollInterval = {0, 20000000};
+			nanosleep(&pollInterval, NULL);
+		}
+	}
+	if (numFailed > 0) {
+		stringstream ss;
+		ss << numFailed << " of " << numSerialParameterScans << " parameter scans failed";
+		throw ss.str();
 	}
+#endif
 }
 
 void SimTool::setSmoldynInputFile(string& inputfile) {
@@ -815,6 +1074,44 @@ void SimTool::setSmoldynInputFile(string& inputfile) {
 }
 
 void SimTool::start1() {
+	if (bStoreEnable && bSimDataHdf5) {
+		std::string h5FileName;
+		h5FileName.append(baseFileName).append(SIMDATA_HDF5_FILE_EXT);
+		simDataHdf5Writer = new SimDataHdf5Writer(h5FileName, simDataDeflateLevel);
+	}
+	if (bStoreEnable && numOutputBuffers > 0) {
+		outputPipeline = new SimOutputPipeline(numOutputBuffers, [this](SimOutputBuffer& buffer) { writeSavePoint(buffer); });
+	}
+	if (bProfile) {
+		Profiler::enable(bProfileHardwareCounters);
+	}
+	try {
+		runSimulation();
+	} catch (...) {
+		// the save points taken before the failure are still written
+		delete outputPipeline;
+		outputPipeline = 0;
+		delete simDataHdf5Writer;
+		simDataHdf5Writer = 0;
+		writeProfile();
+		throw;
+	}
+	delete outputPipeline;
+	outputPipeline = 0;
+	delete simDataHdf5Writer;
+	simDataHdf5Writer = 0;
+	writeProfile();
+}
+
+void SimTool::writeProfile() {
+	if (bProfile) {
+		std::string profileFileName;
+		profileFileName.append(baseFileName).append(PROFILE_FILE_EXT);
+		Profiler::writeJSON(profileFileName);
+	}
+}
+
+void SimTool::runSimulation() {
 
 	// create post processing hdf5 writer
 	if (simulation->getPostProcessingBlock() != NULL) {
@@ -968,6 +1265,10 @@ void SimTool::start1() {
 	if (checkStopRequested()) {
 		return;
 	}
+	if (outputPipeline != 0) {
+		outputPipeline->finish();
+		sendOutputEvents();
+	}
 
 	SimulationMessaging::getInstVar()->setWorkerEvent(new WorkerEvent(JOB_PROGRESS, 1.0, simulation->getTime_sec()));
 	SimulationMessaging::getInstVar()->setWorkerEvent(new WorkerEvent(JOB_COMPLETED, percentile, simulation->getTime_sec()));
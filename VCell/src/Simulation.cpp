@@ -15,6 +15,7 @@
 #include <VCELL/SimTool.h>
 #include <VCELL/CartesianMesh.h>
 #include <VCELL/SerialScheduler.h>
+#include <VCELL/SlabScheduler.h>
 #include <VCELL/SundialsPdeScheduler.h>
 #ifdef VCELL_PETSC
   #include <VCELL/PetscPdeScheduler.h>
@@ -190,6 +191,8 @@ void Simulation::initSimulation()
 #else
 			throw "VCELL_PETSC_SOLVER must be built with VCELL_PETSC flag";
 #endif
+		} else if (simTool->getNumSlabs() != 1) {
+			_scheduler = new SlabScheduler(this, simTool->getNumSlabs());
 		} else {
 			_scheduler = new SerialScheduler(this);
 		}
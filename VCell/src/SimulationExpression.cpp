@@ -21,16 +21,50 @@
 #include <VCELL/VCellModel.h>
 #include <SimpleSymbolTable.h>
 #include <ScalarValueProxy.h>
+#include <EvalContext.h>
+#include <ExpressionCompiler.h>
 #include <VCELL/FVDataSet.h>
 #include <VCELL/PostProcessingBlock.h>
 
 #include <iostream>
 #include <sstream>
+using std::cout;
 using std::endl;
 using std::stringstream;
 
 #define RANDOM_VARIABLE_FILE_EXTENSION ".rv"
 
+static_assert(NUM_VAR_INDEX <= EVAL_CONTEXT_NUM_INDICES, "EvalContext must hold all the variable indices");
+
+// t, x, y, z: the value set by the simulation, or the one of the context
+class TimeCoordinateValueProxy : public ScalarValueProxy
+{
+public:
+	TimeCoordinateValueProxy(int arg_component) {
+		component = arg_component;
+	}
+
+	double evaluate() {
+		return ScalarValueProxy::evaluate();
+	}
+
+	double evaluate(EvalContext& context) {
+		switch (component) {
+		case 0:
+			return context.time;
+		case 1:
+			return context.x;
+		case 2:
+			return context.y;
+		default:
+			return context.z;
+		}
+	}
+
+private:
+	int component;
+};
+
 class ValueProxyVolumeExtrapolate : public ValueProxy
 {
 public:
@@ -41,6 +75,18 @@ public:
 	}
 	
 	double evaluate() {
+		return evaluate(indices);
+	}
+
+	double evaluate(EvalContext& context) {
+		return evaluate(context.indices);
+	}
+
+private:
+	Mesh* mesh;
+	Feature* feature;
+
+	double evaluate(int* indices) {
 		MembraneElement* element = mesh->getMembraneElements() + indices[VAR_MEMBRANE_INDEX];
 		int nearIndex, farIndex;
 		if (mesh->getVolumeElements()[element->vindexFeatureLo].getFeature() == feature) {
@@ -59,10 +105,6 @@ public:
 			return 1.5 * values[nearIndex] - 0.5 * values[farIndex];
 		}	
 	}
-
-private:
-	Mesh* mesh;
-	Feature* feature;
 };
 
 class VolumeRegionMembraneValueProxy : public ValueProxy
@@ -75,6 +117,18 @@ public:
 	}
 	
 	double evaluate() {
+		return evaluate(indices);
+	}
+
+	double evaluate(EvalContext& context) {
+		return evaluate(context.indices);
+	}
+
+private:
+	CartesianMesh* mesh;
+	Feature* feature;
+
+	double evaluate(int* indices) {
 		MembraneRegion* memRegion = mesh->getMembraneRegion(indices[VAR_MEMBRANE_REGION_INDEX]);
 		VolumeRegion* vr = memRegion->getVolumeRegion1();
 		if (memRegion->getVolumeRegion2()->getFeature() == feature) {
@@ -82,10 +136,6 @@ public:
 		}
 		return values[vr->getIndex()];
 	}
-
-private:
-	CartesianMesh* mesh;
-	Feature* feature;
 };
 
 SimulationExpression::SimulationExpression(Mesh *mesh) : Simulation(mesh) {
@@ -371,10 +421,10 @@ void SimulationExpression::createSymbolTable() {
 	// value proxy must be preserved in all solver cases.
 	ValueProxy** oldValueProxies = new ValueProxy*[numSymbols];
 
-	valueProxyTime = new ScalarValueProxy();
-	valueProxyX = new ScalarValueProxy();
-	valueProxyY = new ScalarValueProxy();
-	valueProxyZ = new ScalarValueProxy();
+	valueProxyTime = new TimeCoordinateValueProxy(0);
+	valueProxyX = new TimeCoordinateValueProxy(1);
+	valueProxyY = new TimeCoordinateValueProxy(2);
+	valueProxyZ = new TimeCoordinateValueProxy(3);
 
 	symbolIndexOffset_T = 0;
 	variableNames[0] = "t";
@@ -611,6 +661,19 @@ void SimulationExpression::setCurrentCoordinate(WorldCoord& wc) {
 	valueProxyZ->setValue(wc.z);
 }
 
+void SimulationExpression::setCurrentCoordinate(EvalContext& context, WorldCoord& wc) {
+	context.x = wc.x;
+	context.y = wc.y;
+	context.z = wc.z;
+}
+
+void SimulationExpression::initEvalContext(EvalContext& context) {
+	for (int i = 0; i < EVAL_CONTEXT_NUM_INDICES; i ++) {
+		context.indices[i] = -1;
+	}
+	context.time = getTime_sec();
+}
+
 bool SimulationExpression::isParameter(string& symbol) {
 
 	for (int i = 0; i < (int)paramList.size(); i ++) {
@@ -635,6 +698,21 @@ void SimulationExpression::reinitConstantValues() {
 
 }
 
+void SimulationExpression::compileExpressions() {
+	VCellModel* model = SimTool::getInstance()->getModel();
+
+	VCell::ExpressionCompiler compiler;
+	for (int i = 0; i < model->getNumFeatures(); i ++) {
+		model->getFeatureFromIndex(i)->addExpressionsToCompiler(&compiler);
+	}
+	for (int i = 0; i < model->getNumMembranes(); i ++) {
+		model->getMembraneFromIndex(i)->addExpressionsToCompiler(&compiler);
+	}
+	int numTotal = compiler.getNumExpressions();
+	int numCompiled = compiler.compile();
+	cout << "compiled " << numCompiled << " of " << numTotal << " expressions to native code" << endl;
+}
+
 void SimulationExpression::populateRegionSizeVariableValues(double *darray, bool bVolumeRegion, int regionIndex) {
 	for (int i = 0; i < numRegionSizeVars; i ++) {
 		RegionSizeVariable* rsv = regionSizeVarList[i];
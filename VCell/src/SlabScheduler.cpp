@@ -0,0 +1,154 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SlabScheduler.h>
+#include <VCELL/SimulationExpression.h>
+#include <VCELL/Solver.h>
+#include <VCELL/ODESolver.h>
+#include <VCELL/EqnBuilder.h>
+#include <VCELL/Variable.h>
+#include <VCELL/SimTool.h>
+#include <VCELL/CartesianMesh.h>
+#include <EvalContext.h>
+
+#include <algorithm>
+#include <exception>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+SlabScheduler::SlabScheduler(Simulation *Asim, int numSlabs)
+: SerialScheduler(Asim)
+{
+	CartesianMesh* mesh = (CartesianMesh*)sim->getMesh();
+	int numVolume = mesh->getNumVolumeElements();
+	int numMembrane = mesh->getNumMembraneElements();
+	int planeSize = 1;
+	if (mesh->getDimension() == 3) {
+		planeSize = mesh->getNumVolumeX() * mesh->getNumVolumeY();
+	} else if (mesh->getDimension() == 2) {
+		planeSize = mesh->getNumVolumeX();
+	}
+	int numPlanes = numVolume / planeSize;
+
+	if (numSlabs == 0) {
+		numSlabs = 1;
+#ifdef _OPENMP
+		numSlabs = omp_get_max_threads();
+#endif
+	}
+	numSlabs = std::max(1, std::min(numSlabs, numPlanes));
+	volumeSlabStarts.resize(numSlabs + 1);
+	membraneSlabStarts.resize(numSlabs + 1);
+	for (int s = 0; s <= numSlabs; s ++) {
+		volumeSlabStarts[s] = (int)((long)numPlanes * s / numSlabs) * planeSize;
+		membraneSlabStarts[s] = (int)((long)numMembrane * s / numSlabs);
+	}
+}
+
+void SlabScheduler::iterate()
+{
+	double deltaTime = sim->getDT_sec();
+	int volumeSize = sim->getMesh()->getNumVolumeElements();
+	int membraneSize = sim->getMesh()->getNumMembraneElements();
+
+	// the matrices, the equations of other builders and the serial parts of slab builders
+	vector<EqnBuilder*> slabBuilders;
+	vector<Solver*> slabSolvers;
+	for (int i = 0; i < sim->getNumSolvers(); i ++) {
+		Solver* solver = sim->getSolver(i);
+		string timername = solver->getVar()->getName() + " Build";
+		TimerHandle tHndBuild = SimTool::getInstance()->getTimerHandle(timername);
+
+		solver->initEqn(deltaTime, 0, volumeSize, 0, membraneSize, bFirstTime);
+
+		SimTool::getInstance()->startTimer(tHndBuild);
+		EqnBuilder* builder = solver->getEqnBuilder();
+		if (builder != NULL && builder->isSlabBuilder()) {
+			builder->beginSlabs(deltaTime);
+			slabBuilders.push_back(builder);
+			// ODEs of every element are solved by slab too
+			if (!solver->isPDESolver() && ((ODESolver*)solver)->getArraySize() == 0) {
+				slabSolvers.push_back(solver);
+			}
+		} else {
+			solver->buildEqn(deltaTime, 0, volumeSize, 0, membraneSize, bFirstTime);
+		}
+		SimTool::getInstance()->stopTimer(tHndBuild);
+	}
+
+	string timername = "Slabs";
+	TimerHandle tHndSlabs = SimTool::getInstance()->getTimerHandle(timername);
+	SimTool::getInstance()->startTimer(tHndSlabs);
+	runSlabs(slabBuilders, slabSolvers);
+	SimTool::getInstance()->stopTimer(tHndSlabs);
+
+	for (int i = 0; i < sim->getNumSolvers(); i ++) {
+		Solver* solver = sim->getSolver(i);
+		if (std::find(slabSolvers.begin(), slabSolvers.end(), solver) != slabSolvers.end()) {
+			continue;
+		}
+		string timername = solver->getVar()->getName() + " Solve";
+		TimerHandle tHndSolve = SimTool::getInstance()->getTimerHandle(timername);
+		SimTool::getInstance()->startTimer(tHndSolve);
+		EqnBuilder* builder = solver->getEqnBuilder();
+		if (builder != NULL && builder->isSlabBuilder()) {
+			builder->endSlabs(deltaTime);
+		}
+		solver->solveEqn(deltaTime, 0, volumeSize, 0, membraneSize, bFirstTime);
+		SimTool::getInstance()->stopTimer(tHndSolve);
+	}
+	if (hasFastSystem()) {
+		solveFastSystem(0, volumeSize, 0, membraneSize);
+	}
+	bFirstTime = false;
+}
+
+/*
+ * builds the equations of builders and solves solvers on each slab, a slab per thread at a time, each
+ * thread evaluating with its own context. The first iteration runs on one thread: it creates the stack
+ * machines of the expressions it evaluates, which the threads then share. If slabs throw, the exception
+ * of the first of them is rethrown, as the serial loop would.
+ */
+void SlabScheduler::runSlabs(vector<EqnBuilder*>& builders, vector<Solver*>& solvers)
+{
+	if (builders.empty()) {
+		return;
+	}
+	double deltaTime = sim->getDT_sec();
+	int numSlabs = getNumSlabs();
+	std::exception_ptr error;
+	int errorSlab = numSlabs;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(!bFirstTime && numSlabs > 1)
+#endif
+	for (int s = 0; s < numSlabs; s ++) {
+		int volumeStart = volumeSlabStarts[s];
+		int volumeSize = volumeSlabStarts[s + 1] - volumeStart;
+		int membraneStart = membraneSlabStarts[s];
+		int membraneSize = membraneSlabStarts[s + 1] - membraneStart;
+		try {
+			EvalContext context;
+			((SimulationExpression*)sim)->initEvalContext(context);
+			for (int i = 0; i < (int)builders.size(); i ++) {
+				builders[i]->buildEquation(context, deltaTime, volumeStart, volumeSize, membraneStart, membraneSize);
+			}
+			for (int i = 0; i < (int)solvers.size(); i ++) {
+				solvers[i]->solveEqn(deltaTime, volumeStart, volumeSize, membraneStart, membraneSize, bFirstTime);
+			}
+		} catch (...) {
+#ifdef _OPENMP
+#pragma omp critical (SlabScheduler_error)
+#endif
+			if (s < errorSlab) {
+				errorSlab = s;
+				error = std::current_exception();
+			}
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
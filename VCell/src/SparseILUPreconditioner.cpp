@@ -0,0 +1,203 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SparseILUPreconditioner.h>
+#include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/FVUtils.h>
+
+#include <algorithm>
+#include <map>
+using std::map;
+
+SparseILUPreconditioner::SparseILUPreconditioner(SparseMatrixPCG* arg_A, int fillLevel, int numBlocks, const int* arg_blockStarts)
+{
+	A = arg_A;
+	N = A->getN();
+	if (fillLevel < 0) {
+		throw "SparseILUPreconditioner : fill level must not be negative";
+	}
+	if (arg_blockStarts == 0) {
+		numBlocks = 1;
+		blockStarts.push_back(0);
+		blockStarts.push_back(N);
+	} else {
+		blockStarts.assign(arg_blockStarts, arg_blockStarts + numBlocks + 1);
+		for (int b = 0; b < numBlocks; b ++) {
+			if (blockStarts[b] > blockStarts[b + 1]) {
+				throw "SparseILUPreconditioner : blocks not in increasing order";
+			}
+		}
+		if (numBlocks < 1 || blockStarts[0] != 0 || blockStarts[numBlocks] != N) {
+			throw "SparseILUPreconditioner : blocks must cover all rows";
+		}
+	}
+	numFactorizations = 0;
+
+	try {
+		vector<int32> entryColumns;
+		A->getOffDiagonalRows(entryStarts, entryColumns, entrySources);
+		computePattern(fillLevel, entryColumns);
+		values.resize(cols.size());
+		rowMarkers.assign(N, -1);
+	} catch (std::bad_alloc&) {
+		throw "SparseILUPreconditioner : Out of memory";
+	}
+}
+
+SparseILUPreconditioner::~SparseILUPreconditioner()
+{
+}
+
+/*----------------------------------------------------------------------------
+	symbolic ILU(k): an entry of A has level 0, the update of (i,m) by l_ij * u_jm
+	has level lev(i,j) + lev(j,m) + 1 and is kept if that is at most fillLevel
+ --------------------------------------------------------------------------------------*/
+void SparseILUPreconditioner::computePattern(int fillLevel, const vector<int32>& entryColumns)
+{
+	vector<int> levels;
+	rowStarts.push_back(0);
+	diagPositions.resize(N);
+	entryPositions.resize(entryColumns.size());
+
+	int numBlocks = getNumBlocks();
+	for (int b = 0; b < numBlocks; b ++) {
+		int start = blockStarts[b];
+		int end = blockStarts[b + 1];
+		for (int i = start; i < end; i ++) {
+			map<int, int> row;
+			row[i] = 0;
+			for (long e = entryStarts[i]; e < entryStarts[i + 1]; e ++) {
+				if (entryColumns[e] >= start && entryColumns[e] < end) {
+					row[entryColumns[e]] = 0;
+				}
+			}
+			if (fillLevel > 0) {
+				// fill goes right of the pivot column, so it is visited later
+				for (map<int, int>::iterator it = row.begin(); it->first < i; ++ it) {
+					int j = it->first;
+					for (long m = diagPositions[j] + 1; m < rowStarts[j + 1]; m ++) {
+						int level = it->second + levels[m] + 1;
+						if (level > fillLevel) {
+							continue;
+						}
+						map<int, int>::iterator existing = row.find(cols[m]);
+						if (existing == row.end()) {
+							row[cols[m]] = level;
+						} else if (level < existing->second) {
+							existing->second = level;
+						}
+					}
+				}
+			}
+
+			long rowStart = (long)cols.size();
+			for (map<int, int>::iterator it = row.begin(); it != row.end(); ++ it) {
+				if (it->first == i) {
+					diagPositions[i] = (long)cols.size();
+				}
+				cols.push_back(it->first);
+				levels.push_back(it->second);
+			}
+			rowStarts.push_back((long)cols.size());
+
+			for (long e = entryStarts[i]; e < entryStarts[i + 1]; e ++) {
+				long position = -1;
+				if (entryColumns[e] >= start && entryColumns[e] < end) {
+					position = std::lower_bound(cols.begin() + rowStart, cols.end(), entryColumns[e]) - cols.begin();
+				}
+				entryPositions[e] = position;
+			}
+		}
+	}
+}
+
+long SparseILUPreconditioner::factorBlock(int block)
+{
+	double* sa = A->getsa();
+	for (int i = blockStarts[block]; i < blockStarts[block + 1]; i ++) {
+		long rowStart = rowStarts[i];
+		long rowEnd = rowStarts[i + 1];
+		long diagPosition = diagPositions[i];
+		for (long k = rowStart; k < rowEnd; k ++) {
+			values[k] = 0;
+			rowMarkers[cols[k]] = k;
+		}
+		for (long e = entryStarts[i]; e < entryStarts[i + 1]; e ++) {
+			if (entryPositions[e] >= 0) {
+				values[entryPositions[e]] = sa[entrySources[e]];
+			}
+		}
+		values[diagPosition] = sa[i];
+
+		for (long k = rowStart; k < diagPosition; k ++) {
+			int j = cols[k];
+			double lij = values[k] *= values[diagPositions[j]];
+			for (long m = diagPositions[j] + 1; m < rowStarts[j + 1]; m ++) {
+				long position = rowMarkers[cols[m]];
+				if (position >= 0) {
+					values[position] -= lij * values[m];
+				}
+			}
+		}
+
+		for (long k = rowStart; k < rowEnd; k ++) {
+			rowMarkers[cols[k]] = -1;
+		}
+		if (values[diagPosition] == 0) {
+			return i;
+		}
+		values[diagPosition] = 1.0 / values[diagPosition];
+	}
+	return -1;
+}
+
+void SparseILUPreconditioner::factor()
+{
+	// blocks touch disjoint columns, so they can share rowMarkers
+	int numBlocks = getNumBlocks();
+	vector<long> zeroPivotRows(numBlocks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(numBlocks > 1)
+#endif
+	for (int b = 0; b < numBlocks; b ++) {
+		zeroPivotRows[b] = factorBlock(b);
+	}
+	for (int b = 0; b < numBlocks; b ++) {
+		if (zeroPivotRows[b] >= 0) {
+			throwPCGExceptions(5, 0);
+		}
+	}
+	numFactorizations ++;
+}
+
+void SparseILUPreconditioner::solveBlock(int block, const double* r, double* z)
+{
+	int start = blockStarts[block];
+	int end = blockStarts[block + 1];
+	for (int i = start; i < end; i ++) {
+		double sum = r[i];
+		for (long k = rowStarts[i]; k < diagPositions[i]; k ++) {
+			sum -= values[k] * z[cols[k]];
+		}
+		z[i] = sum;
+	}
+	for (int i = end - 1; i >= start; i --) {
+		double sum = z[i];
+		for (long k = diagPositions[i] + 1; k < rowStarts[i + 1]; k ++) {
+			sum -= values[k] * z[cols[k]];
+		}
+		z[i] = sum * values[diagPositions[i]];
+	}
+}
+
+void SparseILUPreconditioner::solve(const double* r, double* z)
+{
+	int numBlocks = getNumBlocks();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(numBlocks > 1)
+#endif
+	for (int b = 0; b < numBlocks; b ++) {
+		solveBlock(b, r, z);
+	}
+}
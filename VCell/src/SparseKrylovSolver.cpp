@@ -0,0 +1,278 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SparseKrylovSolver.h>
+#include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/SparseMatrixSELL.h>
+#include <VCELL/SparseILUPreconditioner.h>
+#include <VCELL/SparseMultigridSolver.h>
+
+#include <math.h>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+SparseKrylovSolver::SparseKrylovSolver(SparseMatrixPCG* arg_A, int arg_fillLevel)
+{
+	A = arg_A;
+	fillLevel = arg_fillLevel;
+	sellMatrix = 0;
+	preconditioner = 0;
+	multigrid = 0;
+	numIterations = 0;
+	relativeResidual = 0;
+	build();
+}
+
+SparseKrylovSolver::SparseKrylovSolver(SparseMatrixPCG* arg_A, SparseMultigridSolver* arg_multigrid)
+{
+	A = arg_A;
+	fillLevel = 0;
+	sellMatrix = 0;
+	preconditioner = 0;
+	multigrid = arg_multigrid;
+	numIterations = 0;
+	relativeResidual = 0;
+	build();
+}
+
+SparseKrylovSolver::~SparseKrylovSolver()
+{
+	delete sellMatrix;
+	delete preconditioner;
+}
+
+void SparseKrylovSolver::build()
+{
+	delete sellMatrix;
+	delete preconditioner;
+	sellMatrix = 0;
+	preconditioner = 0;
+
+	N = A->getN();
+	vector<long> sources;
+	A->getOffDiagonalRows(patternRowStarts, patternColumns, sources);
+	sellMatrix = new SparseMatrixSELL(A);
+	if (multigrid != 0) {
+		resizeVectors();
+		return;
+	}
+
+	long numBlocks = 1;
+#ifdef _OPENMP
+	numBlocks = std::max(1L, std::min((long)omp_get_max_threads(), N));
+#endif
+	vector<int> blockStarts(numBlocks + 1);
+	for (long b = 0; b <= numBlocks; b ++) {
+		blockStarts[b] = (int)(N * b / numBlocks);
+	}
+	preconditioner = new SparseILUPreconditioner(A, fillLevel, (int)numBlocks, &blockStarts[0]);
+	preconditioner->factor();
+	resizeVectors();
+}
+
+void SparseKrylovSolver::resizeVectors()
+{
+	r.resize(N);
+	z.resize(N);
+	p.resize(N);
+	q.resize(N);
+	if (A->getSymmetricFlag() != MATRIX_SYMMETRIC) {
+		rHat.resize(N);
+		s.resize(N);
+		t.resize(N);
+		u.resize(N);
+	}
+}
+
+void SparseKrylovSolver::update()
+{
+	vector<long> rowStarts;
+	vector<int32> columns;
+	vector<long> sources;
+	A->getOffDiagonalRows(rowStarts, columns, sources);
+	if (A->getN() != N || rowStarts != patternRowStarts || columns != patternColumns) {
+		build();
+		return;
+	}
+	sellMatrix->updateValues();
+	if (preconditioner != 0) {
+		preconditioner->factor();
+	}
+}
+
+void SparseKrylovSolver::precondition(const double* r, double* z)
+{
+	if (multigrid != 0) {
+		multigrid->cycle(r, z);
+	} else {
+		preconditioner->solve(r, z);
+	}
+}
+
+double SparseKrylovSolver::dot(const double* u, const double* v)
+{
+	double sum = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+:sum)
+#endif
+	for (long i = 0; i < N; i ++) {
+		sum += u[i] * v[i];
+	}
+	return sum;
+}
+
+void SparseKrylovSolver::axpy(double a, const double* x, double* y)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long i = 0; i < N; i ++) {
+		y[i] += a * x[i];
+	}
+}
+
+bool SparseKrylovSolver::solve(const double* b, double* x, double relTol, int maxIterations)
+{
+	numIterations = 0;
+	relativeResidual = 0;
+	double bNorm = sqrt(dot(b, b));
+	if (bNorm == 0) {
+		std::fill(x, x + N, 0.0);
+		return true;
+	}
+
+	// r = b - A x
+	sellMatrix->multiply(x, &r[0]);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long i = 0; i < N; i ++) {
+		r[i] = b[i] - r[i];
+	}
+
+	double tolerance = relTol * bNorm;
+	if (A->getSymmetricFlag() == MATRIX_SYMMETRIC) {
+		return solvePCG(x, bNorm, tolerance, maxIterations);
+	}
+	return solveBiCGStab(x, bNorm, tolerance, maxIterations);
+}
+
+bool SparseKrylovSolver::solvePCG(double* x, double bNorm, double tolerance, int maxIterations)
+{
+	double rNorm = sqrt(dot(&r[0], &r[0]));
+	relativeResidual = rNorm / bNorm;
+	if (rNorm <= tolerance) {
+		return true;
+	}
+	precondition(&r[0], &z[0]);
+	p = z;
+	double rz = dot(&r[0], &z[0]);
+
+	for (numIterations = 1; numIterations <= maxIterations; numIterations ++) {
+		sellMatrix->multiply(&p[0], &q[0]);
+		double pq = dot(&p[0], &q[0]);
+		if (pq == 0) {
+			return false;
+		}
+		double alpha = rz / pq;
+		axpy(alpha, &p[0], x);
+		axpy(-alpha, &q[0], &r[0]);
+
+		rNorm = sqrt(dot(&r[0], &r[0]));
+		relativeResidual = rNorm / bNorm;
+		if (rNorm <= tolerance) {
+			return true;
+		}
+
+		precondition(&r[0], &z[0]);
+		double rzNew = dot(&r[0], &z[0]);
+		double beta = rzNew / rz;
+		rz = rzNew;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (long i = 0; i < N; i ++) {
+			p[i] = z[i] + beta * p[i];
+		}
+	}
+	numIterations = maxIterations;
+	return false;
+}
+
+/*----------------------------------------------------------------------------
+	right preconditioned BiCGStab: p and s are preconditioned into z and t,
+	q = A z, u = A t, and the shadow residual rHat is the initial residual
+ --------------------------------------------------------------------------------------*/
+bool SparseKrylovSolver::solveBiCGStab(double* x, double bNorm, double tolerance, int maxIterations)
+{
+	double rNorm = sqrt(dot(&r[0], &r[0]));
+	relativeResidual = rNorm / bNorm;
+	if (rNorm <= tolerance) {
+		return true;
+	}
+	rHat = r;
+	double rho = 1, alpha = 1, omega = 1;
+	std::fill(p.begin(), p.end(), 0.0);
+	std::fill(q.begin(), q.end(), 0.0);
+
+	for (numIterations = 1; numIterations <= maxIterations; numIterations ++) {
+		double rhoNew = dot(&rHat[0], &r[0]);
+		if (rhoNew == 0 || omega == 0) {
+			return false;
+		}
+		double beta = (rhoNew / rho) * (alpha / omega);
+		rho = rhoNew;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (long i = 0; i < N; i ++) {
+			p[i] = r[i] + beta * (p[i] - omega * q[i]);
+		}
+
+		precondition(&p[0], &z[0]);
+		sellMatrix->multiply(&z[0], &q[0]);
+		double rHatq = dot(&rHat[0], &q[0]);
+		if (rHatq == 0) {
+			return false;
+		}
+		alpha = rho / rHatq;
+
+		// s = r - alpha q
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (long i = 0; i < N; i ++) {
+			s[i] = r[i] - alpha * q[i];
+		}
+		double sNorm = sqrt(dot(&s[0], &s[0]));
+		if (sNorm <= tolerance) {
+			axpy(alpha, &z[0], x);
+			relativeResidual = sNorm / bNorm;
+			return true;
+		}
+
+		precondition(&s[0], &t[0]);
+		sellMatrix->multiply(&t[0], &u[0]);
+		double uu = dot(&u[0], &u[0]);
+		omega = uu == 0 ? 0 : dot(&u[0], &s[0]) / uu;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (long i = 0; i < N; i ++) {
+			x[i] += alpha * z[i] + omega * t[i];
+			r[i] = s[i] - omega * u[i];
+		}
+		rNorm = sqrt(dot(&r[0], &r[0]));
+		relativeResidual = rNorm / bNorm;
+		if (rNorm <= tolerance) {
+			return true;
+		}
+	}
+	numIterations = maxIterations;
+	return false;
+}
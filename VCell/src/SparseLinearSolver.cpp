@@ -21,6 +21,9 @@ using std::endl;
 using std::setprecision;
 
 #include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/SparseKrylovSolver.h>
+#include <VCELL/SparseMultigridSolver.h>
+#include <VCELL/CartesianMesh.h>
 #include <VCELL/Simulation.h>
 #include <VCELL/SparseMatrixEqnBuilder.h>
 #include <VCELL/Variable.h>
@@ -41,6 +44,8 @@ SparseLinearSolver::SparseLinearSolver(Variable *Var,  SparseMatrixEqnBuilder *
 	enableRetry = true;
 	eqnBuilder = arg_eqnbuilder;
 	pcg_workspace = NULL;
+	krylovSolver = NULL;
+	multigridSolver = NULL;
 
 	smEqnBuilder = arg_eqnbuilder;
 	long size = smEqnBuilder->getSize();
@@ -62,7 +67,9 @@ SparseLinearSolver::SparseLinearSolver(Variable *Var,  SparseMatrixEqnBuilder *
 			}	
 			break;
 	}		
-	initPCGWorkspace(0);
+	if (!SimTool::getInstance()->isNativeLinearSolver()) {
+		initPCGWorkspace(0);
+	}
 	pcgRelErr = rtol;
 	//cout << endl << "****** solving " + var->getName() + " using PCGPak2, relTol=" << pcgRelErr << endl;
 }
@@ -83,13 +90,15 @@ void SparseLinearSolver::initPCGWorkspace(long additional) {
 SparseLinearSolver::~SparseLinearSolver()
 {
 	delete[] pcg_workspace;	
+	delete krylovSolver;
+	delete multigridSolver;
 }
 
 void SparseLinearSolver::solveEqn(double dT_sec, 
 				 int volumeIndexStart, int volumeIndexSize, 
 				 int membraneIndexStart, int membraneIndexSize, bool bFirstTime)
 {
-	int* IParm = PCGSolve(bFirstTime);
+	int* IParm = SimTool::getInstance()->isNativeLinearSolver() ? KrylovSolve(bFirstTime) : PCGSolve(bFirstTime);
 	int returnCode = IParm[50];
 	int additionalSpace = IParm[53];
 	delete[] IParm;	
@@ -218,3 +227,61 @@ int* SparseLinearSolver::PCGSolve(bool bRecomputeIncompleteFactorization)
 	
 	return IParm;
 }
+
+// --------------------------------------------------
+int* SparseLinearSolver::KrylovSolve(bool bRecomputeIncompleteFactorization)
+// --------------------------------------------------
+{
+	SparseMatrixPCG *A = smEqnBuilder->getA();
+	double *pRHS = smEqnBuilder->getB();
+	double *pNew = smEqnBuilder->getX();
+	long size = smEqnBuilder->getSize();
+
+	string timername = var->getName() + " PCG";
+	TimerHandle tHndPCG = SimTool::getInstance()->getTimerHandle(timername);
+	SimTool::getInstance()->startTimer(tHndPCG);
+
+	// multigrid for volume variables, otherwise fill-in 1 and reuse of the incomplete
+	// factorization as in PCGSolve
+	LinearSolverType type = SimTool::getInstance()->getLinearSolver();
+	const int* volumeIndexes = NULL;
+	bool bMultigrid = type != LINEAR_SOLVER_NATIVE && smEqnBuilder->getVolumeIndexes(volumeIndexes);
+	if (krylovSolver == NULL && multigridSolver == NULL) {
+		if (bMultigrid) {
+			multigridSolver = new SparseMultigridSolver(A, (CartesianMesh*)smEqnBuilder->getMesh(), volumeIndexes);
+		}
+		if (bMultigrid && type == LINEAR_SOLVER_NATIVE_MULTIGRID) {
+			krylovSolver = new SparseKrylovSolver(A, multigridSolver);
+		} else if (!bMultigrid) {
+			krylovSolver = new SparseKrylovSolver(A, 1);
+		}
+	} else if (bRecomputeIncompleteFactorization || isTimeDependent()) {
+		if (multigridSolver != NULL) {
+			multigridSolver->update();
+		}
+		if (krylovSolver != NULL) {
+			krylovSolver->update();
+		}
+	}
+	if (eqnBuilder->isElliptic()) {
+		memset(pNew, 0, size * sizeof(double)); // for elliptic case, we always start with zero initial guess
+	}
+	bool bConverged;
+	if (krylovSolver != NULL) {
+		bConverged = krylovSolver->solve(pRHS, pNew, pcgRelErr, 3000);
+	} else {
+		bConverged = multigridSolver->solve(pRHS, pNew, pcgRelErr, 3000);
+	}
+	SimTool::getInstance()->stopTimer(tHndPCG);
+
+	// PCGPAK return code: 1 is maximum iterations reached
+	int* IParm = new int[75];
+	memset(IParm, 0, 75 * sizeof(int));
+	IParm[50] = bConverged ? 0 : 1;
+
+	// for periodic boundary condition and solve region
+	if (bConverged) {
+		smEqnBuilder->postProcess();
+	}
+	return IParm;
+}
@@ -200,6 +200,35 @@ int SparseMatrixPCG::getColumns(long i, int32*& columns, double*& values) {
 	return ija[i+1] - ija[i];
 }
 
+void SparseMatrixPCG::getOffDiagonalRows(vector<long>& rowStarts, vector<int32>& columns, vector<long>& sources) {
+	rowStarts.assign(N + 1, 0);
+	for (long i = 0; i < N; i ++) {
+		rowStarts[i + 1] += ija[i + 1] - ija[i];
+		if (symmflag == MATRIX_SYMMETRIC) {
+			for (int32 k = ija[i]; k < ija[i + 1]; k ++) {
+				rowStarts[ija[k] + 1] ++;
+			}
+		}
+	}
+	for (long i = 0; i < N; i ++) {
+		rowStarts[i + 1] += rowStarts[i];
+	}
+	columns.resize(rowStarts[N]);
+	sources.resize(rowStarts[N]);
+
+	vector<long> next(rowStarts.begin(), rowStarts.end() - 1);
+	for (long i = 0; i < N; i ++) {
+		for (int32 k = ija[i]; k < ija[i + 1]; k ++) {
+			columns[next[i]] = ija[k];
+			sources[next[i] ++] = k;
+			if (symmflag == MATRIX_SYMMETRIC) {
+				columns[next[ija[k]]] = i;
+				sources[next[ija[k]] ++] = k;
+			}
+		}
+	}
+}
+
 void SparseMatrixPCG::scaleOffDiagonals(double gamma) {
 	int size = ija[N] - ija[0];
 	int incr = 1;
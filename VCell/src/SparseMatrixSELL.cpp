@@ -0,0 +1,134 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SparseMatrixSELL.h>
+#include <VCELL/SparseMatrixPCG.h>
+
+#include <algorithm>
+#include <new>
+
+// orders rows by decreasing number of entries
+struct LongerRow {
+	const vector<long>& rowStarts;
+	LongerRow(const vector<long>& arg_rowStarts) : rowStarts(arg_rowStarts) {}
+	bool operator()(int i, int j) const {
+		return rowStarts[i + 1] - rowStarts[i] > rowStarts[j + 1] - rowStarts[j];
+	}
+};
+
+SparseMatrixSELL::SparseMatrixSELL(SparseMatrixPCG* arg_A, int sortWindow)
+{
+	A = arg_A;
+	N = A->getN();
+	if (sortWindow < 1) {
+		sortWindow = 1;
+	}
+
+	try {
+		vector<long> rowStarts;
+		vector<int32> offDiagonalColumns;
+		vector<long> offDiagonalSources;
+		A->getOffDiagonalRows(rowStarts, offDiagonalColumns, offDiagonalSources);
+		numNonZeros = N + rowStarts[N];
+
+		vector<int> order(N);
+		for (long i = 0; i < N; i ++) {
+			order[i] = i;
+		}
+		for (long w = 0; w < N; w += sortWindow) {
+			std::stable_sort(order.begin() + w, order.begin() + std::min(w + sortWindow, N), LongerRow(rowStarts));
+		}
+
+		numChunks = (int)((N + SELL_CHUNK_SIZE - 1) / SELL_CHUNK_SIZE);
+		chunkRows.assign((long)numChunks * SELL_CHUNK_SIZE, -1);
+		chunkStarts.assign(numChunks + 1, 0);
+		for (int c = 0; c < numChunks; c ++) {
+			long width = 0;
+			for (int r = 0; r < SELL_CHUNK_SIZE && c * SELL_CHUNK_SIZE + r < N; r ++) {
+				int row = order[c * SELL_CHUNK_SIZE + r];
+				chunkRows[c * SELL_CHUNK_SIZE + r] = row;
+				width = std::max(width, 1 + rowStarts[row + 1] - rowStarts[row]);
+			}
+			chunkStarts[c + 1] = chunkStarts[c] + width * SELL_CHUNK_SIZE;
+		}
+
+		// the diagonal first, then the off diagonal entries; padding multiplies the row's own x by 0
+		columns.resize(chunkStarts[numChunks]);
+		values.assign(chunkStarts[numChunks], 0);
+		sources.assign(chunkStarts[numChunks], -1);
+		for (int c = 0; c < numChunks; c ++) {
+			long width = (chunkStarts[c + 1] - chunkStarts[c]) / SELL_CHUNK_SIZE;
+			for (int r = 0; r < SELL_CHUNK_SIZE; r ++) {
+				int row = chunkRows[c * SELL_CHUNK_SIZE + r];
+				long slot = chunkStarts[c] + r;
+				for (long k = 0; k < width; k ++, slot += SELL_CHUNK_SIZE) {
+					columns[slot] = row < 0 ? 0 : row;
+				}
+				if (row < 0) {
+					continue;
+				}
+				slot = chunkStarts[c] + r;
+				sources[slot] = row;
+				for (long e = rowStarts[row]; e < rowStarts[row + 1]; e ++) {
+					slot += SELL_CHUNK_SIZE;
+					columns[slot] = offDiagonalColumns[e];
+					sources[slot] = offDiagonalSources[e];
+				}
+			}
+		}
+	} catch (std::bad_alloc&) {
+		throw "SparseMatrixSELL : Out of memory";
+	}
+	updateValues();
+}
+
+SparseMatrixSELL::~SparseMatrixSELL()
+{
+}
+
+double SparseMatrixSELL::getFillRatio()
+{
+	return numNonZeros == 0 ? 1.0 : (double)columns.size() / numNonZeros;
+}
+
+void SparseMatrixSELL::updateValues()
+{
+	double* sa = A->getsa();
+	long size = (long)values.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long k = 0; k < size; k ++) {
+		if (sources[k] >= 0) {
+			values[k] = sa[sources[k]];
+		}
+	}
+}
+
+void SparseMatrixSELL::multiply(const double* x, double* y)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (int c = 0; c < numChunks; c ++) {
+		double sums[SELL_CHUNK_SIZE];
+		for (int r = 0; r < SELL_CHUNK_SIZE; r ++) {
+			sums[r] = 0;
+		}
+		const int32* chunkColumns = &columns[0] + chunkStarts[c];
+		const double* chunkValues = &values[0] + chunkStarts[c];
+		long size = chunkStarts[c + 1] - chunkStarts[c];
+		for (long k = 0; k < size; k += SELL_CHUNK_SIZE) {
+			for (int r = 0; r < SELL_CHUNK_SIZE; r ++) {
+				sums[r] += chunkValues[k + r] * x[chunkColumns[k + r]];
+			}
+		}
+		const int* rows = &chunkRows[0] + c * SELL_CHUNK_SIZE;
+		for (int r = 0; r < SELL_CHUNK_SIZE; r ++) {
+			if (rows[r] >= 0) {
+				y[rows[r]] = sums[r];
+			}
+		}
+	}
+}
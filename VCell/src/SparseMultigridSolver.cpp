@@ -0,0 +1,508 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include <VCELL/SparseMultigridSolver.h>
+#include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/CartesianMesh.h>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// coarsening stops at this many rows, or when a level would keep more than MULTIGRID_MIN_REDUCTION of them
+#define MULTIGRID_COARSEST_ROWS 256
+#define MULTIGRID_MIN_REDUCTION 0.8
+#define MULTIGRID_MAX_LEVELS 20
+// largest scaling of a coarse correction
+#define MULTIGRID_MAX_SCALE 2.0
+// largest coarsest level solved by LU, larger ones by Gauss-Seidel sweeps
+#define MULTIGRID_DENSE_ROWS 1024
+#define MULTIGRID_COARSEST_SWEEPS 20
+// fewest rows smoothed by a thread
+#define MULTIGRID_MIN_BLOCK_ROWS 4096
+
+SparseMultigridSolver::SparseMultigridSolver(SparseMatrixPCG* arg_A, CartesianMesh* arg_mesh, const int* arg_volumeIndexes)
+{
+	A = arg_A;
+	mesh = arg_mesh;
+	if (arg_volumeIndexes != 0) {
+		volumeIndexes.assign(arg_volumeIndexes, arg_volumeIndexes + A->getN());
+	}
+	bScaleCorrections = false;
+	numIterations = 0;
+	relativeResidual = 0;
+	try {
+		build();
+	} catch (std::bad_alloc&) {
+		clear();
+		throw "SparseMultigridSolver : Out of memory";
+	}
+}
+
+SparseMultigridSolver::~SparseMultigridSolver()
+{
+	clear();
+}
+
+void SparseMultigridSolver::clear()
+{
+	for (int l = 0; l < (int)levels.size(); l ++) {
+		delete levels[l];
+	}
+	levels.clear();
+	coarseLU.clear();
+	coarsePivots.clear();
+}
+
+void SparseMultigridSolver::build()
+{
+	clear();
+	A->getOffDiagonalRows(patternRowStarts, patternColumns, patternSources);
+
+	Level* level = new Level();
+	levels.push_back(level);
+	level->N = A->getN();
+	level->rowStarts = patternRowStarts;
+	level->columns = patternColumns;
+	level->values.resize(patternColumns.size());
+
+	// mesh coordinates of the rows, halved at each level
+	vector<int> coords(level->N * 3);
+	for (long i = 0; i < level->N; i ++) {
+		long volumeIndex = volumeIndexes.empty() ? i : volumeIndexes[i];
+		if (volumeIndex < 0 || volumeIndex >= mesh->getNumVolumeElements()) {
+			throw "SparseMultigridSolver : rows are not volume elements";
+		}
+		MeshCoord mc = mesh->getMeshCoord(volumeIndex);
+		coords[i * 3] = mc.x;
+		coords[i * 3 + 1] = mc.y;
+		coords[i * 3 + 2] = mc.z;
+	}
+
+	while (level->N > MULTIGRID_COARSEST_ROWS && (int)levels.size() < MULTIGRID_MAX_LEVELS) {
+		vector<int> coarseCoords;
+		Level* coarse = coarsen(level, coords, coarseCoords);
+		if (coarse->N > MULTIGRID_MIN_REDUCTION * level->N) {
+			delete coarse;
+			level->aggregates.clear();
+			level->coarsePositions.clear();
+			break;
+		}
+		levels.push_back(coarse);
+		coords.swap(coarseCoords);
+		level = coarse;
+	}
+
+	for (int l = 0; l < (int)levels.size(); l ++) {
+		level = levels[l];
+		level->diagonal.resize(level->N);
+		level->x.resize(level->N);
+		level->b.resize(level->N);
+		level->r.resize(level->N);
+		level->xOld.resize(level->N);
+		setBlocks(level);
+	}
+	computeValues();
+}
+
+void SparseMultigridSolver::setBlocks(Level* level)
+{
+	long numBlocks = 1;
+#ifdef _OPENMP
+	numBlocks = std::max(1L, std::min((long)omp_get_max_threads(), level->N / MULTIGRID_MIN_BLOCK_ROWS));
+#endif
+	level->blockStarts.resize(numBlocks + 1);
+	for (long b = 0; b <= numBlocks; b ++) {
+		level->blockStarts[b] = level->N * b / numBlocks;
+	}
+}
+
+static long findRoot(vector<long>& parents, long i)
+{
+	while (parents[i] != i) {
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+/*----------------------------------------------------------------------------
+	rows in the same 2x2x2 block of (halved) coordinates connected by entries
+	within the block make up a row of the next level, numbered in the order of
+	their first rows
+ --------------------------------------------------------------------------------------*/
+SparseMultigridSolver::Level* SparseMultigridSolver::coarsen(Level* level, const vector<int>& coords, vector<int>& coarseCoords)
+{
+	long N = level->N;
+	vector<long> parents(N);
+	for (long i = 0; i < N; i ++) {
+		parents[i] = i;
+	}
+	for (long i = 0; i < N; i ++) {
+		for (long e = level->rowStarts[i]; e < level->rowStarts[i + 1]; e ++) {
+			long j = level->columns[e];
+			if (coords[i * 3] / 2 == coords[j * 3] / 2 && coords[i * 3 + 1] / 2 == coords[j * 3 + 1] / 2
+					&& coords[i * 3 + 2] / 2 == coords[j * 3 + 2] / 2) {
+				long ri = findRoot(parents, i);
+				long rj = findRoot(parents, j);
+				if (ri != rj) {
+					parents[std::max(ri, rj)] = std::min(ri, rj);
+				}
+			}
+		}
+	}
+
+	Level* coarse = new Level();
+	level->aggregates.resize(N);
+	long numCoarse = 0;
+	vector<long> rootAggregates(N, -1);
+	for (long i = 0; i < N; i ++) {
+		long root = findRoot(parents, i);
+		if (rootAggregates[root] < 0) {
+			rootAggregates[root] = numCoarse ++;
+		}
+		level->aggregates[i] = rootAggregates[root];
+	}
+	coarse->N = numCoarse;
+	coarseCoords.resize(numCoarse * 3);
+	for (long i = 0; i < N; i ++) {
+		long I = level->aggregates[i];
+		for (int d = 0; d < 3; d ++) {
+			coarseCoords[I * 3 + d] = coords[i * 3 + d] / 2;
+		}
+	}
+
+	// rows of each aggregate
+	vector<long> memberStarts(numCoarse + 1, 0);
+	for (long i = 0; i < N; i ++) {
+		memberStarts[level->aggregates[i] + 1] ++;
+	}
+	for (long I = 0; I < numCoarse; I ++) {
+		memberStarts[I + 1] += memberStarts[I];
+	}
+	vector<long> members(N);
+	vector<long> next(memberStarts.begin(), memberStarts.end() - 1);
+	for (long i = 0; i < N; i ++) {
+		members[next[level->aggregates[i]] ++] = i;
+	}
+
+	// pattern of P^T A P, and where each entry of A goes
+	level->coarsePositions.resize(level->columns.size());
+	vector<long> markers(numCoarse, -1);
+	coarse->rowStarts.push_back(0);
+	for (long I = 0; I < numCoarse; I ++) {
+		long rowStart = (long)coarse->columns.size();
+		for (long m = memberStarts[I]; m < memberStarts[I + 1]; m ++) {
+			long i = members[m];
+			for (long e = level->rowStarts[i]; e < level->rowStarts[i + 1]; e ++) {
+				long J = level->aggregates[level->columns[e]];
+				if (J == I) {
+					level->coarsePositions[e] = -1;
+					continue;
+				}
+				if (markers[J] < rowStart) {
+					markers[J] = (long)coarse->columns.size();
+					coarse->columns.push_back((int32)J);
+				}
+				level->coarsePositions[e] = markers[J];
+			}
+		}
+		coarse->rowStarts.push_back((long)coarse->columns.size());
+	}
+	coarse->values.resize(coarse->columns.size());
+	return coarse;
+}
+
+void SparseMultigridSolver::update()
+{
+	vector<long> rowStarts;
+	vector<int32> columns;
+	vector<long> sources;
+	A->getOffDiagonalRows(rowStarts, columns, sources);
+	if (rowStarts != patternRowStarts || columns != patternColumns || sources != patternSources) {
+		build();
+		return;
+	}
+	computeValues();
+}
+
+void SparseMultigridSolver::computeValues()
+{
+	Level* level = levels[0];
+	double* sa = A->getsa();
+	for (long i = 0; i < level->N; i ++) {
+		level->diagonal[i] = sa[i];
+	}
+	for (long e = 0; e < (long)patternSources.size(); e ++) {
+		level->values[e] = sa[patternSources[e]];
+	}
+
+	for (int l = 0; l + 1 < (int)levels.size(); l ++) {
+		level = levels[l];
+		Level* coarse = levels[l + 1];
+		std::fill(coarse->diagonal.begin(), coarse->diagonal.end(), 0.0);
+		std::fill(coarse->values.begin(), coarse->values.end(), 0.0);
+		for (long i = 0; i < level->N; i ++) {
+			long I = level->aggregates[i];
+			coarse->diagonal[I] += level->diagonal[i];
+			for (long e = level->rowStarts[i]; e < level->rowStarts[i + 1]; e ++) {
+				long position = level->coarsePositions[e];
+				if (position < 0) {
+					coarse->diagonal[I] += level->values[e];
+				} else {
+					coarse->values[position] += level->values[e];
+				}
+			}
+		}
+	}
+	factorCoarsest();
+}
+
+void SparseMultigridSolver::factorCoarsest()
+{
+	Level* level = levels.back();
+	long n = level->N;
+	if (n > MULTIGRID_DENSE_ROWS) {
+		coarseLU.clear();
+		coarsePivots.clear();
+		return;
+	}
+	coarseLU.assign(n * n, 0.0);
+	coarsePivots.resize(n);
+	for (long i = 0; i < n; i ++) {
+		coarseLU[i * n + i] = level->diagonal[i];
+		for (long e = level->rowStarts[i]; e < level->rowStarts[i + 1]; e ++) {
+			coarseLU[i * n + level->columns[e]] += level->values[e];
+		}
+	}
+	for (long k = 0; k < n; k ++) {
+		long pivot = k;
+		for (long i = k + 1; i < n; i ++) {
+			if (fabs(coarseLU[i * n + k]) > fabs(coarseLU[pivot * n + k])) {
+				pivot = i;
+			}
+		}
+		coarsePivots[k] = pivot;
+		if (pivot != k) {
+			std::swap_ranges(coarseLU.begin() + k * n, coarseLU.begin() + (k + 1) * n, coarseLU.begin() + pivot * n);
+		}
+		double ukk = coarseLU[k * n + k];
+		if (ukk == 0) {
+			// singular (e.g. no Dirichlet boundary), solveCoarsest() takes 0 for this unknown
+			continue;
+		}
+		for (long i = k + 1; i < n; i ++) {
+			double lik = coarseLU[i * n + k] /= ukk;
+			if (lik != 0) {
+				for (long j = k + 1; j < n; j ++) {
+					coarseLU[i * n + j] -= lik * coarseLU[k * n + j];
+				}
+			}
+		}
+	}
+}
+
+void SparseMultigridSolver::solveCoarsest(Level* level)
+{
+	long n = level->N;
+	double* x = &level->x[0];
+	if (coarseLU.empty()) {
+		std::fill(level->x.begin(), level->x.end(), 0.0);
+		for (int s = 0; s < MULTIGRID_COARSEST_SWEEPS; s ++) {
+			smooth(level, true);
+			smooth(level, false);
+		}
+		return;
+	}
+	memcpy(x, &level->b[0], n * sizeof(double));
+	for (long k = 0; k < n; k ++) {
+		std::swap(x[k], x[coarsePivots[k]]);
+		for (long i = k + 1; i < n; i ++) {
+			x[i] -= coarseLU[i * n + k] * x[k];
+		}
+	}
+	for (long i = n - 1; i >= 0; i --) {
+		double sum = x[i];
+		for (long j = i + 1; j < n; j ++) {
+			sum -= coarseLU[i * n + j] * x[j];
+		}
+		double uii = coarseLU[i * n + i];
+		x[i] = uii == 0 ? 0 : sum / uii;
+	}
+}
+
+/*----------------------------------------------------------------------------
+	Gauss-Seidel sweep of level->x for level->b, each block of rows sweeping
+	with the values of the other blocks from before the sweep
+ --------------------------------------------------------------------------------------*/
+void SparseMultigridSolver::smooth(Level* level, bool bForward)
+{
+	long numBlocks = (long)level->blockStarts.size() - 1;
+	double* x = &level->x[0];
+	const double* b = &level->b[0];
+	const double* xOld = x;
+	if (numBlocks > 1) {
+		level->xOld = level->x;
+		xOld = &level->xOld[0];
+	}
+	const long* rowStarts = &level->rowStarts[0];
+	const int32* columns = level->columns.empty() ? 0 : &level->columns[0];
+	const double* values = level->values.empty() ? 0 : &level->values[0];
+	const double* diagonal = &level->diagonal[0];
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) if (numBlocks > 1)
+#endif
+	for (long block = 0; block < numBlocks; block ++) {
+		long start = level->blockStarts[block];
+		long end = level->blockStarts[block + 1];
+		for (long k = start; k < end; k ++) {
+			long i = bForward ? k : start + end - 1 - k;
+			if (diagonal[i] == 0) {
+				continue;
+			}
+			double sum = b[i];
+			for (long e = rowStarts[i]; e < rowStarts[i + 1]; e ++) {
+				long j = columns[e];
+				sum -= values[e] * (j >= start && j < end ? x[j] : xOld[j]);
+			}
+			x[i] = sum / diagonal[i];
+		}
+	}
+}
+
+void SparseMultigridSolver::residual(Level* level, const double* b, const double* x, double* r)
+{
+	const long* rowStarts = &level->rowStarts[0];
+	const int32* columns = level->columns.empty() ? 0 : &level->columns[0];
+	const double* values = level->values.empty() ? 0 : &level->values[0];
+	const double* diagonal = &level->diagonal[0];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long i = 0; i < level->N; i ++) {
+		double sum = b[i] - diagonal[i] * x[i];
+		for (long e = rowStarts[i]; e < rowStarts[i + 1]; e ++) {
+			sum -= values[e] * x[columns[e]];
+		}
+		r[i] = sum;
+	}
+}
+
+void SparseMultigridSolver::cycle(int l)
+{
+	Level* level = levels[l];
+	if (l + 1 == (int)levels.size()) {
+		solveCoarsest(level);
+		return;
+	}
+	Level* coarse = levels[l + 1];
+
+	std::fill(level->x.begin(), level->x.end(), 0.0);
+	smooth(level, true);
+	residual(level, &level->b[0], &level->x[0], &level->r[0]);
+	std::fill(coarse->b.begin(), coarse->b.end(), 0.0);
+	for (long i = 0; i < level->N; i ++) {
+		coarse->b[level->aggregates[i]] += level->r[i];
+	}
+	cycle(l + 1);
+	double scale = 1.0;
+	if (bScaleCorrections) {
+		scale = correctionScale(coarse);
+	}
+	const long* aggregates = &level->aggregates[0];
+	double* x = &level->x[0];
+	const double* coarseX = &coarse->x[0];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (long i = 0; i < level->N; i ++) {
+		x[i] += scale * coarseX[aggregates[i]];
+	}
+	smooth(level, false);
+}
+
+void SparseMultigridSolver::cycle(const double* r, double* z)
+{
+	Level* level = levels[0];
+	memcpy(&level->b[0], r, level->N * sizeof(double));
+	bScaleCorrections = false;
+	cycle(0);
+	memcpy(z, &level->x[0], level->N * sizeof(double));
+}
+
+/*
+ * for symmetric A, the step along the coarse correction x minimizing the energy norm of the error,
+ * (x, b) / (x, A x) at the coarse level. Aggregates without smoothing make too small
+ * corrections, the more so the more levels are below.
+ */
+double SparseMultigridSolver::correctionScale(Level* coarse)
+{
+	const double* x = &coarse->x[0];
+	const double* b = &coarse->b[0];
+	const long* rowStarts = &coarse->rowStarts[0];
+	const int32* columns = coarse->columns.empty() ? 0 : &coarse->columns[0];
+	const double* values = coarse->values.empty() ? 0 : &coarse->values[0];
+	const double* diagonal = &coarse->diagonal[0];
+	double xb = 0, xax = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+:xb,xax)
+#endif
+	for (long i = 0; i < coarse->N; i ++) {
+		double ax = diagonal[i] * x[i];
+		for (long e = rowStarts[i]; e < rowStarts[i + 1]; e ++) {
+			ax += values[e] * x[columns[e]];
+		}
+		xb += x[i] * b[i];
+		xax += x[i] * ax;
+	}
+	if (xax <= 0 || xb <= 0) {
+		return 1.0;
+	}
+	return std::min(xb / xax, MULTIGRID_MAX_SCALE);
+}
+
+bool SparseMultigridSolver::solve(const double* b, double* x, double relTol, int maxIterations)
+{
+	Level* level = levels[0];
+	long N = level->N;
+	vector<double> r(N), z(N);
+	numIterations = 0;
+	relativeResidual = 0;
+	double bNorm = 0;
+	for (long i = 0; i < N; i ++) {
+		bNorm += b[i] * b[i];
+	}
+	bNorm = sqrt(bNorm);
+	if (bNorm == 0) {
+		std::fill(x, x + N, 0.0);
+		return true;
+	}
+	while (true) {
+		residual(level, b, x, &r[0]);
+		double rNorm = 0;
+		for (long i = 0; i < N; i ++) {
+			rNorm += r[i] * r[i];
+		}
+		relativeResidual = sqrt(rNorm) / bNorm;
+		if (relativeResidual <= relTol) {
+			return true;
+		}
+		if (numIterations == maxIterations) {
+			return false;
+		}
+		memcpy(&level->b[0], &r[0], N * sizeof(double));
+		bScaleCorrections = A->getSymmetricFlag() == MATRIX_SYMMETRIC;
+		cycle(0);
+		memcpy(&z[0], &level->x[0], N * sizeof(double));
+		for (long i = 0; i < N; i ++) {
+			x[i] += z[i];
+		}
+		numIterations ++;
+	}
+}
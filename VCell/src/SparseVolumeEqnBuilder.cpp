@@ -21,6 +21,7 @@ using std::max;
 #include <VCELL/VolumeRegion.h>
 #include <VCELL/VCellModel.h>
 #include <VCELL/SparseMatrixPCG.h>
+#include <EvalContext.h>
 
 #include <assert.h>
 #include <string.h>
@@ -542,10 +543,9 @@ void SparseVolumeEqnBuilder::initEquation(double deltaTime, int volumeIndexStart
 	delete[] columnValues;
 }
 
-double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* lambdas, double bInit) {
+double SparseVolumeEqnBuilder::computeRHS(EvalContext& context, int index, double deltaTime, double* lambdas, double bInit) {
 	string varname = var->getName();
 	double b = bInit;
-	Simulation* sim = SimTool::getInstance()->getSimulation();
 	VolumeElement *pVolumeElement = mesh->getVolumeElements();
 	MembraneElement *pMembraneElement = mesh->getMembraneElements();
 
@@ -555,34 +555,22 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 
 	if (mask & BOUNDARY_TYPE_DIRICHLET){
 		if ((mask & NEIGHBOR_XM_BOUNDARY) && (feature->getXmBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getXmBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_XM_EXP);
 
 		} else if ((mask & NEIGHBOR_XP_BOUNDARY) && (feature->getXpBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getXpBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_XP_EXP);
 
 		} else if ((mask & NEIGHBOR_YM_BOUNDARY) && (feature->getYmBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getYmBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_YM_EXP);
 
 		} else if ((mask & NEIGHBOR_YP_BOUNDARY) && (feature->getYpBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getYpBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_YP_EXP);
 
 		} else if ((mask & NEIGHBOR_ZM_BOUNDARY) && (feature->getZmBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getZmBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_ZM_EXP);
 
 		} else if ((mask & NEIGHBOR_ZP_BOUNDARY) && (feature->getZpBoundaryType() == BOUNDARY_VALUE)){
-			sim->advanceTimeOn();
-			b = varContext->getZpBoundaryValue(index);
-			sim->advanceTimeOff();
+			b = evaluateAdvanced(context, varContext, index, BOUNDARY_ZP_EXP);
 
 		} else {
 			assert(0);
@@ -598,7 +586,7 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 		double lambdaAreaY = lambdas[1];
 		double lambdaAreaZ = lambdas[2];
 
-		double reactionRate = varContext->getReactionRate(index);
+		double reactionRate = varContext->evaluateExpression(context, index, REACT_RATE_EXP);
 		b += reactionRate * deltaTime;
 
 		bool bPeriodic = false;
@@ -647,7 +635,7 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 						continue;
 					}
 
-					double plusReactinoRate = varContext->getReactionRate(plusPeriodicNeighbors[k]);
+					double plusReactinoRate = varContext->evaluateExpression(context, plusPeriodicNeighbors[k], REACT_RATE_EXP);
 					if (fabs(reactionRate - plusReactinoRate) > 1e-3 * fabs(reactionRate)) {
 						throw "non periodic reaction rate at periodic volume.";
 					}
@@ -658,34 +646,22 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 
 			if ((mask & BOUNDARY_TYPE_MASK) == BOUNDARY_TYPE_NEUMANN) { // for corners, it might be both neuman and periodic, but periodic wins.
 				if (mask & NEIGHBOR_XM_BOUNDARY && feature->getXmBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += varContext->getXmBoundaryFlux(index) * lambdaAreaX;
-					sim->advanceTimeOff();
+					b += evaluateAdvanced(context, varContext, index, BOUNDARY_XM_EXP) * lambdaAreaX;
 				}
 				if (mask & NEIGHBOR_XP_BOUNDARY && feature->getXpBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += - varContext->getXpBoundaryFlux(index) * lambdaAreaX;
-					sim->advanceTimeOff();
+					b += - evaluateAdvanced(context, varContext, index, BOUNDARY_XP_EXP) * lambdaAreaX;
 				}
 				if (mask & NEIGHBOR_YM_BOUNDARY && feature->getYmBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += varContext->getYmBoundaryFlux(index) * lambdaAreaY;
-					sim->advanceTimeOff();
+					b += evaluateAdvanced(context, varContext, index, BOUNDARY_YM_EXP) * lambdaAreaY;
 				}
 				if (mask & NEIGHBOR_YP_BOUNDARY && feature->getYpBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += - varContext->getYpBoundaryFlux(index) * lambdaAreaY;
-					sim->advanceTimeOff();
+					b += - evaluateAdvanced(context, varContext, index, BOUNDARY_YP_EXP) * lambdaAreaY;
 				}
 				if (mask & NEIGHBOR_ZM_BOUNDARY && feature->getZmBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += varContext->getZmBoundaryFlux(index) * lambdaAreaZ;
-					sim->advanceTimeOff();
+					b += evaluateAdvanced(context, varContext, index, BOUNDARY_ZM_EXP) * lambdaAreaZ;
 				}
 				if (mask & NEIGHBOR_ZP_BOUNDARY && feature->getZpBoundaryType() == BOUNDARY_FLUX){
-					sim->advanceTimeOn();
-					b += - varContext->getZpBoundaryFlux(index) * lambdaAreaZ;
-					sim->advanceTimeOff();
+					b += - evaluateAdvanced(context, varContext, index, BOUNDARY_ZP_EXP) * lambdaAreaZ;
 				}
 			}
 		}
@@ -693,9 +669,7 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 			int numAdjacentME = (int)pVolumeElement[index].adjacentMembraneIndexes.size();
 			for (int i = 0; i < numAdjacentME; i ++) {
 				MembraneElement *me = pMembraneElement + pVolumeElement[index].adjacentMembraneIndexes[i];
-				sim->advanceTimeOn();
-				double flux = varContext->getFlux(me);
-				sim->advanceTimeOff();
+				double flux = evaluateAdvancedFlux(context, varContext, me);
 				b += flux * me->area * deltaTime / VOLUME;
 			}
 			if (bPeriodic) {
@@ -707,9 +681,7 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 					int numAdjacentME = (int)pVolumeElement[plusPeriodicNeighbors[k]].adjacentMembraneIndexes.size();
 					for (int i = 0; i < numAdjacentME; i ++) {
 						MembraneElement *me = pMembraneElement + pVolumeElement[plusPeriodicNeighbors[k]].adjacentMembraneIndexes[i];
-						sim->advanceTimeOn();
-						double flux = varContext->getFlux(me);
-						sim->advanceTimeOff();
+						double flux = evaluateAdvancedFlux(context, varContext, me);
 						b += flux * me->area * deltaTime / VOLUME;
 					}
 				}
@@ -726,6 +698,28 @@ double SparseVolumeEqnBuilder::computeRHS(int index, double deltaTime, double* l
 //
 //------------------------------------------------------------------
 void SparseVolumeEqnBuilder::buildEquation(double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
+{
+	EvalContext context;
+	initEvalContext(context);
+	beginSlabs(deltaTime);
+	if (bSolveWholeMesh) {
+		buildEquation(context, deltaTime, volumeIndexStart, volumeIndexSize, membraneIndexStart, membraneIndexSize);
+	} else {
+		buildEquation(context, deltaTime, 0, mesh->getNumVolumeElements(), membraneIndexStart, membraneIndexSize);
+	}
+	endSlabs(deltaTime);
+}
+
+void SparseVolumeEqnBuilder::beginSlabs(double deltaTime)
+{
+	advancedTime = getAdvancedTime();
+	if (bSolveWholeMesh) {
+		memcpy(B, var->getCurr(), var->getSize() * sizeof(double));
+	}
+}
+
+// the right hand side at the elements of the range
+void SparseVolumeEqnBuilder::buildEquation(EvalContext& context, double deltaTime, int volumeIndexStart, int volumeIndexSize, int membraneIndexStart, int membraneIndexSize)
 {
 	double lambdaAreaX = deltaTime/DELTAX;
 	double lambdaAreaY = deltaTime/DELTAY;
@@ -733,20 +727,26 @@ void SparseVolumeEqnBuilder::buildEquation(double deltaTime, int volumeIndexStar
 	double lambdas[3] = {lambdaAreaX, lambdaAreaY, lambdaAreaZ};
 
 	if (bSolveWholeMesh) {
-		memcpy(B, var->getCurr(), var->getSize() * sizeof(double));
 		for (int index = volumeIndexStart; index < volumeIndexStart + volumeIndexSize; index ++){
-			B[index] = computeRHS(index, deltaTime, lambdas, B[index]);
+			B[index] = computeRHS(context, index, deltaTime, lambdas, B[index]);
 		}
 	} else {
 		double* currVal = var->getCurr();
-		for (int localIndex = 0; localIndex < getSize() ; localIndex ++) {
-			int globalIndex = LocalToGlobalMap[localIndex];
+		for (int globalIndex = volumeIndexStart; globalIndex < volumeIndexStart + volumeIndexSize; globalIndex ++) {
+			int localIndex = GlobalToLocalMap[globalIndex];
+			if (localIndex < 0) {
+				continue;
+			}
 			// to initialize X, which will be passed to solver as intial guess and final solution.
 			// or set initial guess to zero (need to revisit, we also want to revisit fill-in parameter)
 			X[localIndex] = currVal[globalIndex];
-			B[localIndex] = computeRHS(globalIndex, deltaTime, lambdas, X[localIndex]);
+			B[localIndex] = computeRHS(context, globalIndex, deltaTime, lambdas, X[localIndex]);
 		}
 	}
+}
+
+void SparseVolumeEqnBuilder::endSlabs(double deltaTime)
+{
 	// to make the matrix symmetric
 	// for the points who have dirichlet neighbors
 	// we have to change the right hand side
@@ -761,6 +761,22 @@ void SparseVolumeEqnBuilder::buildEquation(double deltaTime, int volumeIndexStar
 	}
 }
 
+double SparseVolumeEqnBuilder::evaluateAdvanced(EvalContext& context, VarContext* varContext, int index, long expIndex) {
+	double time = context.time;
+	context.time = advancedTime;
+	double value = varContext->evaluateExpression(context, index, expIndex);
+	context.time = time;
+	return value;
+}
+
+double SparseVolumeEqnBuilder::evaluateAdvancedFlux(EvalContext& context, VarContext* varContext, MembraneElement* element) {
+	double time = context.time;
+	context.time = advancedTime;
+	double value = varContext->evaluateJumpCondition(context, element);
+	context.time = time;
+	return value;
+}
+
 bool SparseVolumeEqnBuilder::checkPeriodicCoupledPairsInRegions(int indexm, int indexp) {
 	if (bSolveWholeMesh) {
 		return true;
@@ -5,21 +5,16 @@
 #include <VCELL/SundialsPdeScheduler.h>
 #include <VCELL/SimTypes.h>
 
-extern "C"
-{
-#if defined(FORTRAN_BARE)
-#define PCILU pcilu
-#elif defined(FORTRAN_UNDERSCORE)
-#define PCILU pcilu_
-#endif
-void PCILU(int *, long *, int32 *, double *, double *, double *, double *);
-}
-
 #include <algorithm>
 #include <iostream>
+#include <exception>
 using std::max;
 using std::endl;
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <VCELL/Element.h>
 #include <VCELL/SimTypes.h>
 #include <VCELL/Solver.h>
@@ -42,7 +37,11 @@ using std::endl;
 #include <VCELL/MembraneRegion.h>
 #include <VCELL/VCellModel.h>
 #include <SimpleSymbolTable.h>
+#include <FusedExpressionProgram.h>
 #include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/SparseILUPreconditioner.h>
+#include <VCELL/Profiler.h>
+using VCell::FusedExpressionProgram;
 
 #include <assert.h>
 #include <string.h>
@@ -70,6 +69,12 @@ static int plusMasks[3] = {NEIGHBOR_XP_MASK, NEIGHBOR_YP_MASK, NEIGHBOR_ZP_MASK}
 
 #define PRECOMPUTE_DIFFUSION_COEFFICIENT
 
+// number of points whose reaction rates are evaluated together
+#define RHS_BATCH_SIZE 256
+
+// relative change of gamma since the last factorization of M that triggers a new one
+#define PRECONDITIONER_REFACTOR_GAMMA_CHANGE 0.3
+
 
 SundialsPdeScheduler::SundialsPdeScheduler(Simulation *sim, const SundialsSolverOptions& sso, int numDisTimes, double* disTimes, bool bDefaultOuptput) : Scheduler(sim)
 {
@@ -87,19 +92,30 @@ SundialsPdeScheduler::SundialsPdeScheduler(Simulation *sim, const SundialsSolver
     numUnknowns = 0;
 
     M = 0;
-    pcg_workspace = 0;
+    preconditioner = 0;
 
-    bPcReinit = true;
-    bLUcomputed = false;
+    factorGamma = 0;
 
     bSundialsOneStepOutput = bDefaultOuptput;
     currentTime = 0;
 
     statePointValues = 0;
-    neighborStatePointValues = 0;
+
+    valueArraySize = 0;
+    numRhsWorkspaces = 0;
+    rhsWorkspaces = 0;
+    reactionRates = 0;
+    diffusionRates = 0;
+    velocities[0] = velocities[1] = velocities[2] = 0;
+    membraneFluxes = 0;
+    regionReactionPrograms = 0;
+    membraneReactionPrograms = 0;
 
     diffCoeffs = 0;
+    volumeStencils = 0;
     rhsGradients = 0;
+
+    numRhsEvaluations = 0;
 }
 
 
@@ -108,14 +124,8 @@ SundialsPdeScheduler::~SundialsPdeScheduler()
     N_VDestroy_Serial(y);
     CVodeFree(&sundialsSolverMemory);
 
-    delete[] statePointValues;
-
-    if (bHasVariableDiffusionAdvection) {
-        for (int n = 0; n < 3; n ++) {
-            delete[] neighborStatePointValues[n];
-        }
-        delete neighborStatePointValues;
-    }
+    delete[] rhsWorkspaces;
+    deleteReactionPrograms();
 
     delete[] global2Local;
     delete[] local2Global;
@@ -123,8 +133,8 @@ SundialsPdeScheduler::~SundialsPdeScheduler()
     delete[] regionOffsets;
     delete[] volVectorOffsets;
 
+    delete preconditioner;
     delete M;
-    delete[] pcg_workspace;
 
     if (simulation->getNumVolVariables() > 0) {
         int numVolRegions = mesh->getNumVolumeRegions();
@@ -138,7 +148,7 @@ SundialsPdeScheduler::~SundialsPdeScheduler()
     }
 
     delete[] diffCoeffs;
-    delete[] rhsGradients;
+    delete[] volumeStencils;
 }
 
 void SundialsPdeScheduler::iterate() {
@@ -310,7 +320,7 @@ void SundialsPdeScheduler::setupOrderMaps() {
 
     cout << "numUnknowns = " << numUnknowns << endl;
     if (bHasGradient) {
-        rhsGradients = new double[numUnknowns];
+        rhsGradients = scratch.allocate<double>(numUnknowns);
     }
 }
 
@@ -376,10 +386,9 @@ int SundialsPdeScheduler::RHS_callback(realtype t, N_Vector yinput, N_Vector rhs
 
 int SundialsPdeScheduler::CVodeRHS(double t, double* yinput, double* rhs) {
 #ifdef COMPARE_WITH_OLD
-    double* r1 = new double[numUnknowns];
-	double* r2 = new double[numUnknowns];
-	memset(r1, 0, numUnknowns * sizeof(double));
-	memset(r2, 0, numUnknowns * sizeof(double));
+    ScratchArena::Mark scratchMark = scratch.mark();
+    double* r1 = scratch.allocate<double>(numUnknowns);
+	double* r2 = scratch.allocate<double>(numUnknowns);
 	applyVolumeOperatorOld(t, yinput, r1);
 	applyVolumeOperator(t, yinput, r2);
 
@@ -391,22 +400,59 @@ int SundialsPdeScheduler::CVodeRHS(double t, double* yinput, double* rhs) {
 		}
 	}
 	cout << "--compared with old code" << endl;
-	delete[] r1;
-	delete[] r2;
+	scratch.release(scratchMark);
 #endif
     //cout << yinput[14008] << endl;
     //if (MathUtil::isInfinity(yinput[14008]) || MathUtil::isNaN(yinput[14008])) {
     //	exit(1);
     //}
+    static ProfileHandle rhsHandle = Profiler::getHandle("rhs");
+    static ProfileHandle operatorHandles[7] = {
+        Profiler::getHandle("rhs.reactionRates"),
+        Profiler::getHandle("rhs.membraneFluxes"),
+        Profiler::getHandle("rhs.volumeOperator"),
+        Profiler::getHandle("rhs.membraneDiffusionReactionOperator"),
+        Profiler::getHandle("rhs.volumeRegionReactionOperator"),
+        Profiler::getHandle("rhs.membraneRegionReactionOperator"),
+        Profiler::getHandle("rhs.membraneFluxOperator")
+    };
+    ProfileScope rhsScope(rhsHandle);
+
     memset(rhs, 0, numUnknowns * sizeof(double));
     if (bHasGradient) {
         memset(rhsGradients, 0, numUnknowns * sizeof(double));
     }
-    applyVolumeOperator(t, yinput, rhs);
-    applyMembraneDiffusionReactionOperator(t, yinput, rhs);
-    applyVolumeRegionReactionOperator(t, yinput, rhs);
-    applyMembraneRegionReactionOperator(t, yinput, rhs);
-    applyMembraneFluxOperator(t, yinput, rhs);
+    {
+        ProfileScope scope(operatorHandles[0]);
+        runRhsBlocks(&SundialsPdeScheduler::computeReactionRateBlock, (int)rateBlockRegions.size(), t, yinput, rhs);
+    }
+    if (simulation->getNumVolPde() > 0) {
+        ProfileScope scope(operatorHandles[1]);
+        int numFluxBlocks = (mesh->getNumMembraneElements() + RHS_BATCH_SIZE - 1) / RHS_BATCH_SIZE;
+        runRhsBlocks(&SundialsPdeScheduler::computeMembraneFluxBlock, numFluxBlocks, t, yinput, rhs);
+    }
+    {
+        ProfileScope scope(operatorHandles[2]);
+        applyVolumeOperator(t, yinput, rhs);
+    }
+    {
+        ProfileScope scope(operatorHandles[3]);
+        applyMembraneDiffusionReactionOperator(t, yinput, rhs);
+    }
+    {
+        ProfileScope scope(operatorHandles[4]);
+        applyVolumeRegionReactionOperator(t, yinput, rhs);
+    }
+    {
+        ProfileScope scope(operatorHandles[5]);
+        applyMembraneRegionReactionOperator(t, yinput, rhs);
+    }
+    {
+        ProfileScope scope(operatorHandles[6]);
+        applyMembraneFluxOperator(t, yinput, rhs);
+    }
+
+    numRhsEvaluations ++;
 
 #ifdef SHOW_RHS
     cout << endl << "-----------RHS----at time " << t << "--------------" << endl;
@@ -442,23 +488,84 @@ void SundialsPdeScheduler::initSundialsSolver() {
         randomVariableSymbolOffset = fieldDataSymbolOffset + simulation->getNumFields();
         parameterSymbolOffset = randomVariableSymbolOffset + simulation->getNumRandomVariables();
 
-        int valueArraySize = parameterSymbolOffset + simulation->getNumParameters();
+        valueArraySize = parameterSymbolOffset + simulation->getNumParameters();
 
-        statePointValues = new double[valueArraySize];
-        memset(statePointValues, 0, valueArraySize * sizeof(double));
+        statePointValues = scratch.allocate<double>(valueArraySize);
 
-        if (bHasVariableDiffusionAdvection) {
-            neighborStatePointValues = new double*[3];
+#ifdef _OPENMP
+        numRhsWorkspaces = omp_get_max_threads();
+#else
+        numRhsWorkspaces = 1;
+#endif
+        int maxNumRates = max(1, max(numVolVar, numMemVar));
+        rhsWorkspaces = new RhsWorkspace[numRhsWorkspaces];
+        for (int i = 0; i < numRhsWorkspaces; i ++) {
+            RhsWorkspace& workspace = rhsWorkspaces[i];
+            workspace.statePointValues = scratch.allocate<double>(valueArraySize);
+            workspace.batchValues = scratch.allocate<double>(valueArraySize * RHS_BATCH_SIZE);
+            workspace.batchColumns = scratch.allocate<double*>(valueArraySize);
+            for (int j = 0; j < valueArraySize; j ++) {
+                workspace.batchColumns[j] = workspace.batchValues + j * RHS_BATCH_SIZE;
+            }
+            workspace.batchRates = scratch.allocate<double>(maxNumRates * RHS_BATCH_SIZE);
+            workspace.batchIndexes = scratch.allocate<int>(RHS_BATCH_SIZE);
+            workspace.batchPointSlots = scratch.allocate<int>(RHS_BATCH_SIZE);
+            workspace.batchRateRows = scratch.allocate<double*>(maxNumRates);
+            workspace.programWorkspace = 0;
             for (int n = 0; n < 3; n ++) {
-                neighborStatePointValues[n] = new double[valueArraySize];
-                memset(neighborStatePointValues[n], 0, valueArraySize * sizeof(double));
+                workspace.neighborStatePointValues[n] = 0;
+            }
+        }
+
+        reactionRates = scratch.allocate<double>(numUnknowns);
+        if (simulation->getNumVolPde() > 0) {
+            int numFluxes = mesh->getNumMembraneElements() * 2 * numVolVar;
+            membraneFluxes = scratch.allocate<double>(numFluxes);
+        }
+
+        // volume blocks never span two regions, membrane blocks follow
+        for (int r = 0; r < mesh->getNumVolumeRegions(); r ++) {
+            if (numVolVar == 0 || regionDefinedVolVariableSizes[r] == 0) {
+                continue;
+            }
+            for (int start = 0; start < regionSizes[r]; start += RHS_BATCH_SIZE) {
+                rateBlockRegions.push_back(r);
+                rateBlockStarts.push_back(start);
+            }
+        }
+        if (numMemVar > 0) {
+            for (int start = 0; start < mesh->getNumMembraneElements(); start += RHS_BATCH_SIZE) {
+                rateBlockRegions.push_back(-1);
+                rateBlockStarts.push_back(start);
+            }
+        }
+
+        if (bHasVariableDiffusionAdvection) {
+            for (int i = 0; i < numRhsWorkspaces; i ++) {
+                for (int n = 0; n < 3; n ++) {
+                    rhsWorkspaces[i].neighborStatePointValues[n] = scratch.allocate<double>(valueArraySize);
+                }
+            }
+            diffusionRates = scratch.allocate<double>(numUnknowns);
+            if (bHasAdvection) {
+                for (int n = 0; n < dimension; n ++) {
+                    velocities[n] = scratch.allocate<double>(numUnknowns);
+                }
             }
         }
 
+        if (numVolVar > 0) {
+            buildVolumeStencils();
+        }
+
 #ifndef SUNDIALS_USE_PCNONE
         preallocateM();
 #endif
 
+        if (SimTool::getInstance()->isCompileExpressions()) {
+            simulation->compileExpressions();
+        }
+
         y = N_VNew_Serial(numUnknowns);
         if (y == 0) {
             throw "SundialsPDESolver:: Out of Memory : y ";
@@ -571,11 +678,29 @@ void SundialsPdeScheduler::initSundialsSolver() {
 
     // only populate once serial scan parameter values
     simulation->populateParameterValues(statePointValues + parameterSymbolOffset);
-    if (bHasVariableDiffusionAdvection) {
-        for (int n = 0; n < 3; n ++) {
-            simulation->populateParameterValues(neighborStatePointValues[n] + parameterSymbolOffset);
+    for (int i = 0; i < numRhsWorkspaces; i ++) {
+        simulation->populateParameterValues(rhsWorkspaces[i].statePointValues + parameterSymbolOffset);
+        if (bHasVariableDiffusionAdvection) {
+            for (int n = 0; n < 3; n ++) {
+                simulation->populateParameterValues(rhsWorkspaces[i].neighborStatePointValues[n] + parameterSymbolOffset);
+            }
         }
     }
+    VCellModel* model = SimTool::getInstance()->getModel();
+    for (int i = 0; i < model->getNumFeatures(); i ++) {
+        model->getFeatureFromIndex(i)->createStackMachines();
+    }
+    for (int i = 0; i < model->getNumMembranes(); i ++) {
+        model->getMembraneFromIndex(i)->createStackMachines();
+    }
+    buildReactionPrograms();
+    int programWorkspaceSize = 1;
+    for (int i = 0; i < (int)reactionPrograms.size(); i ++) {
+        programWorkspaceSize = max(programWorkspaceSize, reactionPrograms[i]->getWorkspaceSize());
+    }
+    for (int i = 0; i < numRhsWorkspaces; i ++) {
+        rhsWorkspaces[i].programWorkspace = scratch.allocate<double>(programWorkspaceSize);
+    }
 
 #ifndef SUNDIALS_USE_PCNONE
     if (!simulation->hasTimeDependentDiffusionAdvection()) {
@@ -640,6 +765,12 @@ void SundialsPdeScheduler::printCVodeStats()
     printf("nsetups = %5ld     netf    = %5ld\n"  , nsetups, netf);
     printf("npe     = %5ld     nps     = %5ld\n"  , npe, nps);
     printf("ncfn    = %5ld     ncfl    = %5ld\n", ncfn, ncfl);
+    if (preconditioner != 0) {
+        printf("npf     = %5d\n", preconditioner->getNumFactorizations());
+    }
+    printf("nrhs    = %5ld\n", numRhsEvaluations);
+    printf("scratch = %5ld KB in %ld block(s), peak %ld KB in %ld allocations\n", (long)(scratch.getCapacity() / 1024),
+        scratch.getNumHeapAllocations(), (long)(scratch.getPeakBytesInUse() / 1024), scratch.getNumAllocations());
     printf("last step  = %f\n\n", hlast);
 }
 
@@ -995,21 +1126,30 @@ static void applyAdvectionHybridScheme(double diffTerm, double advectTerm, doubl
     }
 }
 
+// regions run on all threads, except with gradients: each variable region adds all of rhsGradients to rhs
 void SundialsPdeScheduler::applyVolumeOperator(double t, double* yinput, double* rhs) {
     if (simulation->getNumVolVariables() == 0) {
         return;
     }
-    for (int r = 0; r < mesh->getNumVolumeRegions(); r ++) {
-        if (bRegionHasConstantCoefficients[r]) {
-            regionApplyVolumeOperatorConstant(r, t, yinput, rhs);
-        } else {
-            regionApplyVolumeOperatorVariable(r, t, yinput, rhs);
+    if (bHasGradient) {
+        for (int r = 0; r < mesh->getNumVolumeRegions(); r ++) {
+            regionApplyVolumeOperator(rhsWorkspaces[0], r, t, yinput, rhs);
         }
+        return;
+    }
+    runRhsBlocks(&SundialsPdeScheduler::regionApplyVolumeOperator, mesh->getNumVolumeRegions(), t, yinput, rhs);
+}
+
+void SundialsPdeScheduler::regionApplyVolumeOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs) {
+    if (bRegionHasConstantCoefficients[regionID]) {
+        regionApplyVolumeOperatorConstant(workspace, regionID, t, yinput, rhs);
+    } else {
+        regionApplyVolumeOperatorVariable(workspace, regionID, t, yinput, rhs);
     }
 }
 
 // for dirichlet point, boundary condition has to be used.
-void SundialsPdeScheduler::dirichletPointSetup(int volIndex, Feature* feature, VarContext* varContext, int mask, int* volumeNeighbors, double& ypoint) {
+void SundialsPdeScheduler::dirichletPointSetup(int volIndex, Feature* feature, VarContext* varContext, int mask, int* volumeNeighbors, double* values, double& ypoint) {
     volumeNeighbors[0] = -1;
     volumeNeighbors[1] = -1;
     volumeNeighbors[2] = -1;
@@ -1018,7 +1158,7 @@ void SundialsPdeScheduler::dirichletPointSetup(int volIndex, Feature* feature, V
             volumeNeighbors[2] = volIndex + Nxy;
         }
         if (feature->getZmBoundaryType() == BOUNDARY_VALUE) {
-            ypoint = varContext->evaluateExpression(BOUNDARY_ZM_EXP,  statePointValues);
+            ypoint = varContext->evaluateExpression(BOUNDARY_ZM_EXP,  values);
         }
     }
     if (dimension > 1 && (mask & NEIGHBOR_YM_MASK))  {
@@ -1026,7 +1166,7 @@ void SundialsPdeScheduler::dirichletPointSetup(int volIndex, Feature* feature, V
             volumeNeighbors[1] = volIndex + Nx;
         }
         if (feature->getYmBoundaryType() == BOUNDARY_VALUE) {
-            ypoint = varContext->evaluateExpression(BOUNDARY_YM_EXP, statePointValues);
+            ypoint = varContext->evaluateExpression(BOUNDARY_YM_EXP, values);
         }
     }
     if (mask & NEIGHBOR_XM_MASK)  {
@@ -1036,34 +1176,34 @@ void SundialsPdeScheduler::dirichletPointSetup(int volIndex, Feature* feature, V
             volumeNeighbors[0] = volIndex + 1;
         }
         if (feature->getXmBoundaryType() == BOUNDARY_VALUE) {
-            ypoint = varContext->evaluateExpression(BOUNDARY_XM_EXP, statePointValues);
+            ypoint = varContext->evaluateExpression(BOUNDARY_XM_EXP, values);
         }
     }
 }
 
 // boundary flux equals -D*DU/DX at the xm and xp walls, -D*DU/DY at the ym and yp walls
-double SundialsPdeScheduler::computeNeumannCondition(Feature* feature, VarContext* varContext, int mask, double* scaleSs) {
+double SundialsPdeScheduler::computeNeumannCondition(Feature* feature, VarContext* varContext, int mask, double* scaleSs, double* values) {
     double boundaryCondition = 0;
     if (mask & NEIGHBOR_XM_BOUNDARY && feature->getXmBoundaryType() == BOUNDARY_FLUX){
-        boundaryCondition += varContext->evaluateExpression(BOUNDARY_XM_EXP, statePointValues) * oneOverH[0] * scaleSs[0];
+        boundaryCondition += varContext->evaluateExpression(BOUNDARY_XM_EXP, values) * oneOverH[0] * scaleSs[0];
     }
     if (mask & NEIGHBOR_XP_BOUNDARY && feature->getXpBoundaryType() == BOUNDARY_FLUX){
-        boundaryCondition -= varContext->evaluateExpression(BOUNDARY_XP_EXP, statePointValues) * oneOverH[0] * scaleSs[0];
+        boundaryCondition -= varContext->evaluateExpression(BOUNDARY_XP_EXP, values) * oneOverH[0] * scaleSs[0];
     }
     if (dimension > 1) {
         if (mask & NEIGHBOR_YM_BOUNDARY && feature->getYmBoundaryType() == BOUNDARY_FLUX){
-            boundaryCondition += varContext->evaluateExpression(BOUNDARY_YM_EXP, statePointValues) * oneOverH[1] * scaleSs[1];
+            boundaryCondition += varContext->evaluateExpression(BOUNDARY_YM_EXP, values) * oneOverH[1] * scaleSs[1];
         }
         if (mask & NEIGHBOR_YP_BOUNDARY && feature->getYpBoundaryType() == BOUNDARY_FLUX){
-            boundaryCondition -= varContext->evaluateExpression(BOUNDARY_YP_EXP, statePointValues) * oneOverH[1] * scaleSs[1];
+            boundaryCondition -= varContext->evaluateExpression(BOUNDARY_YP_EXP, values) * oneOverH[1] * scaleSs[1];
         }
 
         if (dimension > 2) {
             if (mask & NEIGHBOR_ZM_BOUNDARY && feature->getZmBoundaryType() == BOUNDARY_FLUX){
-                boundaryCondition += varContext->evaluateExpression(BOUNDARY_ZM_EXP, statePointValues) * oneOverH[2] * scaleSs[2];
+                boundaryCondition += varContext->evaluateExpression(BOUNDARY_ZM_EXP, values) * oneOverH[2] * scaleSs[2];
             }
             if (mask & NEIGHBOR_ZP_BOUNDARY && feature->getZpBoundaryType() == BOUNDARY_FLUX){
-                boundaryCondition -= varContext->evaluateExpression(BOUNDARY_ZP_EXP, statePointValues) * oneOverH[2] * scaleSs[2];
+                boundaryCondition -= varContext->evaluateExpression(BOUNDARY_ZP_EXP, values) * oneOverH[2] * scaleSs[2];
             }
         }
     }
@@ -1094,63 +1234,163 @@ void computeScaleS(int mask, double* scaleS) {
 								};
 
 
+// volume indexes, masks, neighbors and flux scales of the points of each region, and the
+// constant coefficients of the variables of constant coefficient regions
+void SundialsPdeScheduler::buildVolumeStencils() {
+    int numVolRegions = mesh->getNumVolumeRegions();
+    volumeStencils = new VolumeStencil[numVolRegions];
+    for (int r = 0; r < numVolRegions; r ++) {
+        int numVars = regionDefinedVolVariableSizes[r];
+        if (numVars == 0) {
+            continue;
+        }
+        VolumeStencil& stencil = volumeStencils[r];
+        int firstPointVolIndex = local2Global[regionOffsets[r]];
+        Feature* feature = pVolumeElement[firstPointVolIndex].getFeature();
+
+        int size = regionSizes[r];
+        stencil.volIndexes.resize(size);
+        stencil.masks.resize(size);
+        stencil.bBoundary.resize(size);
+        for (int n = 0; n < 3; n ++) {
+            stencil.neighborVectorOffsets[n].resize(size);
+            stencil.fluxScales[n].resize(size);
+        }
+        for (int regionPointIndex = 0; regionPointIndex < size; regionPointIndex ++) {
+            int volIndex = local2Global[regionPointIndex + regionOffsets[r]];
+            int mask = pVolumeElement[volIndex].neighborMask;
+            double scaleS[3] = {1, 1, 1};
+            if (mask & NEIGHBOR_BOUNDARY_MASK) {
+                computeScaleS(mask, scaleS);
+            }
+
+            // Macro
+            defineVolumeNeighbors(volIndex, mask)
+
+            bool bBoundary = (mask & (NEIGHBOR_BOUNDARY_MASK | BOUNDARY_TYPE_DIRICHLET)) != 0;
+            stencil.volIndexes[regionPointIndex] = volIndex;
+            stencil.masks[regionPointIndex] = mask;
+            for (int n = 0; n < 3; n ++) {
+                int neighborIndex = volumeNeighbors[n];
+                stencil.neighborVectorOffsets[n][regionPointIndex] = neighborIndex < 0 ? -1 : getVolumeElementVectorOffset(neighborIndex, r);
+                stencil.fluxScales[n][regionPointIndex] = scaleS[n] * oneOverH[n];
+                if (neighborIndex >= 0 && (pVolumeElement[neighborIndex].neighborMask & BOUNDARY_TYPE_DIRICHLET)) {
+                    bBoundary = true;
+                }
+            }
+            stencil.bBoundary[regionPointIndex] = bBoundary;
+        }
+
+        stencil.vars.resize(numVars);
+        stencil.varContexts.resize(numVars);
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+            VolumeVariable* var = simulation->getVolVariable(regionDefinedVolVariableIndexes[r][activeVarCount]);
+            stencil.vars[activeVarCount] = var;
+            stencil.varContexts[activeVarCount] = feature->getVolumeVarContext(var);
+        }
+        if (!bRegionHasConstantCoefficients[r]) {
+            continue;
+        }
+
+        stencil.diffusionRates.assign(numVars, 0);
+        stencil.advectTerms.assign(numVars * 6, 0);
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+            VolumeVariable* var = stencil.vars[activeVarCount];
+            VolumeVarContextExpression* varContext = stencil.varContexts[activeVarCount];
+            if (!var->isDiffusing() && !var->isAdvecting()) {
+                continue;
+            }
+            double D = varContext->evaluateConstantExpression(DIFF_RATE_EXP);
+            stencil.diffusionRates[activeVarCount] = D;
+            if (!var->isAdvecting()) {
+                continue;
+            }
+
+            double Vi_XYZ[3] = {0, 0, 0};
+            Vi_XYZ[0] = varContext->evaluateConstantExpression(VELOCITY_X_EXP);
+            if (dimension > 1) {
+                Vi_XYZ[1] = varContext->evaluateConstantExpression(VELOCITY_Y_EXP);
+            }
+            if (dimension > 2) {
+                Vi_XYZ[2] = varContext->evaluateConstantExpression(VELOCITY_Z_EXP);
+            }
+
+            for (int n = 0; n < 3; n ++) {
+                double diffTerm = D * oneOverH[n];
+                double advectTerm = -Vi_XYZ[n];
+
+                double Aii = 0, Aij = 0;
+                applyAdvectionHybridScheme(diffTerm, advectTerm, Aii, Aij);
+                stencil.advectTerms[activeVarCount * 6 + n * 2] = Aii;
+                stencil.advectTerms[activeVarCount * 6 + n * 2 + 1] = Aij;
+            } // end for n
+        }
+    }
+}
+
 // now we update volume flux symmetrically because D*(Uj - Ui)*S/d is the same (opposite sign) for point i and j.
 // but what we computed is D*(Uj - Ui)*S/(d * dV) which will be the same for both too, but at the end, we have to
 // scale it with volume scale. So now we only have to process neighbor points whose indexes are bigger.
 // because we have to scale the flux, we have to make sure
 // 1. we process points from small global index to big global index (we checked this)
 // 2. we always add reaction at the end because reaction term doesn't have dV (otherwise we need another loop to process reaction).
+//
+// points without boundary conditions only need their stencil: no expression is evaluated for them.
 
-void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, double t, double* yinput, double* rhs) {
-    if (regionDefinedVolVariableSizes[regionID] == 0) {
+void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs) {
+    int numVars = regionDefinedVolVariableSizes[regionID];
+    if (numVars == 0) {
         return;
     }
 
-    int firstPointVolIndex = local2Global[regionOffsets[regionID]];
-    Feature* feature = pVolumeElement[firstPointVolIndex].getFeature();
-    double (*advectTerms)[6] = 0;
-    if (bHasAdvection) {
-        advectTerms = new double[regionDefinedVolVariableSizes[regionID]][6];
-        memset(advectTerms, 0, regionDefinedVolVariableSizes[regionID] * 6 * sizeof(double));
+    VolumeStencil& stencil = volumeStencils[regionID];
+    Feature* feature = pVolumeElement[stencil.volIndexes[0]].getFeature();
+    const int* neighborVectorOffsets[3] = {&stencil.neighborVectorOffsets[0][0], &stencil.neighborVectorOffsets[1][0], &stencil.neighborVectorOffsets[2][0]};
+    const double* fluxScales[3] = {&stencil.fluxScales[0][0], &stencil.fluxScales[1][0], &stencil.fluxScales[2][0]};
+    const double* diffusionRates = &stencil.diffusionRates[0];
+    const double* advectTerms = &stencil.advectTerms[0];
 
-        for (int activeVarCount = 0; activeVarCount < regionDefinedVolVariableSizes[regionID]; activeVarCount ++) {
-            int varIndex = regionDefinedVolVariableIndexes[regionID][activeVarCount];
-            VolumeVariable* var = simulation->getVolVariable(varIndex);
-
-            if (var->isAdvecting()) {
-
-                VolumeVarContextExpression* varContext = feature->getVolumeVarContext(var);
-                double D = varContext->evaluateConstantExpression(DIFF_RATE_EXP);
-
-                double Vi_XYZ[3] = {0, 0, 0};
-                Vi_XYZ[0] = varContext->evaluateConstantExpression(VELOCITY_X_EXP);
-                if (dimension > 1) {
-                    Vi_XYZ[1] = varContext->evaluateConstantExpression(VELOCITY_Y_EXP);
-                }
-                if (dimension > 2) {
-                    Vi_XYZ[2] = varContext->evaluateConstantExpression(VELOCITY_Z_EXP);
+    // loop through points
+    int vectorIndexOffset = volVectorOffsets[regionID];
+    for (int regionPointIndex = 0; regionPointIndex < regionSizes[regionID]; regionPointIndex ++, vectorIndexOffset += numVars) {
+        if (!stencil.bBoundary[regionPointIndex]) {
+            for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+                int vectorIndex = vectorIndexOffset + activeVarCount;
+                double reactionRate = reactionRates[vectorIndex];
+                VolumeVariable* var = stencil.vars[activeVarCount];
+                if (!var->isDiffusing()) {
+                    rhs[vectorIndex] += reactionRate;
+                    continue;
                 }
 
+                double ypoint = yinput[vectorIndex];
+                bool bAdvecting = var->isAdvecting();
+                double D = diffusionRates[activeVarCount];
+                const double* varAdvectTerms = advectTerms + activeVarCount * 6;
                 for (int n = 0; n < 3; n ++) {
-                    double diffTerm = D * oneOverH[n];
+                    int neighborVectorOffset = neighborVectorOffsets[n][regionPointIndex];
+                    if (neighborVectorOffset < 0) {
+                        continue;
+                    }
+                    int neighborVectorIndex = neighborVectorOffset + activeVarCount;
+                    double yneighbor = yinput[neighborVectorIndex];
                     double diffAdvectTerm = 0;
-                    double V = Vi_XYZ[n];
-                    double advectTerm = -V;
-
-                    double Aii = 0, Aij = 0;
-                    applyAdvectionHybridScheme(diffTerm, advectTerm, Aii, Aij);
-                    advectTerms[activeVarCount][n*2] = Aii;
-                    advectTerms[activeVarCount][n*2 + 1] = Aij;
-                } // end for n
+                    if (bAdvecting) {
+                        diffAdvectTerm = yneighbor * varAdvectTerms[n * 2 + 1] - ypoint * varAdvectTerms[n * 2];
+                    } else {
+                        diffAdvectTerm = (yneighbor - ypoint) * D * oneOverH[n];
+                    }
+                    diffAdvectTerm *= fluxScales[n][regionPointIndex];
+                    rhs[vectorIndex] += diffAdvectTerm;
+                    rhs[neighborVectorIndex] -= diffAdvectTerm;
+                }
+                rhs[vectorIndex] += reactionRate;
             }
+            continue;
         }
-    }
 
-    // loop through points
-    for (int regionPointIndex = 0; regionPointIndex < regionSizes[regionID]; regionPointIndex ++) {
-        int localIndex = regionPointIndex + regionOffsets[regionID];
-        int volIndex = local2Global[localIndex];
-        int mask = pVolumeElement[volIndex].neighborMask;
+        int volIndex = stencil.volIndexes[regionPointIndex];
+        int mask = stencil.masks[regionPointIndex];
 
         bool bDirichlet = false;
         double scaleS[3] = {1, 1, 1};
@@ -1166,18 +1406,15 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
         defineVolumeNeighbors(volIndex, mask)
 
         // update values for this point
-        updateVolumeStatePointValues(volIndex, t, yinput, statePointValues);
-
-        int vectorIndexOffset = getVolumeElementVectorOffset(volIndex, regionID);
+        updateVolumeStatePointValues(volIndex, t, yinput, workspace.statePointValues);
 
         // loop through defined variables
-        for (int activeVarCount = 0; activeVarCount < regionDefinedVolVariableSizes[regionID]; activeVarCount ++) {
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
             // I can also increment this, but
             int vectorIndex = vectorIndexOffset + activeVarCount;
 
-            int varIndex = regionDefinedVolVariableIndexes[regionID][activeVarCount];
-            VolumeVariable* var = (VolumeVariable*)simulation->getVolVariable(varIndex);
-            VolumeVarContextExpression* varContext = feature->getVolumeVarContext(var);
+            VolumeVariable* var = stencil.vars[activeVarCount];
+            VolumeVarContextExpression* varContext = stencil.varContexts[activeVarCount];
 
             double reactionRate = 0;
             if (bDirichlet && var->isDiffusing()) {// pde dirichlet
@@ -1186,7 +1423,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
                     continue;
                 }
             } else {
-                reactionRate = varContext->evaluateExpression(REACT_RATE_EXP, statePointValues);
+                reactionRate = reactionRates[vectorIndex];
                 if (!var->isDiffusing()) {
                     rhs[vectorIndex] += reactionRate;
                     continue;
@@ -1196,15 +1433,15 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
             double boundaryCondition = 0;
             if (!bDirichlet && (mask & NEIGHBOR_BOUNDARY_MASK)) {   // neumann boundary condition
                 if ((mask & BOUNDARY_TYPE_MASK) == BOUNDARY_TYPE_NEUMANN) {
-                    boundaryCondition = computeNeumannCondition(feature, varContext, mask, scaleS);
+                    boundaryCondition = computeNeumannCondition(feature, varContext, mask, scaleS, workspace.statePointValues);
                 }
             }
 
-            double D = varContext->evaluateConstantExpression(DIFF_RATE_EXP);
+            double D = diffusionRates[activeVarCount];
 
             double ypoint = yinput[vectorIndex];
             if (bDirichlet) {
-                dirichletPointSetup(volIndex, feature, varContext, mask, volumeNeighbors, ypoint);
+                dirichletPointSetup(volIndex, feature, varContext, mask, volumeNeighbors, workspace.statePointValues, ypoint);
             }
 
             // add diffusion and convection
@@ -1214,7 +1451,8 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
                     continue;
                 }
 
-                int neighborVectorIndex = getVolumeElementVectorOffset(neighborIndex, regionID) + activeVarCount;
+                // dirichlet points keep a subset of their neighbors
+                int neighborVectorIndex = neighborVectorOffsets[n][regionPointIndex] + activeVarCount;
                 double yneighbor = yinput[neighborVectorIndex];
 
                 //use the real value if the neighbor is dirichlet point
@@ -1222,17 +1460,17 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
                 bool bNeighborDirichlet = false;
                 if (neighborMask & BOUNDARY_TYPE_DIRICHLET) {
                     bNeighborDirichlet = true;
-                    updateVolumeStatePointValues(neighborIndex, t, 0, txyzValues);
-                    yneighbor = varContext->evaluateExpression(dirichletExpIndexes[n], txyzValues);
+                    updateVolumeStatePointValues(neighborIndex, t, 0, workspace.txyzValues);
+                    yneighbor = varContext->evaluateExpression(dirichletExpIndexes[n], workspace.txyzValues);
                 }
 
                 double diffAdvectTerm = 0;
                 if (var->isAdvecting()) {
-                    diffAdvectTerm = yneighbor * advectTerms[activeVarCount][n * 2 + 1] - ypoint * advectTerms[activeVarCount][n * 2];
+                    diffAdvectTerm = yneighbor * advectTerms[activeVarCount * 6 + n * 2 + 1] - ypoint * advectTerms[activeVarCount * 6 + n * 2];
                 } else {
                     diffAdvectTerm = (yneighbor - ypoint) * D * oneOverH[n];
                 }
-                diffAdvectTerm *= scaleS[n] * oneOverH[n];
+                diffAdvectTerm *= fluxScales[n][regionPointIndex];
                 if (!bDirichlet) {
                     rhs[vectorIndex] += diffAdvectTerm;
                 }
@@ -1254,7 +1492,6 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorConstant(int regionID, doubl
             }
         } // end for v
     } // end for ri
-    delete[] advectTerms;
 }
 
 void SundialsPdeScheduler::precomputeDiffusionCoefficients() {
@@ -1303,19 +1540,20 @@ void SundialsPdeScheduler::precomputeDiffusionCoefficients() {
     } // region
 }
 
-void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, double t, double* yinput, double* rhs) {
-    if (regionDefinedVolVariableSizes[regionID] == 0) {
+void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs) {
+    int numVars = regionDefinedVolVariableSizes[regionID];
+    if (numVars == 0) {
         return;
     }
 
-    int firstPointVolIndex = local2Global[regionOffsets[regionID]];
-    Feature* feature = pVolumeElement[firstPointVolIndex].getFeature();
+    VolumeStencil& stencil = volumeStencils[regionID];
+    Feature* feature = pVolumeElement[stencil.volIndexes[0]].getFeature();
 
     // loop through points
-    for (int regionPointIndex = 0; regionPointIndex < regionSizes[regionID]; regionPointIndex ++) {
-        int localIndex = regionPointIndex + regionOffsets[regionID];
-        int volIndex = local2Global[localIndex];
-        int mask = pVolumeElement[volIndex].neighborMask;
+    int vectorIndexOffset = volVectorOffsets[regionID];
+    for (int regionPointIndex = 0; regionPointIndex < regionSizes[regionID]; regionPointIndex ++, vectorIndexOffset += numVars) {
+        int volIndex = stencil.volIndexes[regionPointIndex];
+        int mask = stencil.masks[regionPointIndex];
 
         bool bDirichlet = false;
         double scaleS[3] = {1, 1, 1};
@@ -1331,7 +1569,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
         defineVolumeNeighbors(volIndex, mask)
 
         // update values for this point
-        updateVolumeStatePointValues(volIndex, t, yinput, statePointValues);
+        updateVolumeStatePointValues(volIndex, t, yinput, workspace.statePointValues);
 
 #ifdef PRECOMPUTE_DIFFUSION_COEFFICIENT
         if (bRegionHasTimeDepdentVariables[regionID]) {
@@ -1342,22 +1580,19 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                 if (neighborIndex < 0) {
                     continue;
                 }
-                updateVolumeStatePointValues(neighborIndex, t, yinput, neighborStatePointValues[n]);
+                updateVolumeStatePointValues(neighborIndex, t, yinput, workspace.neighborStatePointValues[n]);
             }
 #ifdef PRECOMPUTE_DIFFUSION_COEFFICIENT
         }
 #endif
 
-        int vectorIndexOffset = getVolumeElementVectorOffset(volIndex, regionID);
-
         // loop through defined variables
-        for (int activeVarCount = 0; activeVarCount < regionDefinedVolVariableSizes[regionID]; activeVarCount ++) {
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
             // I can also increment this, but
             int vectorIndex = vectorIndexOffset + activeVarCount;
 
-            int varIndex = regionDefinedVolVariableIndexes[regionID][activeVarCount];
-            VolumeVariable* var = simulation->getVolVariable(varIndex);
-            VolumeVarContextExpression* varContext = feature->getVolumeVarContext(var);
+            VolumeVariable* var = stencil.vars[activeVarCount];
+            VolumeVarContextExpression* varContext = stencil.varContexts[activeVarCount];
 
             double reactionRate = 0;
             if (bDirichlet && var->isDiffusing()) {// pde dirichlet
@@ -1366,7 +1601,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                     continue;
                 }
             } else {
-                reactionRate = varContext->evaluateExpression(REACT_RATE_EXP, statePointValues);
+                reactionRate = reactionRates[vectorIndex];
                 if (!var->isDiffusing()) {
                     rhs[vectorIndex] += reactionRate;
                     continue;
@@ -1376,10 +1611,11 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
             double boundaryCondition = 0;
             if (!bDirichlet && (mask & NEIGHBOR_BOUNDARY_MASK)) {   // neumann boundary condition
                 if ((mask & BOUNDARY_TYPE_MASK) == BOUNDARY_TYPE_NEUMANN) {
-                    boundaryCondition = computeNeumannCondition(feature, varContext, mask, scaleS);
+                    boundaryCondition = computeNeumannCondition(feature, varContext, mask, scaleS, workspace.statePointValues);
                 }
             }
 
+            // diffusion rates and velocities are evaluated with the reaction rates (computeRegionReactionRates)
             double Di = 0;
             if (varContext->hasConstantDiffusion()) {
                 Di = varContext->evaluateConstantExpression(DIFF_RATE_EXP);
@@ -1389,7 +1625,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                     Di = diffCoeffs[vectorIndex];
                 } else {
 #endif
-                    Di = varContext->evaluateExpression(DIFF_RATE_EXP, statePointValues);
+                    Di = diffusionRates[vectorIndex];
 #ifdef PRECOMPUTE_DIFFUSION_COEFFICIENT
                 }
 #endif
@@ -1397,32 +1633,28 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
 
             double Vi_XYZ[3] = {0, 0, 0};
             if (var->isAdvecting()) {
-                Vi_XYZ[0] = varContext->evaluateExpression(VELOCITY_X_EXP, statePointValues);
-                if (dimension > 1) {
-                    Vi_XYZ[1] = varContext->evaluateExpression(VELOCITY_Y_EXP, statePointValues);
-                }
-                if (dimension > 2) {
-                    Vi_XYZ[2] = varContext->evaluateExpression(VELOCITY_Z_EXP, statePointValues);
+                for (int n = 0; n < dimension; n ++) {
+                    Vi_XYZ[n] = velocities[n][vectorIndex];
                 }
             }
 
             double ypoint = yinput[vectorIndex];
             if (bDirichlet) {
-                dirichletPointSetup(volIndex, feature, varContext, mask, volumeNeighbors, ypoint);
+                dirichletPointSetup(volIndex, feature, varContext, mask, volumeNeighbors, workspace.statePointValues, ypoint);
             }
 
             // add diffusion and convection
             for (int n = 0; n < dimension; n ++) {
                 int neighborIndex = volumeNeighbors[n];
                 int neighborMask = neighborIndex < 0 ? 0 : pVolumeElement[neighborIndex].neighborMask;
-                int neighborVectorIndex  = neighborIndex < 0 ? -1 : getVolumeElementVectorOffset(neighborIndex, regionID) + activeVarCount;
+                int neighborVectorIndex  = neighborIndex < 0 ? -1 : stencil.neighborVectorOffsets[n][regionPointIndex] + activeVarCount;
                 bool bNeighborDirichlet = (neighborMask & BOUNDARY_TYPE_DIRICHLET);
 
                 if (varContext->hasGradient(n)) {
-                    double gradi = varContext->evaluateExpression(gradExpIndexes[n], statePointValues);
+                    double gradi = varContext->evaluateExpression(gradExpIndexes[n], workspace.statePointValues);
 
                     if (mask & minusMasks[n]) { // no minus neighbor
-                        double grad_near = varContext->evaluateExpression(gradExpIndexes[n], neighborStatePointValues[n]);
+                        double grad_near = varContext->evaluateExpression(gradExpIndexes[n], workspace.neighborStatePointValues[n]);
                         if (!bDirichlet) {
                             rhsGradients[vectorIndex] += (-gradi + grad_near) * oneOverH[n];
                         }
@@ -1434,7 +1666,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                             rhsGradients[vectorIndex] += gradi * oneOverH[n];
                         }
                     } else {
-                        double gradj = varContext->evaluateExpression(gradExpIndexes[n], neighborStatePointValues[n]);
+                        double gradj = varContext->evaluateExpression(gradExpIndexes[n], workspace.neighborStatePointValues[n]);
                         if (!bDirichlet) {
                             rhsGradients[vectorIndex] += gradj * oneOverH[n] / 2;
                         }
@@ -1460,7 +1692,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                         Dj = diffCoeffs[neighborVectorIndex];
                     } else {
 #endif
-                        Dj = varContext->evaluateExpression(DIFF_RATE_EXP, neighborStatePointValues[n]);
+                        Dj = diffusionRates[neighborVectorIndex];
 #ifdef PRECOMPUTE_DIFFUSION_COEFFICIENT
                     }
 #endif
@@ -1471,14 +1703,14 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
 
                 //use the real value if the neighbor is dirichlet point
                 if (bNeighborDirichlet) {
-                    yneighbor = varContext->evaluateExpression(dirichletExpIndexes[n], neighborStatePointValues[n]);
+                    yneighbor = varContext->evaluateExpression(dirichletExpIndexes[n], workspace.neighborStatePointValues[n]);
                 }
 
                 double diffTerm = D * oneOverH[n];
                 double diffAdvectTerm = 0;
                 if (var->isAdvecting()) {
                     double Vi = Vi_XYZ[n];
-                    double Vj = varContext->evaluateExpression(velocityExpIndexes[n], neighborStatePointValues[n]);
+                    double Vj = velocities[n][neighborVectorIndex];
                     double V = 0.5 * (Vi + Vj);
                     double advectTerm = -V;
 
@@ -1488,7 +1720,7 @@ void SundialsPdeScheduler::regionApplyVolumeOperatorVariable(int regionID, doubl
                 } else {
                     diffAdvectTerm = (yneighbor - ypoint) * diffTerm;
                 }
-                diffAdvectTerm *= scaleS[n] * oneOverH[n];
+                diffAdvectTerm *= stencil.fluxScales[n][regionPointIndex];
                 if (!bDirichlet) {
                     rhs[vectorIndex] += diffAdvectTerm;
                 }
@@ -1547,11 +1779,8 @@ void SundialsPdeScheduler::applyMembraneDiffusionReactionOperator(double t, doub
             int mask = mesh->getMembraneNeighborMask(mi);
 
             if (!var->isDiffusing() || !(mask & BOUNDARY_TYPE_DIRICHLET)) {   // boundary and dirichlet
-                // update values
-                updateMembraneStatePointValues(pMembraneElement[mi], t, yinput, statePointValues);
-                double reactionRate = varContext->evaluateExpression(REACT_RATE_EXP, statePointValues);
                 // add reaction
-                rhs[vectorIndex] += reactionRate;
+                rhs[vectorIndex] += reactionRates[vectorIndex];
             }
 
             if (!var->isDiffusing()) {
@@ -1564,6 +1793,8 @@ void SundialsPdeScheduler::applyMembraneDiffusionReactionOperator(double t, doub
                 continue;
             }
 
+            // update values
+            updateMembraneStatePointValues(pMembraneElement[mi], t, yinput, statePointValues);
             double Di = varContext->evaluateExpression(DIFF_RATE_EXP, statePointValues);
             double volume = mesh->getMembraneCoupling()->getValue(mi, mi);
             if (mask & BOUNDARY_TYPE_NEUMANN) { // boundary and neumann
@@ -1647,44 +1878,51 @@ void SundialsPdeScheduler::applyVolumeRegionReactionOperator(double t, double* y
     if (simulation->getNumVolRegionVariables() == 0) {
         return;
     }
+    runRhsBlocks(&SundialsPdeScheduler::regionApplyVolumeRegionReactionOperator, mesh->getNumVolumeRegions(), t, yinput, rhs);
+}
 
-    for (int r = 0; r < mesh->getNumVolumeRegions(); r ++) {
-        VolumeRegion* volRegion = mesh->getVolumeRegion(r);
-        Feature* feature = volRegion->getFeature();
-        for (int v = 0; v < simulation->getNumVolRegionVariables(); v ++) {
-            VolumeRegionVariable* var = simulation->getVolRegionVariable(v);
-            VolumeRegionVarContextExpression* volRegionVarContext = feature->getVolumeRegionVarContext(var);
-            if (volRegionVarContext == 0) {
-                continue;
-            }
-            int vectorIndex = getVolumeRegionVectorOffset(r) + v;
-
-            updateRegionStatePointValues(r, t, yinput, true, statePointValues);
-            rhs[vectorIndex] = volRegionVarContext->evaluateExpression(UNIFORM_RATE_EXP, statePointValues);
-
-            double volume = volRegion->getSize();
-            int numElements = volRegion->getNumElements();
-            double volumeIntegral = 0.0;
+void SundialsPdeScheduler::regionApplyVolumeRegionReactionOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs) {
+    VolumeRegion* volRegion = mesh->getVolumeRegion(regionID);
+    Feature* feature = volRegion->getFeature();
+    for (int v = 0; v < simulation->getNumVolRegionVariables(); v ++) {
+        VolumeRegionVariable* var = simulation->getVolRegionVariable(v);
+        VolumeRegionVarContextExpression* volRegionVarContext = feature->getVolumeRegionVarContext(var);
+        if (volRegionVarContext == 0) {
+            continue;
+        }
+        int vectorIndex = getVolumeRegionVectorOffset(regionID) + v;
+
+        updateRegionStatePointValues(regionID, t, yinput, true, workspace.statePointValues);
+        rhs[vectorIndex] = volRegionVarContext->evaluateExpression(UNIFORM_RATE_EXP, workspace.statePointValues);
+
+        double volume = volRegion->getSize();
+        int numElements = volRegion->getNumElements();
+        double volumeIntegral = 0.0;
+        for (int blockStart = 0; blockStart < numElements; blockStart += RHS_BATCH_SIZE) {
+            int numPoints = std::min<int>(RHS_BATCH_SIZE, numElements - blockStart);
+            for (int k = 0; k < numPoints; k ++) {
+                workspace.batchIndexes[k] = volRegion->getElementIndex(blockStart + k);
+            }
+            loadVolumeBatch(workspace, numPoints, workspace.batchIndexes, t, yinput);
+            volRegionVarContext->evaluateExpressionBatch(REACT_RATE_EXP, numPoints, workspace.batchColumns, workspace.batchRates);
+            for (int k = 0; k < numPoints; k ++) {
+                volumeIntegral += workspace.batchRates[k] * mesh->getVolumeOfElement_cu(workspace.batchIndexes[k]);
+            }
+        }
+        rhs[vectorIndex] += volumeIntegral/volume;
+
+        int numMembraneRegions = volRegion->getNumMembraneRegions();
+        double surfaceIntegral = 0.0;
+        for(int k = 0; k < numMembraneRegions; k ++){
+            MembraneRegion *memRegion = volRegion->getMembraneRegion(k);
+            numElements = memRegion->getNumElements();
             for(int j = 0; j < numElements; j ++){
-                int volIndex = volRegion->getElementIndex(j);
-                updateVolumeStatePointValues(volIndex, t, yinput, statePointValues);
-                volumeIntegral += volRegionVarContext->evaluateExpression(REACT_RATE_EXP, statePointValues) * mesh->getVolumeOfElement_cu(volIndex);
-            }
-            rhs[vectorIndex] += volumeIntegral/volume;
-
-            int numMembraneRegions = volRegion->getNumMembraneRegions();
-            double surfaceIntegral = 0.0;
-            for(int k = 0; k < numMembraneRegions; k ++){
-                MembraneRegion *memRegion = volRegion->getMembraneRegion(k);
-                numElements = memRegion->getNumElements();
-                for(int j = 0; j < numElements; j ++){
-                    int memIndex = memRegion->getElementIndex(j);
-                    updateMembraneStatePointValues(pMembraneElement[memIndex], t, yinput, statePointValues);
-                    surfaceIntegral += volRegionVarContext->evaluateJumpCondition(&pMembraneElement[memIndex], statePointValues) * pMembraneElement[memIndex].area;
-                }
+                int memIndex = memRegion->getElementIndex(j);
+                updateMembraneStatePointValues(pMembraneElement[memIndex], t, yinput, workspace.statePointValues);
+                surfaceIntegral += volRegionVarContext->evaluateJumpCondition(&pMembraneElement[memIndex], workspace.statePointValues) * pMembraneElement[memIndex].area;
             }
-            rhs[vectorIndex] += surfaceIntegral/volume;
         }
+        rhs[vectorIndex] += surfaceIntegral/volume;
     }
 }
 
@@ -1692,30 +1930,38 @@ void SundialsPdeScheduler::applyMembraneRegionReactionOperator(double t, double*
     if (simulation->getNumMemRegionVariables() == 0) {
         return;
     }
-    for (int r = 0; r < mesh->getNumMembraneRegions(); r ++) {
-        MembraneRegion *memRegion = mesh->getMembraneRegion(r);
-        Membrane* membrane = memRegion->getMembrane();
-        for (int v = 0; v < simulation->getNumMemRegionVariables(); v ++) {
-            MembraneRegionVariable* var = simulation->getMemRegionVariable(v);
-            MembraneRegionVarContextExpression * memRegionvarContext = membrane->getMembraneRegionVarContext(var);
-            if (memRegionvarContext == 0) {
-                continue;
-            }
-            int vectorIndex = getMembraneRegionVectorOffset(r) + v;
+    runRhsBlocks(&SundialsPdeScheduler::regionApplyMembraneRegionReactionOperator, mesh->getNumMembraneRegions(), t, yinput, rhs);
+}
 
-            updateRegionStatePointValues(r, t, yinput, false, statePointValues);
-            rhs[vectorIndex] = memRegionvarContext->evaluateExpression(UNIFORM_RATE_EXP, statePointValues);
+void SundialsPdeScheduler::regionApplyMembraneRegionReactionOperator(RhsWorkspace& workspace, int regionID, double t, double* yinput, double* rhs) {
+    MembraneRegion *memRegion = mesh->getMembraneRegion(regionID);
+    Membrane* membrane = memRegion->getMembrane();
+    for (int v = 0; v < simulation->getNumMemRegionVariables(); v ++) {
+        MembraneRegionVariable* var = simulation->getMemRegionVariable(v);
+        MembraneRegionVarContextExpression * memRegionvarContext = membrane->getMembraneRegionVarContext(var);
+        if (memRegionvarContext == 0) {
+            continue;
+        }
+        int vectorIndex = getMembraneRegionVectorOffset(regionID) + v;
 
-            double surface = memRegion->getSize();
-            long numElements = memRegion->getNumElements();
-            double surfaceIntegral = 0.0;
-            for(int j = 0; j < numElements; j ++) {
-                int memIndex = memRegion->getElementIndex(j);
-                updateMembraneStatePointValues(pMembraneElement[memIndex], t, yinput, statePointValues);
-                surfaceIntegral += memRegionvarContext->evaluateExpression(REACT_RATE_EXP, statePointValues) * pMembraneElement[memIndex].area;
+        updateRegionStatePointValues(regionID, t, yinput, false, workspace.statePointValues);
+        rhs[vectorIndex] = memRegionvarContext->evaluateExpression(UNIFORM_RATE_EXP, workspace.statePointValues);
+
+        double surface = memRegion->getSize();
+        long numElements = memRegion->getNumElements();
+        double surfaceIntegral = 0.0;
+        for (int blockStart = 0; blockStart < numElements; blockStart += RHS_BATCH_SIZE) {
+            int numPoints = std::min<int>(RHS_BATCH_SIZE, numElements - blockStart);
+            for (int k = 0; k < numPoints; k ++) {
+                workspace.batchIndexes[k] = memRegion->getElementIndex(blockStart + k);
+            }
+            loadMembraneBatch(workspace, numPoints, workspace.batchIndexes, t, yinput);
+            memRegionvarContext->evaluateExpressionBatch(REACT_RATE_EXP, numPoints, workspace.batchColumns, workspace.batchRates);
+            for (int k = 0; k < numPoints; k ++) {
+                surfaceIntegral += workspace.batchRates[k] * pMembraneElement[workspace.batchIndexes[k]].area;
             }
-            rhs[vectorIndex] += surfaceIntegral/surface;
         }
+        rhs[vectorIndex] += surfaceIntegral/surface;
     }
 }
 
@@ -1737,7 +1983,9 @@ void SundialsPdeScheduler::applyMembraneFluxOperator(double t, double* yinput, d
         int vi2 = getVolumeElementVectorOffset(me.vindexFeatureLo, loRegionID);
         int vi3 = getVolumeElementVectorOffset(me.vindexFeatureHi, hiRegionID);
 
-        updateMembraneStatePointValues(me, t, yinput, statePointValues);
+        // jump conditions on the lo side, then on the hi side (see computeMembraneFluxBlock)
+        double* loFluxes = membraneFluxes + m * 2 * simulation->getNumVolVariables();
+        double* hiFluxes = loFluxes + simulation->getNumVolVariables();
 
         for (int activeVarCount = 0; activeVarCount < regionDefinedVolVariableSizes[loRegionID]; activeVarCount ++) {
             int varIndex = regionDefinedVolVariableIndexes[loRegionID][activeVarCount];
@@ -1746,8 +1994,7 @@ void SundialsPdeScheduler::applyMembraneFluxOperator(double t, double* yinput, d
                 continue;
             }
 
-            VolumeVarContextExpression* varContext = pVolumeElement[me.vindexFeatureLo].getFeature()->getVolumeVarContext(var);
-            double flux = varContext->evaluateJumpCondition(&me, statePointValues);
+            double flux = loFluxes[activeVarCount];
             rhs[vi2 + activeVarCount] += flux * me.area / loVolume;
             //validateNumber(var->getName(), me.insideIndexNear, "Membrane Flux", rhs[vi2 + activeVarCountInside]);
         }
@@ -1758,8 +2005,7 @@ void SundialsPdeScheduler::applyMembraneFluxOperator(double t, double* yinput, d
                 continue;
             }
 
-            VolumeVarContextExpression* varContext = pVolumeElement[me.vindexFeatureHi].getFeature()->getVolumeVarContext(var);
-            double flux = varContext->evaluateJumpCondition(&me, statePointValues);
+            double flux = hiFluxes[activeVarCount];
             rhs[vi3 + activeVarCount] += flux * me.area / hiVolume;
             //validateNumber(var->getName(), me.outsideIndexNear, "Membrane Flux", rhs[vi3 + activeVarCountOutside]);
         }
@@ -1794,18 +2040,6 @@ void SundialsPdeScheduler::preallocateM() {
                       + mesh->getNumVolumeRegions() * simulation->getNumVolRegionVariables() // vol region variable
                       + mesh->getNumMembraneRegions() * simulation->getNumMemRegionVariables(); // mem region variable
     }
-    if (dimension == 1) {
-        nsp = numNonZeros * 20;
-    } else {
-        nsp = numNonZeros * 8;
-    }
-    try {
-        delete[] pcg_workspace;
-        pcg_workspace = new double[nsp];
-    } catch (...) {
-        throw "SundialsPDESolver:: Out of Memory : pcg_workspace";
-    }
-    memset(pcg_workspace, 0, nsp * sizeof(double));
 
     M = new SparseMatrixPCG(numUnknowns, numNonZeros, MATRIX_GENERAL); // only store upper triangle
 
@@ -1910,9 +2144,34 @@ void SundialsPdeScheduler::preallocateM() {
         }
     }
     M->close();
+
+    // sized from the pattern of M, which buildM_Volume/buildM_Membrane keep
+    int fillLevel = sundialsSolverOptions.preconditionerFillLevel;
+    if (sundialsSolverOptions.preconditioner == SUNDIALS_PRECONDITIONER_BLOCK_JACOBI) {
+        // volume regions, membrane, volume and membrane region variables
+        vector<int> blockStarts;
+        if (simulation->getNumVolVariables() > 0) {
+            blockStarts.assign(volVectorOffsets, volVectorOffsets + mesh->getNumVolumeRegions());
+        }
+        blockStarts.push_back(memVectorOffset);
+        blockStarts.push_back(volRegionVectorOffset);
+        blockStarts.push_back(numUnknowns);
+        if (blockStarts[0] != 0) {
+            blockStarts.insert(blockStarts.begin(), 0);
+        }
+        preconditioner = new SparseILUPreconditioner(M, fillLevel, (int)blockStarts.size() - 1, &blockStarts[0]);
+        cout << "block Jacobi ILU(" << fillLevel << ") preconditioner, " << preconditioner->getNumBlocks() << " blocks";
+    } else {
+        preconditioner = new SparseILUPreconditioner(M, fillLevel);
+        cout << "ILU(" << fillLevel << ") preconditioner";
+    }
+    cout << ", " << preconditioner->getNumFactorNonZeros() << " nonzeros in factors" << endl;
 }
 
 int SundialsPdeScheduler::pcSetup(realtype t, N_Vector y, N_Vector fy, booleantype jok, booleantype *jcurPtr, realtype gamma) {
+    static ProfileHandle profileHandle = Profiler::getHandle("pcSetup");
+    ProfileScope profileScope(profileHandle);
+    bool bPcReinit = false;
     if (simulation->hasTimeDependentDiffusionAdvection()) { // has time dependent diffusion
         bPcReinit = true;
 
@@ -1932,91 +2191,26 @@ int SundialsPdeScheduler::pcSetup(realtype t, N_Vector y, N_Vector fy, booleanty
     }
     *jcurPtr = bPcReinit;
 
+    // if M only moved to the new gamma, the factorization at a close gamma is still
+    // a good preconditioner
+    if (bPcReinit) {
+        if (simulation->hasTimeDependentDiffusionAdvection() || !preconditioner->isFactored()
+                || fabs(gamma / factorGamma - 1) > PRECONDITIONER_REFACTOR_GAMMA_CHANGE) {
+            preconditioner->factor();
+            factorGamma = gamma;
+        }
+    }
+
     return 0;
 }
 
 int SundialsPdeScheduler::pcSolve(realtype t, N_Vector y, N_Vector fy, N_Vector r, N_Vector z, realtype gamma, realtype delta, int lr) {
-    double* sa = M->getsa();
-    int32 *ija = M->getFortranIJA();
-    double *r_data = NV_DATA_S(r);
-    double *z_data = NV_DATA_S(z);
-
-    if (!bLUcomputed || bPcReinit) {
-        int symmetricflg = M->getSymmetricFlag();  // general or symmetric storage format
-
-        int IParm[75];
-        memset(IParm, 0, 75 * sizeof(int));
-
-        double RParm[25];
-        memset(RParm, 0, 25 * sizeof(double));
-
-        IParm[4] = 1; // max number of iteration
-        IParm[13] = 0; // don't reuse all incomplete factorization.
-        IParm[14] = 0; // fill-in parameter
-
-        RParm[0] = 0.0;
-        RParm[1] = 1.0;
-
-        double pcgTol = 0.1;
-        double RHSscale = 1;
-
-        // zero guss
-        memset(z_data, 0, numUnknowns * sizeof(double));
-        int numRetries = 0; // retry twice
-        while (true) {
-            bool bRetry = false;
-            PCGWRAPPER(&numUnknowns, &nsp, &symmetricflg, ija, sa, r_data, z_data, &pcgTol, IParm, RParm, pcg_workspace, pcg_workspace, &RHSscale);
-            if (IParm[50] != 0) {
-                switch (IParm[50]) {
-                    case 2:
-                    case 3:
-                    case 4:
-                    case 9:
-                    case 10:
-                    case 15:
-                        if (numRetries == 2) {
-                            throwPCGExceptions(IParm[50], IParm[53]);
-                        } else {
-                            try {
-                                cout << endl << "!!Note: Insufficient PCG workspace (" << nsp << "), need additional (" << IParm[53] << "), try again" << endl;
-                                delete[] pcg_workspace;
-                                nsp += IParm[53];
-                                pcg_workspace = new double[nsp];
-                                memset(pcg_workspace, 0, nsp * sizeof(double));
-                                numRetries ++;
-                                bRetry = true;
-                            } catch (...) {
-                                char errMsg[128];
-                                snprintf(errMsg, 128, "SundialsPDESolver:: Out of Memory : pcg_workspace allocating (%ld)", nsp);
-                                throw errMsg;
-                            }
-                        }
-                        break;
-                    case 1:	// maximum iterations reached without satisfying stopping criterion
-                    case 8: // stagnant
-                        // ignore these two errors.
-                        break;
-                    default:
-                        throwPCGExceptions(IParm[50], IParm[53]);
-                        break;
-                }
-            }
-            if (!bRetry) {
-                break;
-            }
-        }
-
-        bPcReinit = false;
-        if (IParm[54] == 1) {
-            bLUcomputed = true;
-        } else {
-            bLUcomputed = false;
-        }
-    } else {
-        int icode = -3;
-        memcpy(z_data, r_data, numUnknowns * sizeof(double));
-        PCILU(&icode, &numUnknowns, ija, sa, z_data, pcg_workspace, pcg_workspace);
+    static ProfileHandle profileHandle = Profiler::getHandle("pcSolve");
+    ProfileScope profileScope(profileHandle);
+    if (!preconditioner->isFactored()) {
+        preconditioner->factor();
     }
+    preconditioner->solve(NV_DATA_S(r), NV_DATA_S(z));
 
     return 0;
 }
@@ -2382,3 +2576,342 @@ void SundialsPdeScheduler::updateRegionStatePointValues(int regionID, double t,
         }
     }
 }
+
+void SundialsPdeScheduler::loadVolumeBatch(RhsWorkspace& workspace, int numPoints, int* volIndexes, double t, double* yinput) {
+    for (int k = 0; k < numPoints; k ++) {
+        updateVolumeStatePointValues(volIndexes[k], t, yinput, workspace.statePointValues);
+        for (int i = 0; i < valueArraySize; i ++) {
+            workspace.batchColumns[i][k] = workspace.statePointValues[i];
+        }
+    }
+}
+
+void SundialsPdeScheduler::loadMembraneBatch(RhsWorkspace& workspace, int numPoints, int* memIndexes, double t, double* yinput) {
+    for (int k = 0; k < numPoints; k ++) {
+        updateMembraneStatePointValues(pMembraneElement[memIndexes[k]], t, yinput, workspace.statePointValues);
+        for (int i = 0; i < valueArraySize; i ++) {
+            workspace.batchColumns[i][k] = workspace.statePointValues[i];
+        }
+    }
+}
+
+// calls function for every block on all the threads, each with its own workspace. The blocks write disjoint
+// parts of reactionRates and membraneFluxes, or of rhs when they are regions, and each block sums in the
+// serial order, so the result doesn't depend on the number of threads.
+// The threads share the stack machines of the expressions, which initSundialsSolver creates.
+// If blocks throw, the exception of the first of them is rethrown, as the serial loop would.
+void SundialsPdeScheduler::runRhsBlocks(RhsBlockFunction function, int numBlocks, double t, double* yinput, double* rhs) {
+    std::exception_ptr error;
+    int errorBlock = numBlocks;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(numRhsWorkspaces) if(numRhsWorkspaces > 1)
+#endif
+    for (int block = 0; block < numBlocks; block ++) {
+#ifdef _OPENMP
+        RhsWorkspace& workspace = rhsWorkspaces[omp_get_thread_num()];
+#else
+        RhsWorkspace& workspace = rhsWorkspaces[0];
+#endif
+        try {
+            (this->*function)(workspace, block, t, yinput, rhs);
+        } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical (SundialsPdeScheduler_rhsError)
+#endif
+            if (block < errorBlock) {
+                errorBlock = block;
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void SundialsPdeScheduler::computeReactionRateBlock(RhsWorkspace& workspace, int block, double t, double* yinput, double* rhs) {
+    if (rateBlockRegions[block] < 0) {
+        computeMembraneReactionRates(workspace, rateBlockStarts[block], t, yinput);
+    } else {
+        computeRegionReactionRates(workspace, rateBlockRegions[block], rateBlockStarts[block], t, yinput);
+    }
+}
+
+// jump conditions of the diffusing volume variables at the block of membrane elements starting at
+// block * RHS_BATCH_SIZE, for applyMembraneFluxOperator
+void SundialsPdeScheduler::computeMembraneFluxBlock(RhsWorkspace& workspace, int block, double t, double* yinput, double* rhs) {
+    int numVolVar = simulation->getNumVolVariables();
+    int memIndexEnd = std::min<int>((block + 1) * RHS_BATCH_SIZE, mesh->getNumMembraneElements());
+    for (int m = block * RHS_BATCH_SIZE; m < memIndexEnd; m ++) {
+        MembraneElement& me = pMembraneElement[m];
+        updateMembraneStatePointValues(me, t, yinput, workspace.statePointValues);
+        for (int side = 0; side < 2; side ++) {
+            int volIndex = side == 0 ? me.vindexFeatureLo : me.vindexFeatureHi;
+            int regionID = pVolumeElement[volIndex].getRegionIndex();
+            Feature* feature = pVolumeElement[volIndex].getFeature();
+            double* fluxes = membraneFluxes + (m * 2 + side) * numVolVar;
+            for (int activeVarCount = 0; activeVarCount < regionDefinedVolVariableSizes[regionID]; activeVarCount ++) {
+                VolumeVariable* var = simulation->getVolVariable(regionDefinedVolVariableIndexes[regionID][activeVarCount]);
+                if (var->isDiffusing()) {
+                    fluxes[activeVarCount] = feature->getVolumeVarContext(var)->evaluateJumpCondition(&me, workspace.statePointValues);
+                }
+            }
+        }
+    }
+}
+
+// reaction rates of the variables defined in the region at the block of region points starting at regionPointStart,
+// stored in reactionRates at the vector index of each unknown.
+// Dirichlet points are put last so that, like the point loop, diffusing variables are not evaluated there.
+void SundialsPdeScheduler::computeRegionReactionRates(RhsWorkspace& workspace, int regionID, int regionPointStart, double t, double* yinput) {
+    int* batchIndexes = workspace.batchIndexes;
+    int* batchPointSlots = workspace.batchPointSlots;
+    double* batchRates = workspace.batchRates;
+    int numPoints = std::min<int>(RHS_BATCH_SIZE, regionSizes[regionID] - regionPointStart);
+    int numSlots = 0;
+    int numNonDirichlet = 0;
+    for (int pass = 0; pass < 2; pass ++) {
+        for (int k = 0; k < numPoints; k ++) {
+            int volIndex = local2Global[regionOffsets[regionID] + regionPointStart + k];
+            int mask = pVolumeElement[volIndex].neighborMask;
+            bool bDirichlet = (mask & NEIGHBOR_BOUNDARY_MASK) && (mask & BOUNDARY_TYPE_DIRICHLET);
+            if (bDirichlet == (pass == 1)) {
+                batchPointSlots[k] = numSlots;
+                batchIndexes[numSlots ++] = volIndex;
+            }
+        }
+        if (pass == 0) {
+            numNonDirichlet = numSlots;
+        }
+    }
+    loadVolumeBatch(workspace, numPoints, batchIndexes, t, yinput);
+
+    // the program also computes the rates of diffusing variables at dirichlet points, if one of them
+    // (or any other rate) throws, evaluate the rates one by one as the point loop would
+    int numVars = regionDefinedVolVariableSizes[regionID];
+    FusedExpressionProgram* program = regionReactionPrograms[regionID];
+    bool bEvaluated = false;
+    if (program != 0) {
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+            workspace.batchRateRows[activeVarCount] = batchRates + activeVarCount * RHS_BATCH_SIZE;
+        }
+        bEvaluated = program->evaluateBatch(numPoints, workspace.batchColumns, workspace.batchRateRows, workspace.programWorkspace);
+    }
+
+    if (!bEvaluated) {
+        Feature* feature = pVolumeElement[batchIndexes[0]].getFeature();
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+            int varIndex = regionDefinedVolVariableIndexes[regionID][activeVarCount];
+            VolumeVariable* var = simulation->getVolVariable(varIndex);
+            VolumeVarContextExpression* varContext = feature->getVolumeVarContext(var);
+            int numEvaluated = var->isDiffusing() ? numNonDirichlet : numPoints;
+            varContext->evaluateExpressionBatch(REACT_RATE_EXP, numEvaluated, workspace.batchColumns, batchRates + activeVarCount * RHS_BATCH_SIZE);
+        }
+    }
+
+    for (int k = 0; k < numPoints; k ++) {
+        int vectorIndexOffset = volVectorOffsets[regionID] + (regionPointStart + k) * numVars;
+        for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+            reactionRates[vectorIndexOffset + activeVarCount] = batchRates[activeVarCount * RHS_BATCH_SIZE + batchPointSlots[k]];
+        }
+    }
+
+    // diffusion rates and velocities for regionApplyVolumeOperatorVariable, at all the points: the operator
+    // reads them at each point and its neighbors
+    if (bRegionHasConstantCoefficients[regionID]) {
+        return;
+    }
+    Feature* feature = pVolumeElement[batchIndexes[0]].getFeature();
+    for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+        VolumeVariable* var = simulation->getVolVariable(regionDefinedVolVariableIndexes[regionID][activeVarCount]);
+        if (!var->isDiffusing()) {
+            continue;
+        }
+        VolumeVarContextExpression* varContext = feature->getVolumeVarContext(var);
+        if (!varContext->hasConstantDiffusion() && !(diffCoeffs != 0 && varContext->hasXYZOnlyDiffusion())) {
+            varContext->evaluateExpressionBatch(DIFF_RATE_EXP, numPoints, workspace.batchColumns, batchRates);
+            scatterRegionBatch(regionID, regionPointStart, numPoints, activeVarCount, batchPointSlots, batchRates, diffusionRates);
+        }
+        if (var->isAdvecting()) {
+            for (int n = 0; n < dimension; n ++) {
+                varContext->evaluateExpressionBatch(velocityExpIndexes[n], numPoints, workspace.batchColumns, batchRates);
+                scatterRegionBatch(regionID, regionPointStart, numPoints, activeVarCount, batchPointSlots, batchRates, velocities[n]);
+            }
+        }
+    }
+}
+
+void SundialsPdeScheduler::scatterRegionBatch(int regionID, int regionPointStart, int numPoints, int activeVarCount, int* batchPointSlots, double* batchResults, double* values) {
+    int numVars = regionDefinedVolVariableSizes[regionID];
+    int vectorIndex = volVectorOffsets[regionID] + regionPointStart * numVars + activeVarCount;
+    for (int k = 0; k < numPoints; k ++, vectorIndex += numVars) {
+        values[vectorIndex] = batchResults[batchPointSlots[k]];
+    }
+}
+
+// same for the membrane variables at the block of membrane elements starting at memIndexStart. The elements are
+// grouped by membrane (dirichlet elements last in each group) so that each evaluation covers consecutive slots.
+void SundialsPdeScheduler::computeMembraneReactionRates(RhsWorkspace& workspace, int memIndexStart, double t, double* yinput) {
+    int* batchIndexes = workspace.batchIndexes;
+    int* batchPointSlots = workspace.batchPointSlots;
+    double* batchRates = workspace.batchRates;
+    int numPoints = std::min<int>(RHS_BATCH_SIZE, mesh->getNumMembraneElements() - memIndexStart);
+    VCellModel* model = SimTool::getInstance()->getModel();
+    int numSlots = 0;
+    for (int m = 0; m < model->getNumMembranes(); m ++) {
+        Membrane* membrane = model->getMembraneFromIndex(m);
+        int groupStart = numSlots;
+        int numNonDirichlet = 0;
+        for (int pass = 0; pass < 2; pass ++) {
+            for (int k = 0; k < numPoints; k ++) {
+                int mi = memIndexStart + k;
+                if (pMembraneElement[mi].getMembrane() != membrane) {
+                    continue;
+                }
+                bool bDirichlet = (mesh->getMembraneNeighborMask(mi) & BOUNDARY_TYPE_DIRICHLET) != 0;
+                if (bDirichlet == (pass == 1)) {
+                    batchPointSlots[k] = numSlots;
+                    batchIndexes[numSlots ++] = mi;
+                }
+            }
+            if (pass == 0) {
+                numNonDirichlet = numSlots - groupStart;
+            }
+        }
+        int groupSize = numSlots - groupStart;
+        if (groupSize == 0) {
+            continue;
+        }
+        loadMembraneBatch(workspace, groupSize, batchIndexes + groupStart, t, yinput);
+
+        FusedExpressionProgram* program = membraneReactionPrograms[m];
+        if (program != 0) {
+            int numOutputs = 0;
+            for (int v = 0; v < simulation->getNumMemVariables(); v ++) {
+                Structure* structure = simulation->getMemVariable(v)->getStructure();
+                if (structure == NULL || structure == membrane) {
+                    workspace.batchRateRows[numOutputs ++] = batchRates + v * RHS_BATCH_SIZE + groupStart;
+                }
+            }
+            if (program->evaluateBatch(groupSize, workspace.batchColumns, workspace.batchRateRows, workspace.programWorkspace)) {
+                continue;
+            }
+        }
+
+        for (int v = 0; v < simulation->getNumMemVariables(); v ++) {
+            MembraneVariable* var = (MembraneVariable*)simulation->getMemVariable(v);
+            if (var->getStructure() != NULL && var->getStructure() != membrane) {
+                continue;
+            }
+            MembraneVarContextExpression* varContext = membrane->getMembraneVarContext(var);
+            int numEvaluated = var->isDiffusing() ? numNonDirichlet : groupSize;
+            varContext->evaluateExpressionBatch(REACT_RATE_EXP, numEvaluated, workspace.batchColumns, batchRates + v * RHS_BATCH_SIZE + groupStart);
+        }
+    }
+
+    int numMemVar = simulation->getNumMemVariables();
+    for (int k = 0; k < numPoints; k ++) {
+        int vectorIndexOffset = getMembraneElementVectorOffset(memIndexStart + k);
+        for (int v = 0; v < numMemVar; v ++) {
+            reactionRates[vectorIndexOffset + v] = batchRates[v * RHS_BATCH_SIZE + batchPointSlots[k]];
+        }
+    }
+}
+
+// reaction rates of the variables of each volume region and each membrane in one program (see
+// computeRegionReactionRates), parameters are folded as they are fixed for the run
+void SundialsPdeScheduler::buildReactionPrograms() {
+    deleteReactionPrograms();
+
+    double* parameterValues = statePointValues + parameterSymbolOffset;
+    int numOperations = 0;
+    int numSourceOperations = 0;
+
+    if (simulation->getNumVolVariables() > 0) {
+        int numVolRegions = mesh->getNumVolumeRegions();
+        regionReactionPrograms = new FusedExpressionProgram*[numVolRegions];
+        for (int r = 0; r < numVolRegions; r ++) {
+            regionReactionPrograms[r] = 0;
+            int numVars = regionDefinedVolVariableSizes[r];
+            if (numVars == 0) {
+                continue;
+            }
+            Feature* feature = pVolumeElement[local2Global[regionOffsets[r]]].getFeature();
+            for (int r0 = 0; r0 < r && regionReactionPrograms[r] == 0; r0 ++) {
+                if (regionReactionPrograms[r0] != 0 && regionDefinedVolVariableSizes[r0] == numVars
+                        && pVolumeElement[local2Global[regionOffsets[r0]]].getFeature() == feature
+                        && memcmp(regionDefinedVolVariableIndexes[r0], regionDefinedVolVariableIndexes[r], numVars * sizeof(int)) == 0) {
+                    regionReactionPrograms[r] = regionReactionPrograms[r0];
+                }
+            }
+            if (regionReactionPrograms[r] != 0) {
+                continue;
+            }
+
+            FusedExpressionProgram* program = new FusedExpressionProgram();
+            for (int i = 0; i < simulation->getNumParameters(); i ++) {
+                program->setConstantSymbol(parameterSymbolOffset + i, parameterValues[i]);
+            }
+            // every rate is added, even after one fails, so that all of them have their stack machine
+            // before the threads evaluate them
+            bool bFused = true;
+            for (int activeVarCount = 0; activeVarCount < numVars; activeVarCount ++) {
+                VolumeVariable* var = simulation->getVolVariable(regionDefinedVolVariableIndexes[r][activeVarCount]);
+                bFused = feature->getVolumeVarContext(var)->addExpressionToProgram(REACT_RATE_EXP, program) && bFused;
+            }
+            if (!bFused) {
+                delete program;
+                continue;
+            }
+            regionReactionPrograms[r] = program;
+            reactionPrograms.push_back(program);
+        }
+    }
+
+    if (simulation->getNumMemVariables() > 0) {
+        VCellModel* model = SimTool::getInstance()->getModel();
+        membraneReactionPrograms = new FusedExpressionProgram*[model->getNumMembranes()];
+        for (int m = 0; m < model->getNumMembranes(); m ++) {
+            Membrane* membrane = model->getMembraneFromIndex(m);
+            FusedExpressionProgram* program = new FusedExpressionProgram();
+            for (int i = 0; i < simulation->getNumParameters(); i ++) {
+                program->setConstantSymbol(parameterSymbolOffset + i, parameterValues[i]);
+            }
+            bool bFused = true;
+            for (int v = 0; v < simulation->getNumMemVariables(); v ++) {
+                MembraneVariable* var = simulation->getMemVariable(v);
+                if (var->getStructure() != NULL && var->getStructure() != membrane) {
+                    continue;
+                }
+                bFused = membrane->getMembraneVarContext(var)->addExpressionToProgram(REACT_RATE_EXP, program) && bFused;
+            }
+            if (!bFused || program->getNumOutputs() == 0) {
+                delete program;
+                program = 0;
+            } else {
+                reactionPrograms.push_back(program);
+            }
+            membraneReactionPrograms[m] = program;
+        }
+    }
+
+    for (int i = 0; i < (int)reactionPrograms.size(); i ++) {
+        numSourceOperations += reactionPrograms[i]->getNumSourceOperations();
+        numOperations += reactionPrograms[i]->getNumOperations();
+    }
+    if (reactionPrograms.size() > 0) {
+        cout << "reaction rates: " << numSourceOperations << " operations reduced to " << numOperations
+             << " in " << reactionPrograms.size() << " fused programs" << endl;
+    }
+}
+
+void SundialsPdeScheduler::deleteReactionPrograms() {
+    for (int i = 0; i < (int)reactionPrograms.size(); i ++) {
+        delete reactionPrograms[i];
+    }
+    reactionPrograms.clear();
+    delete[] regionReactionPrograms;
+    delete[] membraneReactionPrograms;
+    regionReactionPrograms = 0;
+    membraneReactionPrograms = 0;
+}
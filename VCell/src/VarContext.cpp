@@ -8,7 +8,12 @@
 using std::stringstream;
 
 #include <Expression.h>
+#include <ExpressionCompiler.h>
+#include <FusedExpressionProgram.h>
+#include <EvalContext.h>
 using VCell::Expression;
+using VCell::ExpressionCompiler;
+using VCell::FusedExpressionProgram;
 
 #include <VCELL/Element.h>
 #include <VCELL/Variable.h>
@@ -126,6 +131,25 @@ double VarContext::evaluateExpression(MembraneElement* element, long expIndex)
 	return expressions[expIndex]->evaluateProxy();	
 }
 
+double VarContext::evaluateExpression(EvalContext& context, MembraneElement* element, long expIndex)
+{
+	if (expressions[expIndex] == 0) { // not defined
+		throw "VarContext::evaluateExpression(MembaneElement), expression not defined";
+	}
+	if (constantValues[expIndex] != NULL) {
+		return constantValues[expIndex][0];
+	}
+	if (dependencyMask[expIndex] & DEPENDENCY_MASK_XYZ) {
+		WorldCoord wc = sim->getMesh()->getMembraneWorldCoord(element);
+		((SimulationExpression*)sim)->setCurrentCoordinate(context, wc);
+	}
+	context.indices[VAR_VOLUME_INDEX] = -1;
+	context.indices[VAR_VOLUME_REGION_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_INDEX] = element->index;
+	context.indices[VAR_MEMBRANE_REGION_INDEX] = element->getRegionIndex();
+	return expressions[expIndex]->evaluate(context);
+}
+
 double VarContext::evaluateConstantExpression(long expIndex) {
 	// pure constant
 	if (constantValues[expIndex] != 0) {
@@ -158,6 +182,26 @@ double VarContext::evaluateExpression(long volIndex, long expIndex) {
 	return expressions[expIndex]->evaluateProxy();	
 }
 
+double VarContext::evaluateExpression(EvalContext& context, long volIndex, long expIndex) {
+	if (expressions[expIndex] == 0) { // not defined
+		stringstream ss;
+		ss << "VarContext::evaluateExpression(VolIndex), for variable " << species->getName() << " expression " << String_Expression_Index[expIndex] << " not defined";
+		throw ss.str();
+	}
+	if (constantValues[expIndex] != NULL) {
+		return constantValues[expIndex][0];
+	}
+	if (dependencyMask[expIndex] & DEPENDENCY_MASK_XYZ) {
+		WorldCoord wc = ((CartesianMesh*)sim->getMesh())->getVolumeWorldCoord(volIndex);
+		((SimulationExpression*)sim)->setCurrentCoordinate(context, wc);
+	}
+	context.indices[VAR_MEMBRANE_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_REGION_INDEX] = -1;
+	context.indices[VAR_VOLUME_INDEX] = volIndex;
+	context.indices[VAR_VOLUME_REGION_INDEX] = sim->getMesh()->getVolumeElements()[volIndex].getRegionIndex();
+	return expressions[expIndex]->evaluate(context);
+}
+
 double VarContext::evaluateExpression(long expIndex, double* values) {
 	if (expressions[expIndex] == 0) { // not defined
 		stringstream ss;
@@ -170,6 +214,22 @@ double VarContext::evaluateExpression(long expIndex, double* values) {
 	return expressions[expIndex]->evaluateVector(values);	
 }
 
+// columns[i] holds value i of evaluateExpression(expIndex, values) for each point
+void VarContext::evaluateExpressionBatch(long expIndex, int numPoints, double** columns, double* result) {
+	if (expressions[expIndex] == 0) { // not defined
+		stringstream ss;
+		ss << "VarContext::evaluateExpressionBatch(), for variable " << species->getName() << " expression " << String_Expression_Index[expIndex] << " not defined";
+		throw ss.str();
+	}
+	if (constantValues[expIndex] != NULL) {
+		for (int i = 0; i < numPoints; i ++) {
+			result[i] = constantValues[expIndex][0];
+		}
+		return;
+	}
+	expressions[expIndex]->evaluateBatch(numPoints, columns, result);
+}
+
 void VarContext::addJumpCondition(Membrane* membrane, Expression* exp) {
 	JumpCondition* jc = new JumpCondition(membrane, exp);
 	jumpConditionList.push_back(jc);
@@ -188,6 +248,19 @@ double VarContext::evaluateJumpCondition(MembraneElement* element)
 	throw ss.str();
 }
 
+double VarContext::evaluateJumpCondition(EvalContext& context, MembraneElement* element)
+{
+	for (int i = 0; i < (int)jumpConditionList.size(); i ++) {
+		if (jumpConditionList[i]->getMembrane() == element->getMembrane()) {
+			return jumpConditionList[i]->evaluateExpression(context, ((SimulationExpression*)sim), element);
+		}
+	}
+	stringstream ss;
+	ss << "Jump Condition for variable " << species->getName() << " in Feature " << structure->getName() 
+		<< " not found for Membrane " << element->getMembrane()->getName();
+	throw ss.str();
+}
+
 double VarContext::evaluateJumpCondition(MembraneElement* element, double* values)
 {
 	for (int i = 0; i < (int)jumpConditionList.size(); i ++) {
@@ -292,6 +365,24 @@ double VarContext::evaluateVolumeRegionExpression(long volRegionIndex, long expI
 	return expressions[expIndex]->evaluateProxy();
 }
 
+double VarContext::evaluateMembraneRegionExpression(EvalContext& context, long memRegionIndex, long expIndex)
+{
+	context.indices[VAR_VOLUME_INDEX] = -1;
+	context.indices[VAR_VOLUME_REGION_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_INDEX] = -1;	
+	context.indices[VAR_MEMBRANE_REGION_INDEX] = memRegionIndex;
+	return expressions[expIndex]->evaluate(context);	
+}
+
+double VarContext::evaluateVolumeRegionExpression(EvalContext& context, long volRegionIndex, long expIndex)
+{
+	context.indices[VAR_VOLUME_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_INDEX] = -1;
+	context.indices[VAR_MEMBRANE_REGION_INDEX] = -1;	
+	context.indices[VAR_VOLUME_REGION_INDEX] = volRegionIndex;
+	return expressions[expIndex]->evaluate(context);
+}
+
 void VarContext::reinitConstantValues() {
 	for (int i = 0; i < TOTAL_NUM_EXPRESSIONS; i ++) {
 		if (expressions[i] == 0 || !isConstantExpression(i)) {
@@ -308,3 +399,41 @@ void VarContext::reinitConstantValues() {
 		jumpConditionList[i]->reinitConstantValues();
 	}
 }
+
+// constant expressions go in the program as their value
+bool VarContext::addExpressionToProgram(long expIndex, FusedExpressionProgram* program) {
+	if (expressions[expIndex] == 0) {
+		return false;
+	}
+	if (constantValues[expIndex] != NULL) {
+		program->addConstant(constantValues[expIndex][0]);
+		return true;
+	}
+	return program->add(expressions[expIndex]);
+}
+
+// constant and parameter only expressions are not evaluated per point, no need to compile them
+void VarContext::addExpressionsToCompiler(ExpressionCompiler* compiler) {
+	for (int i = 0; i < TOTAL_NUM_EXPRESSIONS; i ++) {
+		if (expressions[i] == 0 || isConstantExpression(i)) {
+			continue;
+		}
+		compiler->add(expressions[i]);
+	}
+
+	for (int i = 0; i < (int)jumpConditionList.size(); i ++) {
+		compiler->add(jumpConditionList[i]->getExpression());
+	}
+}
+
+void VarContext::createStackMachines() {
+	for (int i = 0; i < TOTAL_NUM_EXPRESSIONS; i ++) {
+		if (expressions[i] != 0) {
+			expressions[i]->createStackMachine();
+		}
+	}
+
+	for (int i = 0; i < (int)jumpConditionList.size(); i ++) {
+		jumpConditionList[i]->getExpression()->createStackMachine();
+	}
+}
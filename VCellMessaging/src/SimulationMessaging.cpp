@@ -111,6 +111,9 @@ namespace {
 
 SimulationMessaging::~SimulationMessaging() throw()
 {
+	if (m_inst == this) {
+		m_inst = NULL;
+	}
 	if (workerEventOutputMode == WORKEREVENT_OUTPUT_MODE_STDOUT) {
 		return;
 	}
@@ -0,0 +1,264 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <fcntl.h>
+#ifdef WIN32
+#include <direct.h>
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+double BenchResult::getMinSeconds() {
+	return seconds.empty() ? 0 : *std::min_element(seconds.begin(), seconds.end());
+}
+
+double BenchResult::getMedianSeconds() {
+	if (seconds.empty()) {
+		return 0;
+	}
+	vector<double> sorted(seconds);
+	std::sort(sorted.begin(), sorted.end());
+	int n = (int)sorted.size();
+	return n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+double benchNow() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// discards what's written to it
+class NullBuffer : public std::streambuf {
+protected:
+	int overflow(int c) { return c; }
+};
+
+static NullBuffer nullBuffer;
+
+QuietOutput::QuietOutput() {
+	savedBuffer = cout.rdbuf(&nullBuffer);
+	// the solvers printf too
+	fflush(stdout);
+	savedStdout = dup(fileno(stdout));
+	int nullDevice = open(NULL_DEVICE, O_WRONLY);
+	if (nullDevice >= 0) {
+		dup2(nullDevice, fileno(stdout));
+		close(nullDevice);
+	}
+}
+
+QuietOutput::~QuietOutput() {
+	cout.rdbuf(savedBuffer);
+	fflush(stdout);
+	if (savedStdout >= 0) {
+		dup2(savedStdout, fileno(stdout));
+		close(savedStdout);
+	}
+}
+
+BenchReport::BenchReport(const BenchOptions& options) {
+	this->options = options;
+}
+
+bool BenchReport::isSelected(const string& name) {
+	return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+string BenchReport::getWorkFile(const string& name) {
+	return options.workDir + "/" + name;
+}
+
+void BenchReport::add(const BenchResult& result) {
+	results.push_back(result);
+	BenchResult& r = results.back();
+	double minSeconds = r.getMinSeconds();
+	cout.precision(4);
+	cout << r.name << " : min " << minSeconds << " s, median " << r.getMedianSeconds() << " s";
+	if (r.items > 0 && minSeconds > 0) {
+		cout << ", " << r.items / minSeconds << " " << r.unit << "/s";
+	}
+	cout << endl;
+}
+
+static string jsonString(const string& s) {
+	string escaped = "\"";
+	for (size_t i = 0; i < s.size(); i ++) {
+		if (s[i] == '"' || s[i] == '\\') {
+			escaped += '\\';
+		}
+		escaped += s[i];
+	}
+	return escaped + "\"";
+}
+
+/*
+ * one result per line, so that the reports diff line by line and
+ * compare_bench.py needn't parse more than that
+ */
+void BenchReport::writeJSON(const string& fileName) {
+	std::ofstream out(fileName.c_str());
+	if (!out.is_open()) {
+		throw "BenchReport : can't open " + fileName;
+	}
+	out.precision(9);
+
+	char date[64];
+	time_t now = time(0);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	int numThreads = 1;
+#ifdef _OPENMP
+	numThreads = omp_get_max_threads();
+#endif
+	out << "{" << endl;
+	out << "  \"version\": " << jsonString(BENCH_VERSION) << "," << endl;
+	out << "  \"date\": " << jsonString(date) << "," << endl;
+	out << "  \"threads\": " << numThreads << "," << endl;
+	out << "  \"options\": {\"grid2d\": " << options.grid2d << ", \"grid3d\": " << options.grid3d
+		<< ", \"repeat\": " << options.repeat << ", \"points\": " << options.numPoints
+		<< ", \"species\": " << options.numSpecies << ", \"events\": " << options.numEvents
+		<< ", \"molecules\": " << options.numMolecules << ", \"smoldyn_steps\": " << options.numSmoldynSteps << "}," << endl;
+	out << "  \"results\": [" << endl;
+	for (size_t i = 0; i < results.size(); i ++) {
+		BenchResult& r = results[i];
+		double minSeconds = r.getMinSeconds();
+		out << "    {\"name\": " << jsonString(r.name) << ", \"unit\": " << jsonString(r.unit)
+			<< ", \"items\": " << r.items << ", \"repeat\": " << r.seconds.size()
+			<< ", \"min_seconds\": " << minSeconds << ", \"median_seconds\": " << r.getMedianSeconds()
+			<< ", \"items_per_second\": " << (minSeconds > 0 ? r.items / minSeconds : 0);
+		if (!r.metrics.empty()) {
+			out << ", \"metrics\": {";
+			for (map<string, double>::iterator iter = r.metrics.begin(); iter != r.metrics.end(); iter ++) {
+				out << (iter == r.metrics.begin() ? "" : ", ") << jsonString(iter->first) << ": " << iter->second;
+			}
+			out << "}";
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+}
+
+static void usage(const char* program) {
+	cerr << "usage: " << program << " [options]" << endl
+		<< "  --json file       write the results to file" << endl
+		<< "  --filter text     only the benchmarks whose name contains text" << endl
+		<< "  --repeat n        timed repetitions of each benchmark (3)" << endl
+		<< "  --grid2d n        points per axis of the 2D meshes (128)" << endl
+		<< "  --grid3d n        points per axis of the 3D meshes (32)" << endl
+		<< "  --points n        points of the expression benchmarks (100000)" << endl
+		<< "  --species n       species of the Gibson model (100)" << endl
+		<< "  --events n        reactions the Gibson model runs (1000000)" << endl
+		<< "  --molecules n     molecules of each Smoldyn species (10000)" << endl
+		<< "  --smoldyn-steps n time steps of the Smoldyn model (100)" << endl
+		<< "  --workdir dir     scratch directory (bench_work)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+	options.grid2d = 128;
+	options.grid3d = 32;
+	options.repeat = 3;
+	options.numPoints = 100000;
+	options.numSpecies = 100;
+	options.numEvents = 1000000;
+	options.numMolecules = 10000;
+	options.numSmoldynSteps = 100;
+	options.workDir = "bench_work";
+	string jsonFileName;
+
+	for (int i = 1; i < argc; i ++) {
+		string arg = argv[i];
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		string value = argv[++ i];
+		if (arg == "--json") {
+			jsonFileName = value;
+		} else if (arg == "--filter") {
+			options.filter = value;
+		} else if (arg == "--workdir") {
+			options.workDir = value;
+		} else if (arg == "--repeat") {
+			options.repeat = atoi(value.c_str());
+		} else if (arg == "--grid2d") {
+			options.grid2d = atoi(value.c_str());
+		} else if (arg == "--grid3d") {
+			options.grid3d = atoi(value.c_str());
+		} else if (arg == "--points") {
+			options.numPoints = atoi(value.c_str());
+		} else if (arg == "--species") {
+			options.numSpecies = atoi(value.c_str());
+		} else if (arg == "--events") {
+			options.numEvents = atol(value.c_str());
+		} else if (arg == "--molecules") {
+			options.numMolecules = atoi(value.c_str());
+		} else if (arg == "--smoldyn-steps") {
+			options.numSmoldynSteps = atoi(value.c_str());
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (options.repeat < 1 || options.grid2d < 4 || options.grid3d < 4 || options.numPoints < 1
+			|| options.numSpecies < 3 || options.numEvents < 1 || options.numMolecules < 1 || options.numSmoldynSteps < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+#ifdef WIN32
+	_mkdir(options.workDir.c_str());
+#else
+	mkdir(options.workDir.c_str(), 0755);
+#endif
+
+	try {
+		BenchReport report(options);
+		runExpressionBenchmarks(report);
+		runSparseMatrixBenchmarks(report);
+		runFVBenchmarks(report);
+		runStochBenchmarks(report);
+		runSmoldynBenchmarks(report);
+		if (jsonFileName.size() > 0) {
+			report.writeJSON(jsonFileName);
+			cout << "results written to " << jsonFileName << endl;
+		}
+	} catch (const char* ex) {
+		cerr << "VCellBench failed : " << ex << endl;
+		return 1;
+	} catch (string& ex) {
+		cerr << "VCellBench failed : " << ex << endl;
+		return 1;
+	} catch (std::exception& ex) {
+		cerr << "VCellBench failed : " << ex.what() << endl;
+		return 1;
+	} catch (...) {
+		cerr << "VCellBench failed : unknown error." << endl;
+		return 1;
+	}
+	return 0;
+}
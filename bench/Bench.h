@@ -0,0 +1,117 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iosfwd>
+using std::string;
+using std::vector;
+using std::map;
+
+/*----------------------------------------------------------------------------
+	Benchmarks of the solver hot paths (VCellBench, make target bench).
+
+	A benchmark runs its body options.repeat times and keeps the time of every
+	repetition. The report gives the minimum and the median, the minimum also
+	as items per second (points, nonzeros, RHS evaluations, reactions ...).
+	Everything is synthetic and seeded, so the same options on the same
+	machine time the same work from one commit to the next; compare two JSON
+	reports with bench/compare_bench.py.
+ --------------------------------------------------------------------------------------*/
+struct BenchOptions {
+	// points per axis of the synthetic 2D and 3D meshes
+	int grid2d;
+	int grid3d;
+	int repeat;
+	// points for the expression benchmarks
+	int numPoints;
+	// species and reactions of the Gibson model, reactions it runs
+	int numSpecies;
+	long numEvents;
+	// molecules of each species and time steps of the Smoldyn model
+	int numMolecules;
+	int numSmoldynSteps;
+	// only the benchmarks whose name contains filter
+	string filter;
+	// scratch directory for input and output files
+	string workDir;
+};
+
+struct BenchResult {
+	string name;
+	// what items counts and how many a repetition processes
+	string unit;
+	double items;
+	vector<double> seconds;
+	// anything else worth keeping, e.g. the sections of the profiler
+	map<string, double> metrics;
+
+	double getMinSeconds();
+	double getMedianSeconds();
+};
+
+class BenchReport {
+public:
+	BenchReport(const BenchOptions& options);
+
+	bool isSelected(const string& name);
+	void add(const BenchResult& result);
+	void writeJSON(const string& fileName);
+
+	const BenchOptions& getOptions() { return options; }
+	// a new file name in the scratch directory
+	string getWorkFile(const string& name);
+
+private:
+	BenchOptions options;
+	vector<BenchResult> results;
+};
+
+// wall clock seconds
+double benchNow();
+
+/*
+ * runs body options.repeat times after one warm up run and adds the result;
+ * nothing if name isn't selected
+ */
+template <class Body>
+void runBench(BenchReport& report, const string& name, const string& unit, double items, Body body) {
+	if (!report.isSelected(name)) {
+		return;
+	}
+	BenchResult result;
+	result.name = name;
+	result.unit = unit;
+	result.items = items;
+	body();
+	for (int r = 0; r < report.getOptions().repeat; r ++) {
+		double start = benchNow();
+		body();
+		result.seconds.push_back(benchNow() - start);
+	}
+	report.add(result);
+}
+
+// swallows what the solvers print to cout and stdout while in scope
+class QuietOutput {
+public:
+	QuietOutput();
+	~QuietOutput();
+
+private:
+	std::streambuf* savedBuffer;
+	int savedStdout;
+};
+
+void runExpressionBenchmarks(BenchReport& report);
+void runSparseMatrixBenchmarks(BenchReport& report);
+void runFVBenchmarks(BenchReport& report);
+void runStochBenchmarks(BenchReport& report);
+void runSmoldynBenchmarks(BenchReport& report);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <Expression.h>
+#include <FusedExpressionProgram.h>
+#include <SimpleSymbolTable.h>
+#include <random>
+using VCell::Expression;
+using VCell::FusedExpressionProgram;
+
+// reaction rates of the kind the solvers evaluate at every mesh point
+static const char* rateExpressions[] = {
+	"(RanC - (1000.0 * C * Ran)) + (x > 5) * 1.0e-4 * exp(-t) + (x <= 5) * 2.0e-5 * log(1 + y * y)",
+	"- (RanC - (1000.0 * C * Ran)) + 0.5 * RanC / (1e-4 + C)",
+	"2.0 * pow(Ran, 2) * (x - 0.5 * y) / (1 + 0.1 * sqrt(x * x + y * y))"
+};
+#define NUM_RATE_EXPRESSIONS 3
+
+void runExpressionBenchmarks(BenchReport& report) {
+	string symbols[] = {"t", "x", "y", "Ran", "RanC", "C"};
+	int numSymbols = 6;
+	SimpleSymbolTable symbolTable(symbols, numSymbols);
+
+	int numPoints = report.getOptions().numPoints;
+	std::mt19937 random(20111127);
+	std::uniform_real_distribution<double> uniform(0.0, 10.0);
+	vector<double> values(numSymbols * numPoints);
+	vector<double*> columns(numSymbols);
+	for (int i = 0; i < numSymbols; i ++) {
+		columns[i] = &values[i * numPoints];
+		for (int p = 0; p < numPoints; p ++) {
+			columns[i][p] = uniform(random);
+		}
+	}
+	// point values one after the other, as evaluateVector wants them
+	vector<double> rows(numSymbols * numPoints);
+	for (int p = 0; p < numPoints; p ++) {
+		for (int i = 0; i < numSymbols; i ++) {
+			rows[p * numSymbols + i] = columns[i][p];
+		}
+	}
+
+	Expression* expressions[NUM_RATE_EXPRESSIONS];
+	for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+		expressions[k] = new Expression(rateExpressions[k]);
+		expressions[k]->bindExpression(&symbolTable);
+	}
+	vector<double> results(NUM_RATE_EXPRESSIONS * numPoints);
+	double numEvaluations = (double)NUM_RATE_EXPRESSIONS * numPoints;
+
+	runBench(report, "expression.tree", "evaluations", numEvaluations, [&]() {
+		for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+			for (int p = 0; p < numPoints; p ++) {
+				results[k * numPoints + p] = expressions[k]->evaluateVectorTree(&rows[p * numSymbols]);
+			}
+		}
+	});
+	runBench(report, "expression.stackMachine", "evaluations", numEvaluations, [&]() {
+		for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+			for (int p = 0; p < numPoints; p ++) {
+				results[k * numPoints + p] = expressions[k]->evaluateVector(&rows[p * numSymbols]);
+			}
+		}
+	});
+	runBench(report, "expression.stackMachineBatch", "evaluations", numEvaluations, [&]() {
+		for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+			expressions[k]->evaluateBatch(numPoints, &columns[0], &results[k * numPoints]);
+		}
+	});
+
+	FusedExpressionProgram program;
+	for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+		program.add(expressions[k]);
+	}
+	vector<double*> outputs(NUM_RATE_EXPRESSIONS);
+	for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+		outputs[k] = &results[k * numPoints];
+	}
+	vector<double> workspace;
+	// an expression the program can't merge isn't in it
+	double numFusedEvaluations = (double)program.getNumOutputs() * numPoints;
+	runBench(report, "expression.fusedBatch", "evaluations", numFusedEvaluations, [&]() {
+		program.evaluateBatch(numPoints, &columns[0], &outputs[0], workspace);
+	});
+
+	for (int k = 0; k < NUM_RATE_EXPRESSIONS; k ++) {
+		delete expressions[k];
+	}
+}
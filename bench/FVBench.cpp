@@ -0,0 +1,306 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <VCELL/FVSolver.h>
+#include <VCELL/FVDataSet.h>
+#include <VCELL/SimTool.h>
+#include <VCELL/SimulationExpression.h>
+#include <VCELL/Profiler.h>
+#include <zlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sstream>
+using std::stringstream;
+using std::istringstream;
+using std::endl;
+
+// the domain is a box of DOMAIN_SIZE microns with the cell an ellipsoid in the middle
+#define DOMAIN_SIZE 10.0
+#define CELL_RADIUS 3.5
+
+static const char* volumeVariables[] = {"A", "B", "C", "L"};
+#define NUM_VOLUME_VARIABLES 4
+
+/*
+ * A + B <-> C diffusing in the cell, L diffusing outside, exchanged through the
+ * membrane and binding R on it: the kind of model the FV solvers run, with
+ * the geometry inline as a compressed VCG
+ */
+static string syntheticModel(int dimension, int n, const string& solver, const string& baseName, double endTime, double timeStep, int keepEvery) {
+	int numZ = dimension == 3 ? n : 1;
+	long numVolume = (long)n * n * numZ;
+	double h = DOMAIN_SIZE / n;
+	double center = DOMAIN_SIZE / 2;
+
+	vector<unsigned char> samples(numVolume);
+	long numInside = 0;
+	for (int k = 0; k < numZ; k ++) {
+		for (int j = 0; j < n; j ++) {
+			for (int i = 0; i < n; i ++) {
+				double dx = (i + 0.5) * h - center;
+				double dy = (j + 0.5) * h - center;
+				double dz = dimension == 3 ? (k + 0.5) * h - center : 0;
+				bool bInside = dx * dx + dy * dy + 2 * dz * dz < CELL_RADIUS * CELL_RADIUS;
+				samples[((long)k * n + j) * n + i] = bInside ? 1 : 0;
+				numInside += bInside ? 1 : 0;
+			}
+		}
+	}
+	// membrane elements are the faces between the cell and outside, with the normal of the ellipsoid
+	double faceArea = dimension == 3 ? h * h : h;
+	long strides[3] = {1, n, (long)n * n};
+	long numFaces = 0;
+	stringstream cells;
+	for (long index = 0; index < numVolume; index ++) {
+		for (int a = 0; a < dimension; a ++) {
+			int coord = (int)((index / strides[a]) % n);
+			long neighbor = index + strides[a];
+			if (coord == n - 1 || samples[index] == samples[neighbor]) {
+				continue;
+			}
+			double point[3];
+			for (int b = 0; b < 3; b ++) {
+				int c = b < dimension ? (int)((index / strides[b]) % n) : 0;
+				point[b] = b < dimension ? (c + 0.5 + (a == b ? 0.5 : 0)) * h : 0;
+			}
+			double normal[3] = {point[0] - center, point[1] - center, dimension == 3 ? 2 * (point[2] - center) : 0};
+			double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			cells << numFaces << " " << index << " " << neighbor << " " << faceArea
+				<< " " << point[0] << " " << point[1] << " " << point[2]
+				<< " " << normal[0] / length << " " << normal[1] / length << " " << normal[2] / length << endl;
+			numFaces ++;
+		}
+	}
+
+	uLongf compressedLength = compressBound(numVolume);
+	vector<unsigned char> compressed(compressedLength);
+	if (compress(&compressed[0], &compressedLength, &samples[0], numVolume) != Z_OK) {
+		throw "syntheticModel : can't compress the volume samples";
+	}
+	string hex(compressedLength * 2, '0');
+	const char* digits = "0123456789ABCDEF";
+	for (uLongf i = 0; i < compressedLength; i ++) {
+		hex[2 * i] = digits[compressed[i] >> 4];
+		hex[2 * i + 1] = digits[compressed[i] & 15];
+	}
+
+	double voxelVolume = dimension == 3 ? h * h * h : h * h;
+	stringstream ss;
+	ss << "SIMULATION_PARAM_BEGIN" << endl
+		<< "SOLVER " << solver << endl
+		<< "BASE_FILE_NAME " << baseName << endl
+		<< "ENDING_TIME " << endTime << endl
+		<< "TIME_STEP " << timeStep << endl
+		<< "KEEP_EVERY " << keepEvery << endl
+		<< "PROFILE" << endl
+		<< "SIMULATION_PARAM_END" << endl << endl;
+
+	ss << "MODEL_BEGIN" << endl
+		<< "FEATURE ec 0 flux flux flux flux flux flux" << endl
+		<< "FEATURE cell 1 flux flux flux flux flux flux" << endl
+		<< "MEMBRANE cell_ec_membrane cell ec flux flux flux flux flux flux" << endl
+		<< "MODEL_END" << endl << endl;
+
+	ss << "MESH_BEGIN" << endl
+		<< "name bench" << endl
+		<< "dimension " << dimension << endl;
+	if (dimension == 3) {
+		ss << "size " << DOMAIN_SIZE << " " << DOMAIN_SIZE << " " << DOMAIN_SIZE << endl
+			<< "origin 0.0 0.0 0.0" << endl;
+	} else {
+		ss << "size " << DOMAIN_SIZE << " " << DOMAIN_SIZE << endl
+			<< "origin 0.0 0.0" << endl;
+	}
+	ss << "volumeRegions 2" << endl
+		<< "ec0 " << (numVolume - numInside) * voxelVolume << " 0" << endl
+		<< "cell1 " << numInside * voxelVolume << " 1" << endl
+		<< "membraneRegions 1" << endl
+		<< "membrane_ec0_cell1 " << numFaces * faceArea << " 1 0" << endl;
+	if (dimension == 3) {
+		ss << "volumeSamples " << n << " " << n << " " << n << endl;
+	} else {
+		ss << "volumeSamples " << n << " " << n << endl;
+	}
+	ss << hex << endl
+		<< "cells " << numFaces << endl
+		<< cells.str()
+		<< "MESH_END" << endl << endl;
+
+	ss << "VARIABLE_BEGIN" << endl
+		<< "VOLUME_PDE A cell false false false false cell" << endl
+		<< "VOLUME_PDE B cell false false false false cell" << endl
+		<< "VOLUME_PDE C cell false false false false cell" << endl
+		<< "VOLUME_PDE L ec false false false false ec" << endl
+		<< "MEMBRANE_ODE R cell_ec_membrane" << endl
+		<< "VARIABLE_END" << endl << endl;
+
+	const char* cellEquations[][3] = {
+		{"1.0 + 0.5 * (x > 5.0)", "- 2.0 * A * B + 0.5 * C", "1.0"},
+		{"0.8", "- 2.0 * A * B + 0.5 * C", "2.0"},
+		{"0.0", "2.0 * A * B - 0.5 * C", "0.5"},
+		{"0.0", "0.0", "0.0"}
+	};
+	const char* ecEquations[][3] = {
+		{"0.0", "0.0", "0.0"},
+		{"0.0", "0.0", "0.0"},
+		{"0.0", "0.0", "0.0"},
+		{"1.0 + 0.1 * y", "- 0.1 * L", "5.0"}
+	};
+	const char* features[] = {"ec", "cell"};
+	for (int f = 0; f < 2; f ++) {
+		ss << "COMPARTMENT_BEGIN " << features[f] << endl << endl;
+		for (int v = 0; v < NUM_VOLUME_VARIABLES; v ++) {
+			const char** equation = f == 0 ? ecEquations[v] : cellEquations[v];
+			ss << "EQUATION_BEGIN " << volumeVariables[v] << endl
+				<< "INITIAL " << equation[0] << ";" << endl
+				<< "RATE " << equation[1] << ";" << endl
+				<< "DIFFUSION " << equation[2] << ";" << endl
+				<< "VELOCITY_X 0.0;" << endl << "VELOCITY_Y 0.0;" << endl << "VELOCITY_Z 0.0;" << endl
+				<< "BOUNDARY_XM 0.0;" << endl << "BOUNDARY_XP 0.0;" << endl
+				<< "BOUNDARY_YM 0.0;" << endl << "BOUNDARY_YP 0.0;" << endl
+				<< "BOUNDARY_ZM 0.0;" << endl << "BOUNDARY_ZP 0.0;" << endl
+				<< "EQUATION_END" << endl << endl;
+		}
+		ss << "COMPARTMENT_END" << endl << endl;
+	}
+
+	ss << "MEMBRANE_BEGIN cell_ec_membrane cell ec" << endl << endl
+		<< "EQUATION_BEGIN R" << endl
+		<< "INITIAL 0.0;" << endl
+		<< "RATE 0.2 * L_ec_membrane * A_cell_membrane - 0.1 * R;" << endl
+		<< "EQUATION_END" << endl << endl
+		<< "JUMP_CONDITION_BEGIN A" << endl
+		<< "FLUX cell (0.05 * L_ec_membrane - 0.1 * A_cell_membrane);" << endl
+		<< "JUMP_CONDITION_END" << endl << endl
+		<< "JUMP_CONDITION_BEGIN B" << endl
+		<< "FLUX cell 0.0;" << endl
+		<< "JUMP_CONDITION_END" << endl << endl
+		<< "JUMP_CONDITION_BEGIN C" << endl
+		<< "FLUX cell 0.0;" << endl
+		<< "JUMP_CONDITION_END" << endl << endl
+		<< "JUMP_CONDITION_BEGIN L" << endl
+		<< "FLUX ec (0.1 * A_cell_membrane - 0.05 * L_ec_membrane);" << endl
+		<< "JUMP_CONDITION_END" << endl << endl
+		<< "MEMBRANE_END" << endl;
+	return ss.str();
+}
+
+static FVSolver* createSolver(BenchReport& report, const string& input) {
+	istringstream iss(input);
+	vector<char> outputPath(report.getOptions().workDir.begin(), report.getOptions().workDir.end());
+	outputPath.push_back(0);
+	return new FVSolver(iss, -1, &outputPath[0], false);
+}
+
+// profiler sections reported with the Sundials runs
+static const char* sundialsSections[] = {
+	"rhs.reactionRates",
+	"rhs.membraneFluxes",
+	"rhs.volumeOperator",
+	"rhs.membraneDiffusionReactionOperator",
+	"rhs.volumeRegionReactionOperator",
+	"rhs.membraneRegionReactionOperator",
+	"rhs.membraneFluxOperator",
+	"pcSetup",
+	"pcSolve"
+};
+#define NUM_SUNDIALS_SECTIONS 9
+
+/*
+ * the whole Sundials run and, from the profiler, the time in CVodeRHS; the
+ * data set of the last run is then written with FVDataSet::write (uncompressed,
+ * compression shells out to an external program)
+ */
+static void runSundialsBenchmarks(BenchReport& report, int dimension, int n, const string& suffix) {
+	string runName = "fv.sundials." + suffix;
+	string rhsName = "fv.sundialsRhs." + suffix;
+	string writeName = "fvdataset.write." + suffix;
+	if (!report.isSelected(runName) && !report.isSelected(rhsName) && !report.isSelected(writeName)) {
+		return;
+	}
+	string input = syntheticModel(dimension, n, "SUNDIALS_PDE_SOLVER 1.0E-7 1.0E-9 0.1", "bench_sundials_" + suffix, 1.0, 0.25, 1);
+
+	BenchResult run, rhs;
+	run.name = runName;
+	run.unit = "points";
+	run.items = (double)n * n * (dimension == 3 ? n : 1);
+	rhs.name = rhsName;
+	rhs.unit = "evaluations";
+	rhs.items = 0;
+	ProfileHandle rhsHandle = Profiler::getHandle("rhs");
+	FVSolver* solver = 0;
+	for (int r = 0; r < report.getOptions().repeat; r ++) {
+		delete solver;
+		QuietOutput quiet;
+		solver = createSolver(report, input);
+		double start = benchNow();
+		solver->solve(false);
+		run.seconds.push_back(benchNow() - start);
+		rhs.seconds.push_back(Profiler::getSeconds(rhsHandle));
+		rhs.items = (double)Profiler::getNumCalls(rhsHandle);
+		if (run.seconds.back() <= run.getMinSeconds()) {
+			for (int s = 0; s < NUM_SUNDIALS_SECTIONS; s ++) {
+				ProfileHandle handle = Profiler::getHandle(sundialsSections[s]);
+				rhs.metrics[string(sundialsSections[s]) + ".seconds"] = Profiler::getSeconds(handle);
+			}
+		}
+	}
+	if (report.isSelected(runName)) {
+		report.add(run);
+	}
+	if (report.isSelected(rhsName)) {
+		report.add(rhs);
+	}
+
+	SimulationExpression* sim = (SimulationExpression*)SimTool::getInstance()->getSimulation();
+	string dataFileName = report.getWorkFile("bench_" + suffix + ".sim");
+	if (report.isSelected(writeName)) {
+		FVDataSet::write(dataFileName.c_str(), sim, false);
+		struct stat buf;
+		double numBytes = stat(dataFileName.c_str(), &buf) == 0 ? (double)buf.st_size : 0;
+		runBench(report, writeName, "bytes", numBytes, [&]() {
+			FVDataSet::write(dataFileName.c_str(), sim, false);
+		});
+	}
+	remove(dataFileName.c_str());
+	delete solver;
+}
+
+// the semi-implicit FV solver with one of its linear solvers
+static void runSemiImplicitBenchmarks(BenchReport& report, int dimension, int n, const string& suffix, const string& linearSolver) {
+	string name = "fv.semiImplicit." + linearSolver + "." + suffix;
+	if (!report.isSelected(name)) {
+		return;
+	}
+	int numSteps = 20;
+	string input = syntheticModel(dimension, n, "FV_SOLVER 1.0E-8", "bench_fv_" + suffix, numSteps * 0.01, 0.01, numSteps);
+	input.insert(input.find("SIMULATION_PARAM_END"), "LINEAR_SOLVER " + linearSolver + "\n");
+
+	BenchResult result;
+	result.name = name;
+	result.unit = "point steps";
+	result.items = (double)n * n * (dimension == 3 ? n : 1) * numSteps;
+	for (int r = 0; r < report.getOptions().repeat; r ++) {
+		QuietOutput quiet;
+		FVSolver* solver = createSolver(report, input);
+		double start = benchNow();
+		solver->solve(false);
+		result.seconds.push_back(benchNow() - start);
+		delete solver;
+	}
+	report.add(result);
+}
+
+void runFVBenchmarks(BenchReport& report) {
+	for (int dimension = 2; dimension <= 3; dimension ++) {
+		int n = dimension == 2 ? report.getOptions().grid2d : report.getOptions().grid3d;
+		string suffix = dimension == 2 ? "2d" : "3d";
+		runSundialsBenchmarks(report, dimension, n, suffix);
+		runSemiImplicitBenchmarks(report, dimension, n, suffix, "PCGPAK");
+		runSemiImplicitBenchmarks(report, dimension, n, suffix, "NATIVE_MULTIGRID");
+	}
+}
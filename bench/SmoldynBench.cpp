@@ -0,0 +1,76 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <libsmoldyn.h>
+
+#define SMOLDYN_BOX_SIZE 100.0
+#define SMOLDYN_TIME_STEP 0.1
+
+static void checkSmoldyn(enum ErrorCode code, const char* what) {
+	if (code < ECwarning) {
+		throw string("smoldyn : ") + what + " failed";
+	}
+}
+
+/*
+ * A + B <-> C diffusing in a reflective box, numMolecules of A and of B to
+ * start with
+ */
+static simptr smoldynModel(int numMolecules) {
+	double low[3] = {0, 0, 0};
+	double high[3] = {SMOLDYN_BOX_SIZE, SMOLDYN_BOX_SIZE, SMOLDYN_BOX_SIZE};
+	simptr sim = smolNewSim(3, low, high);
+	if (sim == NULL) {
+		throw "smoldyn : smolNewSim failed";
+	}
+	checkSmoldyn(smolSetSimTimes(sim, 0, 1e10, SMOLDYN_TIME_STEP), "smolSetSimTimes");
+	checkSmoldyn(smolSetRandomSeed(sim, 1489333437), "smolSetRandomSeed");
+	for (int d = 0; d < 3; d ++) {
+		checkSmoldyn(smolSetBoundaryType(sim, d, -1, 'r'), "smolSetBoundaryType");
+	}
+	checkSmoldyn(smolSetMaxMolecules(sim, 3 * numMolecules), "smolSetMaxMolecules");
+	const char* species[] = {"A", "B", "C"};
+	for (int s = 0; s < 3; s ++) {
+		checkSmoldyn(smolAddSpecies(sim, species[s], NULL), "smolAddSpecies");
+		checkSmoldyn(smolSetSpeciesMobility(sim, species[s], MSall, 1.0, NULL, NULL), "smolSetSpeciesMobility");
+	}
+	const char* bound[] = {"C"};
+	enum MolecState boundStates[] = {MSsoln};
+	checkSmoldyn(smolAddReaction(sim, "bind", "A", MSsoln, "B", MSsoln, 1, bound, boundStates, 10.0), "smolAddReaction");
+	const char* unbound[] = {"A", "B"};
+	enum MolecState unboundStates[] = {MSsoln, MSsoln};
+	checkSmoldyn(smolAddReaction(sim, "unbind", "C", MSsoln, NULL, MSnone, 2, unbound, unboundStates, 0.1), "smolAddReaction");
+	checkSmoldyn(smolAddSolutionMolecules(sim, "A", numMolecules, low, high), "smolAddSolutionMolecules");
+	checkSmoldyn(smolAddSolutionMolecules(sim, "B", numMolecules, low, high), "smolAddSolutionMolecules");
+	checkSmoldyn(smolUpdateSim(sim), "smolUpdateSim");
+	return sim;
+}
+
+void runSmoldynBenchmarks(BenchReport& report) {
+	string name = "smoldyn.steps";
+	if (!report.isSelected(name)) {
+		return;
+	}
+	int numMolecules = report.getOptions().numMolecules;
+	int numSteps = report.getOptions().numSmoldynSteps;
+	BenchResult result;
+	result.name = name;
+	result.unit = "steps";
+	result.items = numSteps;
+	for (int r = 0; r < report.getOptions().repeat; r ++) {
+		QuietOutput quiet;
+		simptr sim = smoldynModel(numMolecules);
+		double start = benchNow();
+		for (int step = 0; step < numSteps; step ++) {
+			checkSmoldyn(smolRunTimeStep(sim), "smolRunTimeStep");
+		}
+		result.seconds.push_back(benchNow() - start);
+		result.metrics["C"] = smolGetMoleculeCount(sim, "C", MSall);
+		smolFreeSim(sim);
+	}
+	result.metrics["molecules"] = 2 * numMolecules;
+	report.add(result);
+}
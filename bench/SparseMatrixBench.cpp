@@ -0,0 +1,134 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <VCELL/SparseMatrixPCG.h>
+#include <VCELL/SparseKrylovSolver.h>
+#include <VCELL/FVUtils.h>
+#include <random>
+#include <sstream>
+#include <string.h>
+
+#define SPARSE_REL_TOL 1e-8
+#define SPARSE_MAX_ITERATIONS 3000
+
+/*
+ * I + c L for the 5 or 7 point Laplacian L of a box of n points per axis with
+ * no flux boundaries, the implicit diffusion system of the FV solver; symmetric
+ * storage, upper triangle only
+ */
+static SparseMatrixPCG* buildDiffusionMatrix(int dimension, int n, double c) {
+	long strides[3] = {1, n, (long)n * n};
+	long N = dimension == 2 ? (long)n * n : (long)n * n * n;
+	SparseMatrixPCG* A = new SparseMatrixPCG(N, N + dimension * N, MATRIX_SYMMETRIC);
+	for (long index = 0; index < N; index ++) {
+		A->addNewRow();
+		int numNeighbors = 0;
+		bool bUpper[3];
+		for (int a = 0; a < dimension; a ++) {
+			int coord = (int)((index / strides[a]) % n);
+			if (coord > 0) {
+				numNeighbors ++;
+			}
+			bUpper[a] = coord < n - 1;
+			if (bUpper[a]) {
+				numNeighbors ++;
+			}
+		}
+		A->setCol(index, 1 + c * numNeighbors);
+		for (int a = 0; a < dimension; a ++) {
+			if (bUpper[a]) {
+				A->setCol(index + strides[a], -c);
+			}
+		}
+	}
+	A->close();
+	return A;
+}
+
+static void runDiffusionMatrixBenchmarks(BenchReport& report, int dimension, int n) {
+	std::stringstream ss;
+	ss << dimension << "d";
+	string suffix = ss.str();
+	double c = 1.0;
+
+	SparseMatrixPCG* A = buildDiffusionMatrix(dimension, n, c);
+	long N = A->getN();
+	long numNonZeros = 0;
+	for (long i = 0; i < N; i ++) {
+		int32* columns;
+		double* values;
+		numNonZeros += 1 + A->getColumns(i, columns, values);
+	}
+	runBench(report, "sparse.build." + suffix, "nonzeros", (double)numNonZeros, [&]() {
+		delete buildDiffusionMatrix(dimension, n, c);
+	});
+
+	std::mt19937 random(1489333437);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	vector<double> b(N), rhs(N), x(N);
+	for (long i = 0; i < N; i ++) {
+		b[i] = uniform(random);
+	}
+
+	// PCGPAK as SparseLinearSolver calls it, factored again every time
+	if (report.isSelected("sparse.pcgpak." + suffix)) {
+		long nWork = dimension == 2 ? N * 9 : (long)(N * 11.8 + 2208);
+		vector<double> workspace(nWork);
+		int32* ija = A->getFortranIJA();
+		int symmetricFlag = A->getSymmetricFlag();
+		string name = "bench";
+		int returnCode = 0;
+		runBench(report, "sparse.pcgpak." + suffix, "unknowns", (double)N, [&]() {
+			int IParm[75];
+			double RParm[25];
+			memset(IParm, 0, sizeof(IParm));
+			memset(RParm, 0, sizeof(RParm));
+			IParm[4] = SPARSE_MAX_ITERATIONS;
+			IParm[14] = 1;
+			RParm[1] = 1.0;
+			double tolerance = SPARSE_REL_TOL;
+			memcpy(&rhs[0], &b[0], N * sizeof(double));
+			memset(&x[0], 0, N * sizeof(double));
+			double rhsScale = computeRHSscale(N, &rhs[0], name);
+			PCGWRAPPER(&N, &nWork, &symmetricFlag, ija, A->getsa(), &rhs[0], &x[0], &tolerance, IParm, RParm, &workspace[0], &workspace[0], &rhsScale);
+			returnCode = IParm[50];
+			if (returnCode != 0 && IParm[53] > 0) {
+				// as SparseLinearSolver, once more with the workspace PCGPAK asks for
+				nWork += IParm[53];
+				workspace.resize(nWork);
+			}
+		});
+		if (returnCode != 0) {
+			throwPCGExceptions(returnCode, 0);
+		}
+	}
+
+	SparseKrylovSolver* krylov = 0;
+	runBench(report, "sparse.iluSetup." + suffix, "nonzeros", (double)numNonZeros, [&]() {
+		delete krylov;
+		krylov = new SparseKrylovSolver(A, 0);
+	});
+	if (krylov == 0) {
+		krylov = new SparseKrylovSolver(A, 0);
+	}
+	if (report.isSelected("sparse.krylov." + suffix)) {
+		bool bConverged = true;
+		runBench(report, "sparse.krylov." + suffix, "unknowns", (double)N, [&]() {
+			memset(&x[0], 0, N * sizeof(double));
+			bConverged = krylov->solve(&b[0], &x[0], SPARSE_REL_TOL, SPARSE_MAX_ITERATIONS);
+		});
+		if (!bConverged) {
+			throw "sparse.krylov : conjugate gradients didn't converge";
+		}
+	}
+	delete krylov;
+	delete A;
+}
+
+void runSparseMatrixBenchmarks(BenchReport& report) {
+	runDiffusionMatrixBenchmarks(report, 2, report.getOptions().grid2d);
+	runDiffusionMatrixBenchmarks(report, 3, report.getOptions().grid3d);
+}
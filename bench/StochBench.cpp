@@ -0,0 +1,145 @@
+/*
+ * (C) Copyright University of Connecticut Health Center 2001.
+ * All rights reserved.
+ */
+#include "Bench.h"
+
+#include <Gibson.h>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+using std::endl;
+
+#define SPECIES_COUNT 1000
+#define CONVERSION_RATE 1.0
+#define BINDING_RATE 0.001
+
+/*
+ * a ring of species S0 .. Sn-1 with conversions Si -> Si+1 and bindings
+ * Si + Si+1 -> 2 Si, each of about the same propensity, so that every reaction
+ * changes a few propensities as in a real network. Every reaction also adds
+ * one to Events, which no propensity uses: its final value is the number of
+ * reactions of the trial.
+ */
+static string gibsonModel(int numSpecies, double endTime) {
+	std::stringstream ss;
+	ss << "<control>" << endl
+		<< "STARTING_TIME\t0.0" << endl
+		<< "ENDING_TIME\t" << endTime << endl
+		<< "TOLERANCE\t1.0E-9" << endl
+		<< "SAVE_PERIOD\t" << endTime << endl
+		<< "MAX_SAVE_POINTS\t10.0" << endl
+		<< "NUM_TRIAL\t1" << endl
+		<< "SEED\t1489333437" << endl
+		<< "</control>" << endl;
+
+	ss << "<model>" << endl << "<discreteVariables>" << endl
+		<< "TotalVars\t" << numSpecies + 1 << endl;
+	for (int i = 0; i < numSpecies; i ++) {
+		ss << "S" << i << "\t" << SPECIES_COUNT << endl;
+	}
+	ss << "Events\t0" << endl << "</discreteVariables>" << endl << endl;
+
+	int numProcesses = 2 * numSpecies;
+	ss << "<jumpProcesses>" << endl << "TotalProcesses\t" << numProcesses << endl;
+	for (int i = 0; i < numSpecies; i ++) {
+		ss << "c" << i << endl << "b" << i << endl;
+	}
+	ss << "</jumpProcesses>" << endl << endl;
+
+	// conversion ci uses Si and changes Si, Si+1; binding bi uses Si, Si+1 and changes them
+	ss << "<processDesc>" << endl << "TotalDescriptions\t" << numProcesses << endl;
+	for (int i = 0; i < numSpecies; i ++) {
+		int next = (i + 1) % numSpecies;
+		for (int p = 0; p < 2; p ++) {
+			bool bConversion = p == 0;
+			ss << "JumpProcess\t" << (bConversion ? "c" : "b") << i << endl;
+			if (bConversion) {
+				ss << "\tPropensity\t(" << CONVERSION_RATE << " * S" << i << ")" << endl;
+			} else {
+				ss << "\tPropensity\t(" << BINDING_RATE << " * S" << i << " * S" << next << ")" << endl;
+			}
+			ss << "\tEffect\t3" << endl
+				<< "\t\tS" << i << "\tinc\t" << (bConversion ? -1.0 : 1.0) << endl << endl
+				<< "\t\tS" << next << "\tinc\t" << (bConversion ? 1.0 : -1.0) << endl << endl
+				<< "\t\tEvents\tinc\t1.0" << endl << endl;
+			// processes whose propensity uses Si or Si+1
+			std::set<string> dependents;
+			int species[2] = {i, next};
+			for (int s = 0; s < 2; s ++) {
+				int j = species[s];
+				int previous = (j + numSpecies - 1) % numSpecies;
+				std::stringstream c, b, bPrevious;
+				c << "c" << j;
+				b << "b" << j;
+				bPrevious << "b" << previous;
+				dependents.insert(c.str());
+				dependents.insert(b.str());
+				dependents.insert(bPrevious.str());
+			}
+			ss << "\tDependentProcesses\t" << dependents.size() << endl;
+			for (std::set<string>::iterator iter = dependents.begin(); iter != dependents.end(); iter ++) {
+				ss << "\t\t" << *iter << endl;
+			}
+			ss << endl;
+		}
+	}
+	ss << "</processDesc>" << endl << "</model>" << endl;
+	return ss.str();
+}
+
+// the last value of the last line of the output, Events at the end of the trial
+static double readNumEvents(const string& outputFileName) {
+	std::ifstream in(outputFileName.c_str());
+	string line, lastLine;
+	while (getline(in, line)) {
+		if (line.find_first_not_of(" \t\r") != string::npos) {
+			lastLine = line;
+		}
+	}
+	std::stringstream ss(lastLine);
+	double value = 0, numEvents = 0;
+	while (ss >> value) {
+		numEvents = value;
+	}
+	return numEvents;
+}
+
+void runStochBenchmarks(BenchReport& report) {
+	string name = "gibson.steps";
+	if (!report.isSelected(name)) {
+		return;
+	}
+	int numSpecies = report.getOptions().numSpecies;
+	// each species has about CONVERSION_RATE * SPECIES_COUNT reactions per unit of time of each kind
+	double eventsPerTime = numSpecies * (CONVERSION_RATE * SPECIES_COUNT + BINDING_RATE * SPECIES_COUNT * SPECIES_COUNT);
+	double endTime = report.getOptions().numEvents / eventsPerTime;
+
+	string inputFileName = report.getWorkFile("bench_gibson.stochInput");
+	string outputFileName = report.getWorkFile("bench_gibson.stochOutput");
+	std::ofstream input(inputFileName.c_str());
+	input << gibsonModel(numSpecies, endTime);
+	input.close();
+
+	BenchResult result;
+	result.name = name;
+	result.unit = "reactions";
+	result.items = 0;
+	for (int r = 0; r < report.getOptions().repeat; r ++) {
+		QuietOutput quiet;
+		Gibson gibson(inputFileName.c_str(), outputFileName.c_str());
+		double start = benchNow();
+		gibson.march();
+		result.seconds.push_back(benchNow() - start);
+	}
+	result.items = readNumEvents(outputFileName);
+	result.metrics["species"] = numSpecies;
+	result.metrics["processes"] = 2 * numSpecies;
+	report.add(result);
+
+	remove(inputFileName.c_str());
+	remove(outputFileName.c_str());
+	remove((outputFileName + "_hdf5").c_str());
+}
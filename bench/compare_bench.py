@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+#
+# compares two VCellBench JSON reports, a baseline and a candidate, benchmark
+# by benchmark on the fastest of the repeated runs
+#
+#   compare_bench.py baseline.json candidate.json [--threshold 0.05]
+#
+# exits with 1 if a benchmark got slower by more than the threshold
+#
+import argparse
+import json
+import sys
+
+
+def load(fileName):
+    with open(fileName) as f:
+        report = json.load(f)
+    return report, dict((r["name"], r) for r in report["results"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="compare two VCellBench reports")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown reported as a regression (default 0.05)")
+    args = parser.parse_args()
+
+    baseReport, base = load(args.baseline)
+    candReport, cand = load(args.candidate)
+    print("baseline  %s (%s)" % (baseReport.get("version"), baseReport.get("date")))
+    print("candidate %s (%s)" % (candReport.get("version"), candReport.get("date")))
+    print("")
+    print("%-40s %12s %12s %8s" % ("benchmark", "baseline s", "candidate s", "speedup"))
+
+    numRegressions = 0
+    for name in sorted(set(base) | set(cand)):
+        if name not in base or name not in cand:
+            where = "baseline" if name in base else "candidate"
+            print("%-40s only in %s" % (name, where))
+            continue
+        before = base[name]["min_seconds"]
+        after = cand[name]["min_seconds"]
+        if before <= 0 or after <= 0:
+            print("%-40s %12g %12g %8s" % (name, before, after, "-"))
+            continue
+        speedup = before / after
+        flag = ""
+        if after > before * (1 + args.threshold):
+            flag = "  slower"
+            numRegressions += 1
+        elif before > after * (1 + args.threshold):
+            flag = "  faster"
+        print("%-40s %12g %12g %7.2fx%s" % (name, before, after, speedup, flag))
+
+    return 1 if numRegressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())